@@ -26,6 +26,7 @@
 #include "common/log.h"
 #include "common/memory.h"
 #include "common/reset.h"
+#include "common/state.h"
 #include "common/timers.h"
 
 /** @addtogroup BOOTLOADER_UTILS_FILE
@@ -73,9 +74,11 @@ void boot_init(void) {
 
     log_printf("**********\nStart\n**********\n");
 
+    state_init();
+
     // If first power on, setup some data
-    if ((boot_info->init_key != BOOT_INIT_KEY) &&
-        (boot_info->init_key != BOOT_INIT_KEY2)) {
+    if ((state_info->init_key != BOOT_INIT_KEY) &&
+        (state_info->init_key != BOOT_INIT_KEY2)) {
         BOOT_LOG("First Run\n");
 
         // Reset RTC (+Backup Registers)
@@ -85,18 +88,19 @@ void boot_init(void) {
         timers_rtc_lock();
 
         // Boot info
-        mem_eeprom_write_word_ptr(&boot_info->app_init_key, 0);
+        state_info->app_init_key = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_version_to_download, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_num_recovery_attempts, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_done, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_state, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_flags, 0);
+        state_info->upg_in_progress = 0;
+        state_info->upg_version_to_download = 0;
+        state_info->upg_num_recovery_attempts = 0;
+        state_info->upg_new_app_installed = 0;
+        state_info->upg_done = 0;
+        state_info->upg_state = 0;
+        state_info->upg_flags = 0;
 
         // Set initialized
-        mem_eeprom_write_word_ptr(&boot_info->init_key, BOOT_INIT_KEY);
+        state_info->init_key = BOOT_INIT_KEY;
+        state_commit();
     }
 
     serial_printf(".Dev ID: %u\n", boot_info->dev_id);
@@ -123,8 +127,8 @@ void boot_init(void) {
         // Caused by app, not bootloader
         if (mem_read_bkp_reg(BKUP_BOOT_OK) == BOOT_OK_KEY) {
             log_printf(".App\n");
-            mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset,
-                                      boot_info->app_num_iwdg_reset + 1);
+            state_info->app_num_iwdg_reset++;
+            state_commit();
         }
         // Caused by bootloader, much much worse
         else {
@@ -135,8 +139,9 @@ void boot_init(void) {
     else {
         mem_program_bkp_reg(BKUP_NUM_IWDG_RESET, 0);
 
-        if (boot_info->app_num_iwdg_reset) {
-            mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset, 0);
+        if (state_info->app_num_iwdg_reset) {
+            state_info->app_num_iwdg_reset = 0;
+            state_commit();
         }
     }
 
@@ -0,0 +1,107 @@
+/**
+ ******************************************************************************
+ * @file    date.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Date Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "common/date.h"
+
+/** @addtogroup DATE_FILE
+ * @{
+ */
+
+/** @addtogroup DATE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// Days before each month in a non leap year
+static const uint16_t days_before_month[12] = {0,   31,  59,  90,  120, 151,
+                                               181, 212, 243, 273, 304, 334};
+
+// 01/01/1970 to 01/01/2000
+#define DAYS_1970_TO_2000 10957U
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool is_leap_year(uint8_t year);
+
+/** @} */
+
+/** @addtogroup DATE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+uint32_t date_to_timestamp(uint8_t year, uint8_t month, uint8_t day,
+                           uint8_t hours, uint8_t mins, uint8_t secs) {
+    if ((month < 1) || (month > 12) || (day < 1)) {
+        return 0;
+    }
+
+    // Leap days in years before this one, 2000 is a leap year
+    uint32_t days = DAYS_1970_TO_2000 + (365U * year) + ((year + 3U) / 4U);
+    days += days_before_month[month - 1] + (day - 1U);
+    if ((month > 2) && is_leap_year(year)) {
+        days++;
+    }
+
+    return (days * 86400U) + (hours * 3600U) + (mins * 60U) + secs;
+}
+
+void timestamp_to_date(uint32_t timestamp, uint8_t* year, uint8_t* month,
+                       uint8_t* day) {
+    uint32_t days = (timestamp / 86400U) - DAYS_1970_TO_2000;
+
+    *year = 0;
+    while (days >= (is_leap_year(*year) ? 366U : 365U)) {
+        days -= is_leap_year(*year) ? 366U : 365U;
+        (*year)++;
+    }
+
+    *month = 12;
+    while (*month > 1) {
+        uint16_t start = days_before_month[*month - 1];
+        if ((*month > 2) && is_leap_year(*year)) {
+            start++;
+        }
+        if (days >= start) {
+            days -= start;
+            break;
+        }
+        (*month)--;
+    }
+
+    *day = (uint8_t)(days + 1);
+}
+
+/** @} */
+
+/** @addtogroup DATE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool is_leap_year(uint8_t year) { return ((year % 4) == 0); }
+
+/** @} */
+/** @} */
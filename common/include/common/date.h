@@ -0,0 +1,62 @@
+/**
+ ******************************************************************************
+ * @file    date.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Date Header File
+ *
+ * @defgroup   DATE_FILE  Date
+ * @brief      Unix time to & from calendar dates
+ *
+ * Dates are UTC with the year counted from 2000, as the RTC and the SIM800
+ * clock give it. Every fourth year is a leap year, which holds until 2099.
+ *
+ * Kept apart from timers.c so it builds and is tested on the host.
+ *
+ * @{
+ * @defgroup   DATE_API  Date API
+ * @brief
+ *
+ * @defgroup   DATE_INT  Date Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef DATE_H
+#define DATE_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup DATE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Unix time from date, year since 2000, 0 if month or day invalid */
+uint32_t date_to_timestamp(uint8_t year, uint8_t month, uint8_t day,
+                           uint8_t hours, uint8_t mins, uint8_t secs);
+
+/** @brief Date from unix time, year since 2000 */
+void timestamp_to_date(uint32_t timestamp, uint8_t* year, uint8_t* month,
+                       uint8_t* day);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DATE_H
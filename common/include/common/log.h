@@ -92,6 +92,109 @@ extern "C" {
 // Exported Variables
 /*////////////////////////////////////////////////////////////////////////////*/
 
+/** @addtogroup LOG_LEVEL Log Levels
+ * @brief Statements above a level compile away, strings & all
+ *
+ * LOG_LEVEL caps the whole build, LOG_DBG with DEBUG & LOG_INFO without. Each
+ * module has its own threshold as well, e.g. SIM_LOG_LEVEL, which defaults to
+ * LOG_LEVEL. Both can be set with -D. LOG_AT() compares against them at
+ * compile time so a statement above either costs no flash or cycles.
+ *
+ * log_set_level() is the runtime threshold for the EEPROM log, set from the
+ * cloud on the hub. The serial & USB sinks get every statement compiled in
+ * and log_printf() is always stored. serial_printf() is the debug UART and
+ * compiles away without DEBUG.
+ * @{
+ */
+
+#define LOG_NONE 0
+#define LOG_ERR  1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DBG  4
+
+#ifndef LOG_LEVEL
+#ifdef DEBUG
+#define LOG_LEVEL LOG_DBG
+#else
+#define LOG_LEVEL LOG_INFO
+#endif
+#endif
+
+#define LOG_ON(level, mod_level)                                               \
+    (((level) <= LOG_LEVEL) && ((level) <= (mod_level)))
+
+#define LOG_AT(level, mod_level, ...)                                          \
+    do {                                                                       \
+        if (LOG_ON(level, mod_level)) {                                        \
+            LOG_T(level, __VA_ARGS__);                                         \
+        }                                                                      \
+    } while (0)
+
+// Same for statements with %s, always text
+#define LOG_AT_S(level, mod_level, ...)                                        \
+    do {                                                                       \
+        if (LOG_ON(level, mod_level)) {                                        \
+            log_lprintf(level, __VA_ARGS__);                                   \
+        }                                                                      \
+    } while (0)
+
+/** @} */
+
+/** @addtogroup LOG_TOKEN Tokenized Logging
+ * @brief log_printf() without the text
+ *
+ * With LOG_TOKENS defined LOG_T() keeps its format string out of flash in the
+ * .log_fmt section, which the linker script leaves unloaded at address 0. The
+ * string's offset there is its token and only the token & raw arguments go
+ * to the EEPROM log, written by log_token() as
+ *
+ *     LOG_TOKEN_MARK | nargs, token LSB, token MSB, args as LEB128
+ *
+ * Log text is ASCII so the marks can't be mistaken for it and text & tokens
+ * mix freely, e.g. from the bootloader. The build dumps .log_fmt next to the
+ * elf as <app>_log_fmt.bin for host/log_decode.py to print them.
+ *
+ * Arguments must be 32 bit or smaller integers, no %s. Without LOG_TOKENS
+ * LOG_T() is log_lprintf(). Use through LOG_AT().
+ * @{
+ */
+
+#define LOG_TOKEN_MARK     0xF0
+#define LOG_TOKEN_MAX_ARGS 8
+
+#ifdef LOG_TOKENS
+#define LOG_T(level, fmt, ...)                                                 \
+    do {                                                                       \
+        static const char log_fmt_[]                                           \
+            __attribute__((section(".log_fmt"))) = fmt;                        \
+        log_token(level, (uint32_t)(uintptr_t)log_fmt_,                        \
+                  LOG_NARGS(fmt, ##__VA_ARGS__), ##__VA_ARGS__);               \
+    } while (0)
+#else
+#define LOG_T(level, fmt, ...) log_lprintf(level, fmt, ##__VA_ARGS__)
+#endif
+
+// Arguments after the format, up to LOG_TOKEN_MAX_ARGS
+#define LOG_NARGS(...) LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(f, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+/** @} */
+
+/** @brief Where log output goes, DEBUG builds only for SPF & USB
+ *
+ * EEPROM is written a word at a time as each line ends. The UART & USB sinks
+ * queue in RAM and are sent from interrupts, by DMA and 64 byte reports, so
+ * a statement never waits on them. Anything that doesn't fit is counted &
+ * dropped, for EEPROM that is unsent bytes overwritten as the ring wraps.
+ */
+typedef enum log_sink {
+    LOG_SINK_MEM = 0,
+    LOG_SINK_SPF,
+    LOG_SINK_USB,
+    LOG_NUM_SINKS
+} log_sink_t;
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // Exported Function Declarations
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -99,18 +202,41 @@ extern "C" {
 void     log_init(void);
 void     log_end(void);
 void     log_printf(const char* format, ...);
+void     log_lprintf(uint32_t level, const char* format, ...);
+void     log_token(uint32_t level, uint32_t token, uint32_t nargs, ...);
+void     log_set_level(uint8_t level);
+uint8_t  log_get_level(void);
+uint32_t log_dropped(log_sink_t sink);
+void     log_flush(void);
 void     log_error(uint16_t error);
 uint8_t  log_get_byte(uint16_t index);
 void     log_read_reset(void);
 uint8_t  log_read(void);
 uint16_t log_size(void);
+uint16_t log_sent_index(void);
+uint16_t log_unsent(void);
+void     log_mark_sent(uint16_t index);
 void     log_erase(void);
 void     log_create_backup(void);
 void     log_erase_backup(void);
 
+#ifdef DEBUG
 void serial_printf(const char* format, ...);
 bool serial_available(void);
 char serial_read(void);
+#else
+static inline void log_discard(const char* format, ...) { (void)format; }
+
+// Arguments still type checked, nothing is generated
+#define serial_printf(...)                                                     \
+    do {                                                                       \
+        if (0) {                                                               \
+            log_discard(__VA_ARGS__);                                          \
+        }                                                                      \
+    } while (0)
+#define serial_available() false
+#define serial_read()      ((char)0)
+#endif
 
 /** @} */
 
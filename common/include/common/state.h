@@ -0,0 +1,79 @@
+/**
+ ******************************************************************************
+ * @file    state.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Boot State Header File
+ *
+ * @defgroup   STATE_FILE  Boot State
+ * @brief      Bootloader state kept as records rotated across EEPROM
+ *
+ * The upgrade state machine changes several fields at each step. Writing them
+ * one by one to boot_info wore the same cells every upgrade and a brown out
+ * part way through left a mix of old & new. Instead the fields live in RAM,
+ * state_info, and state_commit() saves all of them as one record.
+ *
+ * Each record holds a sequence number & a CRC and goes in the slot after the
+ * last one, so EEPROM_STATE_SIZE is shared out between them. The newest
+ * record with a good CRC is loaded at boot. A record torn by a reset fails
+ * its CRC and the one before it is used, so a step either happened or not.
+ *
+ * With no record yet, e.g. after updating the bootloader, state is seeded
+ * from the old fields in boot_info.
+ *
+ * @{
+ * @defgroup   STATE_API  Boot State API
+ * @brief
+ *
+ * @defgroup   STATE_INT  Boot State Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef STATE_H
+#define STATE_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config/board_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup STATE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief RAM copy, change fields then state_commit() */
+extern state_info_t* state_info;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Load newest good record, or seed from boot_info if none */
+void state_init(void);
+
+/** @brief Save state_info as the next record, nothing written if unchanged */
+bool state_commit(void);
+
+void state_print(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATE_H
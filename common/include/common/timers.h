@@ -91,6 +91,9 @@ extern "C" {
 void timers_rtc_init(void);
 void timers_rtc_set_time(uint8_t year, uint8_t month, uint8_t day,
                          uint8_t hours, uint8_t mins, uint8_t secs);
+/** @brief Unix time from RTC, 0 if RTC has not been set */
+uint32_t timers_rtc_get_timestamp(void);
+void     timers_rtc_set_timestamp(uint32_t timestamp);
 void timers_set_wakeup_time(uint32_t wakeup_time);
 void timers_clear_wakeup_flag(void);
 void timers_enable_wut_interrupt(void);
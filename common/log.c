@@ -19,6 +19,7 @@
 
 #include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/flash.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
@@ -30,7 +31,7 @@
 #include "common/timers.h"
 #include "config/board_defs.h"
 
-#ifdef _HUB
+#ifdef COOLEASE_DEVICE_HUB
 #include "hub/cusb.h"
 #endif
 
@@ -50,20 +51,60 @@
 static uint16_t write_index;
 static uint16_t read_index;
 
-#define LOG_SIZE (EEPROM_LOG_SIZE - 8)
+// Start of bytes not yet uploaded, pushed along if the ring wraps onto it
+static uint16_t sent_index;
+static uint32_t mem_dropped;
+
+// Power of two so indexes wrap with a mask
+#define LOG_SIZE EEPROM_LOG_SIZE
+#define LOG_MASK (LOG_SIZE - 1)
+
+#if (LOG_SIZE & LOG_MASK)
+#error "LOG: Ring size must be a power of two"
+#endif
+
+// Characters wait here & go to EEPROM a word at a time, on a newline, when
+// full or on log_flush(). A byte write costs as much as a word
+#define LOG_STAGE_SIZE 32
+
+static uint8_t stage[LOG_STAGE_SIZE];
+static uint8_t stage_len;
+
+// Runtime threshold for EEPROM, off for the statement being printed if above
+static uint8_t mem_level = LOG_LEVEL;
+static bool    mem_on = true;
+
+#ifdef DEBUG
+// TX drained by DMA, RX filled by the USART interrupt. Full TX drops
+#define SPF_TX_SIZE 256
+#define SPF_RX_SIZE 64
+
+static char     spf_tx_buf[SPF_TX_SIZE];
+static char     spf_rx_buf[SPF_RX_SIZE];
+static uint16_t spf_tx_head = 0;
+static uint16_t spf_tx_tail = 0;
+static uint16_t spf_tx_dma = 0; // Bytes from tail in flight, 0 if idle
+static uint8_t  spf_rx_head = 0;
+static uint8_t  spf_rx_tail = 0;
+static uint32_t spf_dropped = 0;
+#endif
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // Static Function Declarations
 /*////////////////////////////////////////////////////////////////////////////*/
 
+static void vlog(uint32_t level, const char* format, va_list va);
 static void _putchar_main(char character);
 static void _putchar_mem(char character);
+static void stage_put(uint8_t byte);
 
 #ifdef DEBUG
 static void usart_setup(void);
 static void usart_end(void);
 static void _putchar_spf(char character);
-#ifdef _HUB
+static void spf_kick(void);
+static void sinks_kick(void);
+#ifdef COOLEASE_DEVICE_HUB
 static void _putchar_usb(char character);
 #endif
 #endif
@@ -79,8 +120,15 @@ static void _putchar_usb(char character);
 /*////////////////////////////////////////////////////////////////////////////*/
 
 void log_init(void) {
-    write_index = log_file->idx % LOG_SIZE;
+    write_index = log_info->idx & LOG_MASK;
     read_index = write_index;
+    stage_len = 0;
+
+    // Not valid e.g. new layout, upload whole ring once
+    sent_index = log_info->sent;
+    if (sent_index >= LOG_SIZE) {
+        sent_index = (write_index + 1) & LOG_MASK;
+    }
 
 #ifdef DEBUG
     usart_setup();
@@ -92,8 +140,17 @@ void log_init(void) {
 }
 
 void log_end(void) {
+    uint32_t spf = log_dropped(LOG_SINK_SPF);
+    uint32_t usb = log_dropped(LOG_SINK_USB);
+
+    if (mem_dropped || spf || usb) {
+        log_printf("LOG: drop %u %u %u\n", mem_dropped, spf, usb);
+    }
+
+    log_flush();
+
     // Update write location
-    mem_eeprom_write_half_word((uint32_t)&log_file->idx, write_index);
+    mem_eeprom_write_half_word((uint32_t)&log_info->idx, write_index);
 
 #ifdef DEBUG
     usart_end();
@@ -103,16 +160,104 @@ void log_end(void) {
 void log_printf(const char* format, ...) {
     va_list va;
     va_start(va, format);
-    fnprintf(_putchar_main, format, va);
+    vlog(LOG_NONE, format, va);
     va_end(va);
 }
 
+void log_lprintf(uint32_t level, const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    vlog(level, format, va);
+    va_end(va);
+}
+
+void log_token(uint32_t level, uint32_t token, uint32_t nargs, ...) {
+    // EEPROM only, see LOG_T()
+    if (level > mem_level) {
+        return;
+    }
+
+    va_list va;
+    va_start(va, nargs);
+
+    stage_put((uint8_t)(LOG_TOKEN_MARK | nargs));
+    stage_put((uint8_t)(token >> 0));
+    stage_put((uint8_t)(token >> 8));
+
+    // 7 bits a byte, top bit set if more follow. Most args fit in one or two
+    for (uint32_t i = 0; i < nargs; i++) {
+        uint32_t arg = va_arg(va, uint32_t);
+
+        while (arg >= 0x80) {
+            stage_put((uint8_t)(arg | 0x80));
+            arg >>= 7;
+        }
+        stage_put((uint8_t)arg);
+    }
+
+    va_end(va);
+
+    // Same as a line of text
+    log_flush();
+}
+
+void log_flush(void) {
+    uint8_t i = 0;
+
+    while (i < stage_len) {
+        // Ring is word aligned & a whole number of words, never wraps mid word
+        uint32_t offset = write_index & 3;
+        uint32_t address = (uint32_t)&log_file->log[write_index - offset];
+        uint32_t word = *(volatile uint32_t*)address;
+
+        for (; (offset < 4) && (i < stage_len); offset++, i++) {
+            word &= ~(0xFFU << (offset * 8));
+            word |= (uint32_t)stage[i] << (offset * 8);
+
+            write_index = (write_index + 1) & LOG_MASK;
+
+            // Oldest unsent byte overwritten
+            if (write_index == sent_index) {
+                sent_index = (sent_index + 1) & LOG_MASK;
+                mem_dropped++;
+            }
+        }
+
+        mem_eeprom_write_word(address, word);
+    }
+
+    stage_len = 0;
+}
+
+void log_set_level(uint8_t level) {
+    mem_level = (level > LOG_DBG) ? LOG_DBG : level;
+}
+
+uint8_t log_get_level(void) { return mem_level; }
+
+uint32_t log_dropped(log_sink_t sink) {
+    switch (sink) {
+    case LOG_SINK_MEM:
+        return mem_dropped;
+#ifdef DEBUG
+    case LOG_SINK_SPF:
+        return spf_dropped;
+#ifdef COOLEASE_DEVICE_HUB
+    case LOG_SINK_USB:
+        return cusb_dropped();
+#endif
+#endif
+    default:
+        return 0;
+    }
+}
+
 void log_error(uint16_t error) { log_printf("LError %4x\n", error); }
 
 uint8_t log_get_byte(uint16_t index) {
     uint8_t byte;
 
-    if (index > LOG_SIZE) {
+    if (index >= LOG_SIZE) {
         byte = 0;
     } else {
         byte = log_file->log[index];
@@ -124,7 +269,7 @@ uint8_t log_get_byte(uint16_t index) {
 uint8_t log_read(void) {
     uint8_t byte;
 
-    read_index = (read_index + 1) % LOG_SIZE;
+    read_index = (read_index + 1) & LOG_MASK;
 
     if (read_index == write_index) {
         byte = 0;
@@ -137,19 +282,44 @@ uint8_t log_read(void) {
     return byte;
 }
 
-void log_read_reset(void) { read_index = write_index; }
+void log_read_reset(void) {
+    log_flush();
+    read_index = write_index;
+}
 
 uint16_t log_size(void) { return LOG_SIZE; }
 
+uint16_t log_sent_index(void) {
+    log_flush();
+    return sent_index;
+}
+
+uint16_t log_unsent(void) {
+    log_flush();
+    return (write_index - sent_index) & LOG_MASK;
+}
+
+void log_mark_sent(uint16_t index) {
+    log_flush();
+    sent_index = index & LOG_MASK;
+
+    // Write index saved as well so a reset carries on from here
+    mem_eeprom_write_half_word((uint32_t)&log_info->sent, sent_index);
+    mem_eeprom_write_half_word((uint32_t)&log_info->idx, write_index);
+}
+
 void log_erase(void) {
     serial_printf("Log Erase Start: %8x\n", &(log_file->log[0]));
-    for (write_index = 0; write_index < LOG_SIZE; write_index++) {
-        mem_eeprom_write_byte((uint32_t)(&(log_file->log[write_index])), 0);
+    stage_len = 0;
+    for (write_index = 0; write_index < LOG_SIZE; write_index += 4) {
+        mem_eeprom_write_word((uint32_t)(&(log_file->log[write_index])), 0);
     }
 
     // Update write location
     write_index = 0;
-    mem_eeprom_write_half_word((uint32_t)&log_file->idx, write_index);
+    sent_index = 0;
+    mem_eeprom_write_half_word((uint32_t)&log_info->idx, write_index);
+    mem_eeprom_write_half_word((uint32_t)&log_info->sent, sent_index);
 }
 
 void log_create_backup(void) {
@@ -183,34 +353,56 @@ void log_erase_backup(void) {
 // Static Function Definitions
 /*////////////////////////////////////////////////////////////////////////////*/
 
+// LOG_NONE for log_printf(), always stored
+static void vlog(uint32_t level, const char* format, va_list va) {
+    mem_on = (level <= mem_level);
+
+#ifndef DEBUG
+    // Nowhere else for it to go
+    if (!mem_on) {
+        return;
+    }
+#endif
+
+    fnprintf(_putchar_main, format, va);
+
+    mem_on = true;
+
+#ifdef DEBUG
+    sinks_kick();
+#endif
+}
+
 static void _putchar_main(char character) {
-    _putchar_mem(character);
+    if (mem_on) {
+        _putchar_mem(character);
+    }
 
 #ifdef DEBUG
     _putchar_spf(character);
-#ifdef _HUB
+#ifdef COOLEASE_DEVICE_HUB
     _putchar_usb(character);
 #endif
 #endif
 }
 
 static void _putchar_mem(char character) {
-    mem_eeprom_write_byte((uint32_t) & (log_file->log[write_index]), character);
+    stage_put((uint8_t)character);
 
-    write_index = (write_index + 1) % LOG_SIZE;
+    if (character == '\n') {
+        log_flush();
+    }
 }
 
-#ifdef DEBUG
+static void stage_put(uint8_t byte) {
+    stage[stage_len++] = byte;
 
-#define SPF_BUFFER_SIZE 64
-
-static char    spf_tx_buf[SPF_BUFFER_SIZE];
-static char    spf_rx_buf[SPF_BUFFER_SIZE];
-static uint8_t spf_tx_head = 0;
-static uint8_t spf_tx_tail = 0;
-static uint8_t spf_rx_head = 0;
-static uint8_t spf_rx_tail = 0;
+    if (stage_len == sizeof(stage)) {
+        log_flush();
+    }
+}
 
+#ifdef DEBUG
 static void usart_setup(void) {
     rcc_periph_clock_enable(SPF_USART_RCC);
     rcc_periph_reset_pulse(SPF_USART_RCC_RST);
@@ -238,6 +430,31 @@ static void usart_setup(void) {
     gpio_set_output_options(SPF_USART_TX_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_2MHZ,
                             SPF_USART_TX);
 
+    // TX DMA, memory address & length set per transfer by spf_kick()
+    rcc_periph_clock_enable(RCC_DMA);
+    dma_channel_reset(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    dma_set_channel_request(DMA1, SPF_USART_DMA_TX_CHANNEL,
+                            SPF_USART_DMA_TX_REQ);
+    dma_set_read_from_memory(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    dma_set_priority(DMA1, SPF_USART_DMA_TX_CHANNEL, DMA_CCR_PL_LOW);
+    dma_set_peripheral_address(DMA1, SPF_USART_DMA_TX_CHANNEL,
+                               (uint32_t)&USART_TDR(SPF_USART));
+    dma_set_peripheral_size(DMA1, SPF_USART_DMA_TX_CHANNEL,
+                            DMA_CCR_PSIZE_8BIT);
+    dma_disable_peripheral_increment_mode(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    dma_set_memory_size(DMA1, SPF_USART_DMA_TX_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_enable_memory_increment_mode(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    dma_enable_transfer_complete_interrupt(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    usart_enable_tx_dma(SPF_USART);
+
+    spf_tx_head = 0;
+    spf_tx_tail = 0;
+    spf_tx_dma = 0;
+
+    nvic_clear_pending_irq(SPF_DMA_NVIC);
+    nvic_set_priority(SPF_DMA_NVIC, IRQ_PRIORITY_SPF);
+    nvic_enable_irq(SPF_DMA_NVIC);
+
     usart_enable_rx_interrupt(SPF_USART);
 
     nvic_clear_pending_irq(SPF_USART_NVIC);
@@ -250,6 +467,16 @@ static void usart_end(void) {
     nvic_disable_irq(SPF_USART_NVIC);
     usart_disable_rx_interrupt(SPF_USART);
 
+    // Let queued output go, a full buffer takes 22 ms at 115200
+    for (uint8_t i = 0; (i < 30) && (spf_tx_head != spf_tx_tail); i++) {
+        timers_delay_milliseconds(1);
+    }
+
+    nvic_disable_irq(SPF_DMA_NVIC);
+    usart_disable_tx_dma(SPF_USART);
+    dma_disable_channel(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    dma_channel_reset(DMA1, SPF_USART_DMA_TX_CHANNEL);
+
     gpio_mode_setup(SPF_USART_RX_PORT, GPIO_MODE_ANALOG, GPIO_PUPD_NONE,
                     SPF_USART_RX);
     gpio_mode_setup(SPF_USART_TX_PORT, GPIO_MODE_ANALOG, GPIO_PUPD_NONE,
@@ -260,37 +487,46 @@ static void usart_end(void) {
     rcc_periph_clock_disable(SPF_USART_RCC);
 }
 
+// Called from interrupts too, e.g. USB callbacks
 static void _putchar_spf(char character) {
-    bool done = false;
+    uint32_t masked = cm_mask_interrupts(1);
+
+    uint16_t next = (spf_tx_head + 1) % SPF_TX_SIZE;
 
-    // send immediatly if tx buffer empty
-    if ((spf_tx_head == spf_tx_tail) &&
-        usart_get_flag(SPF_USART, USART_ISR_TXE)) {
-        usart_send(SPF_USART, character);
-        done = true;
+    if (next == spf_tx_tail) {
+        spf_dropped++;
     } else {
-        while (!done) {
-            cm_disable_interrupts();
+        spf_tx_buf[spf_tx_head] = character;
+        spf_tx_head = next;
+    }
 
-            uint8_t i = (spf_tx_head + 1) % SPF_BUFFER_SIZE;
+    cm_mask_interrupts(masked);
+}
 
-            if (i == spf_tx_tail) {
-                done = false;
-                cm_enable_interrupts();
-                timers_delay_milliseconds(1);
-            } else {
+// Start DMA on the bytes up to the head or the end of the buffer
+static void spf_kick(void) {
+    uint32_t masked = cm_mask_interrupts(1);
 
-                spf_tx_buf[spf_tx_head] = character;
+    if ((spf_tx_dma == 0) && (spf_tx_head != spf_tx_tail)) {
+        spf_tx_dma = (spf_tx_head > spf_tx_tail) ? (spf_tx_head - spf_tx_tail)
+                                                 : (SPF_TX_SIZE - spf_tx_tail);
 
-                spf_tx_head = i;
+        dma_disable_channel(DMA1, SPF_USART_DMA_TX_CHANNEL);
+        dma_set_memory_address(DMA1, SPF_USART_DMA_TX_CHANNEL,
+                               (uint32_t)&spf_tx_buf[spf_tx_tail]);
+        dma_set_number_of_data(DMA1, SPF_USART_DMA_TX_CHANNEL, spf_tx_dma);
+        dma_enable_channel(DMA1, SPF_USART_DMA_TX_CHANNEL);
+    }
 
-                usart_enable_tx_interrupt(SPF_USART);
+    cm_mask_interrupts(masked);
+}
 
-                done = true;
-            }
-            cm_enable_interrupts();
-        }
-    }
+// Statement done, let the sinks send what they have
+static void sinks_kick(void) {
+    spf_kick();
+#ifdef COOLEASE_DEVICE_HUB
+    cusb_flush();
+#endif
 }
 
 void serial_printf(const char* format, ...) {
@@ -298,10 +534,12 @@ void serial_printf(const char* format, ...) {
     va_start(va, format);
     fnprintf(_putchar_spf, format, va);
     va_end(va);
+
+    spf_kick();
 }
 
 bool serial_available(void) {
-    return (((spf_rx_head + SPF_BUFFER_SIZE - spf_rx_tail) % SPF_BUFFER_SIZE));
+    return (((spf_rx_head + SPF_RX_SIZE - spf_rx_tail) % SPF_RX_SIZE));
 }
 
 char serial_read(void) {
@@ -309,7 +547,7 @@ char serial_read(void) {
 
     if (serial_available()) {
         c = spf_rx_buf[spf_rx_tail];
-        spf_rx_tail = (spf_rx_tail + 1) % SPF_BUFFER_SIZE;
+        spf_rx_tail = (spf_rx_tail + 1) % SPF_RX_SIZE;
     }
 
     return c;
@@ -319,40 +557,31 @@ SPF_ISR() {
     // Received data from serial monitor
     // Read data (clears flag automatically)
     if (usart_get_flag(SPF_USART, USART_ISR_RXNE)) {
-        if (((spf_rx_head + 1) % SPF_BUFFER_SIZE) == spf_rx_tail) {
+        if (((spf_rx_head + 1) % SPF_RX_SIZE) == spf_rx_tail) {
             // Read overflow
             usart_recv(SPF_USART);
         } else {
             spf_rx_buf[spf_rx_head] = usart_recv(SPF_USART);
-
-            // if (spf_rx_buf[spf_rx_head] == '\n')
-            // {
-            // 	spf_rx_buf[spf_rx_head + 1] = '\0'
-            // }
-
-            spf_rx_head = (spf_rx_head + 1) % SPF_BUFFER_SIZE;
+            spf_rx_head = (spf_rx_head + 1) % SPF_RX_SIZE;
         }
     }
+}
 
-    // Transmit buffer empty
-    // Fill it (clears flag automatically)
-    if (usart_get_flag(SPF_USART, USART_ISR_TXE)) {
-        // Fill it if data waiting
-        if ((SPF_BUFFER_SIZE + spf_tx_head - spf_tx_tail) % SPF_BUFFER_SIZE) {
-            usart_send(SPF_USART, spf_tx_buf[spf_tx_tail]);
-            spf_tx_tail = (spf_tx_tail + 1) % SPF_BUFFER_SIZE;
-        }
-        // Otherwise tranfer is done, disable interrupt (prevent irq firing
-        // constantly waiting for TX Data Reg to be filled)
-        else {
-            usart_disable_tx_interrupt(SPF_USART);
-        }
+SPF_DMA_ISR() {
+    if (dma_get_interrupt_flag(DMA1, SPF_USART_DMA_TX_CHANNEL, DMA_TCIF)) {
+        dma_clear_interrupt_flags(DMA1, SPF_USART_DMA_TX_CHANNEL, DMA_TCIF);
+
+        spf_tx_tail = (spf_tx_tail + spf_tx_dma) % SPF_TX_SIZE;
+        spf_tx_dma = 0;
+
+        // Rest of a wrapped buffer or anything added meanwhile
+        spf_kick();
     }
 }
 
-#ifdef _HUB
+#ifdef COOLEASE_DEVICE_HUB
 static void _putchar_usb(char character) { cusb_send(character); }
-#endif // _HUB
+#endif // COOLEASE_DEVICE_HUB
 #endif // DEBUG
 
 /** @} */
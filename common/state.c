@@ -0,0 +1,183 @@
+/**
+ ******************************************************************************
+ * @file    state.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Boot State Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "common/state.h"
+
+#include <string.h>
+
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "common/log.h"
+#include "common/memory.h"
+
+/** @addtogroup STATE_FILE
+ * @{
+ */
+
+/** @addtogroup STATE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef STATE_LOG_LEVEL
+#define STATE_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define STATE_LOG(level, ...)                                                  \
+    LOG_AT(level, STATE_LOG_LEVEL, "STATE: " __VA_ARGS__)
+
+typedef struct state_rec_s {
+    uint32_t     seq;
+    state_info_t info;
+    uint32_t     crc; /**< Over seq & info, written last */
+} state_rec_t;
+
+#define REC_WORDS (sizeof(state_rec_t) / 4)
+#define NUM_RECS  (EEPROM_STATE_SIZE / sizeof(state_rec_t))
+
+static state_info_t ram;
+state_info_t*       state_info = &ram;
+
+// Newest good record, NUM_RECS if none yet
+static uint8_t  last_slot = NUM_RECS;
+static uint32_t last_seq = 0;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static state_rec_t* slot_rec(uint8_t slot);
+static bool         rec_ok(const state_rec_t* rec);
+static uint32_t     rec_crc(const state_rec_t* rec);
+
+/** @} */
+
+/** @addtogroup STATE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void state_init(void) {
+    last_slot = NUM_RECS;
+    last_seq = 0;
+
+    for (uint8_t i = 0; i < NUM_RECS; i++) {
+        state_rec_t* rec = slot_rec(i);
+
+        if (rec_ok(rec) &&
+            ((last_slot == NUM_RECS) || ((int32_t)(rec->seq - last_seq) > 0))) {
+            last_slot = i;
+            last_seq = rec->seq;
+        }
+    }
+
+    if (last_slot < NUM_RECS) {
+        memcpy(&ram, &slot_rec(last_slot)->info, sizeof(ram));
+    } else {
+        // Same order as the variable part of boot_info_t
+        STATE_LOG(LOG_WARN, "no record, from boot info\n");
+        memcpy(&ram, (const void*)&boot_info->init_key, sizeof(ram));
+    }
+
+    state_print();
+}
+
+bool state_commit(void) {
+    if ((last_slot < NUM_RECS) &&
+        (0 == memcmp(&slot_rec(last_slot)->info, &ram, sizeof(ram)))) {
+        return true;
+    }
+
+    uint8_t     slot = (last_slot + 1) % NUM_RECS;
+    state_rec_t rec = {.seq = last_seq + 1, .info = ram};
+    rec.crc = rec_crc(&rec);
+
+    // Overwrites the oldest record, the newest stays good until this one is.
+    // Words matching the old record are skipped by mem_eeprom_write_word()
+    uint32_t* words = (uint32_t*)&rec;
+    uint32_t  address = (uint32_t)slot_rec(slot);
+
+    for (uint8_t i = 0; i < REC_WORDS; i++) {
+        if (false == mem_eeprom_write_word(address + (i * 4), words[i])) {
+            STATE_LOG(LOG_ERR, "ERR write %u\n", slot);
+            return false;
+        }
+    }
+
+    if (false == rec_ok(slot_rec(slot))) {
+        STATE_LOG(LOG_ERR, "ERR verify %u\n", slot);
+        return false;
+    }
+
+    last_slot = slot;
+    last_seq = rec.seq;
+
+    STATE_LOG(LOG_DBG, "rec %u seq %u upg %u\n", slot, last_seq,
+              ram.upg_state);
+
+    return true;
+}
+
+void state_print(void) {
+    STATE_LOG(LOG_INFO, "rec %u seq %u\n", last_slot, last_seq);
+    STATE_LOG(LOG_INFO, "upg %u %u flags %8x\n",
+              (ram.upg_in_progress == BOOT_UPGRADE_IN_PROGRESS_KEY),
+              ram.upg_state, ram.upg_flags);
+    STATE_LOG(LOG_INFO, "app v%u next v%u prev v%u\n", ram.app_version,
+              ram.app_update_version, ram.app_previous_version);
+}
+
+/** @} */
+
+/** @addtogroup STATE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static state_rec_t* slot_rec(uint8_t slot) {
+    return (state_rec_t*)(EEPROM_STATE_BASE + (slot * sizeof(state_rec_t)));
+}
+
+// Blank eeprom reads 0, never a good CRC
+static bool rec_ok(const state_rec_t* rec) {
+    return (rec->crc == rec_crc(rec));
+}
+
+static uint32_t rec_crc(const state_rec_t* rec) {
+    rcc_periph_clock_enable(RCC_CRC);
+    crc_reset();
+    crc_set_reverse_input(CRC_CR_REV_IN_BYTE);
+    crc_reverse_output_enable();
+    CRC_INIT = 0xFFFFFFFF;
+
+    uint32_t crc = ~crc_calculate_block((uint32_t*)rec, REC_WORDS - 1);
+
+    crc_reset();
+    rcc_periph_clock_disable(RCC_CRC);
+
+    return crc;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,98 @@
+#include <stdint.h>
+
+#include "date.h"
+#include "unity.h"
+
+#define SECS_PER_DAY 86400U
+
+// 2000-01-01 & 2099-12-31, the range the year since 2000 leap rule holds for
+#define FIRST_DAY (946684800U / SECS_PER_DAY)
+#define LAST_DAY  (4102358400U / SECS_PER_DAY)
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static void assert_date(uint32_t timestamp, uint8_t year, uint8_t month,
+                        uint8_t day) {
+    uint8_t y, m, d;
+
+    timestamp_to_date(timestamp, &y, &m, &d);
+
+    TEST_ASSERT_EQUAL_UINT8(year, y);
+    TEST_ASSERT_EQUAL_UINT8(month, m);
+    TEST_ASSERT_EQUAL_UINT8(day, d);
+}
+
+void test_date_to_timestamp_known_dates(void) {
+    TEST_ASSERT_EQUAL_UINT32(946684800U, date_to_timestamp(0, 1, 1, 0, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(951825600U,
+                             date_to_timestamp(0, 2, 29, 12, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(1612359432U,
+                             date_to_timestamp(21, 2, 3, 13, 37, 12));
+    TEST_ASSERT_EQUAL_UINT32(1709164800U,
+                             date_to_timestamp(24, 2, 29, 0, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(4102444799U,
+                             date_to_timestamp(99, 12, 31, 23, 59, 59));
+}
+
+void test_date_to_timestamp_invalid(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, date_to_timestamp(21, 0, 1, 0, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, date_to_timestamp(21, 13, 1, 0, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, date_to_timestamp(21, 1, 0, 0, 0, 0));
+}
+
+void test_timestamp_to_date_edges(void) {
+    assert_date(946684800U, 0, 1, 1);
+    assert_date(951825600U, 0, 2, 29);
+    assert_date(951868800U, 0, 3, 1);
+    assert_date(4102444799U, 99, 12, 31);
+
+    // Last second of a day is still that day
+    assert_date(983404799U, 1, 2, 28);
+    assert_date(983404800U, 1, 3, 1);
+    assert_date(1104537599U, 4, 12, 31);
+    assert_date(1104537600U, 5, 1, 1);
+}
+
+void test_month_boundaries(void) {
+    static const uint8_t days_in_month[12] = {31, 28, 31, 30, 31, 30,
+                                              31, 31, 30, 31, 30, 31};
+
+    for (uint8_t year = 0; year < 100; year++) {
+        for (uint8_t month = 1; month <= 12; month++) {
+            uint8_t last = days_in_month[month - 1];
+            if ((month == 2) && ((year % 4) == 0)) {
+                last++;
+            }
+
+            uint32_t end = date_to_timestamp(year, month, last, 23, 59, 59);
+            assert_date(end, year, month, last);
+
+            // Next second starts the next month
+            if (month == 12) {
+                assert_date(end + 1, year + 1, 1, 1);
+            } else {
+                assert_date(end + 1, year, month + 1, 1);
+            }
+        }
+    }
+}
+
+void test_round_trip_every_day(void) {
+    for (uint32_t days = FIRST_DAY; days <= LAST_DAY; days++) {
+        uint32_t timestamp = (days * SECS_PER_DAY) + 12345U;
+        uint8_t  year, month, day;
+
+        timestamp_to_date(timestamp, &year, &month, &day);
+
+        uint32_t secs = timestamp % SECS_PER_DAY;
+        TEST_ASSERT_EQUAL_UINT32(timestamp,
+                                 date_to_timestamp(year, month, day,
+                                                   secs / 3600,
+                                                   (secs / 60) % 60,
+                                                   secs % 60));
+    }
+}
@@ -0,0 +1,218 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "state.h"
+#include "unity.h"
+
+// Same layout as state_rec_t in state.c
+typedef struct rec_s {
+    uint32_t     seq;
+    state_info_t info;
+    uint32_t     crc;
+} rec_t;
+
+#define NUM_RECS (EEPROM_STATE_SIZE / sizeof(rec_t))
+#define RECS     ((rec_t*)EEPROM_STATE_BASE)
+
+#define PAGE 4096U
+
+boot_info_t* boot_info = (boot_info_t*)EEPROM_BOOT_INFO_BASE;
+
+static uint32_t crc_val;
+static uint32_t writes;
+static int32_t  writes_left;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Fakes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken) { (void)clken; }
+void rcc_periph_clock_disable(enum rcc_periph_clken clken) { (void)clken; }
+
+void crc_reset(void) { crc_val = 0xFFFFFFFF; }
+void crc_set_reverse_input(uint32_t reverse_in) { (void)reverse_in; }
+void crc_reverse_output_enable(void) {}
+
+// Byte reversed input & output, as set up by state.c, is the usual CRC-32
+uint32_t crc_calculate_block(uint32_t* datap, int size) {
+    for (int i = 0; i < size; i++) {
+        crc_val ^= datap[i];
+        for (uint8_t b = 0; b < 32; b++) {
+            crc_val = (crc_val >> 1) ^ (0xEDB88320 & -(crc_val & 1));
+        }
+    }
+
+    return crc_val;
+}
+
+// Skips words already set like the real one, stops after writes_left to tear
+bool mem_eeprom_write_word(uint32_t address, uint32_t data) {
+    uint32_t* word = (uint32_t*)(uintptr_t)address;
+
+    if (*word == data) {
+        return true;
+    }
+
+    if (writes_left == 0) {
+        return true;
+    } else if (writes_left > 0) {
+        writes_left--;
+    }
+
+    *word = data;
+    writes++;
+
+    return true;
+}
+
+void log_lprintf(uint32_t level, const char* format, ...) {
+    (void)level;
+    (void)format;
+}
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Helpers
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void map_page(uint32_t address) {
+    void* want = (void*)(uintptr_t)(address & ~(PAGE - 1));
+    void* page = mmap(want, PAGE, PROT_READ | PROT_WRITE,
+                      MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    TEST_ASSERT_EQUAL_PTR(want, page);
+}
+
+static void put_rec(uint8_t slot, uint32_t seq, uint32_t upg_state) {
+    rec_t rec = {.seq = seq};
+
+    rec.info.upg_state = upg_state;
+
+    crc_reset();
+    rec.crc = ~crc_calculate_block((uint32_t*)&rec, (sizeof(rec) / 4) - 1);
+
+    memcpy(&RECS[slot], &rec, sizeof(rec));
+}
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Tests
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void setUp(void) {
+    // EEPROM & the CRC peripheral, state.c sets CRC_INIT directly
+    map_page(EEPROM_START);
+    map_page(CRC_BASE);
+
+    memset((void*)EEPROM_START, 0, EEPROM_SIZE);
+
+    writes = 0;
+    writes_left = -1;
+}
+
+void tearDown(void) {
+    munmap((void*)(uintptr_t)EEPROM_START, PAGE);
+    munmap((void*)(uintptr_t)CRC_BASE, PAGE);
+}
+
+void test_blank_eeprom_seeded_from_boot_info(void) {
+    boot_info->init_key = BOOT_INIT_KEY2;
+    boot_info->upg_state = 7;
+    boot_info->app_version = 3;
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(BOOT_INIT_KEY2, state_info->init_key);
+    TEST_ASSERT_EQUAL_UINT32(7, state_info->upg_state);
+    TEST_ASSERT_EQUAL_UINT32(3, state_info->app_version);
+
+    // Once committed the record is used, not boot_info
+    TEST_ASSERT_TRUE(state_commit());
+    boot_info->upg_state = 9;
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(7, state_info->upg_state);
+}
+
+void test_newest_record_across_seq_wrap(void) {
+    put_rec(0, 0xFFFFFFFE, 1);
+    put_rec(1, 0xFFFFFFFF, 2);
+    put_rec(2, 0, 3);
+    put_rec(3, 1, 4);
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(4, state_info->upg_state);
+
+    // Next goes after it & wins from then on
+    state_info->upg_state = 5;
+    TEST_ASSERT_TRUE(state_commit());
+    TEST_ASSERT_EQUAL_UINT32(2, RECS[4].seq);
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(5, state_info->upg_state);
+}
+
+void test_torn_record_falls_back(void) {
+    state_init();
+
+    state_info->upg_state = 1;
+    TEST_ASSERT_TRUE(state_commit());
+
+    // Reset part way through the next one, CRC is written last
+    state_info->upg_state = 2;
+    writes_left = 2;
+    state_commit();
+    writes_left = -1;
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(1, state_info->upg_state);
+
+    // Whole record with a bad CRC is the same
+    state_info->upg_state = 3;
+    TEST_ASSERT_TRUE(state_commit());
+    state_info->upg_state = 4;
+    TEST_ASSERT_TRUE(state_commit());
+    RECS[3].crc ^= 1;
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(3, state_info->upg_state);
+}
+
+void test_unchanged_commit_writes_nothing(void) {
+    state_init();
+
+    state_info->upg_state = 1;
+    TEST_ASSERT_TRUE(state_commit());
+    TEST_ASSERT_NOT_EQUAL(0, writes);
+
+    writes = 0;
+    TEST_ASSERT_TRUE(state_commit());
+    TEST_ASSERT_EQUAL_UINT32(0, writes);
+
+    // Nor after a reset
+    state_init();
+    TEST_ASSERT_TRUE(state_commit());
+    TEST_ASSERT_EQUAL_UINT32(0, writes);
+}
+
+void test_every_slot_used_in_turn(void) {
+    state_init();
+
+    for (uint32_t i = 1; i <= (2 * NUM_RECS); i++) {
+        state_info->upg_state = i;
+        TEST_ASSERT_TRUE(state_commit());
+        TEST_ASSERT_EQUAL_UINT32(i, RECS[i % NUM_RECS].info.upg_state);
+    }
+
+    state_init();
+
+    TEST_ASSERT_EQUAL_UINT32(2 * NUM_RECS, state_info->upg_state);
+}
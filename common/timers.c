@@ -16,6 +16,7 @@
 
 #include "common/aes.h"
 #include "common/battery.h"
+#include "common/date.h"
 #include "common/log.h"
 #include "common/reset.h"
 #include "common/rf_scan.h"
@@ -126,6 +127,42 @@ void timers_rtc_set_time(uint8_t year, uint8_t month, uint8_t day,
     timers_rtc_lock();
 }
 
+uint32_t timers_rtc_get_timestamp(void) {
+    // Never set since backup domain reset
+    if (!(RTC_ISR & RTC_ISR_INITS)) {
+        return 0;
+    }
+
+    // Reading TR locks DR until it is read
+    uint32_t tr = RTC_TR;
+    uint32_t dr = RTC_DR;
+
+    uint8_t secs = (((tr >> RTC_TR_ST_SHIFT) & RTC_TR_ST_MASK) * 10) +
+                   ((tr >> RTC_TR_SU_SHIFT) & RTC_TR_SU_MASK);
+    uint8_t mins = (((tr >> RTC_TR_MNT_SHIFT) & RTC_TR_MNT_MASK) * 10) +
+                   ((tr >> RTC_TR_MNU_SHIFT) & RTC_TR_MNU_MASK);
+    uint8_t hours = (((tr >> RTC_TR_HT_SHIFT) & RTC_TR_HT_MASK) * 10) +
+                    ((tr >> RTC_TR_HU_SHIFT) & RTC_TR_HU_MASK);
+    uint8_t day = (((dr >> RTC_DR_DT_SHIFT) & RTC_DR_DT_MASK) * 10) +
+                  ((dr >> RTC_DR_DU_SHIFT) & RTC_DR_DU_MASK);
+    uint8_t month = (((dr >> RTC_DR_MT_SHIFT) & RTC_DR_MT_MASK) * 10) +
+                    ((dr >> RTC_DR_MU_SHIFT) & RTC_DR_MU_MASK);
+    uint8_t year = (((dr >> RTC_DR_YT_SHIFT) & RTC_DR_YT_MASK) * 10) +
+                   ((dr >> RTC_DR_YU_SHIFT) & RTC_DR_YU_MASK);
+
+    return date_to_timestamp(year, month, day, hours, mins, secs);
+}
+
+void timers_rtc_set_timestamp(uint32_t timestamp) {
+    uint32_t secs = timestamp % 86400U;
+    uint8_t  year, month, day;
+
+    timestamp_to_date(timestamp, &year, &month, &day);
+
+    timers_rtc_set_time(year, month, day, secs / 3600, (secs / 60) % 60,
+                        secs % 60);
+}
+
 void timers_set_wakeup_time(uint32_t wakeup_time) {
     timers_rtc_unlock();
 
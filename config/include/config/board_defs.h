@@ -45,9 +45,11 @@ extern enum rcc_osc sys_clk;
 #define EEPROM_APP_INFO_SIZE        256U
 #define EEPROM_LOG_SIZE             1024U
 #define EEPROM_SHARED_INFO_SIZE     64U
+#define EEPROM_LOG_INFO_SIZE        8U
+#define EEPROM_STATE_SIZE           440U
 
 // Check EEPROM memory large enough
-#if ((EEPROM_SHARED_INFO_SIZE + EEPROM_BOOT_INFO_SIZE + EEPROM_APP_INFO_SIZE + EEPROM_LOG_SIZE) > EEPROM_SIZE)
+#if ((EEPROM_SHARED_INFO_SIZE + EEPROM_BOOT_INFO_SIZE + EEPROM_APP_INFO_SIZE + EEPROM_LOG_SIZE + EEPROM_LOG_INFO_SIZE + EEPROM_STATE_SIZE) > EEPROM_SIZE)
 #warning "EEPROM: Data does not fit"
 #endif
 
@@ -59,7 +61,7 @@ extern enum rcc_osc sys_clk;
 #define EEPROM_APP_INFO_BASE            EEPROM_BOOT_INFO_END
 #define EEPROM_APP_INFO_END             (EEPROM_APP_INFO_BASE + EEPROM_APP_INFO_SIZE)
 
-// Logging
+// Logging, ring only, power of two
 #define EEPROM_LOG_BASE                 EEPROM_APP_INFO_END
 #define EEPROM_LOG_END                  (EEPROM_LOG_BASE + EEPROM_LOG_SIZE)
 // Backup log in flash
@@ -69,6 +71,14 @@ extern enum rcc_osc sys_clk;
 #define EEPROM_SHARED_INFO_BASE         EEPROM_LOG_END
 #define EEPROM_SHARED_INFO_END          (EEPROM_SHARED_INFO_BASE + EEPROM_SHARED_INFO_SIZE)
 
+// Log indexes, after shared info to keep that where it was
+#define EEPROM_LOG_INFO_BASE            EEPROM_SHARED_INFO_END
+#define EEPROM_LOG_INFO_END             (EEPROM_LOG_INFO_BASE + EEPROM_LOG_INFO_SIZE)
+
+// Boot state records, rest of eeprom, see common/state.h
+#define EEPROM_STATE_BASE               EEPROM_LOG_INFO_END
+#define EEPROM_STATE_END                (EEPROM_STATE_BASE + EEPROM_STATE_SIZE)
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // RTC Backup Registers
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -104,6 +114,8 @@ extern enum rcc_osc sys_clk;
 #define BOOT_UPGRADE_DONE_KEY 0xACD15FE6
 
 #define APP_INIT_KEY 0x1357ACDE
+#define DATA_USAGE_KEY 0x5A3C96E1
+#define REMOTE_CFG_KEY 0x3C7E19A6
 
 
 typedef struct
@@ -133,7 +145,8 @@ typedef struct
 	uint8_t	 aes_key[16];
 	char 	 pwd[33];
 
-	// Variable
+	// Variable, old bootloaders only. Now kept in state_info_t records,
+	// read once to seed them
 	uint32_t init_key;
 
 	uint32_t upg_in_progress;
@@ -154,6 +167,53 @@ typedef struct
 	uint32_t app_previous_version;
 } boot_info_t;
 
+// Bootloader state, changed together & saved as one record, see common/state.h
+typedef struct
+{
+	uint32_t init_key;
+
+	uint32_t upg_in_progress;
+	uint32_t upg_new_app_installed;
+	uint32_t upg_done;
+	uint32_t upg_state;
+	uint32_t upg_flags;
+
+	uint32_t upg_version_to_download;
+	uint32_t upg_num_recovery_attempts;
+
+	uint32_t app_init_key;
+	uint32_t app_ok_key;
+	uint32_t app_num_iwdg_reset;
+	uint32_t app_num_fail_runs;
+	uint32_t app_version;
+	uint32_t app_update_version;
+	uint32_t app_previous_version;
+} state_info_t;
+
+// Cellular data usage, bytes, saved periodically by the app
+typedef struct
+{
+	uint32_t key;
+	uint32_t day;		// Days since 1970
+	uint32_t month;		// Months since 2000
+	uint32_t day_bytes;
+	uint32_t month_bytes;
+	uint32_t total_tx;
+	uint32_t total_rx;
+	uint32_t total_overhead;
+} data_usage_info_t;
+
+// Config pushed by cloud, see hub/remote_cfg.h for the keys
+#define REMOTE_CFG_NUM_VALS 5
+#define REMOTE_CFG_URL_SIZE 64
+
+typedef struct
+{
+	uint32_t key;
+	int32_t  vals[REMOTE_CFG_NUM_VALS];
+	char 	 url[REMOTE_CFG_URL_SIZE];
+} remote_cfg_info_t;
+
 typedef struct
 {
 	uint32_t init_key;
@@ -162,25 +222,36 @@ typedef struct
 	uint32_t registered_key;
 	uint8_t  aes_key[16];
 	char 	 pwd[33];
+	char 	 alarm_sms[17]; // +447..., set by cloud
+	uint32_t data_budget_kb; // Monthly, 0 for no limit, set by cloud
+	data_usage_info_t data_usage;
+	remote_cfg_info_t remote_cfg;
 } app_info_t;
 
 typedef struct
 {
-	uint16_t size;
 	uint16_t idx;
-	uint8_t log[];
+	uint16_t sent;	// First byte not yet uploaded
+} log_info_t;
+
+typedef struct
+{
+	uint8_t log[EEPROM_LOG_SIZE];
 } log_t;
 
 // Uncomment to check size
 // uint32_t size = sizeof(shared_info_t);
 // uint32_t size = sizeof(boot_info_t);
+// uint32_t size = sizeof(state_info_t);
 // uint32_t size = sizeof(app_info_t);
 // uint32_t size = sizeof(log_t);
+// uint32_t size = sizeof(log_info_t);
 
 extern shared_info_t *shared_info;
 extern boot_info_t *boot_info;
 extern app_info_t *app_info;
 extern log_t *log_file;
+extern log_info_t *log_info;
 
 
 #ifdef COOLEASE_DEVICE_HUB
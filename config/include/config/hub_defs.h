@@ -24,6 +24,14 @@ typedef struct
 	uint16_t battery;
 	int16_t temperature;
 	int16_t rssi;
+	uint32_t timestamp;
+	uint32_t rx_millis;
+	int16_t alarm_low;
+	int16_t alarm_high;
+	uint16_t alarm_rate; // 0.01 C per minute, 0 is off
+	bool alarm_active;
+	bool alarm_pend;
+	bool alarm_appended;
 	bool msg_pend;
 	bool msg_appended;
 	bool active;
@@ -53,6 +61,11 @@ typedef struct
 #define SPF_USART_RX_PORT GPIOA
 #define SPF_USART_RX GPIO10
 #define SPF_ISR() void usart1_isr(void)
+#define SPF_USART_DMA_TX_CHANNEL DMA_CHANNEL4
+#define SPF_USART_DMA_TX_REQ 3
+// DMA1 channels 4 to 7 share a vector with SIM RX, called from SIM_DMA_ISR()
+#define SPF_DMA_NVIC NVIC_DMA1_CHANNEL4_7_IRQ
+#define SPF_DMA_ISR() void spf_dma_isr(void)
 
 // RFM
 // SPI
@@ -105,6 +118,12 @@ typedef struct
 #define SIM_USART_NVIC NVIC_USART2_IRQ
 #define SIM_ISR() void usart2_isr(void)
 #define SIM_USART_BAUD 38400
+// Fixed rate negotiated with AT+IPR and saved in SIM800, 38400 is fallback
+#define SIM_USART_BAUD_FAST 115200
+#define SIM_USART_DMA_RX_CHANNEL DMA_CHANNEL5
+#define SIM_USART_DMA_RX_REQ 4
+#define SIM_DMA_NVIC NVIC_DMA1_CHANNEL4_7_IRQ
+#define SIM_DMA_ISR() void dma1_channel4_7_isr(void)
 
 #define SIM_USART_TX_PORT GPIOA
 #define SIM_USART_TX GPIO2
@@ -132,4 +151,20 @@ typedef struct
 #define W25_SPI_MOSI GPIO5
 
 #define W25_SPI_SCK_PORT GPIOB
-#define W25_SPI_SCK GPIO3
\ No newline at end of file
+#define W25_SPI_SCK GPIO3
+
+// Bulk transfers, polled so no interrupts
+#define W25_SPI_DMA_RX_CHANNEL DMA_CHANNEL2
+#define W25_SPI_DMA_TX_CHANNEL DMA_CHANNEL3
+#define W25_SPI_DMA_REQ 1
+
+// Firmware slots A, B & golden, header sector + 32 KB image each
+#define W25_FW_SLOT_START_SECTOR 0
+#define W25_FW_SLOT_NUM_SECTORS 9
+
+// Reading journal, upper 512 KB of external flash
+#define W25_JOURNAL_START_SECTOR 128
+#define W25_JOURNAL_NUM_SECTORS 128
+
+// Sectors from 0 tracked in the erased map, 2 bits of RAM each
+#define W25_MAP_NUM_SECTORS 256
@@ -22,6 +22,10 @@
 #define SPF_USART_RCC RCC_USART2
 #define SPF_USART_RCC_RST RST_USART2
 #define SPF_ISR() void usart2_isr(void)
+#define SPF_USART_DMA_TX_CHANNEL DMA_CHANNEL4
+#define SPF_USART_DMA_TX_REQ 4
+#define SPF_DMA_NVIC NVIC_DMA1_CHANNEL4_7_IRQ
+#define SPF_DMA_ISR() void dma1_channel4_7_isr(void)
 
 // GPIOA
 #define SPF_USART_TX_PORT GPIOA
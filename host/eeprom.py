@@ -12,7 +12,7 @@ class bin_section(object):
         self.data = data
 
 
-def generate_eeprom(dev_id, device_type, vtor, aes_key, pwd, log_size):
+def generate_eeprom(dev_id, device_type, vtor, aes_key, pwd):
     vtor = int(vtor, 16)
     aes_key = bytes.fromhex(aes_key)
     pwd = bytes(pwd, "utf-8") + bytes(0)
@@ -30,8 +30,16 @@ def generate_eeprom(dev_id, device_type, vtor, aes_key, pwd, log_size):
         ),
     )
     app = bin_section("app", 256, struct.pack("<I", 0))
-    log = bin_section("log", 1024, struct.pack("<HH", log_size, 0))
+    # Ring only, indexes are in log_info
+    log = bin_section("log", 1024, bytes(0))
     shared = bin_section("shared", 64, struct.pack("<I", 0))
+    # idx, sent
+    log_info = bin_section("log_info", 8, struct.pack("<HH", 0, 0))
+    # No record yet, bootloader seeds one from boot
+    state = bin_section("state", 440, bytes(0))
+
+    # Same order as config/board_defs.h
+    sections = [boot, app, log, shared, log_info, state]
 
     # Special case, default eeprom file
     if dev_id == 0:
@@ -53,21 +61,14 @@ def generate_eeprom(dev_id, device_type, vtor, aes_key, pwd, log_size):
 
         locator = 0
 
-        eeprom.seek(locator)
-        eeprom.write(boot.data)
-        locator += boot.size
-
-        eeprom.seek(locator)
-        eeprom.write(app.data)
-        locator += app.size
-
-        eeprom.seek(locator)
-        eeprom.write(log.data)
-        locator += log.size
+        for section in sections:
+            eeprom.seek(locator)
+            eeprom.write(section.data)
+            locator += section.size
 
-        eeprom.seek(locator)
-        eeprom.write(shared.data)
-        locator += shared.size
+        if locator > 2048:
+            print("Error: EEPROM sections too big " + str(locator))
+            exit()
 
 
 # Append meta info to hub app binary
@@ -201,7 +202,6 @@ def generate_app(device_type, bin_type):
             vtor="0x08008000",
             aes_key=_aes_key,
             pwd=_pwd,
-            log_size=1020,
         )
 
 
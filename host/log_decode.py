@@ -0,0 +1,212 @@
+"""
+Hub log upload decoder
+
+Log uploads carry only the bytes written since the last acknowledged upload,
+starting at ring index log_idx. With HUB_LOG_LZ the bytes are compressed by
+hub/lz.c and sent as unpadded URL safe base64 in logz, otherwise as plain text
+in log.
+
+Release builds log LOG_T() statements as tokens, a mark byte with the
+argument count, the offset of the format string in the .log_fmt section and
+the arguments as LEB128. --fmt takes the section dumped next to the elf by the
+build and prints them as the firmware would have. It has to come from the
+same build as the app that wrote the log, text from the bootloader passes
+through as is.
+
+Example:
+    python host/log_decode.py "EAAATkVUOiAu..."
+    python host/log_decode.py --file upload.txt
+    python host/log_decode.py --file upload.txt --fmt hub_Release_log_fmt.bin
+"""
+
+import argparse
+import base64
+import sys
+
+MIN_MATCH = 3
+
+# common/include/common/log.h
+LOG_TOKEN_MARK = 0xF0
+LOG_TOKEN_MAX_ARGS = 8
+
+
+def lz_decompress(data):
+    """Groups of a flag byte then up to 8 items, set bit means match"""
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        flags = data[i]
+        i += 1
+
+        for bit in range(8):
+            if i >= len(data):
+                break
+
+            if flags & (1 << bit):
+                if i + 1 >= len(data):
+                    raise ValueError("match cut short at {}".format(i))
+                dist = data[i] + 1
+                length = data[i + 1] + MIN_MATCH
+                i += 2
+                if dist > len(out):
+                    raise ValueError("match before start at {}".format(i))
+                # Byte by byte, a match can run on into itself
+                for _ in range(length):
+                    out.append(out[-dist])
+            else:
+                out.append(data[i])
+                i += 1
+
+    return bytes(out)
+
+
+def decode_logz(text):
+    text = text.strip()
+    return lz_decompress(base64.urlsafe_b64decode(text + "=" * (-len(text) % 4)))
+
+
+def fmt_string(table, token):
+    if token >= len(table):
+        return None
+    end = table.find(b"\0", token)
+    return table[token : end if end >= 0 else len(table)].decode(errors="replace")
+
+
+def ntoa(value, base, width, negative):
+    """Same output as _ntoa_format() in common/printf.c"""
+    digits = ""
+    while True:
+        digit = value % base
+        digits = "0123456789ABCDEF"[digit] + digits
+        value //= base
+        if not value:
+            break
+    digits = digits.rjust(width, "0")
+    if base == 16:
+        digits = "0X" + digits
+    elif base == 2:
+        digits = "0b" + digits
+    return ("-" if negative else "") + digits
+
+
+def render(fmt, args):
+    """Format like fnprintf() in common/printf.c, %[width]specifier only"""
+    out = ""
+    args = list(args)
+    i = 0
+
+    while i < len(fmt):
+        if fmt[i] != "%":
+            out += fmt[i]
+            i += 1
+            continue
+        i += 1
+
+        width = 0
+        while i < len(fmt) and fmt[i].isdigit():
+            width = width * 10 + int(fmt[i])
+            i += 1
+        if i >= len(fmt):
+            break
+        spec = fmt[i]
+        i += 1
+
+        if spec == "%":
+            out += "%"
+            continue
+        if spec not in "diuxXobcsp":
+            out += spec
+            continue
+        if not args:
+            out += "<?>"
+            continue
+        arg = args.pop(0)
+
+        if spec in "di":
+            val = arg - (1 << 32) if arg & 0x80000000 else arg
+            out += ntoa(abs(val), 10, width, val < 0)
+        elif spec in "uxXob":
+            base = {"x": 16, "X": 16, "o": 8, "b": 2}.get(spec, 10)
+            out += ntoa(arg, base, width, False)
+        elif spec == "p":
+            out += ntoa(arg, 16, 8, False)
+        elif spec == "c":
+            out += chr(arg & 0xFF)
+        else:
+            out += "<str>"
+
+    return out
+
+
+def detokenize(data, table):
+    """Log bytes with tokens back to text, text passes through"""
+    out = ""
+    text = bytearray()
+    i = 0
+
+    while i < len(data):
+        byte = data[i]
+        nargs = byte - LOG_TOKEN_MARK
+
+        if not 0 <= nargs <= LOG_TOKEN_MAX_ARGS:
+            text.append(byte)
+            i += 1
+            continue
+
+        out += text.decode(errors="replace")
+        text = bytearray()
+
+        if i + 3 > len(data):
+            out += "<cut>\n"
+            break
+        token = data[i + 1] | (data[i + 2] << 8)
+        i += 3
+
+        args = []
+        while len(args) < nargs and i < len(data):
+            arg = 0
+            shift = 0
+            while i < len(data):
+                arg |= (data[i] & 0x7F) << shift
+                shift += 7
+                i += 1
+                if not data[i - 1] & 0x80:
+                    break
+            args.append(arg & 0xFFFFFFFF)
+
+        fmt = fmt_string(table, token)
+        if fmt is None:
+            out += "<token {} {}>\n".format(token, args)
+        else:
+            out += render(fmt, args)
+
+    return out + text.decode(errors="replace")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode hub logz upload")
+    parser.add_argument("logz", nargs="?", type=str, help="logz value")
+    parser.add_argument("--file", type=str, help="Read logz value from file")
+    parser.add_argument("--fmt", type=str, help="<app>_log_fmt.bin for tokens")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "r") as file:
+            text = file.read()
+    elif args.logz:
+        text = args.logz
+    else:
+        text = sys.stdin.read()
+
+    data = decode_logz(text)
+
+    if args.fmt:
+        with open(args.fmt, "rb") as file:
+            sys.stdout.write(detokenize(data, file.read()))
+    else:
+        sys.stdout.write(data.decode(errors="replace"))
+
+
+if __name__ == "__main__":
+    main()
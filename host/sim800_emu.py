@@ -0,0 +1,749 @@
+"""
+SIM800 AT command emulator
+
+Speaks the subset of AT commands used by hub/sim.c so that the hub net_task and
+the bootloader net_task can be exercised without a modem or SIM data.
+
+The emulator either creates a pseudo terminal (default, for host tools) or opens
+a serial port (--port) e.g. a USB-UART wired to the hub SIM800 header, in which
+case the hub firmware runs unmodified against it.
+
+HTTP requests are answered by a built in backend that serves app binaries from
+hub/bin/store and fixed responses, or are forwarded to a local server with
+--backend.
+
+Example:
+    python host/sim800_emu.py --latency 20 --reg-delay 5 --stats stats.json
+"""
+
+import argparse
+import json
+import os
+import pty
+import random
+import re
+import select
+import signal
+import termios
+import time
+import tty
+import urllib.error
+import urllib.request
+
+BAUD_RATES = {
+    1200: termios.B1200,
+    2400: termios.B2400,
+    4800: termios.B4800,
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: termios.B460800,
+}
+
+CTRL_Z = 0x1A
+ESC = 0x1B
+
+# GSM 07.10 basic option, control fields without the poll/ final bit
+CMUX_FLAG = 0xF9
+CMUX_PF = 0x10
+CMUX_SABM = 0x2F
+CMUX_UA = 0x63
+CMUX_DM = 0x0F
+CMUX_DISC = 0x43
+CMUX_UIH = 0xEF
+CMUX_MSG_CLD = 0xC3
+CMUX_N1 = 127
+
+
+def cmux_fcs(data):
+    """Reflected CRC-8 as used for the frame check sequence"""
+    fcs = 0xFF
+    for byte in data:
+        fcs ^= byte
+        for _ in range(8):
+            fcs = (fcs >> 1) ^ 0xE0 if fcs & 0x01 else fcs >> 1
+    return fcs
+
+
+def cmux_frame(dlci, control, info=b""):
+    header = bytes([(dlci << 2) | 0x03, control, (len(info) << 1) | 0x01])
+    fcs = 0xFF - cmux_fcs(header)
+    return bytes([CMUX_FLAG]) + header + bytes(info) + bytes([fcs, CMUX_FLAG])
+
+
+class CmuxDecoder(object):
+    """Splits the byte stream into (dlci, control, info) frames"""
+
+    def __init__(self):
+        self.state = "flag"
+        self.header = bytearray()
+        self.info = bytearray()
+        self.fcs = 0
+
+    def feed(self, byte):
+        frame = None
+
+        if self.state == "flag":
+            if byte == CMUX_FLAG:
+                self.state = "header"
+                self.header = bytearray()
+        elif self.state == "header":
+            # Repeated flags between frames
+            if byte == CMUX_FLAG and not self.header:
+                return None
+            self.header.append(byte)
+            if len(self.header) == 3:
+                self.info = bytearray()
+                self.state = "info" if byte >> 1 else "fcs"
+        elif self.state == "info":
+            self.info.append(byte)
+            if len(self.info) == self.header[2] >> 1:
+                self.state = "fcs"
+        elif self.state == "fcs":
+            self.fcs = byte
+            self.state = "end"
+        elif self.state == "end":
+            if byte == CMUX_FLAG and cmux_fcs(self.header + bytes([self.fcs])) == 0xCF:
+                frame = (self.header[0] >> 2, self.header[1], bytes(self.info))
+            self.state = "header" if byte == CMUX_FLAG else "flag"
+            self.header = bytearray()
+
+        return frame
+
+
+class Stats(object):
+    """Timing of the interesting parts of a session, for benchmarks"""
+
+    def __init__(self):
+        self.start = time.monotonic()
+        self.commands = 0
+        self.errors_injected = 0
+        self.bytes_rx = 0
+        self.bytes_tx = 0
+        self.first_at = None
+        self.registered = None
+        self.bearer_open = None
+        self.http_data = []  # (bytes, seconds)
+        self.http_read = []  # (bytes, seconds)
+        self.actions = []  # (method, status, bytes, seconds)
+
+    def mark(self, name):
+        if getattr(self, name) is None:
+            setattr(self, name, time.monotonic() - self.start)
+
+    def summary(self):
+        data_bytes = sum(b for b, _ in self.http_data)
+        data_time = sum(t for _, t in self.http_data)
+        read_bytes = sum(b for b, _ in self.http_read)
+        read_time = sum(t for _, t in self.http_read)
+        return {
+            "commands": self.commands,
+            "errors_injected": self.errors_injected,
+            "bytes_rx": self.bytes_rx,
+            "bytes_tx": self.bytes_tx,
+            "first_at_s": self.first_at,
+            "registered_s": self.registered,
+            "bearer_open_s": self.bearer_open,
+            "http_actions": self.actions,
+            "upload_bytes": data_bytes,
+            "upload_Bps": data_bytes / data_time if data_time else 0,
+            "download_bytes": read_bytes,
+            "download_Bps": read_bytes / read_time if read_time else 0,
+        }
+
+
+class Backend(object):
+    """Built in HTTP server stand in
+
+    POST with version=<n> returns <bin_dir>/hub_<n>.bin or NoBin, version=get
+    returns the latest version, anything else returns the fixed response.
+    """
+
+    def __init__(self, url=None, bin_dir="hub/bin/store", latest=0, response=""):
+        self.url = url
+        self.bin_dir = bin_dir
+        self.latest = latest
+        self.response = response.encode()
+
+    def request(self, method, url, body):
+        if self.url is not None:
+            return self.forward(method, body)
+
+        text = body.decode(errors="replace")
+        print("HTTP {} {} {}".format(method, url, text), flush=True)
+
+        match = re.search(r"version=\s*(\d+|get)", text)
+        if match is None:
+            return 200, self.response
+        elif match.group(1) == "get":
+            return 200, "version={}".format(self.latest).encode()
+
+        filename = os.path.join(
+            self.bin_dir, "hub_{0:03}.bin".format(int(match.group(1)))
+        )
+        if os.path.isfile(filename):
+            with open(filename, "rb") as file:
+                return 200, file.read()
+        return 200, b"NoBin"
+
+    def forward(self, method, body):
+        req = urllib.request.Request(
+            self.url, data=body if method == "POST" else None, method=method
+        )
+        req.add_header("Content-Type", "application/x-www-form-urlencoded")
+        try:
+            with urllib.request.urlopen(req, timeout=30) as resp:
+                return resp.status, resp.read()
+        except urllib.error.HTTPError as err:
+            return err.code, err.read()
+        except (urllib.error.URLError, OSError):
+            return 603, b""
+
+
+class Sim800(object):
+    """Modem state and AT command handling"""
+
+    def __init__(self, link, backend, args):
+        self.link = link
+        self.backend = backend
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.stats = Stats()
+
+        self.fail = {}
+        for item in args.fail:
+            cmd, _, count = item.partition(":")
+            self.fail[cmd.upper()] = int(count) if count else -1
+
+        self.line = bytearray()
+        self.raw = None  # (remaining bytes, callback) while taking raw data
+        self.pending = []  # (due time, bytes, dlci) for URCs
+        self.next_urc = time.monotonic() + args.urc_interval
+        self.power_on()
+
+    def power_on(self):
+        self.echo = True
+        self.cfun = 1
+        self.clts = self.args.clts
+        self.csclk = 0
+        self.ipr = self.args.ipr
+        self.powered = True
+        self.boot_time = time.monotonic()
+        self.bearer = 3  # closed
+        self.bearer_params = {}
+        self.http_init = False
+        self.http_params = {}
+        self.http_ssl = 0
+        self.http_data = b""
+        self.http_response = b""
+        self.sms_ref = 0
+
+        # Multiplexer, each DLCI has its own command line & raw data state
+        self.mux = None
+        self.dlci = 0
+        self.chans = {}
+
+        # Fixed baud rate modems announce themselves
+        if self.ipr != 0:
+            self.link.set_baud(self.ipr)
+            self.urc("RDY", 0.5)
+
+    # Link
+
+    def send(self, data, dlci=None):
+        if isinstance(data, str):
+            data = data.encode()
+        if self.mux is not None:
+            dlci = self.dlci if dlci is None else dlci
+            data = b"".join(
+                cmux_frame(dlci, CMUX_UIH, data[i : i + CMUX_N1])
+                for i in range(0, len(data), CMUX_N1)
+            )
+        self.stats.bytes_tx += len(data)
+        self.link.write(data)
+
+    def reply(self, *lines):
+        for line in lines:
+            self.send("\r\n" + line + "\r\n")
+
+    def urc(self, line, delay):
+        # Sent on the channel that issued the command
+        self.pending.append(
+            (time.monotonic() + delay, "\r\n" + line + "\r\n", self.dlci)
+        )
+
+    def poll(self):
+        now = time.monotonic()
+        due = [p for p in self.pending if p[0] <= now]
+        self.pending = [p for p in self.pending if p[0] > now]
+        for _, data, dlci in sorted(due):
+            self.send(data, dlci)
+
+        # Unsolicited status e.g. to check it does not corrupt HTTP data, goes
+        # to the first channel when multiplexed
+        if self.args.urc_interval and now >= self.next_urc:
+            self.next_urc = now + self.args.urc_interval
+            if self.powered:
+                self.send("\r\n+CSQN: {},0\r\n".format(self.args.rssi), 1)
+
+        # Power down then back up again e.g. hub resetting modem
+        if not self.powered and now - self.boot_time > self.args.boot_delay:
+            self.power_on()
+
+    def receive(self, data):
+        self.stats.bytes_rx += len(data)
+
+        if not self.powered:
+            return
+
+        for byte in data:
+            if self.mux is not None:
+                frame = self.mux.feed(byte)
+                if frame:
+                    self.frame(*frame)
+                continue
+
+            self.byte(byte)
+
+    def byte(self, byte):
+        if self.raw is not None:
+            self.raw_byte(byte)
+            return
+
+        if self.echo:
+            self.send(bytes([byte]))
+
+        if byte == ord("\r"):
+            line = self.line.decode(errors="replace").strip()
+            self.line = bytearray()
+            if line:
+                self.command(line)
+        elif byte != ord("\n"):
+            self.line.append(byte)
+
+    def raw_byte(self, byte):
+        remaining, done = self.raw
+        remaining.append(byte)
+        if done(remaining):
+            self.raw = None
+
+    # Multiplexer
+
+    def frame(self, dlci, control, info):
+        control &= ~CMUX_PF
+
+        if control in (CMUX_SABM, CMUX_DISC):
+            self.send_frame(dlci, CMUX_UA | CMUX_PF)
+        elif control == CMUX_UIH and dlci == 0:
+            # Close down, reply then back to AT commands
+            if info[:1] == bytes([CMUX_MSG_CLD]):
+                self.send_frame(0, CMUX_UIH, bytes([CMUX_MSG_CLD & ~0x02, 0x01]))
+                self.mux = None
+                self.select(0)
+        elif control == CMUX_UIH:
+            self.select(dlci)
+            for byte in info:
+                self.byte(byte)
+
+    def send_frame(self, dlci, control, info=b""):
+        data = cmux_frame(dlci, control, info)
+        self.stats.bytes_tx += len(data)
+        self.link.write(data)
+
+    def select(self, dlci):
+        if dlci != self.dlci:
+            self.chans[self.dlci] = (self.line, self.raw)
+            self.line, self.raw = self.chans.pop(dlci, (bytearray(), None))
+            self.dlci = dlci
+
+    # Commands
+
+    def command(self, line):
+        self.stats.commands += 1
+        self.stats.mark("first_at")
+
+        upper = line.upper()
+        if not upper.startswith("AT"):
+            return
+
+        if self.args.latency:
+            time.sleep(self.args.latency / 1000.0)
+
+        match = re.match(r"AT([+&]?[A-Z]*)(=\?|\?|=)?(.*)$", line, re.IGNORECASE)
+        name = match.group(1).upper()
+        op = match.group(2) or ""
+        val = match.group(3)
+
+        # Error injection
+        count = self.fail.get(name)
+        if count is not None and count != 0:
+            self.fail[name] = count - 1
+            self.stats.errors_injected += 1
+            self.reply("ERROR")
+            return
+        if self.rng.random() < self.args.drop_rate:
+            self.stats.errors_injected += 1
+            return
+        if self.rng.random() < self.args.error_rate:
+            self.stats.errors_injected += 1
+            self.reply("ERROR")
+            return
+
+        # ATE0 / ATE1
+        if name == "E":
+            self.echo = val == "1"
+            self.reply("OK")
+            return
+
+        key = {"": "at", "I": "ati", "&W": "at"}.get(name, name.strip("+").lower())
+        handler = getattr(self, "cmd_" + key, None)
+        if handler is None:
+            self.reply("ERROR")
+            return
+
+        handler(op, val)
+
+    def cmd_at(self, op, val):
+        self.reply("OK")
+
+    def cmd_ati(self, op, val):
+        self.reply("SIM800 R14.18", "OK")
+
+    def cmd_gcap(self, op, val):
+        self.reply("+GCAP: +CGSM", "OK")
+
+    def cmd_ipr(self, op, val):
+        if op == "?":
+            self.reply("+IPR: {}".format(self.ipr), "OK")
+        elif op == "=" and val.isdigit() and (int(val) in BAUD_RATES or val == "0"):
+            self.reply("OK")
+            self.link.drain()
+            self.ipr = int(val)
+            if self.ipr:
+                self.link.set_baud(self.ipr)
+        else:
+            self.reply("ERROR")
+
+    def cmd_cfun(self, op, val):
+        if op == "?":
+            self.reply("+CFUN: {}".format(self.cfun), "OK")
+        elif op == "=":
+            self.cfun = int(val.split(",")[0])
+            if self.cfun != 1:
+                self.bearer = 3
+            self.reply("OK")
+
+    def cmd_clts(self, op, val):
+        if op == "?":
+            self.reply("+CLTS: {}".format(self.clts), "OK")
+        else:
+            self.clts = int(val)
+            self.reply("OK")
+
+    def cmd_cclk(self, op, val):
+        stamp = time.strftime("%y/%m/%d,%H:%M:%S", time.gmtime())
+        self.reply('+CCLK: "{}+00"'.format(stamp), "OK")
+
+    def cmd_csclk(self, op, val):
+        if op == "?":
+            self.reply("+CSCLK: {}".format(self.csclk), "OK")
+        else:
+            self.csclk = int(val)
+            self.reply("OK")
+
+    def cmd_cpowd(self, op, val):
+        if val.strip() == "1":
+            self.reply("NORMAL POWER DOWN")
+        self.powered = False
+        self.boot_time = time.monotonic()
+
+    def cmd_cmux(self, op, val):
+        if op == "=" and val.split(",")[0] == "0":
+            self.reply("OK")
+            self.mux = CmuxDecoder()
+            self.chans = {}
+        else:
+            self.reply("ERROR")
+
+    def cmd_csq(self, op, val):
+        self.reply("+CSQ: {},0".format(self.args.rssi), "OK")
+
+    def cmd_creg(self, op, val):
+        if op == "?":
+            if self.cfun != 1:
+                stat = 0
+            elif time.monotonic() - self.boot_time < self.args.reg_delay:
+                stat = 2
+            else:
+                stat = self.args.reg_status
+                self.stats.mark("registered")
+            self.reply("+CREG: 0,{}".format(stat), "OK")
+        else:
+            self.reply("OK")
+
+    def cmd_sapbr(self, op, val):
+        parts = val.split(",")
+        cmd = int(parts[0])
+        if cmd == 3:
+            self.bearer_params[parts[2].strip('"')] = ",".join(parts[3:]).strip('"')
+            self.reply("OK")
+        elif cmd == 2:
+            ip = '"10.0.0.2"' if self.bearer == 1 else '"0.0.0.0"'
+            self.reply("+SAPBR: 1,{},{}".format(self.bearer, ip), "OK")
+        elif cmd == 1:
+            if self.cfun != 1 or self.bearer == 1:
+                self.reply("ERROR")
+                return
+            time.sleep(self.args.bearer_delay)
+            self.bearer = 1
+            self.stats.mark("bearer_open")
+            self.reply("OK")
+        elif cmd == 0:
+            if self.bearer != 1:
+                self.reply("ERROR")
+                return
+            self.bearer = 3
+            self.reply("OK")
+        else:
+            self.reply("ERROR")
+
+    def cmd_httpinit(self, op, val):
+        if self.http_init or self.bearer != 1:
+            self.reply("ERROR")
+        else:
+            self.http_init = True
+            self.http_params = {}
+            self.reply("OK")
+
+    def cmd_httpterm(self, op, val):
+        if not self.http_init:
+            self.reply("ERROR")
+        else:
+            self.http_init = False
+            self.reply("OK")
+
+    def cmd_httppara(self, op, val):
+        if not self.http_init:
+            self.reply("ERROR")
+            return
+        if op == "?":
+            lines = [
+                '+HTTPPARA: "{}","{}"'.format(k, v) for k, v in self.http_params.items()
+            ]
+            self.reply(*(lines + ["OK"]))
+            return
+        key, _, value = val.partition(",")
+        self.http_params[key.strip('"').upper()] = value.strip('"')
+        self.reply("OK")
+
+    def cmd_httpssl(self, op, val):
+        if op == "?":
+            self.reply("+HTTPSSL: {}".format(self.http_ssl), "OK")
+        else:
+            self.http_ssl = int(val)
+            self.reply("OK")
+
+    def cmd_sslopt(self, op, val):
+        self.reply("OK")
+
+    def cmd_httpdata(self, op, val):
+        if not self.http_init:
+            self.reply("ERROR")
+            return
+        size, _, _ = val.partition(",")
+        size = int(size)
+        start = time.monotonic()
+
+        def done(data):
+            if len(data) < size:
+                return False
+            self.http_data = bytes(data)
+            self.stats.http_data.append((size, time.monotonic() - start))
+            self.reply("OK")
+            return True
+
+        self.reply("DOWNLOAD")
+        self.raw = (bytearray(), done)
+
+    def cmd_httpaction(self, op, val):
+        if not self.http_init or self.bearer != 1:
+            self.reply("ERROR")
+            return
+        method = {0: "GET", 1: "POST", 2: "HEAD"}.get(int(val), None)
+        if method is None:
+            self.reply("ERROR")
+            return
+
+        self.reply("OK")
+        start = time.monotonic()
+        url = self.http_params.get("URL", "")
+        status, body = self.backend.request(
+            method, url, self.http_data if method == "POST" else b""
+        )
+        if self.args.http_status:
+            status = self.args.http_status
+        self.http_response = body
+
+        delay = max(0.0, self.args.action_delay - (time.monotonic() - start))
+        self.stats.actions.append((method, status, len(body), self.args.action_delay))
+        self.urc(
+            "+HTTPACTION: {},{},{}".format(int(val), status, len(body)), delay
+        )
+
+    def cmd_httpread(self, op, val):
+        if not self.http_init:
+            self.reply("ERROR")
+            return
+        if val:
+            start, _, size = val.partition(",")
+            start, size = int(start), int(size)
+        else:
+            start, size = 0, len(self.http_response)
+        data = self.http_response[start : start + size]
+
+        begin = time.monotonic()
+        self.send("\r\n+HTTPREAD: {}\r\n".format(len(data)))
+        self.send(data)
+        self.reply("OK")
+        self.link.drain()
+        self.stats.http_read.append((len(data), time.monotonic() - begin))
+
+    def cmd_cmgf(self, op, val):
+        self.reply("OK")
+
+    def cmd_cscs(self, op, val):
+        self.reply("OK")
+
+    def cmd_cmgs(self, op, val):
+        number = val.strip('"')
+
+        def done(data):
+            if data[-1] == ESC:
+                self.reply("OK")
+                return True
+            if data[-1] != CTRL_Z:
+                return False
+            text = data[:-1].decode(errors="replace")
+            print("SMS to {}: {}".format(number, text))
+            self.sms_ref += 1
+            self.reply("+CMGS: {}".format(self.sms_ref), "OK")
+            return True
+
+        self.send("\r\n> ")
+        self.raw = (bytearray(), done)
+
+
+class Link(object):
+    """Pseudo terminal or serial port, paced to the emulated baud rate"""
+
+    def __init__(self, port, baud, pace):
+        self.pace = pace
+        self.baud = baud
+
+        if port is None:
+            self.fd, slave = pty.openpty()
+            tty.setraw(slave)
+            self.name = os.ttyname(slave)
+        else:
+            self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+            tty.setraw(self.fd)
+            self.name = port
+
+        self.serial = port is not None
+        self.set_baud(baud)
+
+    def set_baud(self, baud):
+        self.baud = baud
+        if self.serial and baud in BAUD_RATES:
+            attr = termios.tcgetattr(self.fd)
+            attr[4] = attr[5] = BAUD_RATES[baud]
+            termios.tcsetattr(self.fd, termios.TCSADRAIN, attr)
+
+    def write(self, data):
+        os.write(self.fd, data)
+        # 10 bits per byte on the wire
+        if self.pace and not self.serial:
+            time.sleep(len(data) * 10.0 / self.baud)
+
+    def drain(self):
+        if self.serial:
+            termios.tcdrain(self.fd)
+
+    def read(self, timeout):
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if ready:
+            try:
+                return os.read(self.fd, 4096)
+            except OSError:
+                # pty with nothing attached yet
+                time.sleep(timeout)
+        return b""
+
+
+def main():
+    parser = argparse.ArgumentParser(description="SIM800 AT command emulator")
+    parser.add_argument("--port", type=str, help="Serial port, default new pty")
+    parser.add_argument("--baud", type=int, default=38400, help="Initial baud")
+    parser.add_argument("--ipr", type=int, default=0, help="Saved AT+IPR rate")
+    parser.add_argument("--pace", action="store_true", help="Pace pty to baud")
+    parser.add_argument("--latency", type=int, default=0, help="Per command ms")
+    parser.add_argument("--reg-delay", type=float, default=2.0, help="CREG s")
+    parser.add_argument("--reg-status", type=int, default=1, help="CREG stat")
+    parser.add_argument("--bearer-delay", type=float, default=1.0, help="SAPBR s")
+    parser.add_argument("--action-delay", type=float, default=1.0, help="HTTP s")
+    parser.add_argument("--boot-delay", type=float, default=3.0, help="CPOWD s")
+    parser.add_argument("--rssi", type=int, default=20, help="CSQ rssi")
+    parser.add_argument("--clts", type=int, default=0, help="Saved CLTS")
+    parser.add_argument("--urc-interval", type=float, default=0.0, help="URC s")
+    parser.add_argument("--error-rate", type=float, default=0.0)
+    parser.add_argument("--drop-rate", type=float, default=0.0)
+    parser.add_argument(
+        "--fail",
+        type=str,
+        action="append",
+        default=[],
+        help="Reply ERROR to command e.g. +SAPBR or +HTTPINIT:2 for 2 times",
+    )
+    parser.add_argument("--http-status", type=int, default=0, help="Force status")
+    parser.add_argument("--seed", type=int, default=0, help="Random seed")
+    parser.add_argument("--backend", type=str, help="Forward HTTP to this URL")
+    parser.add_argument("--bin-dir", type=str, default="hub/bin/store")
+    parser.add_argument("--latest", type=int, default=0, help="version=get reply")
+    parser.add_argument("--response", type=str, default="", help="POST reply")
+    parser.add_argument("--stats", type=str, help="Write stats json on exit")
+    args = parser.parse_args()
+
+    link = Link(args.port, args.baud, args.pace)
+    backend = Backend(args.backend, args.bin_dir, args.latest, args.response)
+    sim = Sim800(link, backend, args)
+
+    print("SIM800 emulator on {}".format(link.name), flush=True)
+
+    # Stop cleanly from scripts as well as Ctrl-C
+    def stop(signum, frame):
+        raise KeyboardInterrupt
+
+    signal.signal(signal.SIGTERM, stop)
+    signal.signal(signal.SIGINT, stop)
+
+    try:
+        while True:
+            data = link.read(0.01)
+            if data:
+                sim.receive(data)
+            sim.poll()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        summary = sim.stats.summary()
+        print(json.dumps(summary, indent=2))
+        if args.stats:
+            with open(args.stats, "w") as file:
+                json.dump(summary, file, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,173 @@
+/**
+ ******************************************************************************
+ * @file    cmux.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   GSM 07.10 Multiplexer Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/cmux.h"
+
+#include <string.h>
+
+/** @addtogroup CMUX_FILE
+ * @{
+ */
+
+/** @addtogroup CMUX_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// Address & length extension bit
+#define EA 0x01
+
+// FCS is reflected CRC-8 x^8 + x^2 + x + 1, remainder when checked
+#define FCS_INIT 0xFF
+#define FCS_POLY 0xE0
+#define FCS_GOOD 0xCF
+
+enum dec_state {
+    DEC_FLAG = 0,
+    DEC_ADDRESS,
+    DEC_CONTROL,
+    DEC_LENGTH,
+    DEC_INFO,
+    DEC_FCS,
+    DEC_END
+};
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint8_t fcs_update(uint8_t fcs, uint8_t byte);
+
+/** @} */
+
+/** @addtogroup CMUX_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+uint16_t cmux_encode(uint8_t dlci, uint8_t control, const uint8_t* info,
+                     uint8_t len, uint8_t* out) {
+    uint8_t fcs = FCS_INIT;
+
+    if (len > CMUX_N1) {
+        len = CMUX_N1;
+    }
+
+    out[0] = CMUX_FLAG;
+    out[1] = (uint8_t)((dlci << 2) | CMUX_CR | EA);
+    out[2] = control;
+    out[3] = (uint8_t)((len << 1) | EA);
+
+    // UIH FCS covers header only, others cover info as well but never have
+    // any here
+    for (uint8_t i = 1; i < 4; i++) {
+        fcs = fcs_update(fcs, out[i]);
+    }
+
+    if (len) {
+        memcpy(&out[4], info, len);
+    }
+
+    out[4 + len] = (uint8_t)(0xFF - fcs);
+    out[5 + len] = CMUX_FLAG;
+
+    return (uint16_t)(len + CMUX_FRAME_OVERHEAD);
+}
+
+void cmux_decoder_reset(cmux_decoder_t* dec) { dec->state = DEC_FLAG; }
+
+bool cmux_decode(cmux_decoder_t* dec, uint8_t byte) {
+    switch (dec->state) {
+    case DEC_FLAG:
+        if (byte == CMUX_FLAG) {
+            dec->state = DEC_ADDRESS;
+        }
+        break;
+    case DEC_ADDRESS:
+        // Repeated flags between frames
+        if (byte == CMUX_FLAG) {
+            break;
+        }
+        dec->fcs = fcs_update(FCS_INIT, byte);
+        dec->frame.dlci = byte >> 2;
+        dec->state = DEC_CONTROL;
+        break;
+    case DEC_CONTROL:
+        dec->fcs = fcs_update(dec->fcs, byte);
+        dec->frame.control = byte;
+        dec->state = DEC_LENGTH;
+        break;
+    case DEC_LENGTH:
+        dec->fcs = fcs_update(dec->fcs, byte);
+        dec->frame.len = byte >> 1;
+        dec->idx = 0;
+
+        // Only single byte lengths, N1 < 128
+        if (!(byte & EA) || (dec->frame.len > CMUX_N1)) {
+            dec->state = DEC_FLAG;
+        } else {
+            dec->state = dec->frame.len ? DEC_INFO : DEC_FCS;
+        }
+        break;
+    case DEC_INFO:
+        dec->frame.info[dec->idx++] = byte;
+        if (dec->idx >= dec->frame.len) {
+            dec->state = DEC_FCS;
+        }
+        break;
+    case DEC_FCS:
+        dec->fcs = fcs_update(dec->fcs, byte);
+        dec->state = DEC_END;
+        break;
+    case DEC_END:
+        // Closing flag doubles as next opening flag
+        dec->state = (byte == CMUX_FLAG) ? DEC_ADDRESS : DEC_FLAG;
+        return (byte == CMUX_FLAG) && (dec->fcs == FCS_GOOD);
+    default:
+        dec->state = DEC_FLAG;
+        break;
+    }
+
+    return false;
+}
+
+/** @} */
+
+/** @addtogroup CMUX_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint8_t fcs_update(uint8_t fcs, uint8_t byte) {
+    fcs ^= byte;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        fcs = (fcs & 0x01) ? (uint8_t)((fcs >> 1) ^ FCS_POLY)
+                           : (uint8_t)(fcs >> 1);
+    }
+
+    return fcs;
+}
+
+/** @} */
+/** @} */
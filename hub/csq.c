@@ -0,0 +1,174 @@
+/**
+ ******************************************************************************
+ * @file    csq.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Signal Quality Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/csq.h"
+
+#include "common/log.h"
+#include "common/timers.h"
+
+/** @addtogroup CSQ_FILE
+ * @{
+ */
+
+/** @addtogroup CSQ_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef CSQ_LOG_LEVEL
+#define CSQ_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define CSQ_LOG(level, ...) LOG_AT(level, CSQ_LOG_LEVEL, "CSQ: " __VA_ARGS__)
+
+#define CSQ_UNKNOWN 99
+#define CSQ_MAX     31
+
+// Below this uploads usually need retries, -103 dBm
+#define CSQ_MIN_USABLE 5
+
+// Dip below the usual signal at this site worth waiting out, 12 dB
+#define CSQ_DIP 6
+
+// Average kept x16, new sample weighted 1/16
+#define AVG_SHIFT 4
+
+static uint16_t avg_x16 = 0;
+static uint8_t  last = CSQ_UNKNOWN;
+static uint8_t  min = CSQ_MAX;
+static bool     have_avg = false;
+
+static bool     deferring = false;
+static uint32_t defer_start = 0;
+static uint32_t defer_last = 0;
+static uint32_t num_deferred = 0;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool is_poor(uint8_t csq);
+
+/** @} */
+
+/** @addtogroup CSQ_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void csq_init(void) {
+    avg_x16 = 0;
+    last = CSQ_UNKNOWN;
+    min = CSQ_MAX;
+    have_avg = false;
+    deferring = false;
+    num_deferred = 0;
+}
+
+void csq_add(uint8_t csq) {
+    last = csq;
+
+    // No signal, keep out of the average
+    if (csq > CSQ_MAX) {
+        min = 0;
+        return;
+    }
+
+    if (csq < min) {
+        min = csq;
+    }
+
+    if (have_avg) {
+        avg_x16 = avg_x16 - (avg_x16 >> AVG_SHIFT) + csq;
+    } else {
+        avg_x16 = (uint16_t)csq << AVG_SHIFT;
+        have_avg = true;
+    }
+}
+
+bool csq_defer_upload(bool urgent) {
+    uint32_t now = timers_millis();
+
+    if (urgent || !is_poor(last)) {
+        return false;
+    }
+
+    if (false == deferring) {
+        deferring = true;
+        defer_start = now;
+    }
+
+    // Waited long enough, go anyway
+    if ((now - defer_start) >= CSQ_MAX_DEFER_MS) {
+        CSQ_LOG(LOG_INFO, "poor %u, max wait\n", last);
+        return false;
+    }
+
+    CSQ_LOG(LOG_DBG, "poor %u avg %u, defer\n", last, csq_avg());
+
+    num_deferred++;
+    defer_last = now;
+
+    return true;
+}
+
+void csq_upload_done(void) {
+    deferring = false;
+    min = CSQ_MAX;
+}
+
+bool csq_waiting(void) {
+    return deferring && ((timers_millis() - defer_last) < CSQ_RETRY_MS);
+}
+
+uint8_t csq_last(void) { return last; }
+
+uint8_t csq_avg(void) {
+    return have_avg ? (uint8_t)(avg_x16 >> AVG_SHIFT) : CSQ_UNKNOWN;
+}
+
+uint8_t csq_min(void) { return min; }
+
+uint32_t csq_num_deferred(void) { return num_deferred; }
+
+int16_t csq_to_dbm(uint8_t csq) {
+    return (csq > CSQ_MAX) ? 0 : (int16_t)(-113 + (2 * (int16_t)csq));
+}
+
+/** @} */
+
+/** @addtogroup CSQ_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool is_poor(uint8_t csq) {
+    if ((csq > CSQ_MAX) || (csq < CSQ_MIN_USABLE)) {
+        return true;
+    }
+
+    return have_avg && ((csq + CSQ_DIP) < csq_avg());
+}
+
+/** @} */
+/** @} */
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
 #include <libopencm3/stm32/crc.h>
 #include <libopencm3/stm32/crs.h>
@@ -358,6 +359,14 @@ union {
 
 } hid_in_report;
 
+// Print output, sent as reports of up to 64 bytes. Full drops
+#define PRINT_BUF_SIZE 256U
+
+static uint8_t  print_buf[PRINT_BUF_SIZE];
+static uint16_t print_head = 0;
+static uint16_t print_tail = 0;
+static uint32_t print_dropped = 0;
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // Static Function Declarations
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -365,6 +374,9 @@ union {
 /** @brief Setup CPU and peripheral clocks for usb */
 static void cusb_clock_init(void);
 
+/** @brief Write next report of print output if the endpoint is free */
+static void print_kick(void);
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // USB Callback Function Declarations
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -471,11 +483,42 @@ bool cusb_plugged_in(void) { return usb_plugged_in; }
 void cusb_poll(void) { usbd_poll(usbd_dev); }
 
 void cusb_send(char character) {
-    if (usb_state == USB_PRINT) {
-        usbd_ep_write_packet(usbd_dev, ENDPOINT_HID_IN, &character, 1);
+    if (usb_state != USB_PRINT) {
+        return;
+    }
+
+    uint32_t masked = cm_mask_interrupts(1);
+
+    uint16_t next = (print_head + 1) % PRINT_BUF_SIZE;
+
+    if (next == print_tail) {
+        print_dropped++;
+    } else {
+        print_buf[print_head] = (uint8_t)character;
+        print_head = next;
+    }
+
+    // Whole report ready, no need to wait for the end of the statement
+    if (((print_head + PRINT_BUF_SIZE - print_tail) % PRINT_BUF_SIZE) >=
+        HID_REPORT_SIZE_BYTES) {
+        print_kick();
+    }
+
+    cm_mask_interrupts(masked);
+}
+
+void cusb_flush(void) {
+    if (usb_state != USB_PRINT) {
+        return;
     }
+
+    uint32_t masked = cm_mask_interrupts(1);
+    print_kick();
+    cm_mask_interrupts(masked);
 }
 
+uint32_t cusb_dropped(void) { return print_dropped; }
+
 /** @} */
 
 /** @addtogroup CUSB_INT
@@ -508,6 +551,22 @@ static void cusb_clock_init(void) {
     rcc_set_hsi48_source_rc48();
 }
 
+static void print_kick(void) {
+    uint8_t  report[HID_REPORT_SIZE_BYTES];
+    uint16_t len = 0;
+    uint16_t tail = print_tail;
+
+    while ((tail != print_head) && (len < HID_REPORT_SIZE_BYTES)) {
+        report[len++] = print_buf[tail];
+        tail = (tail + 1) % PRINT_BUF_SIZE;
+    }
+
+    // Returns 0 while the last report is still going, IN callback retries
+    if (len && usbd_ep_write_packet(usbd_dev, ENDPOINT_HID_IN, report, len)) {
+        print_tail = tail;
+    }
+}
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // USB Callback Function Definitions
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -555,7 +614,9 @@ hid_control_request(usbd_device* dev, struct usb_setup_data* req, uint8_t** buf,
 static void hid_in_report_callback(usbd_device* dev, uint8_t ea) {
     // serial_printf("i\n");
 
-    if (usb_state == USB_GET_LOG) {
+    if (usb_state == USB_PRINT) {
+        print_kick();
+    } else if (usb_state == USB_GET_LOG) {
         static uint16_t bytes_sent = 0;
 
         // Get next 64 bytes of log
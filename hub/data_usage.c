@@ -0,0 +1,205 @@
+/**
+ ******************************************************************************
+ * @file    data_usage.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Cellular Data Usage Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/data_usage.h"
+
+#include <string.h>
+
+#include "common/date.h"
+#include "common/log.h"
+#include "common/memory.h"
+#include "config/board_defs.h"
+
+/** @addtogroup DATA_USAGE_FILE
+ * @{
+ */
+
+/** @addtogroup DATA_USAGE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef DATA_LOG_LEVEL
+#define DATA_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define DATA_LOG(level, ...) LOG_AT(level, DATA_LOG_LEVEL, "DATA: " __VA_ARGS__)
+
+// Percent of monthly budget before uploads are throttled
+#define NEAR_PERCENT 80
+
+// Upload spacing at each level, fewer larger uploads share the overhead
+#define INTERVAL_NEAR_MS 900000
+#define INTERVAL_OVER_MS 3600000
+
+static data_usage_info_t usage;
+
+static data_level_t level = DATA_LEVEL_OK;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void         roll_over(uint32_t timestamp);
+static data_level_t calc_level(void);
+
+/** @} */
+
+/** @addtogroup DATA_USAGE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void data_usage_init(void) {
+    if (app_info->data_usage.key == DATA_USAGE_KEY) {
+        memcpy(&usage, &app_info->data_usage, sizeof(usage));
+    } else {
+        memset(&usage, 0, sizeof(usage));
+        usage.key = DATA_USAGE_KEY;
+    }
+
+    level = calc_level();
+
+    data_usage_print();
+}
+
+void data_usage_add(uint32_t tx, uint32_t rx, uint32_t overhead,
+                    uint32_t timestamp) {
+    uint32_t bytes = tx + rx + overhead;
+
+    roll_over(timestamp);
+
+    usage.day_bytes += bytes;
+    usage.month_bytes += bytes;
+    usage.total_tx += tx;
+    usage.total_rx += rx;
+    usage.total_overhead += overhead;
+
+    DATA_LOG(LOG_DBG, "tx %u rx %u oh %u, day %u month %u\n", tx, rx, overhead,
+             usage.day_bytes, usage.month_bytes);
+
+    // Save straight away when crossing a level so it survives a reset
+    data_level_t new_level = calc_level();
+    if (new_level != level) {
+        DATA_LOG(LOG_INFO, "level %u -> %u\n", level, new_level);
+        level = new_level;
+        data_usage_save();
+    }
+}
+
+void data_usage_save(void) {
+    const uint32_t* src = (const uint32_t*)&usage;
+    uint32_t*       dst = (uint32_t*)&app_info->data_usage;
+
+    for (uint8_t i = 0; i < (sizeof(usage) / sizeof(uint32_t)); i++) {
+        mem_eeprom_write_word_ptr(&dst[i], src[i]);
+    }
+}
+
+void data_usage_set_budget_kb(uint32_t kb) {
+    if (kb != app_info->data_budget_kb) {
+        mem_eeprom_write_word_ptr(&app_info->data_budget_kb, kb);
+        DATA_LOG(LOG_INFO, "budget %u kB\n", kb);
+    }
+
+    level = calc_level();
+}
+
+data_level_t data_usage_level(void) { return level; }
+
+uint32_t data_usage_upload_interval_ms(void) {
+    if (level == DATA_LEVEL_OVER) {
+        return INTERVAL_OVER_MS;
+    } else if (level == DATA_LEVEL_NEAR) {
+        return INTERVAL_NEAR_MS;
+    }
+
+    return 0;
+}
+
+bool data_usage_defer_log(void) { return (level != DATA_LEVEL_OK); }
+
+uint32_t data_usage_day_bytes(void) { return usage.day_bytes; }
+
+uint32_t data_usage_month_bytes(void) { return usage.month_bytes; }
+
+void data_usage_print(void) {
+    DATA_LOG(LOG_INFO, "day %u month %u budget %u kB, tx %u rx %u oh %u\n",
+             usage.day_bytes, usage.month_bytes, app_info->data_budget_kb,
+             usage.total_tx, usage.total_rx, usage.total_overhead);
+}
+
+/** @} */
+
+/** @addtogroup DATA_USAGE_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void roll_over(uint32_t timestamp) {
+    uint8_t year, month, day;
+
+    // Time not known yet, count against current day
+    if (timestamp == 0) {
+        return;
+    }
+
+    timestamp_to_date(timestamp, &year, &month, &day);
+
+    uint32_t today = timestamp / 86400U;
+    uint32_t this_month = ((uint32_t)year * 12) + (month - 1);
+
+    if (today != usage.day) {
+        usage.day = today;
+        usage.day_bytes = 0;
+    }
+
+    if (this_month != usage.month) {
+        DATA_LOG(LOG_INFO, "new month, last %u\n", usage.month_bytes);
+        usage.month = this_month;
+        usage.month_bytes = 0;
+        level = calc_level();
+        data_usage_save();
+    }
+}
+
+static data_level_t calc_level(void) {
+    uint32_t budget = app_info->data_budget_kb;
+
+    if (budget == 0) {
+        return DATA_LEVEL_OK;
+    }
+
+    uint32_t used_kb = usage.month_bytes / 1024;
+
+    if (used_kb >= budget) {
+        return DATA_LEVEL_OVER;
+    } else if ((used_kb * 100) >= (budget * NEAR_PERCENT)) {
+        return DATA_LEVEL_NEAR;
+    }
+
+    return DATA_LEVEL_OK;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,371 @@
+/**
+ ******************************************************************************
+ * @file    fw_slot.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Firmware Slots Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/fw_slot.h"
+
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "common/log.h"
+#include "common/memory.h"
+#include "common/timers.h"
+#include "config/board_defs.h"
+
+#include "hub/w25qxx.h"
+
+/** @addtogroup FW_SLOT_FILE
+ * @{
+ */
+
+/** @addtogroup FW_SLOT_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef FW_LOG_LEVEL
+#define FW_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define FW_LOG(level, ...) LOG_AT(level, FW_LOG_LEVEL, "FW: " __VA_ARGS__)
+
+#define SLOT_MAGIC  0x5107F1A5
+#define PAGE_SIZE   256U
+#define SECTOR_SIZE 4096U
+#define IMAGE_MAX   ((W25_FW_SLOT_NUM_SECTORS - 1) * SECTOR_SIZE)
+#define CHUNK       FLASH_HALF_PAGE_SIZE_BYTES
+
+static bool fw_ok = false;
+
+// Read from W25 as bytes, CRC'd & programmed to internal flash as words
+static union {
+    uint8_t  u8[CHUNK];
+    uint32_t u32[CHUNK / 4];
+} chunk;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint32_t slot_sector(fw_slot_t slot);
+static uint32_t image_address(fw_slot_t slot);
+static bool     read_hdr(fw_slot_t slot, fw_slot_hdr_t* hdr);
+static uint32_t slot_crc(fw_slot_t slot, uint32_t size);
+static uint32_t flash_crc(uint32_t size);
+static void     crc_start(void);
+static void     crc_stop(void);
+static bool     program_half_page(uint32_t address, uint32_t* data);
+
+/** @} */
+
+/** @addtogroup FW_SLOT_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+bool fw_slot_init(void) {
+    fw_ok = false;
+
+    if (false == w25_Init()) {
+        FW_LOG(LOG_ERR, "ERR no flash\n");
+        return false;
+    }
+
+    if ((W25_FW_SLOT_START_SECTOR + (FW_NUM_SLOTS * W25_FW_SLOT_NUM_SECTORS)) >
+        w25.SectorCount) {
+        FW_LOG(LOG_ERR, "ERR flash too small %u\n", w25.SectorCount);
+        return false;
+    }
+
+    w25_ScanErased(W25_FW_SLOT_START_SECTOR,
+                   FW_NUM_SLOTS * W25_FW_SLOT_NUM_SECTORS);
+
+    fw_ok = true;
+
+    fw_slot_print();
+
+    return true;
+}
+
+bool fw_slot_erase(fw_slot_t slot) {
+    if (!fw_ok || (slot >= FW_NUM_SLOTS)) {
+        return false;
+    }
+
+    // Header first, a reset part way through leaves the slot ignored
+    for (uint32_t i = 0; i < W25_FW_SLOT_NUM_SECTORS; i++) {
+        w25_EraseSector(slot_sector(slot) + i);
+        timers_pet_dogs();
+    }
+
+    return true;
+}
+
+bool fw_slot_write(fw_slot_t slot, uint32_t offset, const uint8_t* data,
+                   uint32_t len) {
+    if (!fw_ok || (slot >= FW_NUM_SLOTS) || ((offset + len) > IMAGE_MAX)) {
+        FW_LOG(LOG_ERR, "ERR write %u %u\n", slot, offset + len);
+        return false;
+    }
+
+    uint32_t address = image_address(slot) + offset;
+
+    while (len) {
+        uint32_t num = PAGE_SIZE - (address % PAGE_SIZE);
+        if (num > len) {
+            num = len;
+        }
+
+        w25_WritePage((uint8_t*)data, address / PAGE_SIZE,
+                      address % PAGE_SIZE, num);
+
+        address += num;
+        data += num;
+        len -= num;
+    }
+
+    return true;
+}
+
+bool fw_slot_commit(fw_slot_t slot, uint32_t version, uint32_t size,
+                    uint32_t crc32) {
+    if (!fw_ok || (slot >= FW_NUM_SLOTS) || (size == 0) ||
+        (size > IMAGE_MAX) || (size % CHUNK)) {
+        return false;
+    }
+
+    uint32_t crc = slot_crc(slot, size);
+
+    if (crc != crc32) {
+        FW_LOG(LOG_ERR, "ERR slot %u crc %8x not %8x\n", slot, crc,
+               crc32);
+        return false;
+    }
+
+    fw_slot_hdr_t hdr = {
+        .magic = SLOT_MAGIC,
+        .version = version,
+        .size = size,
+        .crc32 = crc32,
+    };
+
+    w25_WritePage((uint8_t*)&hdr, w25_SectorToPage(slot_sector(slot)), 0,
+                  sizeof(hdr));
+
+    FW_LOG(LOG_INFO, "slot %u v%u %u B\n", slot, version, size);
+
+    return true;
+}
+
+bool fw_slot_valid(fw_slot_t slot, fw_slot_hdr_t* hdr) {
+    fw_slot_hdr_t tmp;
+
+    if (hdr == NULL) {
+        hdr = &tmp;
+    }
+
+    if (!read_hdr(slot, hdr)) {
+        return false;
+    }
+
+    if (slot_crc(slot, hdr->size) != hdr->crc32) {
+        FW_LOG(LOG_INFO, "slot %u v%u bad crc\n", slot, hdr->version);
+        return false;
+    }
+
+    return true;
+}
+
+int8_t fw_slot_find(uint32_t version) {
+    fw_slot_hdr_t hdr;
+
+    for (uint8_t i = 0; i < FW_NUM_SLOTS; i++) {
+        if (read_hdr(i, &hdr) && (hdr.version == version) &&
+            fw_slot_valid(i, NULL)) {
+            return (int8_t)i;
+        }
+    }
+
+    return -1;
+}
+
+fw_slot_t fw_slot_spare(uint32_t keep_version) {
+    fw_slot_hdr_t hdr;
+
+    if (read_hdr(FW_SLOT_A, &hdr) && (hdr.version == keep_version)) {
+        return FW_SLOT_B;
+    }
+
+    return FW_SLOT_A;
+}
+
+bool fw_slot_install(fw_slot_t slot) {
+    fw_slot_hdr_t hdr;
+
+    if (!fw_slot_valid(slot, &hdr)) {
+        return false;
+    }
+
+    FW_LOG(LOG_INFO, "install slot %u v%u\n", slot, hdr.version);
+
+    uint32_t timer = timers_millis();
+
+    for (uint32_t offset = 0; offset < hdr.size; offset += CHUNK) {
+        timers_pet_dogs();
+
+        w25_ReadBytes(chunk.u8, image_address(slot) + offset, CHUNK);
+
+        if (!program_half_page(FLASH_APP_ADDRESS + offset, chunk.u32)) {
+            return false;
+        }
+    }
+
+    uint32_t crc = flash_crc(hdr.size);
+
+    if (crc != hdr.crc32) {
+        FW_LOG(LOG_ERR, "ERR flash crc %8x not %8x\n", crc, hdr.crc32);
+        return false;
+    }
+
+    FW_LOG(LOG_INFO, "installed in %u ms\n", timers_millis() - timer);
+
+    return true;
+}
+
+bool fw_slot_save(fw_slot_t slot, uint32_t version, uint32_t size) {
+    if ((size == 0) || (size > (FLASH_APP_END - FLASH_APP_ADDRESS)) ||
+        !fw_slot_erase(slot)) {
+        return false;
+    }
+
+    FW_LOG(LOG_INFO, "save v%u to slot %u\n", version, slot);
+
+    for (uint32_t offset = 0; offset < size; offset += CHUNK) {
+        timers_pet_dogs();
+
+        if (!fw_slot_write(slot, offset,
+                           (const uint8_t*)(FLASH_APP_ADDRESS + offset),
+                           CHUNK)) {
+            return false;
+        }
+    }
+
+    return fw_slot_commit(slot, version, size, flash_crc(size));
+}
+
+void fw_slot_print(void) {
+    fw_slot_hdr_t hdr;
+
+    for (uint8_t i = 0; i < FW_NUM_SLOTS; i++) {
+        if (read_hdr(i, &hdr)) {
+            FW_LOG(LOG_INFO, "slot %u v%u %u B\n", i, hdr.version,
+                   hdr.size);
+        } else {
+            FW_LOG(LOG_INFO, "slot %u empty\n", i);
+        }
+    }
+}
+
+/** @} */
+
+/** @addtogroup FW_SLOT_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint32_t slot_sector(fw_slot_t slot) {
+    return W25_FW_SLOT_START_SECTOR + (slot * W25_FW_SLOT_NUM_SECTORS);
+}
+
+static uint32_t image_address(fw_slot_t slot) {
+    return (slot_sector(slot) + 1) * SECTOR_SIZE;
+}
+
+// Header only, image is CRC'd by fw_slot_valid()
+static bool read_hdr(fw_slot_t slot, fw_slot_hdr_t* hdr) {
+    if (!fw_ok || (slot >= FW_NUM_SLOTS)) {
+        return false;
+    }
+
+    w25_ReadBytes((uint8_t*)hdr, slot_sector(slot) * SECTOR_SIZE,
+                  sizeof(*hdr));
+
+    return (hdr->magic == SLOT_MAGIC) && (hdr->size != 0) &&
+           (hdr->size <= IMAGE_MAX) && ((hdr->size % CHUNK) == 0);
+}
+
+static uint32_t slot_crc(fw_slot_t slot, uint32_t size) {
+    uint32_t crc = 0;
+
+    crc_start();
+
+    for (uint32_t offset = 0; offset < size; offset += CHUNK) {
+        w25_ReadBytes(chunk.u8, image_address(slot) + offset, CHUNK);
+        crc = ~crc_calculate_block(chunk.u32, CHUNK / 4);
+    }
+
+    crc_stop();
+
+    return crc;
+}
+
+static uint32_t flash_crc(uint32_t size) {
+    crc_start();
+    uint32_t crc = ~crc_calculate_block((uint32_t*)FLASH_APP_ADDRESS, size / 4);
+    crc_stop();
+
+    return crc;
+}
+
+// Same as the server, CRC-32 over the bin bytes
+static void crc_start(void) {
+    rcc_periph_clock_enable(RCC_CRC);
+    crc_reset();
+    crc_set_reverse_input(CRC_CR_REV_IN_BYTE);
+    crc_reverse_output_enable();
+    CRC_INIT = 0xFFFFFFFF;
+}
+
+static void crc_stop(void) {
+    crc_reset();
+    rcc_periph_clock_disable(RCC_CRC);
+}
+
+static bool program_half_page(uint32_t address, uint32_t* data) {
+    // Erase page before programming first half of it
+    if ((address % FLASH_PAGE_SIZE) == 0) {
+        if (false == mem_flash_erase_page(address)) {
+            FW_LOG(LOG_ERR, "ERR erase %8x\n", address);
+            return false;
+        }
+    }
+
+    if (false == mem_flash_write_half_page(address, data)) {
+        FW_LOG(LOG_ERR, "ERR prog %8x\n", address);
+        return false;
+    }
+
+    return true;
+}
+
+/** @} */
+/** @} */
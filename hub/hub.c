@@ -29,20 +29,49 @@
 #include "common/timers.h"
 #include "config/board_defs.h"
 
+#include "hub/csq.h"
 #include "hub/cusb.h"
+#include "hub/data_usage.h"
 #include "hub/hub_test.h"
+#include "hub/journal.h"
+#include "hub/lz.h"
+#include "hub/modem_pwr.h"
+#include "hub/remote_cfg.h"
 #include "hub/sim.h"
 
 #define VERSION                   101
-#define HUB_CHECK_TIME_S          60
-#define HUB_LOG_TIME_S            3600
-#define NET_SLEEP_TIME_DEFAULT_MS 120000
 #define HUB_PLUGGED_IN_VALUE      0x2468
 #define HUB_PLUGGED_OUT_VALUE     0x1357
-
-#define NET_LOG                                                                \
-    log_printf("NET: ");                                                       \
-    log_printf
+#define HUB_ALARM_SMS_TIMEOUT_MS  300000
+#define JOURNAL_UPLOAD_BATCH      32
+#define JOURNAL_REC_MAX_CHARS     80
+#define HUB_CSQ_SAMPLE_MS         60000
+#define HUB_LOG_MAX_CHARS         768
+#define NET_READ_WINDOW           256
+#define NET_KEY_MAX               16
+#define NET_ITEM_MAX              REMOTE_CFG_URL_SIZE
+#define NET_ITEMS_MAX             4
+#define URL_MAX_FAILS             6
+
+// Compress log uploads, comment out to send plain text
+#define HUB_LOG_LZ
+
+// Tokens are binary, plain text uploads would mangle them
+#if defined(LOG_TOKENS) && !defined(HUB_LOG_LZ)
+#error "HUB: LOG_TOKENS needs HUB_LOG_LZ"
+#endif
+
+#ifndef HUB_LOG_LEVEL
+#define HUB_LOG_LEVEL LOG_LEVEL
+#endif
+
+#ifndef NET_LOG_LEVEL
+#define NET_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define HUB_LOG(level, ...)   LOG_AT(level, HUB_LOG_LEVEL, __VA_ARGS__)
+#define HUB_LOG_S(level, ...) LOG_AT_S(level, HUB_LOG_LEVEL, __VA_ARGS__)
+#define NET_LOG(level, ...)   LOG_AT(level, NET_LOG_LEVEL, "NET: " __VA_ARGS__)
 
 // TODO
 // Http post with ssl, logging
@@ -62,18 +91,22 @@ typedef enum {
     NET_CONNECTED,
     NET_RUNNING,
     NET_CHECK_CONNECTION,
+    NET_CHECK_SIGNAL,
+    NET_SAMPLE_SIGNAL,
     NET_HTTPINIT,
     NET_HTTPPOST,
     NET_HTTPREADY,
     NET_HTTP_DONE,
+    NET_TIME_SYNC,
     NET_ASSEMBLE_PACKET,
     NET_POST,
     NET_SLEEP_START,
     NET_SLEEP_TRY_POST_AGAIN,
     NET_GO_TO_SLEEP,
     NET_SLEEP,
+    NET_WAKE,
     NET_PARSE_RESPONSE,
-    NET_SEND_ERROR_SMS,
+    NET_SEND_ALARM_SMS,
     NET_ERROR,
     NET_NUM_STATES,
 } net_state_t;
@@ -99,6 +132,46 @@ static bool     log_appended;
 static bool     pwr_appended;
 static bool     check_appended;
 static uint32_t log_counter;
+static bool     time_sync_pending;
+static uint32_t time_sync_counter;
+static uint32_t journal_appended;
+static bool     alarm_pending;
+static bool     alarm_appended;
+static bool     alarm_sms_sent;
+static uint32_t alarm_start;
+static uint32_t last_upload;
+static uint32_t upload_fails;
+
+// Log ring index after the bytes appended, saved once the upload is acked
+static uint16_t log_upload_idx;
+static bool     log_more;
+static uint16_t log_lz_from;
+static uint32_t b64_acc;
+static uint8_t  b64_len;
+
+// Full sensor list once after boot, then only changes
+static bool sensor_list_synced;
+
+// Response parsed a byte at a time, key=item,item,...&key=...
+typedef struct net_parser_s {
+    char     key[NET_KEY_MAX];
+    char     item[NET_ITEM_MAX];
+    uint8_t  key_len;
+    uint8_t  item_len;
+    uint8_t  num_items;
+    bool     in_value;
+    int32_t  vals[NET_ITEMS_MAX];
+    uint32_t listed;     // Sensor slots on a full list
+    uint32_t list_count; // IDs the full list says it holds
+    uint32_t list_ids;   // IDs received so far
+    bool     list_counted;
+} net_parser_t;
+
+static net_parser_t parser;
+static uint32_t     net_resp_idx;
+
+static const char b64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // Static Function Declarations
@@ -110,13 +183,23 @@ static void deinit(void);
 static void test(void);
 static void hub(void);
 
+static uint32_t checks_per(remote_cfg_key_t key);
+
 static uint32_t get_timestamp(void);
 static void     check_for_packets(void);
+static bool     check_alarm(sensor_t* sensor, int16_t prev_temp,
+                            uint32_t prev_millis);
+static bool     alarm_sms_due(void);
+static modem_pwr_prio_t net_priority(void);
 
 static void net_task(void);
 static bool upload_pending(void);
+static bool upload_due(void);
 static void clear_upload_pending(void);
-static void parse_net_response(void);
+static void parse_net_reset(void);
+static void parse_net_response(const char* buf, uint32_t len);
+static void parse_item(void);
+static void parse_field(void);
 
 static bool    check_pending(void);
 static uint8_t temps_pending(void);
@@ -124,15 +207,24 @@ static bool    log_pending(void);
 static bool    pwr_pending(void);
 static void    append_check(void);
 static void    append_temp(void);
+static void    append_journal(uint32_t idx, uint32_t num);
 static void    append_log(void);
 static void    append_pwr(void);
+static void    append_alarm(void);
+static void    append_alarm_sms(void);
 
-static void update_sensor_list(const char* list_start,
-                               uint32_t    sensor_list_len);
+static void update_sensor(uint32_t dev_id, bool add);
+static void update_alarm(uint32_t dev_id, int32_t low, int32_t high,
+                         uint32_t rate);
+static void update_alarm_sms(const char* str);
+static int32_t parse_int(const char** str);
 
 static void     net_buf_clear(void);
 static uint32_t net_buf_append_printf(const char* format, ...);
+static void     net_buf_append_b64(uint8_t byte);
+static void     net_buf_b64_flush(void);
 static void     _putchar_buffer(char character);
+static uint8_t  log_lz_get(uint32_t idx);
 
 /** @} */
 
@@ -146,7 +238,7 @@ int main(void) {
 
     // Check if first time running
     if (app_info->init_key != APP_INIT_KEY) {
-        log_printf("APP: First Run\n");
+        HUB_LOG(LOG_INFO, "APP: First Run\n");
 
         serial_printf(".App: v%u\n", VERSION);
         serial_printf(".Boot: v%u\n", shared_info->boot_version);
@@ -172,14 +264,14 @@ int main(void) {
         scb_reset_system();
     }
 
-    log_printf("Hub Start\n");
+    HUB_LOG(LOG_INFO, "Hub Start\n");
 
     test();
 
     hub();
 
     for (;;) {
-        log_printf("Hub Loop\n\n");
+        HUB_LOG(LOG_DBG, "Hub Loop\n\n");
         timers_delay_milliseconds(1000);
     }
 
@@ -280,6 +372,8 @@ void add_sensor(uint32_t dev_id) {
 
                 sensor->active = true;
                 sensor->dev_id = dev_id;
+                sensor->alarm_low = INT16_MIN;
+                sensor->alarm_high = INT16_MAX;
 
                 ++num_sensors;
 
@@ -322,48 +416,75 @@ void print_sensors(void) {
                   num_sensors == count ? "OK" : "Error", num_sensors, count);
 }
 
-static void update_sensor_list(const char* list_start, const uint32_t len) {
-    uint32_t  i = 0;
-    uint32_t  list[MAX_SENSORS];
-    sensor_t* sensor = NULL;
+static void update_sensor(uint32_t dev_id, bool add) {
+    if (add) {
+        add_sensor(dev_id);
 
-    serial_printf("HUB: Update sensors\n");
-    // serial_printf(".list %s\n", list_start);
+        sensor_t* sensor = get_sensor_by_id(dev_id);
+        if (sensor == NULL) {
+            NET_LOG(LOG_ERR, ".ERR no room for sensor %u, max is %u\n",
+                    dev_id, MAX_SENSORS);
+            return;
+        }
 
-    // IDs ascii to int
-    while ((i < len) && (*(list_start++) == ',')) {
-        list[i] = _atoi((const char**)&list_start);
-        ++i;
+        parser.listed |= (1UL << (sensor - sensors));
+    } else {
+        rem_sensor(dev_id);
     }
 
-    // Remove any not on list
-    for (i = 0; i < MAX_SENSORS; i++) {
-        sensor = &sensors[i];
+    serial_printf("HUB: Sensor %s %u\n", add ? "add" : "rem", dev_id);
+}
 
-        if ((sensor == NULL) || (sensor->active == false)) {
-            continue;
-        } else {
-            bool found = false;
+static void update_alarm(uint32_t dev_id, int32_t low, int32_t high,
+                         uint32_t rate) {
+    sensor_t* sensor = get_sensor_by_id(dev_id);
 
-            for (uint32_t j = 0; j < len; j++) {
-                if (list[j] == sensor->dev_id) {
-                    found = true;
-                    break;
-                }
-            }
+    if (sensor == NULL) {
+        return;
+    }
 
-            if (found == false) {
-                rem_sensor(sensor->dev_id);
-            }
+    sensor->alarm_low = (int16_t)low;
+    sensor->alarm_high = (int16_t)high;
+    sensor->alarm_rate = (uint16_t)rate;
+
+    serial_printf("HUB: Alarm %u %i %i %u\n", dev_id, sensor->alarm_low,
+                  sensor->alarm_high, sensor->alarm_rate);
+}
+
+static void update_alarm_sms(const char* str) {
+    char    num[sizeof(app_info->alarm_sms)] = {0};
+    uint8_t len = 0;
+
+    if (*str == '+') {
+        num[len++] = *(str++);
+    }
+
+    while (_is_digit(*str) && (len < (sizeof(num) - 1))) {
+        num[len++] = *(str++);
+    }
+
+    // Only write EEPROM if changed
+    if ((num[0] == '+') && (len > 1) &&
+        (strncmp(num, app_info->alarm_sms, sizeof(num)) != 0)) {
+        for (uint8_t i = 0; i < sizeof(num); i++) {
+            mem_eeprom_write_byte((uint32_t)&app_info->alarm_sms[i],
+                                  (uint8_t)num[i]);
         }
+        HUB_LOG_S(LOG_INFO, "HUB: Alarm SMS %s\n", app_info->alarm_sms);
     }
+}
+
+static int32_t parse_int(const char** str) {
+    bool neg = false;
 
-    // Add new
-    for (i = 0; i < len; i++) {
-        add_sensor(list[i]);
+    if (**str == '-') {
+        neg = true;
+        (*str)++;
     }
 
-    // print_sensors();
+    int32_t val = (int32_t)_atoi(str);
+
+    return neg ? -val : val;
 }
 
 /** @} */
@@ -413,6 +534,7 @@ static void test(void) {
     // test_sim_get_request();
     // test_sim_get_request_version();
     // test_sim_post();
+    // test_w25_benchmark(W25_JOURNAL_START_SECTOR - 4, 4);
 
     // test_sim_get_request();
 }
@@ -430,25 +552,39 @@ static void hub(void) {
     clean_sensors();
     print_sensors();
 
-    // Start listening on rfm
+    // Start listening on rfm, fixed as sensors can't be told of a change
     rfm_init();
     rfm_config_for_lora(RFM_BW_125KHZ, RFM_CODING_RATE_4_5,
                         RFM_SPREADING_FACTOR_128CPS, true, 0);
     rfm_start_listening();
 
-    // Todo
-    // Get timestamp from sim
-    uint32_t timestamp = get_timestamp();
-    serial_printf("got timestamp %d", timestamp);
+    // Intervals, may be changed by cloud
+    remote_cfg_init();
+    log_set_level((uint8_t)remote_cfg_get(REMOTE_CFG_LOG_LEVEL));
+
+    // Store and forward readings, live values only if no external flash
+    journal_init();
+
+    // Time in each modem state from here on
+    modem_pwr_init();
+
+    // Bytes used this month, throttles uploads near the budget
+    data_usage_init();
+
+    // Signal quality, holds back uploads while poor
+    csq_init();
 
     // Init rtc, one hour wakeup flag for logging & checking software
     timers_rtc_init();
-    timers_set_wakeup_time(HUB_CHECK_TIME_S);
+    timers_set_wakeup_time(remote_cfg_get(REMOTE_CFG_CHECK_S));
     timers_disable_wut_interrupt();
 
     // Assume plugged in at first
     hub_plugged_in = true;
 
+    // Time synced from network with first upload
+    time_sync_pending = true;
+
     // Initial upload
     check_upload_pending = true;
     pwr_upload_pending = true;
@@ -465,7 +601,8 @@ static void hub(void) {
             // Check if hub plugged in or out since last check
             // Notify cloud if it has
             if (hub_plugged_in ^ batt_is_plugged_in()) {
-                log_printf("PWR: plugged %s\n", hub_plugged_in ? "out" : "in");
+                HUB_LOG_S(LOG_INFO, "PWR: plugged %s\n",
+                          hub_plugged_in ? "out" : "in");
                 pwr_upload_pending = true;
             }
             hub_plugged_in = batt_is_plugged_in();
@@ -477,31 +614,54 @@ static void hub(void) {
             check_upload_pending = true;
             log_counter++;
 
-            if (log_counter >= HUB_LOG_TIME_S / HUB_CHECK_TIME_S) {
+            if (log_counter >= checks_per(REMOTE_CFG_LOG_S)) {
                 log_counter = 0;
                 log_upload_pending = true;
                 pwr_upload_pending = true;
+
+                data_usage_save();
+            }
+
+            // LSI RTC drifts, resync with next upload
+            time_sync_counter++;
+            if (time_sync_counter >= checks_per(REMOTE_CFG_TIME_SYNC_S)) {
+                time_sync_counter = 0;
+                time_sync_pending = true;
             }
         }
 
         // Deal with modem and uploading to azure
         net_task();
 
+        // Background flash erase
+        journal_poll();
+
+        // Anything logged without a newline yet
+        log_flush();
+
+        // New config from cloud, apply without a reset
+        if (remote_cfg_changed()) {
+            timers_set_wakeup_time(remote_cfg_get(REMOTE_CFG_CHECK_S));
+            log_set_level((uint8_t)remote_cfg_get(REMOTE_CFG_LOG_LEVEL));
+        }
+
         // Start upgrade if signaled by cloud
         if (upgrade_to_version != 0) {
             if (hub_plugged_in) {
-                log_printf("UPG: Start\n");
+                HUB_LOG(LOG_INFO, "UPG: Start\n");
                 mem_eeprom_write_word_ptr(&shared_info->app_next_version,
                                           upgrade_to_version);
                 mem_eeprom_write_word_ptr(&shared_info->upg_pending,
                                           SHARED_UPGRADE_PENDING_KEY);
 
+                data_usage_save();
+
                 timers_pet_dogs();
                 timers_delay_milliseconds(500);
                 deinit();
                 scb_reset_system();
             } else {
-                log_printf("UPG: Not plugged in\n");
+                HUB_LOG(LOG_WARN, "UPG: Not plugged in\n");
             }
 
             upgrade_to_version = 0;
@@ -515,16 +675,18 @@ static void hub(void) {
     }
 }
 
-//
-static uint32_t get_timestamp(void) {
-    uint32_t stamp = 0;
-
-    return stamp;
+// Wakeups per interval, at least one
+static uint32_t checks_per(remote_cfg_key_t key) {
+    uint32_t num = remote_cfg_get(key) / remote_cfg_get(REMOTE_CFG_CHECK_S);
+    return num ? num : 1;
 }
 
+// Unix time, 0 until first network time sync
+static uint32_t get_timestamp(void) { return timers_rtc_get_timestamp(); }
+
 static void check_for_packets(void) {
     if (rfm_get_num_packets() > 0) {
-        log_printf("RFM: #RX %u\n", rfm_get_num_packets());
+        HUB_LOG(LOG_DBG, "RFM: #RX %u\n", rfm_get_num_packets());
 
         while (rfm_get_num_packets()) {
             // Get packet, decrypt and organise
@@ -536,16 +698,43 @@ static void check_for_packets(void) {
 
             // Skip if wrong device number
             if (sensor == NULL) {
-                log_printf(".Bad ID %u\n", packet->data.device_number);
+                HUB_LOG(LOG_WARN, ".Bad ID %u\n", packet->data.device_number);
                 continue;
             } else {
+                int16_t  prev_temp = sensor->temperature;
+                uint32_t prev_millis = sensor->rx_millis;
+
                 sensor->power = packet->data.power;
                 sensor->battery = packet->data.battery;
                 sensor->temperature = packet->data.temperature;
                 sensor->msg_num++;
-                sensor->msg_pend = true;
                 sensor->msg_appended = false;
                 sensor->rssi = packet->rssi;
+                sensor->timestamp = get_timestamp();
+                sensor->rx_millis = timers_millis();
+
+                // Only raise on entering alarm, cleared with normal uploads
+                if (check_alarm(sensor, prev_temp, prev_millis)) {
+                    HUB_LOG(LOG_INFO, "ALM: %u %i\n", sensor->dev_id,
+                            sensor->temperature);
+                    sensor->alarm_pend = true;
+
+                    if (false == alarm_pending) {
+                        alarm_pending = true;
+                        alarm_sms_sent = false;
+                        alarm_start = timers_millis();
+                    }
+                }
+
+                journal_rec_t rec = {
+                    .timestamp = sensor->timestamp,
+                    .dev_id = sensor->dev_id,
+                    .temperature = sensor->temperature,
+                    .battery = sensor->battery,
+                    .rssi = sensor->rssi,
+                    .power = sensor->power,
+                };
+                sensor->msg_pend = !journal_append(&rec);
             }
 
             // Print packet details
@@ -562,14 +751,65 @@ static void check_for_packets(void) {
     }
 }
 
+// True when sensor goes into alarm
+static bool check_alarm(sensor_t* sensor, int16_t prev_temp,
+                        uint32_t prev_millis) {
+    bool alarm = (sensor->temperature < sensor->alarm_low) ||
+                 (sensor->temperature > sensor->alarm_high);
+
+    // Rate of change since last reading, needs two readings
+    if ((sensor->alarm_rate != 0) && (sensor->msg_num > 1)) {
+        uint32_t dt_s = (sensor->rx_millis - prev_millis) / 1000;
+        int32_t  dtemp = (int32_t)sensor->temperature - prev_temp;
+
+        if (dtemp < 0) {
+            dtemp = -dtemp;
+        }
+
+        if ((dt_s != 0) &&
+            (((uint32_t)dtemp * 60U) / dt_s) > sensor->alarm_rate) {
+            alarm = true;
+        }
+    }
+
+    bool raised = alarm && !sensor->alarm_active;
+    sensor->alarm_active = alarm;
+
+    return raised;
+}
+
+// Sensor in alarm, another upload could be needed at any time
+static modem_pwr_prio_t net_priority(void) {
+    for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+        if (sensors[i].active && sensors[i].alarm_active) {
+            return MODEM_PWR_PRIO_URGENT;
+        }
+    }
+
+    return MODEM_PWR_PRIO_NORMAL;
+}
+
+// Alarm not uploaded in time, fall back to SMS if number set
+static bool alarm_sms_due(void) {
+    return alarm_pending && !alarm_sms_sent &&
+           (app_info->alarm_sms[0] == '+') &&
+           ((timers_millis() - alarm_start) > HUB_ALARM_SMS_TIMEOUT_MS);
+}
+
 static void net_task(void) {
     static net_state_t net_state = NET_0;
     static net_state_t net_next_state;
     static net_state_t net_fallback_state;
 
-    static uint32_t net_sleep_start;
-    static uint32_t net_sleep_time_ms = NET_SLEEP_TIME_DEFAULT_MS;
-    static bool     net_sleep_expired;
+    static sim_state_t       net_sleep_probe = SIM_SUCCESS;
+    static uint32_t          net_sleep_start;
+    static uint32_t          net_sleep_time_ms;
+    static bool              net_sleep_expired;
+    static modem_pwr_state_t net_sleep_mode = MODEM_PWR_OFF;
+    static uint32_t          num_bytes;
+    static uint32_t          timestamp;
+    static uint8_t           csq;
+    static uint32_t          csq_sample_time;
 
     net_sleep_expired =
         (uint32_t)(timers_millis() - net_sleep_start) > net_sleep_time_ms;
@@ -579,7 +819,7 @@ static void net_task(void) {
     switch (net_state) {
     // Upload inital message
     case NET_0:
-        NET_LOG("FIRST UPLOAD\n");
+        NET_LOG(LOG_INFO, "FIRST UPLOAD\n");
         net_next_state = NET_UPLOAD_FIRST_PACKET;
 
         sim800.state = SIM_SUCCESS;
@@ -590,6 +830,7 @@ static void net_task(void) {
         net_next_state = NET_REGISTERING;
         net_fallback_state = NET_UPLOAD_FIRST_PACKET;
 
+        modem_pwr_set_state(MODEM_PWR_ATTACH);
         sim800.state = sim_init();
         break;
 
@@ -598,6 +839,7 @@ static void net_task(void) {
         net_next_state = NET_REGISTERING;
         net_fallback_state = NET_INIT;
 
+        modem_pwr_set_state(MODEM_PWR_ATTACH);
         sim800.state = sim_init();
 
         break;
@@ -610,7 +852,7 @@ static void net_task(void) {
         break;
 
     case NET_REGISTERED:
-        NET_LOG("Registered\n");
+        NET_LOG(LOG_INFO, "Registered\n");
         net_next_state = NET_CONNECTING;
         net_fallback_state = NET_INIT;
 
@@ -625,7 +867,7 @@ static void net_task(void) {
         break;
 
     case NET_CONNECTED:
-        NET_LOG("Connected\n");
+        NET_LOG(LOG_INFO, "Connected\n");
 
         net_next_state = NET_RUNNING;
         net_fallback_state = NET_CONNECTING;
@@ -637,22 +879,83 @@ static void net_task(void) {
         net_fallback_state = NET_CONNECTING;
         sim800.state = SIM_BUSY;
 
-        if (upload_pending()) {
-            NET_LOG("Upload\n");
+        modem_pwr_set_state(MODEM_PWR_ON);
+
+        if (upload_due()) {
+            NET_LOG(LOG_DBG, "Upload\n");
             net_next_state = NET_CHECK_CONNECTION;
             sim800.state = SIM_SUCCESS;
-        } else if (false == hub_plugged_in) {
-            net_sleep_time_ms = NET_SLEEP_TIME_DEFAULT_MS;
-            net_next_state = NET_GO_TO_SLEEP;
-            sim800.state = SIM_SUCCESS;
+        } else {
+            modem_pwr_input_t in = {
+                .plugged_in = hub_plugged_in,
+                .batt_voltage = batt_get_batt_voltage(),
+                .prio = net_priority(),
+                .upload_ms = remote_cfg_get(REMOTE_CFG_UPLOAD_S) * 1000U};
+
+            net_sleep_mode = modem_pwr_select(&in, &net_sleep_time_ms);
+
+            if (net_sleep_mode != MODEM_PWR_ON) {
+                net_next_state = NET_SLEEP_START;
+                sim800.state = SIM_SUCCESS;
+            }
+            // Staying awake, keep signal history up to date
+            else if ((timers_millis() - csq_sample_time) > HUB_CSQ_SAMPLE_MS) {
+                net_next_state = NET_SAMPLE_SIGNAL;
+                sim800.state = SIM_SUCCESS;
+            }
         }
         break;
 
     case NET_CHECK_CONNECTION:
         sim800.state = sim_is_connected();
         net_fallback_state = NET_CONNECTING;
+        net_next_state = NET_CHECK_SIGNAL;
+
+        break;
+
+    // Poor signal, wait for better unless urgent. Failure not critical
+    case NET_CHECK_SIGNAL:
+        net_next_state = (time_sync_pending && !alarm_pending)
+                             ? NET_TIME_SYNC
+                             : NET_ASSEMBLE_PACKET;
+        net_fallback_state = net_next_state;
+
+        sim800.state = sim_get_signal(&csq);
+
+        if (sim800.state == SIM_SUCCESS) {
+            csq_sample_time = timers_millis();
+            csq_add(csq);
+
+            if (csq_defer_upload(alarm_pending)) {
+                net_next_state = NET_RUNNING;
+            }
+        }
+        break;
+
+    case NET_SAMPLE_SIGNAL:
+        net_next_state = NET_RUNNING;
+        net_fallback_state = NET_RUNNING;
+
+        sim800.state = sim_get_signal(&csq);
+        csq_sample_time = timers_millis();
+
+        if (sim800.state == SIM_SUCCESS) {
+            csq_add(csq);
+        }
+        break;
+
+    // Failure not critical, try again with next upload
+    case NET_TIME_SYNC:
         net_next_state = NET_ASSEMBLE_PACKET;
+        net_fallback_state = NET_ASSEMBLE_PACKET;
+
+        sim800.state = sim_get_timestamp(&timestamp);
 
+        if (sim800.state == SIM_SUCCESS) {
+            NET_LOG(LOG_INFO, "Time %u -> %u\n", get_timestamp(), timestamp);
+            timers_rtc_set_timestamp(timestamp);
+            time_sync_pending = false;
+        }
         break;
 
     case NET_ASSEMBLE_PACKET:
@@ -666,33 +969,49 @@ static void net_task(void) {
                               "&id=%u",
                               app_info->pwd, app_info->dev_id);
 
+        // Priority upload, only sensors in alarm
+        if (alarm_pending) {
+            serial_printf(".Alarm\n");
+            append_alarm();
+
+            serial_printf("//////////\nMSG %u: %s\n//////////\n",
+                          strlen(net_buf), net_buf);
+            break;
+        }
+
         serial_printf(".check\n");
         append_check();
 
-        serial_printf(".get sensors\n");
-        net_buf_append_printf("&sensors=get");
+        // Signal now, usual & worst since last upload, to compare to fails
+        net_buf_append_printf("&sig=%u,%u,%u,%u,%u", csq_last(), csq_avg(),
+                              csq_min(), upload_fails, csq_num_deferred());
+
+        // Whole list after boot, after that only what changed
+        serial_printf(".sensors\n");
+        net_buf_append_printf("&sensors=%s",
+                              sensor_list_synced ? "diff" : "get");
 
         if (pwr_pending()) {
             serial_printf(".Pwr\n");
             append_pwr();
         }
 
-        if (temps_pending()) {
-            serial_printf(".Temps: %u\n", temps_pending());
-            append_temp();
-        }
-
         if (log_pending()) {
             serial_printf(".Log\n");
             append_log();
             log_appended = true;
         }
 
+        if (temps_pending() || journal_pending()) {
+            serial_printf(".Temps: %u %u\n", temps_pending(),
+                          journal_pending());
+            append_temp();
+        }
+
         net_buf_append_printf("\0\0");
 
         serial_printf("//////////\nMSG %u: %s\n//////////\n", strlen(net_buf),
                       net_buf);
-        timers_delay_milliseconds(1000);
         break;
 
     case NET_HTTPPOST:
@@ -702,19 +1021,56 @@ static void net_task(void) {
         upgrade_to_version = 0;
 
         sim800.state = sim_http_post_str(
-            "http://rickceas.azurewebsites.net/CE/hub.php", net_buf, false, 3);
+            remote_cfg_url(), net_buf,
+            !strncmp(remote_cfg_url(), "https", 5), 3);
         break;
 
     case NET_HTTP_DONE:
-        net_next_state = NET_RUNNING;
+        net_next_state = NET_PARSE_RESPONSE;
         net_fallback_state = NET_RUNNING;
         sim800.state = SIM_SUCCESS;
 
         serial_printf("HTTP: %u %u\n", sim800.http.status_code,
                       sim800.http.response_size);
-        NET_LOG("Parse response\n");
-        parse_net_response();
+        last_upload = timers_millis();
+        upload_fails = 0;
+        net_resp_idx = 0;
+        csq_upload_done();
         clear_upload_pending();
+        net_buf_clear();
+        break;
+
+    case NET_PARSE_RESPONSE:
+        net_next_state = NET_RUNNING;
+        net_fallback_state = NET_RUNNING;
+        sim800.state = SIM_SUCCESS;
+
+        if (sim800.http.response_size == 0) {
+            break;
+        }
+
+        // Fixed windows so any size response parses in the same RAM
+        sim800.state = sim_http_read_response(net_resp_idx, NET_READ_WINDOW,
+                                              (uint8_t*)net_buf, &num_bytes);
+
+        if (sim800.state == SIM_SUCCESS) {
+            if (net_resp_idx == 0) {
+                NET_LOG(LOG_DBG, "Parse response %u\n",
+                        sim800.http.response_size);
+                parse_net_reset();
+            }
+
+            parse_net_response(net_buf, num_bytes);
+            net_resp_idx += num_bytes;
+
+            if (num_bytes && (net_resp_idx < sim800.http.response_size)) {
+                net_next_state = NET_PARSE_RESPONSE;
+            } else {
+                // Last field has no separator after it
+                parse_net_response("&", 1);
+                net_resp_idx = 0;
+            }
+        }
         break;
 
     case NET_SLEEP_START:
@@ -729,7 +1085,18 @@ static void net_task(void) {
         net_next_state = NET_SLEEP;
         net_fallback_state = NET_INIT;
 
-        sim800.state = sim_sleep();
+        if (net_sleep_mode == MODEM_PWR_CSCLK) {
+            sim800.state = sim_slow_clock(true);
+        } else if (net_sleep_mode == MODEM_PWR_MIN) {
+            sim800.state = sim_min_function(true);
+        } else {
+            net_sleep_mode = MODEM_PWR_OFF;
+            sim800.state = sim_sleep();
+        }
+
+        if (sim800.state == SIM_SUCCESS) {
+            modem_pwr_set_state(net_sleep_mode);
+        }
         break;
 
     case NET_SLEEP:
@@ -738,23 +1105,66 @@ static void net_task(void) {
 
         sim800.state = SIM_SUCCESS;
 
-        if (hub_plugged_in || (net_sleep_expired && upload_pending())) {
-            net_next_state = NET_INIT;
+        // Probe always run to the end, else the next command after waking
+        // starts half way through it
+        if (net_sleep_probe != SIM_BUSY) {
+            if (hub_plugged_in || alarm_pending ||
+                (net_sleep_expired && upload_due())) {
+                net_next_state = NET_WAKE;
+                modem_pwr_set_state(MODEM_PWR_ATTACH);
+                break;
+            }
+
+            if (net_sleep_mode != MODEM_PWR_OFF) {
+                break;
+            }
         }
+
         // Sim sometimes wakes up randomly, NET_INIT will put back to sleep
-        else if (sim_printf_and_check_response(100, "OK", "AT\r")) {
+        net_sleep_probe = sim_printf_and_check_response(100, "OK", "AT\r");
+
+        if (net_sleep_probe == SIM_SUCCESS) {
             net_next_state = NET_GO_TO_SLEEP;
         }
         break;
 
+    // Only redo as much as the sleep state lost
+    case NET_WAKE:
+        net_fallback_state = NET_INIT;
+
+        if (net_sleep_mode == MODEM_PWR_CSCLK) {
+            net_next_state = NET_RUNNING;
+            sim800.state = sim_slow_clock(false);
+        } else if (net_sleep_mode == MODEM_PWR_MIN) {
+            net_next_state = NET_REGISTERING;
+            sim800.state = sim_min_function(false);
+        } else {
+            net_next_state = NET_INIT;
+            sim800.state = SIM_SUCCESS;
+        }
+        break;
+
+    case NET_SEND_ALARM_SMS:
+        net_fallback_state = net_next_state;
+        sim800.state = sim_send_sms(app_info->alarm_sms, net_buf);
+
+        if (sim800.state == SIM_SUCCESS) {
+            NET_LOG(LOG_INFO, "Alarm SMS sent\n");
+            alarm_sms_sent = true;
+        } else if (sim800.state != SIM_BUSY) {
+            // Try again after another timeout
+            alarm_start = timers_millis();
+        }
+        break;
+
     case NET_ERROR:
-        NET_LOG("ERROR State\n");
+        NET_LOG(LOG_ERR, "ERROR State\n");
         net_next_state = NET_INIT;
         sim800.state = SIM_SUCCESS;
         break;
 
     default:
-        NET_LOG("DEFAULT State\n");
+        NET_LOG(LOG_ERR, "DEFAULT State\n");
         net_next_state = NET_INIT;
         sim800.state = SIM_SUCCESS;
         break;
@@ -763,23 +1173,77 @@ static void net_task(void) {
     if (sim800.state == SIM_SUCCESS) {
         net_state = net_next_state;
     } else if (sim800.state == SIM_ERROR || sim800.state == SIM_TIMEOUT) {
-        NET_LOG("SIM ERR %u fb %u\n", net_state, net_fallback_state);
+        NET_LOG(LOG_ERR, "SIM ERR %u fb %u\n", net_state, net_fallback_state);
+
+        if (net_state == NET_HTTPPOST) {
+            upload_fails++;
+
+            // A bad URL from the cloud would cut the hub off for good
+            if (upload_fails >= URL_MAX_FAILS) {
+                remote_cfg_default_url();
+            }
+        }
+
         net_state = net_fallback_state;
+
+        // Upload failing, text alarm then carry on from fallback state
+        if (alarm_sms_due() && (net_state != NET_SEND_ALARM_SMS)) {
+            NET_LOG(LOG_INFO, "Alarm SMS\n");
+            net_buf_clear();
+            append_alarm_sms();
+            net_next_state = net_state;
+            net_state = NET_SEND_ALARM_SMS;
+        }
+    }
+
+    // Count bytes used by whatever the SIM800 just did
+    if (sim800.data.tx || sim800.data.rx || sim800.data.overhead) {
+        data_usage_add(sim800.data.tx, sim800.data.rx, sim800.data.overhead,
+                       get_timestamp());
+        memset(&sim800.data, 0, sizeof(sim800.data));
     }
 }
 
 static bool upload_pending(void) {
-    return (check_pending() || temps_pending() || log_pending() ||
-            pwr_pending());
+    return (alarm_pending || check_pending() || temps_pending() ||
+            journal_pending() || log_pending() || pwr_pending());
+}
+
+// Space out uploads as data budget runs low, alarms always go
+static bool upload_due(void) {
+    if (alarm_pending) {
+        return true;
+    } else if (csq_waiting()) {
+        return false;
+    }
+
+    uint32_t since_upload = timers_millis() - last_upload;
+
+    // First upload after reset not held back
+    return upload_pending() &&
+           ((last_upload == 0) ||
+            (since_upload >= data_usage_upload_interval_ms()));
 }
 
 static void clear_upload_pending(void) {
+    // Alarm packet contains nothing else
+    if (alarm_pending && alarm_appended) {
+        alarm_pending = false;
+        alarm_appended = false;
+
+        for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+            sensors[i].alarm_pend = false;
+        }
+        return;
+    }
+
     if (check_upload_pending && check_appended) {
         check_upload_pending = false;
         check_appended = false;
     }
 
-    for (uint8_t i = 0; i < num_sensors; i++) {
+    // Removing sensors leaves holes, any slot may be in use
+    for (uint8_t i = 0; i < MAX_SENSORS; i++) {
         sensor_t* sensor = &sensors[i];
         if (sensor->msg_pend && sensor->msg_appended) {
             sensor->msg_pend = false;
@@ -788,7 +1252,10 @@ static void clear_upload_pending(void) {
     }
 
     if (log_upload_pending && log_appended) {
-        log_upload_pending = false;
+        log_mark_sent(log_upload_idx);
+
+        // Rest of a long log goes with the next upload
+        log_upload_pending = log_more;
         log_appended = false;
     }
 
@@ -796,53 +1263,128 @@ static void clear_upload_pending(void) {
         pwr_upload_pending = false;
         pwr_appended = false;
     }
-}
-
-static void parse_net_response(void) {
-    uint32_t sensor_list_len = 0;
-    uint32_t num_bytes = 0;
 
-    char* str = NULL;
+    journal_mark_uploaded(journal_appended);
+    journal_appended = 0;
+}
 
-    net_buf_clear();
+static void parse_net_reset(void) {
+    memset(&parser, 0, sizeof(parser));
+}
 
-    if (sim800.http.response_size > sizeof(net_buf) - 1) {
-        NET_LOG(".ERR resp too big %u!\n", sim800.http.response_size);
-        return;
+// Any length response, fields & list items are handled as they complete
+static void parse_net_response(const char* buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        char c = buf[i];
+
+        if (!parser.in_value) {
+            if (c == '=') {
+                parser.key[parser.key_len] = '\0';
+                parser.in_value = true;
+                parser.item_len = 0;
+                parser.num_items = 0;
+            } else if (_is_digit(c) || (c == '_') ||
+                       ((c >= 'a') && (c <= 'z'))) {
+                if (parser.key_len < (NET_KEY_MAX - 1)) {
+                    parser.key[parser.key_len++] = c;
+                }
+            } else {
+                parser.key_len = 0;
+            }
+        } else if (c == ',') {
+            parse_item();
+        } else if ((c == '&') || (c == '\r') || (c == '\n') || (c == ' ')) {
+            parse_item();
+            parse_field();
+
+            parser.in_value = false;
+            parser.key_len = 0;
+        } else if (parser.item_len < (NET_ITEM_MAX - 1)) {
+            parser.item[parser.item_len++] = c;
+        }
     }
+}
 
-    if (sim800.http.response_size) {
-        num_bytes = sim_http_read_response(0, sim800.http.response_size,
-                                           (uint8_t*)net_buf);
+static void parse_item(void) {
+    const char* str = parser.item;
+    uint8_t     idx = parser.num_items++;
 
-        net_buf[num_bytes] = '\0';
+    parser.item[parser.item_len] = '\0';
+    parser.item_len = 0;
 
-        // Print header
-        serial_printf(".num bytes: %u\n.header: %s\n", num_bytes, net_buf);
+    if (*str == '\0') {
+        return;
+    }
 
-        // Version
-        str = strstr(net_buf, "version=");
-        if (str != NULL) {
-            str += strlen("verison=");
-            upgrade_to_version = _atoi((const char**)&str);
-            serial_printf(".Upgrade to v%u\n", upgrade_to_version);
+    if (!strcmp(parser.key, "version")) {
+        upgrade_to_version = _atoi(&str);
+        serial_printf(".Upgrade to v%u\n", upgrade_to_version);
+    }
+    // Full list, count then IDs e.g. sensors=2,123,456
+    else if (!strcmp(parser.key, "sensors")) {
+        if (idx == 0) {
+            parser.listed = 0;
+            parser.list_count = _atoi(&str);
+            parser.list_ids = 0;
+            parser.list_counted = true;
+        } else {
+            update_sensor(_atoi(&str), true);
+            parser.list_ids++;
         }
+    } else if (!strcmp(parser.key, "sensors_add")) {
+        update_sensor(_atoi(&str), true);
+    } else if (!strcmp(parser.key, "sensors_rem")) {
+        update_sensor(_atoi(&str), false);
+    }
+    // Alarm thresholds, one per sensor e.g. alarm=<id>,<low>,<high>,<rate>
+    else if (!strcmp(parser.key, "alarm")) {
+        if (idx < NET_ITEMS_MAX) {
+            parser.vals[idx] = parse_int(&str);
+        }
+    }
+    // SMS number for alarms
+    else if (!strcmp(parser.key, "sms")) {
+        update_alarm_sms(str);
+    }
+    // Monthly data budget in kB
+    else if (!strcmp(parser.key, "data_kb")) {
+        if (_is_digit(*str)) {
+            data_usage_set_budget_kb(_atoi(&str));
+        }
+    }
+    // Config e.g. cfg=check_s,300 or cfg=url,http://...
+    else if (!strcmp(parser.key, "cfg")) {
+        if (idx == 0) {
+            parser.vals[0] = remote_cfg_find(str);
+        } else if (idx == 1) {
+            remote_cfg_set((int8_t)parser.vals[0], str);
+        }
+    }
+}
 
-        // Sensor list
-        str = strstr(net_buf, "sensors=");
-        if (str != NULL) {
-            str += strlen("sensors=");
-            sensor_list_len = _atoi((const char**)&str);
-
-            serial_printf(".List len: %u\n", sensor_list_len);
+static void parse_field(void) {
+    if (!strcmp(parser.key, "sensors")) {
+        // Truncated response, unlisted sensors may just not have arrived
+        if (!parser.list_counted || (parser.list_ids != parser.list_count)) {
+            NET_LOG(LOG_WARN, ".Sensor list %u of %u, kept\n",
+                    parser.list_ids, parser.list_count);
+            parser.list_counted = false;
+            return;
+        }
+        parser.list_counted = false;
 
-            if (sensor_list_len > MAX_SENSORS) {
-                NET_LOG(".ERR sens list too long %u, max is %u\n",
-                        sensor_list_len, MAX_SENSORS);
-            } else {
-                update_sensor_list(str, sensor_list_len);
+        // Remove any not on the list
+        for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+            if (sensors[i].active && !(parser.listed & (1UL << i))) {
+                update_sensor(sensors[i].dev_id, false);
             }
         }
+
+        sensor_list_synced = true;
+    } else if (!strcmp(parser.key, "alarm") &&
+               (parser.num_items == NET_ITEMS_MAX)) {
+        update_alarm((uint32_t)parser.vals[0], parser.vals[1], parser.vals[2],
+                     (uint32_t)parser.vals[3]);
     }
 }
 
@@ -851,8 +1393,8 @@ static bool check_pending(void) { return check_upload_pending; }
 
 static uint8_t temps_pending(void) {
     uint8_t res = 0;
-    for (uint8_t i = 0; i < num_sensors; i++) {
-        if (sensors[i].msg_pend) {
+    for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+        if (sensors[i].active && sensors[i].msg_pend) {
             ++res;
         }
     }
@@ -860,7 +1402,9 @@ static uint8_t temps_pending(void) {
     return res;
 }
 
-static bool log_pending(void) { return log_upload_pending; }
+static bool log_pending(void) {
+    return log_upload_pending && log_unsent() && !data_usage_defer_log();
+}
 
 static bool pwr_pending(void) { return pwr_upload_pending; }
 
@@ -872,18 +1416,33 @@ static void append_check(void) {
 
 static void append_temp(void) {
     uint8_t num_pending = temps_pending();
-    net_buf_append_printf("&num_temp=%u", num_pending);
 
+    // Backfill from journal with whatever space is left after log etc.
+    uint32_t num_journal = 0;
+    uint32_t space = sizeof(net_buf) - net_buf_idx;
+    if (space > ((num_pending + 1U) * JOURNAL_REC_MAX_CHARS)) {
+        num_journal = (space / JOURNAL_REC_MAX_CHARS) - num_pending - 1U;
+    }
+    if (num_journal > JOURNAL_UPLOAD_BATCH) {
+        num_journal = JOURNAL_UPLOAD_BATCH;
+    }
+    if (num_journal > journal_pending()) {
+        num_journal = journal_pending();
+    }
+
+    net_buf_append_printf("&num_temp=%u", num_pending + num_journal);
+
+    uint16_t j = 0;
     if (num_pending) {
-        uint16_t j = 0;
         for (uint16_t i = 0; i < MAX_SENSORS; i++) {
             sensor_t* sensor = &sensors[i];
 
-            if (sensor->msg_pend) {
+            if (sensor->active && sensor->msg_pend) {
                 net_buf_append_printf("&id%u=%u", j, sensor->dev_id);
                 net_buf_append_printf("&temp%u=%i", j, sensor->temperature);
                 net_buf_append_printf("&batt%u=%u", j, sensor->battery);
                 net_buf_append_printf("&rssi%u=%i", j, sensor->rssi);
+                net_buf_append_printf("&ts%u=%u", j, sensor->timestamp);
 
                 sensor->msg_appended = true;
 
@@ -891,22 +1450,101 @@ static void append_temp(void) {
             }
         }
     }
+
+    append_journal(j, num_journal);
 }
 
-static void append_log(void) {
-    net_buf_append_printf("&log=\n-----LOG START------\n");
+// Same keys as live readings plus time received
+static void append_journal(uint32_t idx, uint32_t num) {
+    journal_rec_t rec;
 
-    log_read_reset();
-    for (uint16_t i = 0; i < log_size(); i++) {
-        char c = log_read();
-        if (c == '\0') {
-            c = ' ';
+    journal_appended = 0;
+
+    while ((journal_appended < num) && journal_peek(journal_appended, &rec)) {
+        net_buf_append_printf("&id%u=%u", idx, rec.dev_id);
+        net_buf_append_printf("&temp%u=%i", idx, rec.temperature);
+        net_buf_append_printf("&batt%u=%u", idx, rec.battery);
+        net_buf_append_printf("&rssi%u=%i", idx, rec.rssi);
+        net_buf_append_printf("&ts%u=%u", idx, rec.timestamp);
+
+        ++journal_appended;
+        ++idx;
+    }
+}
+
+static void append_alarm(void) {
+    uint8_t j = 0;
+
+    for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+        sensor_t* sensor = &sensors[i];
+
+        if (sensor->active && sensor->alarm_pend) {
+            net_buf_append_printf("&id%u=%u", j, sensor->dev_id);
+            net_buf_append_printf("&temp%u=%i", j, sensor->temperature);
+            net_buf_append_printf("&ts%u=%u", j, sensor->timestamp);
+            ++j;
         }
-        net_buf_append_printf("%c", c);
     }
 
-    net_buf_append_printf("\n-----LOG END------\n");
+    net_buf_append_printf("&alarm=%u", j);
+    alarm_appended = true;
+}
+
+static void append_alarm_sms(void) {
+    net_buf_append_printf("CoolEase hub %u alarm", app_info->dev_id);
+
+    for (uint8_t i = 0; i < MAX_SENSORS; i++) {
+        sensor_t* sensor = &sensors[i];
+
+        if (sensor->active && sensor->alarm_pend) {
+            bool     neg = sensor->temperature < 0;
+            uint32_t temp = neg ? -sensor->temperature : sensor->temperature;
+
+            net_buf_append_printf("\n%u: %s%u.%02u C", sensor->dev_id,
+                                  neg ? "-" : "", temp / 100, temp % 100);
+        }
+    }
+}
+
+static void append_log(void) {
+    // Only what was written since the last acknowledged upload
+    uint16_t from = log_sent_index();
+    uint32_t unsent = log_unsent();
+    uint32_t num = unsent;
+
+    net_buf_append_printf("&log_idx=%u", from);
+
+#ifdef HUB_LOG_LZ
+    net_buf_append_printf("&logz=");
+
+    log_lz_from = from;
+    num = lz_compress(log_lz_get, num, net_buf_append_b64,
+                      (HUB_LOG_MAX_CHARS / 4) * 3);
+    net_buf_b64_flush();
+#else
+    // Finish on a whole line if it does not all fit
+    if (num > HUB_LOG_MAX_CHARS) {
+        num = HUB_LOG_MAX_CHARS;
+        for (uint32_t end = num; end > 0; end--) {
+            if (log_get_byte((from + end - 1) % log_size()) == '\n') {
+                num = end;
+                break;
+            }
+        }
+    }
+
+    net_buf_append_printf("&log=");
+    for (uint32_t i = 0; i < num; i++) {
+        char c = (char)log_get_byte((from + i) % log_size());
+        _putchar_buffer((c == '\0') ? ' ' : c);
+    }
+#endif
+
+    log_upload_idx = (uint16_t)((from + num) % log_size());
+    log_more = (num < unsent);
     log_appended = true;
+
+    NET_LOG(LOG_DBG, ".log %u of %u\n", num, unsent);
 }
 
 static void append_pwr(void) {
@@ -916,6 +1554,20 @@ static void append_pwr(void) {
                           batt_get_pwr_voltage(), batt_get_batt_voltage(),
                           hub_plugged_in ? HUB_PLUGGED_IN_VALUE
                                          : HUB_PLUGGED_OUT_VALUE);
+
+    // Seconds in each modem_pwr_state_t
+    net_buf_append_printf("&modem=");
+    for (uint8_t i = 0; i < MODEM_PWR_NUM_STATES; i++) {
+        net_buf_append_printf(i ? ",%u" : "%u",
+                              modem_pwr_get_time_s((modem_pwr_state_t)i));
+    }
+    modem_pwr_print();
+
+    net_buf_append_printf("&data=%u,%u,%u", data_usage_day_bytes(),
+                          data_usage_month_bytes(), data_usage_level());
+
+    // Lets the cloud spot hubs that missed a config change
+    net_buf_append_printf("&cfg=%u", remote_cfg_hash());
     pwr_appended = true;
 }
 
@@ -934,8 +1586,41 @@ static uint32_t net_buf_append_printf(const char* format, ...) {
     return res;
 }
 
+// Unpadded URL safe base64, 3 bytes to 4 chars
+static void net_buf_append_b64(uint8_t byte) {
+    b64_acc = (b64_acc << 8) | byte;
+    b64_len++;
+
+    if (b64_len == 3) {
+        for (int8_t shift = 18; shift >= 0; shift -= 6) {
+            _putchar_buffer(b64_chars[(b64_acc >> shift) & 0x3F]);
+        }
+        b64_acc = 0;
+        b64_len = 0;
+    }
+}
+
+// 1 byte left is 2 chars, 2 bytes 3 chars
+static void net_buf_b64_flush(void) {
+    if (b64_len) {
+        b64_acc <<= 8 * (3 - b64_len);
+        for (uint8_t i = 0; i <= b64_len; i++) {
+            _putchar_buffer(b64_chars[(b64_acc >> (18 - (6 * i))) & 0x3F]);
+        }
+        b64_acc = 0;
+        b64_len = 0;
+    }
+}
+
 static void _putchar_buffer(char character) {
-    net_buf[net_buf_idx++] = character;
+    // Leave room for null terminator
+    if (net_buf_idx < (sizeof(net_buf) - 1)) {
+        net_buf[net_buf_idx++] = character;
+    }
+}
+
+static uint8_t log_lz_get(uint32_t idx) {
+    return log_get_byte((uint16_t)((log_lz_from + idx) % log_size()));
 }
 
 /** @} */
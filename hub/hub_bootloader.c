@@ -17,16 +17,16 @@
 
 #include "hub/hub_bootloader.h"
 
-#include <libopencm3/stm32/crc.h>
-
 #include "common/log.h"
 #include "common/memory.h"
 #include "common/printf.h"
+#include "common/state.h"
 #include "common/test.h"
 #include "common/timers.h"
 #include "config/board_defs.h"
 
 #include "hub/cusb.h"
+#include "hub/fw_slot.h"
 #include "hub/hub_test.h"
 #include "hub/sim.h"
 #include "hub/w25qxx.h"
@@ -42,16 +42,14 @@
 #define VERSION         100
 #define BACKUP_VERSION  100
 #define BIN_HEADER_SIZE 64
+// Bytes per HTTPREAD while programming, multiple of flash half page
+#define BIN_READ_SIZE 512
 
 #define NET_LOG                                                                \
     log_printf("NET: ");                                                       \
     log_printf
-#define BOOT_CLEAR_UPG_FLAG(x)                                                 \
-    mem_eeprom_write_word_ptr(&boot_info->upg_flags,                           \
-                              (boot_info->upg_flags & (~(x))))
-#define BOOT_SET_UPG_FLAG(x)                                                   \
-    mem_eeprom_write_word_ptr(&boot_info->upg_flags,                           \
-                              (boot_info->upg_flags | (x)))
+#define BOOT_CLEAR_UPG_FLAG(x) (state_info->upg_flags &= ~(x))
+#define BOOT_SET_UPG_FLAG(x)   (state_info->upg_flags |= (x))
 
 #define UPG_FLAG_DATA_ERR       (1 << 0)
 #define UPG_FLAG_DOWNLOAD_ERR   (1 << 1)
@@ -66,6 +64,7 @@
 #define UPG_FLAG_RECOVERY     (1 << 9)
 #define UPG_FLAG_BACKUP       (1 << 10)
 #define UPG_FLAG_IWDG_UPGRADE (1 << 11)
+#define UPG_FLAG_LOCAL        (1 << 12)
 
 typedef enum {
     NET_0 = 0,
@@ -118,6 +117,12 @@ typedef enum upg_type {
 static char     sim_buf[1536];
 static uint16_t sim_buf_idx = 0;
 
+// Expected crc of the bin being programmed, from its header
+static uint32_t bin_crc32 = 0;
+
+// W25 slot the bin is downloaded into
+static fw_slot_t bin_slot = FW_SLOT_A;
+
 static net_state_t net_state = NET_0;
 static net_state_t net_next_state = NET_0;
 static net_state_t net_fallback_state = NET_0;
@@ -129,8 +134,9 @@ static void test(void);
 static bool net_task(void);
 static void net_fallback(void);
 static bool check_bin(void);
-static bool check_crc(uint32_t expected);
 static bool program_bin(void);
+static bool install_slot(int8_t slot);
+static uint32_t read_response(uint32_t address, uint32_t size, uint8_t* buf);
 
 static void     prepare_msg(msg_type_e msg_type);
 static void     sim_buf_clear(void);
@@ -181,134 +187,147 @@ int main(void) {
     uint32_t recovery_check_timer = timers_millis();
 
     // If first power on
-    if (boot_info->init_key != BOOT_INIT_KEY2) {
+    if (state_info->init_key != BOOT_INIT_KEY2) {
         BOOT_LOG("First App Check\n");
 
         serial_printf(".Boot: v%8u\n", VERSION);
 
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_fail_runs, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset, 0);
+        state_info->app_ok_key = 0;
+        state_info->app_num_fail_runs = 0;
+        state_info->app_num_iwdg_reset = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_state, UPGRADE_TEST_RUN_APP);
-        mem_eeprom_write_word_ptr(&boot_info->upg_flags, UPG_FLAG_FIRST_CHECK);
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress,
-                                  BOOT_UPGRADE_IN_PROGRESS_KEY);
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed,
-                                  BOOT_UPGRADE_NEW_APP_INSTALLED_KEY);
+        state_info->upg_state = UPGRADE_TEST_RUN_APP;
+        state_info->upg_flags = UPG_FLAG_FIRST_CHECK;
+        state_info->upg_in_progress = BOOT_UPGRADE_IN_PROGRESS_KEY;
+        state_info->upg_new_app_installed = BOOT_UPGRADE_NEW_APP_INSTALLED_KEY;
 
         // Set initialized
-        mem_eeprom_write_word_ptr(&boot_info->init_key, BOOT_INIT_KEY2);
+        state_info->init_key = BOOT_INIT_KEY2;
     }
     // Super backup condition just in case
-    else if ((boot_info->app_num_iwdg_reset >= 10) ||
+    else if ((state_info->app_num_iwdg_reset >= 10) ||
              (mem_read_bkp_reg(BKUP_NUM_IWDG_RESET) >= 10)) {
-        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                  UPGRADE_RECOVERY_FAILED);
+        state_info->upg_state = UPGRADE_RECOVERY_FAILED;
 
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
+        state_info->app_ok_key = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_done, 0);
+        state_info->upg_new_app_installed = 0;
+        state_info->upg_done = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_flags, UPG_FLAG_IWDG_UPGRADE);
+        state_info->upg_flags = UPG_FLAG_IWDG_UPGRADE;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress,
-                                  BOOT_UPGRADE_IN_PROGRESS_KEY);
+        state_info->upg_in_progress = BOOT_UPGRADE_IN_PROGRESS_KEY;
     }
     // Try downgrade to backup version if watchdog resetting app
-    else if (boot_info->app_num_iwdg_reset >= 3 &&
-             (boot_info->upg_in_progress != BOOT_UPGRADE_IN_PROGRESS_KEY)) {
-        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                  UPGRADE_RECOVER_BACKUP_APP);
+    else if (state_info->app_num_iwdg_reset >= 3 &&
+             (state_info->upg_in_progress != BOOT_UPGRADE_IN_PROGRESS_KEY)) {
+        state_info->upg_state = UPGRADE_RECOVER_BACKUP_APP;
 
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
+        state_info->app_ok_key = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_done, 0);
+        state_info->upg_new_app_installed = 0;
+        state_info->upg_done = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_num_recovery_attempts, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_flags, UPG_FLAG_IWDG_UPGRADE);
+        state_info->upg_num_recovery_attempts = 0;
+        state_info->upg_flags = UPG_FLAG_IWDG_UPGRADE;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress,
-                                  BOOT_UPGRADE_IN_PROGRESS_KEY);
+        state_info->upg_in_progress = BOOT_UPGRADE_IN_PROGRESS_KEY;
     }
     // Begin upgrade if signaled by main app, if not already happening
     else if ((shared_info->upg_pending == SHARED_UPGRADE_PENDING_KEY) &&
-             (boot_info->app_ok_key == BOOT_APP_OK_KEY) &&
-             (boot_info->upg_in_progress != BOOT_UPGRADE_IN_PROGRESS_KEY)) {
+             (state_info->app_ok_key == BOOT_APP_OK_KEY) &&
+             (state_info->upg_in_progress != BOOT_UPGRADE_IN_PROGRESS_KEY)) {
 
-        mem_eeprom_write_word_ptr(&boot_info->app_version,
-                                  shared_info->app_curr_version);
-        mem_eeprom_write_word_ptr(&boot_info->app_update_version,
-                                  shared_info->app_next_version);
-        mem_eeprom_write_word_ptr(&boot_info->app_previous_version,
-                                  shared_info->app_curr_version);
+        state_info->app_version = shared_info->app_curr_version;
+        state_info->app_update_version = shared_info->app_next_version;
+        state_info->app_previous_version = shared_info->app_curr_version;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_state, UPGRADE_INIT);
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_done, 0);
+        state_info->upg_state = UPGRADE_INIT;
+        state_info->upg_new_app_installed = 0;
+        state_info->upg_done = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_version_to_download, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_num_recovery_attempts, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_flags, UPG_FLAG_APP_UPGRADE);
+        state_info->upg_version_to_download = 0;
+        state_info->upg_num_recovery_attempts = 0;
+        state_info->upg_flags = UPG_FLAG_APP_UPGRADE;
+
+        state_info->upg_in_progress = BOOT_UPGRADE_IN_PROGRESS_KEY;
+    }
 
-        // Only try upgrade once
+    // Whichever branch ran is saved as one record. Only try upgrade once, the
+    // request is cleared after the record is saved so a reset between neither
+    // loses it nor runs it twice
+    if (state_commit() &&
+        (state_info->upg_in_progress == BOOT_UPGRADE_IN_PROGRESS_KEY) &&
+        (shared_info->upg_pending == SHARED_UPGRADE_PENDING_KEY)) {
         mem_eeprom_write_word_ptr(&shared_info->upg_pending, 0);
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress,
-                                  BOOT_UPGRADE_IN_PROGRESS_KEY);
     }
 
     // State machine for upgrade procedure,
     // if upgrade fail, install previous version
     // then try backup version
     // then wait for instructions from cloud
-    if (boot_info->upg_in_progress == BOOT_UPGRADE_IN_PROGRESS_KEY) {
+    if (state_info->upg_in_progress == BOOT_UPGRADE_IN_PROGRESS_KEY) {
         bool     break_upg_loop = false;
         bool     download_ok = false;
         uint32_t timer = 0;
 
         // If reset occurs during critical part (downloading/ programming .bin),
         // error
-        if ((boot_info->upg_state >= UPGRADE_DOWNLOAD_BIN) &&
-            (boot_info->upg_state <= UPGRADE_PROGRAM_BIN)) {
-            mem_eeprom_write_word_ptr(&boot_info->upg_state, UPGRADE_ERROR);
+        if ((state_info->upg_state >= UPGRADE_DOWNLOAD_BIN) &&
+            (state_info->upg_state <= UPGRADE_PROGRAM_BIN)) {
+            state_info->upg_state = UPGRADE_ERROR;
+            state_commit();
         }
 
         while (break_upg_loop == false) {
             timers_pet_dogs();
 
-            serial_printf("UPG: %u\n", boot_info->upg_state);
+            serial_printf("UPG: %u\n", state_info->upg_state);
 
-            switch (boot_info->upg_state) {
+            switch (state_info->upg_state) {
             case UPGRADE_INIT:
                 BOOT_LOG("Begin upgrade from v%u to v%u\n",
-                         boot_info->app_version, boot_info->app_update_version);
+                         state_info->app_version,
+                         state_info->app_update_version);
 
                 // Check info is set
-                if ((boot_info->app_version != 0) &&
-                    (boot_info->app_update_version != 0) &&
-                    (boot_info->app_previous_version != 0)) {
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_version_to_download,
-                        boot_info->app_update_version);
+                if ((state_info->app_version != 0) &&
+                    (state_info->app_update_version != 0) &&
+                    (state_info->app_previous_version != 0)) {
+                    // Keep the running app on the W25 so a rollback never
+                    // needs downloading. Golden if still empty, otherwise A,
+                    // which program_bin() then leaves alone
+                    if (fw_slot_find(state_info->app_version) < 0) {
+                        fw_slot_t save_slot =
+                            fw_slot_valid(FW_SLOT_GOLDEN, NULL)
+                                ? FW_SLOT_A
+                                : FW_SLOT_GOLDEN;
+
+                        if (false ==
+                            fw_slot_save(save_slot, state_info->app_version,
+                                         FLASH_LOG_BKP - FLASH_APP_ADDRESS)) {
+                            log_printf("UPG: Save v%u fail\n",
+                                       state_info->app_version);
+                        }
+                    }
+
+                    state_info->upg_version_to_download =
+                        state_info->app_update_version;
 
                     prepare_msg(MSG_GET_NEXT_BIN);
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_DOWNLOAD_BIN);
+                    state_info->upg_state = UPGRADE_DOWNLOAD_BIN;
                 } else {
                     log_printf("UPG: Bad init data\n");
                     BOOT_SET_UPG_FLAG(UPG_FLAG_DATA_ERR);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_ERROR);
+                    state_info->upg_state = UPGRADE_ERROR;
                 }
                 break;
 
             case UPGRADE_DOWNLOAD_BIN:
                 // Check for version & try download for 3 min
                 log_printf("UPG: Download %u\n",
-                           boot_info->upg_version_to_download);
+                           state_info->upg_version_to_download);
                 timer = timers_millis();
                 download_ok = false;
                 while ((false == download_ok) &&
@@ -317,44 +336,34 @@ int main(void) {
                 }
 
                 if (download_ok == true) {
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_CHECK_BIN);
+                    state_info->upg_state = UPGRADE_CHECK_BIN;
                 } else {
                     net_fallback();
                     BOOT_SET_UPG_FLAG(UPG_FLAG_DOWNLOAD_ERR);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_ERROR);
+                    state_info->upg_state = UPGRADE_ERROR;
                 }
                 break;
 
             case UPGRADE_CHECK_BIN:
                 if (check_bin() == true) {
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_PROGRAM_BIN);
+                    state_info->upg_state = UPGRADE_PROGRAM_BIN;
                 } else {
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_ERROR);
+                    state_info->upg_state = UPGRADE_ERROR;
                 }
                 break;
 
             case UPGRADE_PROGRAM_BIN:
-                // Once this state is reached assume that program memory is
-                // garbage unless succesfull programming
-                mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
-
-                if (program_bin() == true) {
+                // Bin is streamed into a spare W25 slot, the app in internal
+                // flash is only touched once the whole bin is in & its CRC
+                // matches. From then on assume program memory is garbage
+                // unless the install succeeds, recovered from through
+                // UPGRADE_ERROR
+                if ((program_bin() == true) && install_slot(bin_slot)) {
                     BOOT_LOG("Binary installed\n");
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_new_app_installed,
-                        BOOT_UPGRADE_NEW_APP_INSTALLED_KEY);
-
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_TEST_RUN_APP);
+                    state_info->upg_state = UPGRADE_TEST_RUN_APP;
                 } else {
                     BOOT_LOG("Programming fail\n");
-                    BOOT_SET_UPG_FLAG(UPG_FLAG_PROG_ERR);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_ERROR);
+                    state_info->upg_state = UPGRADE_ERROR;
                 }
 
                 break;
@@ -362,80 +371,75 @@ int main(void) {
             case UPGRADE_TEST_RUN_APP:
                 // Break while loop to allow program to run and check if its ok
                 break_upg_loop = true;
-                mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                          UPGRADE_CHECK_APP_OK);
+                state_info->upg_state = UPGRADE_CHECK_APP_OK;
                 break;
 
             case UPGRADE_CHECK_APP_OK:
                 if (shared_info->app_ok_key == SHARED_APP_OK_KEY) {
                     // Program running succesfully
-                    mem_eeprom_write_word_ptr(&boot_info->app_ok_key,
-                                              BOOT_APP_OK_KEY);
+                    state_info->app_ok_key = BOOT_APP_OK_KEY;
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_DONE);
+                    state_info->upg_state = UPGRADE_DONE;
                 } else {
                     // Currently fail after first failed run
-                    mem_eeprom_write_word_ptr(&boot_info->app_num_fail_runs,
-                                              boot_info->app_num_fail_runs + 1);
+                    state_info->app_num_fail_runs++;
 
-                    if (boot_info->app_num_fail_runs >= 1) {
+                    if (state_info->app_num_fail_runs >= 1) {
                         BOOT_SET_UPG_FLAG(UPG_FLAG_TEST_ERR);
-                        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                  UPGRADE_ERROR);
+                        state_info->upg_state = UPGRADE_ERROR;
                     } else {
                         // Try again
-                        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                  UPGRADE_TEST_RUN_APP);
+                        state_info->upg_state = UPGRADE_TEST_RUN_APP;
                     }
                 }
                 break;
 
             case UPGRADE_RECOVER_PREVIOUS_APP:
-                mem_eeprom_write_word_ptr(&boot_info->upg_num_recovery_attempts,
-                                          boot_info->upg_num_recovery_attempts +
-                                              1);
-                if (boot_info->upg_num_recovery_attempts > 3) {
+                state_info->upg_num_recovery_attempts++;
+                if (state_info->upg_num_recovery_attempts > 3) {
                     // Reset counter for backup attempt
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_num_recovery_attempts, 0);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_RECOVER_BACKUP_APP);
+                    state_info->upg_num_recovery_attempts = 0;
+                    state_info->upg_state = UPGRADE_RECOVER_BACKUP_APP;
                 } else {
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_version_to_download,
-                        boot_info->app_previous_version);
+                    state_info->upg_version_to_download =
+                        state_info->app_previous_version;
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_flags,
-                                              UPG_FLAG_RECOVERY);
+                    state_info->upg_flags = UPG_FLAG_RECOVERY;
+
+                    // Still on the W25 from before the upgrade
+                    if (install_slot(
+                            fw_slot_find(state_info->app_previous_version))) {
+                        BOOT_SET_UPG_FLAG(UPG_FLAG_LOCAL);
+                        state_info->upg_state = UPGRADE_TEST_RUN_APP;
+                        break;
+                    }
 
                     prepare_msg(MSG_GET_NEXT_BIN);
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_DOWNLOAD_BIN);
+                    state_info->upg_state = UPGRADE_DOWNLOAD_BIN;
                 }
                 break;
 
             case UPGRADE_RECOVER_BACKUP_APP:
-                mem_eeprom_write_word_ptr(&boot_info->upg_num_recovery_attempts,
-                                          boot_info->upg_num_recovery_attempts +
-                                              1);
-                if (boot_info->upg_num_recovery_attempts > 3) {
+                state_info->upg_num_recovery_attempts++;
+                if (state_info->upg_num_recovery_attempts > 3) {
                     recovery_auto_timer = timers_millis();
                     recovery_check_timer = timers_millis();
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_RECOVERY_FAILED);
+                    state_info->upg_state = UPGRADE_RECOVERY_FAILED;
                 } else {
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_version_to_download, BACKUP_VERSION);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_flags,
-                                              UPG_FLAG_BACKUP);
+                    state_info->upg_version_to_download = BACKUP_VERSION;
+                    state_info->upg_flags = UPG_FLAG_BACKUP;
+
+                    if (install_slot(FW_SLOT_GOLDEN)) {
+                        BOOT_SET_UPG_FLAG(UPG_FLAG_LOCAL);
+                        state_info->upg_state = UPGRADE_TEST_RUN_APP;
+                        break;
+                    }
 
                     prepare_msg(MSG_GET_NEXT_BIN);
 
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_DOWNLOAD_BIN);
+                    state_info->upg_state = UPGRADE_DOWNLOAD_BIN;
                 }
                 break;
 
@@ -446,14 +450,11 @@ int main(void) {
                 timers_delay_milliseconds(3000);
                 if ((timers_millis() - recovery_check_timer) > 60000) {
                     recovery_check_timer = timers_millis();
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_CHECK_CLOUD);
+                    state_info->upg_state = UPGRADE_CHECK_CLOUD;
                 } else if ((timers_millis() - recovery_auto_timer) > 600000) {
                     recovery_auto_timer = timers_millis();
-                    mem_eeprom_write_word_ptr(
-                        &boot_info->upg_num_recovery_attempts, 0);
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_RECOVER_BACKUP_APP);
+                    state_info->upg_num_recovery_attempts = 0;
+                    state_info->upg_state = UPGRADE_RECOVER_BACKUP_APP;
                 }
                 break;
 
@@ -469,8 +470,7 @@ int main(void) {
                 if (download_ok == true) {
                     // Check header (no bin)
                     char     buf[BIN_HEADER_SIZE] = {0};
-                    uint32_t num_bytes =
-                        sim_http_read_response(0, 63, (uint8_t*)buf);
+                    uint32_t num_bytes = read_response(0, 63, (uint8_t*)buf);
                     buf[num_bytes] = '\0';
 
                     char* str = strstr(buf, "version=");
@@ -478,31 +478,32 @@ int main(void) {
                         str += strlen("verison=");
                         uint32_t ver = _atoi((const char**)&str);
                         if (ver != 0) {
-                            mem_eeprom_write_word_ptr(
-                                &boot_info->upg_version_to_download, ver);
+                            state_info->upg_version_to_download = ver;
                             serial_printf(".Upgrade to v%u\n",
-                                          boot_info->upg_version_to_download);
+                                          state_info->upg_version_to_download);
                             prepare_msg(MSG_GET_NEXT_BIN);
 
-                            mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                      UPGRADE_DOWNLOAD_BIN);
+                            state_info->upg_state = UPGRADE_DOWNLOAD_BIN;
                         } else {
-                            mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                      UPGRADE_RECOVERY_FAILED);
+                            state_info->upg_state = UPGRADE_RECOVERY_FAILED;
                         }
                     }
                 } else {
                     net_fallback();
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_RECOVERY_FAILED);
+                    state_info->upg_state = UPGRADE_RECOVERY_FAILED;
                 }
                 break;
 
             case UPGRADE_DONE:
-                mem_eeprom_write_word_ptr(&boot_info->upg_done,
-                                          BOOT_UPGRADE_DONE_KEY);
-                mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                          UPGRADE_DO_NOTHING);
+                // First app seen running ok is kept as the last resort
+                if ((state_info->app_ok_key == BOOT_APP_OK_KEY) &&
+                    (false == fw_slot_valid(FW_SLOT_GOLDEN, NULL))) {
+                    fw_slot_save(FW_SLOT_GOLDEN, shared_info->app_curr_version,
+                                 FLASH_LOG_BKP - FLASH_APP_ADDRESS);
+                }
+
+                state_info->upg_done = BOOT_UPGRADE_DONE_KEY;
+                state_info->upg_state = UPGRADE_DO_NOTHING;
                 break;
 
             case UPGRADE_DO_NOTHING:
@@ -516,32 +517,32 @@ int main(void) {
                 log_printf("Upg: Error\n");
 
                 // Check if old version still programmed
-                if (boot_info->app_ok_key == BOOT_APP_OK_KEY) {
+                if (state_info->app_ok_key == BOOT_APP_OK_KEY) {
                     log_printf(".App still Ok\n");
 
                     // Send error message
-                    mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                              UPGRADE_DONE);
+                    state_info->upg_state = UPGRADE_DONE;
                 }
                 // Otherwise recover
                 else {
                     // Try previous app
-                    if ((boot_info->upg_version_to_download ==
-                         boot_info->app_update_version) ||
-                        (boot_info->upg_version_to_download ==
-                         boot_info->app_previous_version)) {
+                    if ((state_info->upg_version_to_download ==
+                         state_info->app_update_version) ||
+                        (state_info->upg_version_to_download ==
+                         state_info->app_previous_version)) {
                         log_printf(".Recover Old\n");
-                        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                  UPGRADE_RECOVER_PREVIOUS_APP);
+                        state_info->upg_state = UPGRADE_RECOVER_PREVIOUS_APP;
                     }
                     // Try backup
                     else {
                         log_printf(".Recover Backup\n");
-                        mem_eeprom_write_word_ptr(&boot_info->upg_state,
-                                                  UPGRADE_RECOVER_BACKUP_APP);
+                        state_info->upg_state = UPGRADE_RECOVER_BACKUP_APP;
                     }
                 }
 
+                // Next step saved before spending a minute sending
+                state_commit();
+
                 // Send error + flags
                 log_printf(".Sending\n");
                 prepare_msg(MSG_UPGRADE_ERROR);
@@ -558,41 +559,45 @@ int main(void) {
 
             default:
                 log_printf("*UPG: Default State*\n");
-                mem_eeprom_write_word_ptr(&boot_info->upg_state, UPGRADE_ERROR);
+                state_info->upg_state = UPGRADE_ERROR;
                 break;
             }
 
+            // One record per step
+            state_commit();
+
             timers_pet_dogs();
         }
     }
 
     // Setup fresh app after new bin installed
-    if (boot_info->upg_new_app_installed ==
+    if (state_info->upg_new_app_installed ==
         BOOT_UPGRADE_NEW_APP_INSTALLED_KEY) {
         BOOT_LOG("New App Installed\n");
         // Boot Info
 
-        // Default app info setup by boot_init() when app_init_key is not set
-        mem_eeprom_write_word_ptr(&boot_info->app_init_key, 0);
+        // Default app info setup below when app_init_key is not set, both
+        // saved together there
+        state_info->app_init_key = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_new_app_installed, 0);
+        state_info->upg_new_app_installed = 0;
     }
 
     // Setup eeprom for first run of new app
-    if (boot_info->app_init_key != BOOT_APP_INIT_KEY) {
+    if (state_info->app_init_key != BOOT_APP_INIT_KEY) {
         BOOT_LOG("Setup App\n");
 
         // Boot Info
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_fail_runs, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset, 0);
+        state_info->app_ok_key = 0;
+        state_info->app_num_fail_runs = 0;
+        state_info->app_num_iwdg_reset = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->app_version, 0);
+        state_info->app_version = 0;
 
         // Shared Info
         mem_eeprom_write_word_ptr(&shared_info->boot_version, VERSION);
         mem_eeprom_write_word_ptr(&shared_info->upg_flags,
-                                  boot_info->upg_flags);
+                                  state_info->upg_flags);
         mem_eeprom_write_word_ptr(&shared_info->upg_pending, 0);
 
         mem_eeprom_write_word_ptr(&shared_info->app_ok_key, 0);
@@ -616,24 +621,31 @@ int main(void) {
             mem_eeprom_write_byte((uint32_t)u8ptr, boot_info->pwd[i]);
         }
 
-        mem_eeprom_write_word_ptr(&boot_info->app_init_key, BOOT_APP_INIT_KEY);
+        // Set by cloud
+        u8ptr = (uint8_t*)&app_info->alarm_sms[0];
+        mem_eeprom_write_byte((uint32_t)u8ptr, 0);
+        mem_eeprom_write_word_ptr(&app_info->data_budget_kb, 0);
+        mem_eeprom_write_word_ptr(&app_info->data_usage.key, 0);
+        mem_eeprom_write_word_ptr(&app_info->remote_cfg.key, 0);
+
+        state_info->app_init_key = BOOT_APP_INIT_KEY;
+        state_commit();
     }
 
     // Reinitialize upgrade procedure, only run after confirmed that app is
     // running successfully
-    if (boot_info->upg_done == BOOT_UPGRADE_DONE_KEY) {
-        BOOT_LOG("Upgrade Done %8x\n", boot_info->upg_flags);
-
-        mem_eeprom_write_word_ptr(&boot_info->app_version,
-                                  shared_info->app_curr_version);
-        mem_eeprom_write_word_ptr(&boot_info->app_previous_version,
-                                  shared_info->app_curr_version);
-        mem_eeprom_write_word_ptr(&boot_info->app_update_version, 0);
+    if (state_info->upg_done == BOOT_UPGRADE_DONE_KEY) {
+        BOOT_LOG("Upgrade Done %8x\n", state_info->upg_flags);
+
+        state_info->app_version = shared_info->app_curr_version;
+        state_info->app_previous_version = shared_info->app_curr_version;
+        state_info->app_update_version = 0;
         mem_eeprom_write_word_ptr(&shared_info->upg_flags,
-                                  boot_info->upg_flags);
-        mem_eeprom_write_word_ptr(&boot_info->upg_in_progress, 0);
+                                  state_info->upg_flags);
+        state_info->upg_in_progress = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->upg_done, 0);
+        state_info->upg_done = 0;
+        state_commit();
     }
 
     BOOT_LOG("Jump %8x\n\n----------\n\n", boot_info->vtor);
@@ -667,6 +679,7 @@ static void init(void) {
     timers_lptim_init();
     log_init();
     cusb_init();
+    fw_slot_init();
     flash_led(40, 3);
 }
 
@@ -690,11 +703,11 @@ static void prepare_msg(msg_type_e msg_type) {
                           "&id=%u"
                           "&upg_flags=%8u",
                           boot_info->pwd, boot_info->dev_id,
-                          boot_info->upg_flags);
+                          state_info->upg_flags);
     switch (msg_type) {
     case MSG_GET_NEXT_BIN:
         sim_buf_append_printf("&version=%3u",
-                              boot_info->upg_version_to_download);
+                              state_info->upg_version_to_download);
         break;
 
     case MSG_UPGRADE_ERROR:
@@ -855,8 +868,8 @@ static bool check_bin(void) {
     // Check header (no bin)
     struct {
         union {
-            uint8_t u8buf[BIN_HEADER_SIZE];
-            char    str[BIN_HEADER_SIZE];
+            uint8_t u8buf[BIN_HEADER_SIZE + 1];
+            char    str[BIN_HEADER_SIZE + 1];
             struct {
                 uint32_t version;
                 uint32_t crc32;
@@ -864,13 +877,11 @@ static bool check_bin(void) {
         };
     } header;
 
-    sim_http_read_response(0, 63, header.u8buf);
-    header.u8buf[64] = '\0';
+    read_response(0, 63, header.u8buf);
+    header.u8buf[BIN_HEADER_SIZE] = '\0';
 
     serial_printf(".Header: %s\n", header.str);
 
-    timers_delay_milliseconds(500);
-
     if (sim800.http.response_size <= BIN_HEADER_SIZE ||
         strstr(header.str, "NoBin") != NULL) {
         serial_printf(".No Bin\n");
@@ -884,150 +895,187 @@ static bool check_bin(void) {
         BOOT_SET_UPG_FLAG(UPG_FLAG_BIN_SIZE_WRONG);
     }
     // Todo: check returned version number same as expected
-    else if (check_crc(header.crc32) == false) {
-        serial_printf(".CRC Fail\n");
-        BOOT_SET_UPG_FLAG(UPG_FLAG_CRC_ERR);
-    } else {
+    else {
+        // CRC is checked while streaming the bin into flash
+        bin_crc32 = header.crc32;
+
         BOOT_LOG("Bin Check OK\n");
         ret = true;
     }
 
-    timers_delay_milliseconds(500);
-
     return ret;
 }
 
-static bool check_crc(uint32_t expected) {
-    serial_printf("Check CRC\n");
-
+static bool program_bin(void) {
     bool     ret = false;
     uint32_t file_size = sim800.http.response_size - BIN_HEADER_SIZE;
+    uint32_t offset = 0;
+    uint32_t written = 0;
+    uint32_t timer = timers_millis();
+    uint32_t dropped = sim800.rx_dropped;
 
-    uint32_t crc = 0;
+    // Two half page buffers, one being filled from the SIM RX buffer while the
+    // other waits to be written to the slot. The last half page of each
+    // HTTPREAD is written while the SIM800 turns the next request around
+    static uint8_t half_page[2][FLASH_HALF_PAGE_SIZE_BYTES];
 
-    if (file_size) {
-        // Todo: make sure num half pages is an even integer, otherwise will
-        // program garbage at end
-        uint16_t num_half_pages =
-            ((file_size - 1) / (FLASH_HALF_PAGE_SIZE_BYTES)) + 1;
+    uint8_t fill = 0;
+    uint8_t fill_idx = 0;
+    bool    pending = false;
+    bool    ok = true;
 
-        // Initialize CRC Peripheral
-        rcc_periph_clock_enable(RCC_CRC);
-        crc_reset();
-        crc_set_reverse_input(CRC_CR_REV_IN_BYTE);
-        crc_reverse_output_enable();
-        CRC_INIT = 0xFFFFFFFF;
+    serial_printf("Prog %u bytes\n", file_size);
 
-        // Get data and calc crc
-        for (uint16_t n = 0; n < num_half_pages; n++) {
-            timers_pet_dogs();
+    if (file_size == 0) {
+        return false;
+    }
 
-            // Half page buffer
-            // Using union so that data can be read as bytes and programmed as
-            // u32 this automatically deals with endianness
-            union {
-                uint8_t  buf8[FLASH_HALF_PAGE_SIZE_BYTES];
-                uint32_t buf32[(FLASH_HALF_PAGE_SIZE_BYTES) / 4];
-            } half_page;
-
-            // HTTPREAD command & get number of bytes read
-            // 		*number of bytes returned may be less than requested
-            // depending how many are left in file 		SIM800 signifies how
-            // many bytes are returned
-            if (sim_http_read_response(
-                    BIN_HEADER_SIZE + (n * FLASH_HALF_PAGE_SIZE_BYTES),
-                    FLASH_HALF_PAGE_SIZE_BYTES, half_page.buf8) != 64) {
-                log_printf(".sim resp not 64 bytes\n");
-                return false;
-            }
+    // Keep the slot holding the app from before the upgrade
+    bin_slot = fw_slot_spare(state_info->app_previous_version);
+    serial_printf(".slot %u\n", bin_slot);
 
-            // Add half page to crc
-            crc = ~crc_calculate_block(half_page.buf32, 16);
-        }
+    if (false == fw_slot_erase(bin_slot)) {
+        BOOT_SET_UPG_FLAG(UPG_FLAG_PROG_ERR);
+        return false;
+    }
 
-        // Deinit
-        crc_reset();
-        rcc_periph_clock_disable(RCC_CRC);
+    while (ok && (offset < file_size)) {
+        timers_pet_dogs();
 
-        ret = (crc == expected) ? true : false;
-    }
+        uint32_t request = file_size - offset;
+        if (request > BIN_READ_SIZE) {
+            request = BIN_READ_SIZE;
+        }
 
-    serial_printf(".crc %8x %8x\n", crc, expected);
+        sim_http_read_request(BIN_HEADER_SIZE + offset, request);
 
-    return ret;
-}
+        // Write leftover half page from last read while SIM800 is busy
+        if (pending) {
+            ok = fw_slot_write(bin_slot, written, half_page[fill ^ 1],
+                               FLASH_HALF_PAGE_SIZE_BYTES);
+            written += FLASH_HALF_PAGE_SIZE_BYTES;
+            pending = false;
+        }
 
-static bool program_bin(void) {
-    bool     ret = false;
-    uint32_t file_size = sim800.http.response_size - BIN_HEADER_SIZE;
+        // HTTPREAD command & get number of bytes read
+        // 	*number of bytes returned may be less than requested depending how
+        // many are left in file. SIM800 signifies how many bytes are returned
+        uint32_t    num_bytes = 0;
+        sim_state_t res;
+        do {
+            res = sim_http_read_wait(2000, &num_bytes);
+        } while (res == SIM_BUSY);
+
+        if (ok && (num_bytes != request)) {
+            log_printf(".sim resp %u not %u bytes\n", num_bytes, request);
+            ok = false;
+        }
 
-    serial_printf("Prog %u bytes\n", file_size);
+        for (uint32_t i = 0; ok && (i < num_bytes); i++) {
+            uint32_t rx_timer = timers_millis();
+            while (!sim_available()) {
+                timers_pet_dogs();
 
-    if (file_size) {
-        // make sure num half pages is an even integer, otherwise will program
-        // garbage at end
-        uint16_t num_half_pages =
-            ((file_size - 1) / (FLASH_HALF_PAGE_SIZE_BYTES)) + 1;
+                if ((timers_millis() - rx_timer) > 1000) {
+                    log_printf(".sim rx timeout\n");
+                    ok = false;
+                    break;
+                }
+            }
 
-        serial_printf(".%i half pages\n", num_half_pages);
+            if (sim800.rx_dropped != dropped) {
+                log_printf(".sim rx overrun\n");
+                ok = false;
+                break;
+            }
 
-        // Todo: flash write timeout
-        serial_printf(".erase\n");
-        for (uint16_t i = 0; i < ((num_half_pages + 1) / 2); i++) {
-            timers_pet_dogs();
+            half_page[fill][fill_idx++] = (uint8_t)sim_read();
+
+            // Half page full, swap buffers
+            if (fill_idx == FLASH_HALF_PAGE_SIZE_BYTES) {
+                if (pending) {
+                    ok = fw_slot_write(bin_slot, written, half_page[fill ^ 1],
+                                       FLASH_HALF_PAGE_SIZE_BYTES);
+                    written += FLASH_HALF_PAGE_SIZE_BYTES;
+                }
 
-            if (false == (mem_flash_erase_page(FLASH_APP_ADDRESS +
-                                               (i * FLASH_PAGE_SIZE)))) {
-                serial_printf(".fail\n");
-                return false;
+                pending = true;
+                fill ^= 1;
+                fill_idx = 0;
             }
         }
 
-        serial_printf(".prog\n");
+        if (ok) {
+            do {
+                res = sim_http_read_done();
+            } while (res == SIM_BUSY);
 
-        // Get data and program
-        for (uint16_t n = 0; n < num_half_pages; n++) {
-            timers_pet_dogs();
-
-            // Half page buffer
-            // Using union so that data can be read as bytes and programmed as
-            // u32 this automatically deals with endianness
-            union {
-                uint8_t  buf8[FLASH_HALF_PAGE_SIZE_BYTES];
-                uint32_t buf32[(FLASH_HALF_PAGE_SIZE_BYTES) / 4];
-            } half_page;
-
-            // HTTPREAD command & get number of bytes read
-            // 		*number of bytes returned may be less than requested
-            // depending how many are left in file 		SIM800 signifies how
-            // many bytes are returned
-            uint8_t num_bytes = sim_http_read_response(
-                BIN_HEADER_SIZE + (n * FLASH_HALF_PAGE_SIZE_BYTES),
-                (FLASH_HALF_PAGE_SIZE_BYTES), half_page.buf8);
-
-            serial_printf("read %d bytes", num_bytes);
-
-            serial_printf("..%8x\n",
-                          FLASH_APP_ADDRESS + (n * FLASH_HALF_PAGE_SIZE_BYTES));
-            timers_delay_milliseconds(10);
-
-            // Program half page
-            if (false ==
-                mem_flash_write_half_page(FLASH_APP_ADDRESS +
-                                              (n * FLASH_HALF_PAGE_SIZE_BYTES),
-                                          half_page.buf32)) {
-                serial_printf("..fail\n");
-                return false;
+            if (res != SIM_SUCCESS) {
+                log_printf(".sim no OK\n");
+                ok = false;
             }
         }
 
-        serial_printf(".done\n");
+        offset += num_bytes;
+    }
+
+    // Last half page
+    if (ok && pending) {
+        ok = fw_slot_write(bin_slot, written, half_page[fill ^ 1],
+                           FLASH_HALF_PAGE_SIZE_BYTES);
+    }
+
+    if (ok == false) {
+        BOOT_SET_UPG_FLAG(UPG_FLAG_PROG_ERR);
+    }
+    // Read back from the slot, header only written if the CRC matches
+    else if (false == fw_slot_commit(bin_slot,
+                                     state_info->upg_version_to_download,
+                                     file_size, bin_crc32)) {
+        serial_printf(".CRC Fail\n");
+        BOOT_SET_UPG_FLAG(UPG_FLAG_CRC_ERR);
+    } else {
+        timer = timers_millis() - timer;
+        log_printf(".done %u B %u ms %u B/s @%u\n", file_size, timer,
+                   (file_size * 1000) / (timer ? timer : 1), sim800.baud);
         ret = true;
     }
 
     return ret;
 }
 
+// Copy a slot into internal flash, the app there is lost from the start
+static bool install_slot(int8_t slot) {
+    if ((slot < 0) || (false == fw_slot_valid(slot, NULL))) {
+        return false;
+    }
+
+    // Saved first, the app in flash can't be trusted once install starts
+    state_info->app_ok_key = 0;
+    state_commit();
+
+    if (false == fw_slot_install(slot)) {
+        BOOT_SET_UPG_FLAG(UPG_FLAG_PROG_ERR);
+        return false;
+    }
+
+    state_info->upg_new_app_installed = BOOT_UPGRADE_NEW_APP_INSTALLED_KEY;
+
+    return true;
+}
+
+// Bootloader has nothing else to do while waiting
+static uint32_t read_response(uint32_t address, uint32_t size, uint8_t* buf) {
+    uint32_t num_bytes = 0;
+
+    while (sim_http_read_response(address, size, buf, &num_bytes) ==
+           SIM_BUSY) {
+        timers_pet_dogs();
+    }
+
+    return num_bytes;
+}
+
 static void sim_buf_clear(void) {
     for (uint16_t i = 0; i < sim_buf_idx; i++) {
         sim_buf[i] = '\0';
@@ -38,6 +38,7 @@
 #include "hub/cusb.h"
 #include "hub/hub.h"
 #include "hub/sim.h"
+#include "hub/w25qxx.h"
 
 /** @addtogroup HUB_TEST_FILE
  * @{
@@ -641,8 +642,12 @@ void test_sim_get_request_version(void) {
 
             uint8_t buf[64] = {0};
 
-            uint32_t num_bytes =
-                sim_http_read_response(0, sim800.http.response_size, buf);
+            uint32_t num_bytes = 0;
+
+            do {
+                res = sim_http_read_response(0, sim800.http.response_size, buf,
+                                             &num_bytes);
+            } while (res == SIM_BUSY);
 
             // SIM800 now returns that number of bytes
             for (uint32_t i = 0; i < num_bytes; i++) {
@@ -702,8 +707,12 @@ void test_sim_post(void) {
 
             uint8_t buf[64] = {0};
 
-            uint32_t num_bytes =
-                sim_http_read_response(0, sim800.http.response_size, buf);
+            uint32_t num_bytes = 0;
+
+            do {
+                res = sim_http_read_response(0, sim800.http.response_size, buf,
+                                             &num_bytes);
+            } while (res == SIM_BUSY);
 
             // SIM800 now returns that number of bytes
             for (uint32_t i = 0; i < num_bytes; i++) {
@@ -742,18 +751,21 @@ void test_sim_tcip_get(void) {
             serial_printf("Sim init fail\n");
         } else if (!sim_register_to_network()) {
             serial_printf("Sim not able to register to network\n");
-        } else if (!sim_tcp_init("cooleasetest.000webhostapp.com", 443, true)) {
         } else {
-            // sim_printf_and_check_response(10000, "SEND OK", "GET /
-            // HTTP/1.1\r\nHost: cooleasetest.000webhostapp.com\r\n\r\n%c\r\n",
-            // 0x1A);
-            sim_printf("GET / HTTP/1.1\r\nHost: "
-                       "cooleasetest.000webhostapp.com\r\n\r\n%c\r\n",
-                       0x1A);
+            sim_state_t res;
+            do {
+                res = sim_tcp_init("cooleasetest.000webhostapp.com", 443, true);
+            } while (res == SIM_BUSY);
 
-            // timers_delay_milliseconds(10000);
+            if (res != SIM_SUCCESS) {
+                serial_printf("TCP init fail\n");
+            } else {
+                sim_printf("GET / HTTP/1.1\r\nHost: "
+                           "cooleasetest.000webhostapp.com\r\n\r\n%c\r\n",
+                           0x1A);
 
-            sim_serial_pass_through();
+                sim_serial_pass_through();
+            }
         }
 
         serial_printf("Passed %i/%i\n\n*******************\n\n", num_pass,
@@ -824,11 +836,13 @@ void test_sim_send_sms(void) {
         // sim_printf_and_check_response(10000, "SEND OK", "GET /
         // HTTP/1.1\r\nHost: cooleasetest.000webhostapp.com\r\n\r\n%c\r\n",
         // 0x1A);
-        sim_send_sms("+447862350369", "Testing sim");
-
-        // timers_delay_milliseconds(10000);
+        do {
+            res = sim_send_sms("+447862350369", "Testing sim");
+        } while (res == SIM_BUSY);
 
-        sim_serial_pass_through();
+        if (res == SIM_SUCCESS) {
+            num_pass++;
+        }
 
         serial_printf("Passed %i/%i\n\n*******************\n\n", num_pass,
                       test_num);
@@ -841,5 +855,63 @@ void test_sim_send_sms(void) {
     serial_printf("------------------------------\n");
 }
 
+/*////////////////////////////////////////////////////////////////////////////*/
+// W25 Tests
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// KB/s from bytes & ms, at least 1 ms so a fast run does not divide by 0
+#define KB_PER_S(bytes, ms) (((bytes) * 1000U) / (1024U * ((ms) ? (ms) : 1)))
+
+void test_w25_benchmark(uint32_t start_sector, uint8_t num_sectors) {
+    test_init("test_w25_benchmark()");
+
+    if (!w25_Init()) {
+        serial_printf("No flash\n");
+        return;
+    }
+
+    static uint8_t page[256];
+    uint32_t       bytes = (uint32_t)num_sectors * w25.SectorSize;
+    uint32_t       num_pages = bytes / w25.PageSize;
+    uint32_t       first_page = w25_SectorToPage(start_sector);
+    uint32_t       errors = 0;
+    uint32_t       start;
+
+    for (uint16_t i = 0; i < sizeof(page); i++) {
+        page[i] = (uint8_t)i;
+    }
+
+    start = timers_millis();
+    for (uint8_t i = 0; i < num_sectors; i++) {
+        w25_EraseSector(start_sector + i);
+        timers_pet_dogs();
+    }
+    uint32_t erase_ms = timers_millis() - start;
+
+    start = timers_millis();
+    for (uint32_t i = 0; i < num_pages; i++) {
+        page[0] = (uint8_t)i;
+        w25_WritePage(page, first_page + i, 0, w25.PageSize);
+    }
+    uint32_t program_ms = timers_millis() - start;
+    timers_pet_dogs();
+
+    start = timers_millis();
+    for (uint32_t i = 0; i < num_pages; i++) {
+        w25_ReadPage(page, first_page + i, 0, w25.PageSize);
+        if (page[0] != (uint8_t)i || page[1] != 1) {
+            errors++;
+        }
+    }
+    uint32_t read_ms = timers_millis() - start;
+
+    serial_printf("%u bytes, %u errors\n", bytes, errors);
+    serial_printf("Read    %u ms %u KB/s\n", read_ms, KB_PER_S(bytes, read_ms));
+    serial_printf("Program %u ms %u KB/s\n", program_ms,
+                  KB_PER_S(bytes, program_ms));
+    serial_printf("Erase   %u ms %u KB/s\n", erase_ms,
+                  KB_PER_S(bytes, erase_ms));
+}
+
+/** @} */
 /** @} */
-/** @} */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/**
+ ******************************************************************************
+ * @file    cmux.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   GSM 07.10 Multiplexer Header File
+ *
+ * @defgroup   CMUX_FILE  CMUX
+ * @brief      Basic option GSM 07.10 framing
+ *
+ * Frames are F9 | address | control | length | info | FCS | F9. The address
+ * holds the DLCI, 0 is the multiplexer control channel and the rest are
+ * virtual serial ports each with their own AT command interpreter. Only
+ * framing lives here, sim.c owns the channels.
+ *
+ * @{
+ * @defgroup   CMUX_API  CMUX API
+ * @brief
+ *
+ * @defgroup   CMUX_INT  CMUX Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef CMUX_H
+#define CMUX_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup CMUX_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#define CMUX_FLAG 0xF9
+
+// Command/ response bit, in the address & in control channel message types
+#define CMUX_CR 0x02
+
+// Poll/ final bit & control field without it, for comparing replies
+#define CMUX_PF           0x10
+#define CMUX_CONTROL(ctl) ((uint8_t)((ctl) & ~CMUX_PF))
+
+// Control field, poll/ final bit set
+#define CMUX_SABM 0x3F
+#define CMUX_UA   0x73
+#define CMUX_DM   0x1F
+#define CMUX_DISC 0x53
+#define CMUX_UIH  0xEF
+
+// Multiplexer close down, UIH message on DLCI 0
+#define CMUX_MSG_CLD 0xC3
+
+// Max info length, matches N1 in AT+CMUX
+#define CMUX_N1 127
+
+// Flags, address, control, length & FCS
+#define CMUX_FRAME_OVERHEAD 6
+
+typedef struct cmux_frame_s {
+    uint8_t dlci;
+    uint8_t control;
+    uint8_t len;
+    uint8_t info[CMUX_N1];
+} cmux_frame_t;
+
+typedef struct cmux_decoder_s {
+    uint8_t      state;
+    uint8_t      idx;
+    uint8_t      fcs;
+    cmux_frame_t frame;
+} cmux_decoder_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Build frame in out, needs len + CMUX_FRAME_OVERHEAD bytes
+ *
+ * @return Frame length
+ */
+uint16_t cmux_encode(uint8_t dlci, uint8_t control, const uint8_t* info,
+                     uint8_t len, uint8_t* out);
+
+void cmux_decoder_reset(cmux_decoder_t* dec);
+
+/** @brief Feed one received byte
+ *
+ * @return true when dec->frame holds a complete frame with a good FCS
+ */
+bool cmux_decode(cmux_decoder_t* dec, uint8_t byte);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CMUX_H
@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * @file    csq.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Signal Quality Header File
+ *
+ * @defgroup   CSQ_FILE  Signal Quality
+ * @brief      Track GSM signal & hold back uploads while it is poor
+ *
+ * AT+CSQ samples are taken whenever the modem is awake anyway, before each
+ * upload and periodically while plugged in. A running average gives the
+ * usual signal at this site so a dip can be told apart from a site that is
+ * always marginal. Non urgent uploads are deferred while the signal is poor,
+ * for at most CSQ_MAX_DEFER_MS, then go regardless.
+ *
+ * @{
+ * @defgroup   CSQ_API  Signal Quality API
+ * @brief
+ *
+ * @defgroup   CSQ_INT  Signal Quality Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef CSQ_H
+#define CSQ_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup CSQ_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// Longest a non urgent upload is held back waiting for better signal
+#define CSQ_MAX_DEFER_MS 1800000
+
+// Time between retries while deferred
+#define CSQ_RETRY_MS 120000
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void csq_init(void);
+
+/** @brief Add sample from sim_get_signal(), 99 counts as no signal */
+void csq_add(uint8_t csq);
+
+/** @brief Should an upload wait for better signal, false once waited long
+ * enough */
+bool csq_defer_upload(bool urgent);
+
+/** @brief Upload went through, ends any deferral */
+void csq_upload_done(void);
+
+/** @brief Deferred upload waiting for retry time */
+bool csq_waiting(void);
+
+uint8_t  csq_last(void);
+uint8_t  csq_avg(void);
+uint8_t  csq_min(void);
+uint32_t csq_num_deferred(void);
+
+/** @brief dBm from CSQ, 0 if unknown */
+int16_t csq_to_dbm(uint8_t csq);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSQ_H
@@ -73,8 +73,15 @@ bool cusb_plugged_in(void);
 
 void cusb_poll(void);
 
+/** @brief Queue print output, dropped if the buffer is full */
 void cusb_send(char character);
 
+/** @brief Send what is queued, up to a report, if the endpoint is free */
+void cusb_flush(void);
+
+/** @brief Print bytes dropped since boot */
+uint32_t cusb_dropped(void);
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // Hook Functions
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -0,0 +1,91 @@
+/**
+ ******************************************************************************
+ * @file    data_usage.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Cellular Data Usage Header File
+ *
+ * @defgroup   DATA_USAGE_FILE  Data Usage
+ * @brief      Count bytes sent over the cellular network against a budget
+ *
+ * Counts TX, RX and estimated protocol overhead per day, per calendar month
+ * and in total. Counters live in RAM and are saved to app_info in EEPROM
+ * periodically so at most one save period is lost over a reset. The monthly
+ * budget is set by the cloud, as it is approached uploads are spaced further
+ * apart & the log upload is deferred.
+ *
+ * @{
+ * @defgroup   DATA_USAGE_API  Data Usage API
+ * @brief
+ *
+ * @defgroup   DATA_USAGE_INT  Data Usage Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef DATA_USAGE_H
+#define DATA_USAGE_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup DATA_USAGE_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+typedef enum data_level {
+    DATA_LEVEL_OK = 0,
+    DATA_LEVEL_NEAR, /**< Most of the monthly budget used */
+    DATA_LEVEL_OVER
+} data_level_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Load counters from EEPROM */
+void data_usage_init(void);
+
+/** @brief Add bytes used, timestamp 0 if unknown keeps current day & month */
+void data_usage_add(uint32_t tx, uint32_t rx, uint32_t overhead,
+                    uint32_t timestamp);
+
+/** @brief Write changed counters to EEPROM */
+void data_usage_save(void);
+
+/** @brief Monthly budget in kB, 0 for no limit. Written only if changed */
+void data_usage_set_budget_kb(uint32_t kb);
+
+data_level_t data_usage_level(void);
+
+/** @brief Minimum time between uploads that are not urgent */
+uint32_t data_usage_upload_interval_ms(void);
+
+/** @brief Log upload can wait until the budget resets */
+bool data_usage_defer_log(void);
+
+uint32_t data_usage_day_bytes(void);
+uint32_t data_usage_month_bytes(void);
+
+void data_usage_print(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DATA_USAGE_H
@@ -0,0 +1,108 @@
+/**
+ ******************************************************************************
+ * @file    fw_slot.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Firmware Slots Header File
+ *
+ * @defgroup   FW_SLOT_FILE  Firmware Slots
+ * @brief      App images kept on the W25 so the bootloader can roll back
+ *
+ * Three slots sit below the journal, A & B take downloads in turn & the
+ * golden slot keeps the first app that ran ok. Each slot is a header sector
+ * followed by the image. The header holds the version, size & CRC and is
+ * written last, once the image has been read back and its CRC matches, so a
+ * slot is either complete or ignored.
+ *
+ * Installing copies a slot into internal flash and checks the CRC again
+ * there. Going back to a previous or golden app then takes seconds and no
+ * data instead of a download.
+ *
+ * @{
+ * @defgroup   FW_SLOT_API  Firmware Slots API
+ * @brief
+ *
+ * @defgroup   FW_SLOT_INT  Firmware Slots Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef FW_SLOT_H
+#define FW_SLOT_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup FW_SLOT_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+typedef enum fw_slot {
+    FW_SLOT_A = 0,
+    FW_SLOT_B,
+    FW_SLOT_GOLDEN,
+    FW_NUM_SLOTS
+} fw_slot_t;
+
+typedef struct fw_slot_hdr_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; /**< Bytes, multiple of flash half page */
+    uint32_t crc32;
+} fw_slot_hdr_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Init flash & scan the slots into its erased map */
+bool fw_slot_init(void);
+
+/** @brief Erase header & image, sectors already erased are skipped */
+bool fw_slot_erase(fw_slot_t slot);
+
+/** @brief Program part of the image, slot must be erased first */
+bool fw_slot_write(fw_slot_t slot, uint32_t offset, const uint8_t* data,
+                   uint32_t len);
+
+/** @brief Read image back, write header only if its CRC matches */
+bool fw_slot_commit(fw_slot_t slot, uint32_t version, uint32_t size,
+                    uint32_t crc32);
+
+/** @brief Header present & image CRC matches, hdr may be NULL */
+bool fw_slot_valid(fw_slot_t slot, fw_slot_hdr_t* hdr);
+
+/** @brief Valid slot holding version, -1 if none */
+int8_t fw_slot_find(uint32_t version);
+
+/** @brief A or B, whichever doesn't hold keep_version */
+fw_slot_t fw_slot_spare(uint32_t keep_version);
+
+/** @brief Copy slot into internal flash & check its CRC there */
+bool fw_slot_install(fw_slot_t slot);
+
+/** @brief Copy the app running from internal flash into slot */
+bool fw_slot_save(fw_slot_t slot, uint32_t version, uint32_t size);
+
+void fw_slot_print(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FW_SLOT_H
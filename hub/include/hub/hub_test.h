@@ -72,6 +72,13 @@ void test_sim_post(void);
 void test_sim_tcip_get(void);
 void test_sim_send_sms(void);
 
+/*////////////////////////////////////////////////////////////////////////////*/
+// W25 Tests
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Erases then programs & reads back, prints KB/s for each */
+void test_w25_benchmark(uint32_t start_sector, uint8_t num_sectors);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,92 @@
+/**
+ ******************************************************************************
+ * @file    journal.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Reading Journal Header File
+ *
+ * @defgroup   JOURNAL_FILE  Journal
+ * @brief      Store and forward log of sensor readings on external flash
+ *
+ * Every reading received is appended to a ring of W25 sectors. Records are
+ * uploaded in order from the upload cursor, which is stored in the records
+ * themselves by programming their flags byte once uploaded. The head and
+ * cursor are recovered by scanning the flash at startup so nothing is lost
+ * over a reset.
+ *
+ * @note One sector ahead of the head is always kept erased so the start of
+ * the ring can be found. When full the oldest sector is erased even if it
+ * has not been uploaded.
+ *
+ * @{
+ * @defgroup   JOURNAL_API  Journal API
+ * @brief
+ *
+ * @defgroup   JOURNAL_INT  Journal Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup JOURNAL_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief One reading, 16 bytes so records never cross a flash page */
+typedef struct journal_rec_s {
+    uint32_t timestamp;
+    uint32_t dev_id;
+    int16_t  temperature;
+    uint16_t battery;
+    int16_t  rssi;
+    int8_t   power;
+    uint8_t  flags;
+} journal_rec_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Init W25 and find head & upload cursor, false if no flash */
+bool journal_init(void);
+
+/** @brief Append reading at head, false if journal not available */
+bool journal_append(const journal_rec_t* rec);
+
+/** @brief Number of readings not yet uploaded */
+uint32_t journal_pending(void);
+
+/** @brief Read n-th reading after the upload cursor */
+bool journal_peek(uint32_t n, journal_rec_t* rec);
+
+/** @brief Mark num readings from upload cursor as uploaded */
+void journal_mark_uploaded(uint32_t num);
+
+/** @brief Call from main loop, notes when a background erase finishes */
+void journal_poll(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JOURNAL_H
@@ -0,0 +1,73 @@
+/**
+ ******************************************************************************
+ * @file    lz.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   LZ Compression Header File
+ *
+ * @defgroup   LZ_FILE  LZ
+ * @brief      Small LZSS coder for uploads
+ *
+ * Output is groups of a flag byte then up to 8 items, flag bit n (LSB first)
+ * set means item n is a match of 2 bytes: distance - 1, length - 3. Otherwise
+ * it is a literal byte. Matches reach back up to 256 bytes. The source is
+ * read through a callback so e.g. the EEPROM log ring can be compressed in
+ * place without copying it to RAM. host/log_decode.py decodes it.
+ *
+ * @{
+ * @defgroup   LZ_API  LZ API
+ * @brief
+ *
+ * @defgroup   LZ_INT  LZ Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup LZ_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Source byte at idx, 0 to len - 1 */
+typedef uint8_t (*lz_get_t)(uint32_t idx);
+
+/** @brief Next output byte */
+typedef void (*lz_put_t)(uint8_t byte);
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Compress up to len bytes, stopping before output exceeds max_out
+ *
+ * Only whole groups are output so whatever was sent decodes on its own
+ *
+ * @return Number of source bytes compressed
+ */
+uint32_t lz_compress(lz_get_t get, uint32_t len, lz_put_t put,
+                     uint32_t max_out);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ_H
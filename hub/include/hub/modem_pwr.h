@@ -0,0 +1,107 @@
+/**
+ ******************************************************************************
+ * @file    modem_pwr.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Modem Power Policy Header File
+ *
+ * @defgroup   MODEM_PWR_FILE  Modem Power
+ * @brief      Choose how the SIM800 idles between uploads
+ *
+ * Each low power state trades idle current against the time & energy needed
+ * to get back to uploading. The default policy estimates the energy used
+ * until the next upload in each state and picks the lowest. Only states that
+ * wake fast enough for the upload priority are allowed, and the upload
+ * interval is stretched as the battery runs down. Time spent in each state
+ * is recorded and the measured wake times feed back into the model.
+ *
+ * @{
+ * @defgroup   MODEM_PWR_API  Modem Power API
+ * @brief
+ *
+ * @defgroup   MODEM_PWR_INT  Modem Power Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef MODEM_PWR_H
+#define MODEM_PWR_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup MODEM_PWR_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+typedef enum modem_pwr_state {
+    MODEM_PWR_ON = 0, /**< Registered, bearer open */
+    MODEM_PWR_CSCLK,  /**< Slow clock, stays registered */
+    MODEM_PWR_MIN,    /**< CFUN=0, RF off */
+    MODEM_PWR_OFF,    /**< Powered down */
+    MODEM_PWR_ATTACH, /**< Waking & getting back on the network */
+    MODEM_PWR_NUM_STATES
+} modem_pwr_state_t;
+
+typedef enum modem_pwr_prio {
+    MODEM_PWR_PRIO_NORMAL = 0,
+    MODEM_PWR_PRIO_URGENT /**< E.g. sensor in alarm, keep wake time short */
+} modem_pwr_prio_t;
+
+typedef struct modem_pwr_input_s {
+    bool             plugged_in;
+    uint16_t         batt_voltage; /**< From batt_get_batt_voltage(), 10 mV */
+    modem_pwr_prio_t prio;
+    uint32_t         upload_ms; /**< Upload interval on battery, 0 default */
+} modem_pwr_input_t;
+
+/** @brief Policy, returns state to idle in and sets time until next upload */
+typedef modem_pwr_state_t (*modem_pwr_policy_t)(const modem_pwr_input_t* in,
+                                                uint32_t* sleep_ms);
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void modem_pwr_init(void);
+
+/** @brief Replace the default policy, NULL to restore it */
+void modem_pwr_set_policy(modem_pwr_policy_t policy);
+
+/** @brief Run the policy */
+modem_pwr_state_t modem_pwr_select(const modem_pwr_input_t* in,
+                                   uint32_t*                sleep_ms);
+
+/** @brief Energy to idle in state for sleep_ms then wake, in uA.s */
+uint32_t modem_pwr_estimate_uas(modem_pwr_state_t state, uint32_t sleep_ms);
+
+/** @brief Record modem state change, ATTACH -> ON updates the wake model */
+void modem_pwr_set_state(modem_pwr_state_t state);
+
+modem_pwr_state_t modem_pwr_get_state(void);
+
+/** @brief Total time spent in state since init */
+uint32_t modem_pwr_get_time_s(modem_pwr_state_t state);
+
+void modem_pwr_print(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MODEM_PWR_H
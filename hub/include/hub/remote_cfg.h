@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * @file    remote_cfg.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Remote Config Header File
+ *
+ * @defgroup   REMOTE_CFG_FILE  Remote Config
+ * @brief      Intervals & radio settings the cloud can change
+ *
+ * Each key has a default, min & max. The cloud sends a key name & value in
+ * the HTTP response, values out of range are ignored. Accepted values are
+ * saved to app_info in EEPROM only if they changed and the app is told to
+ * apply them. A hash of all values is uploaded so the cloud can tell which
+ * hubs are out of date.
+ *
+ * The LoRa settings must match the sensors, change them only once the
+ * sensors at the site are on the same profile.
+ *
+ * @{
+ * @defgroup   REMOTE_CFG_API  Remote Config API
+ * @brief
+ *
+ * @defgroup   REMOTE_CFG_INT  Remote Config Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef REMOTE_CFG_H
+#define REMOTE_CFG_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup REMOTE_CFG_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Numeric keys index remote_cfg_info_t.vals, URL is stored apart */
+typedef enum remote_cfg_key {
+    REMOTE_CFG_CHECK_S = 0, /**< RTC wakeup, sensor & upload checks */
+    REMOTE_CFG_LOG_S,       /**< Log & power upload */
+    REMOTE_CFG_TIME_SYNC_S, /**< Resync RTC from network time */
+    REMOTE_CFG_UPLOAD_S,    /**< Upload interval on battery */
+    REMOTE_CFG_LOG_LEVEL,   /**< EEPROM log threshold, LOG_NONE to LOG_DBG */
+    REMOTE_CFG_URL,
+    REMOTE_CFG_NUM_KEYS
+} remote_cfg_key_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Load from EEPROM, defaults for any missing or out of range */
+void remote_cfg_init(void);
+
+/** @brief Key from name e.g. "check_s", -1 if unknown */
+int8_t remote_cfg_find(const char* name);
+
+/** @brief Set from text, saved if valid & changed. False if rejected */
+bool remote_cfg_set(int8_t key, const char* str);
+
+/** @brief Back to the built in URL, e.g. uploads keep failing to the set one */
+void remote_cfg_default_url(void);
+
+int32_t     remote_cfg_get(remote_cfg_key_t key);
+const char* remote_cfg_url(void);
+
+/** @brief True once after any value changed */
+bool remote_cfg_changed(void);
+
+/** @brief Hash of all values, to report to the cloud */
+uint32_t remote_cfg_hash(void);
+
+void remote_cfg_print(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REMOTE_CFG_H
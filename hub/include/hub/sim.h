@@ -48,6 +48,8 @@ extern "C" {
 // Exported Variables
 /*////////////////////////////////////////////////////////////////////////////*/
 
+#define SIM_CSQ_UNKNOWN 99
+
 typedef enum sim_state {
     SIM_BUSY = 0,
     SIM_SUCCESS,
@@ -85,12 +87,22 @@ typedef struct sim800_s {
     sim_state_t           state;
     sim_function_t        func;
     registration_status_t reg_status;
+    uint32_t              baud;
+    bool                  cmux; /**< GSM 07.10 mux up, HTTP on own channel */
+    uint32_t              rx_dropped; /**< RX bytes lost to a full buffer */
 
     struct http_params {
         http_state_t state;
         uint32_t     status_code;
         uint32_t     response_size;
     } http;
+
+    // Bytes on air since last cleared by the app, overhead is estimated
+    struct data_params {
+        uint32_t tx;
+        uint32_t rx;
+        uint32_t overhead;
+    } data;
 } sim800_t;
 
 extern sim800_t sim800;
@@ -105,11 +117,15 @@ extern sim800_t sim800;
 
 void sim_printf(const char* format, ...);
 
-/** @brief Print to SIM800 then wait for expected response or timeout */
-bool sim_printf_and_check_response(uint32_t    timeout_ms,
-                                   const char* expected_response,
-                                   const char* format, ...);
+/** @brief Print to SIM800 then wait for expected response or timeout
+ *
+ * Non blocking, call until it no longer returns SIM_BUSY
+ */
+sim_state_t sim_printf_and_check_response(uint32_t    timeout_ms,
+                                          const char* expected_response,
+                                          const char* format, ...);
 
+/** @brief Blocking USART pass through, debug use only */
 void sim_serial_pass_through(void);
 
 void sim_print_state(sim_state_t res);
@@ -129,8 +145,19 @@ sim_state_t sim_init(void);
 /** @brief Enter sleep mode and disable MCU USART */
 sim_state_t sim_end(void);
 
+/** @brief Power down SIM800, needs sim_init() to wake */
 sim_state_t sim_sleep(void);
 
+/** @brief Enter or leave CSCLK=2 slow clock mode
+ *
+ * Stays registered with the bearer open, sleeps whenever the serial port is
+ * idle
+ */
+sim_state_t sim_slow_clock(bool on);
+
+/** @brief Enter or leave CFUN=0, RF off so registration is lost */
+sim_state_t sim_min_function(bool on);
+
 sim_state_t sim_register_to_network(void);
 
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -143,15 +170,28 @@ void sim_print_capabilities(void);
 // Network Configuration
 /*////////////////////////////////////////////////////////////////////////////*/
 
-uint8_t*    sim_get_timestamp(void);
+/** @brief Read network time as unix time (UTC)
+ *
+ * Needs +CLTS=1, fails until the network has sent the time after registering
+ */
+sim_state_t sim_get_timestamp(uint32_t* stamp);
+
+/** @brief Read signal quality, 0 (-113 dBm) to 31 (-51 dBm) in 2 dB steps */
+sim_state_t sim_get_signal(uint8_t* csq);
 sim_state_t sim_open_bearer(char* apn_str, char* user_str, char* pwd_str);
 sim_state_t sim_close_bearer(void);
+/** @brief Check bearer, no AT command if already seen open since last error */
 sim_state_t sim_is_connected(void);
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // HTTP
 /*////////////////////////////////////////////////////////////////////////////*/
 
+/** @brief Start HTTP service, or reuse the open session
+ *
+ * Only URL & SSL are sent if changed. Full init after an error, reset or
+ * sim_http_term()
+ */
 sim_state_t sim_http_init(const char* url_str, bool ssl);
 sim_state_t sim_http_term(void);
 sim_state_t sim_http_get(const char* url_str, bool ssl, uint8_t num_tries);
@@ -160,20 +200,35 @@ sim_state_t sim_http_post_str(const char* url_str, const char* msg_str,
 sim_state_t sim_http_post_init(const char* url_str, bool ssl);
 sim_state_t sim_http_post_enter_data(uint32_t size, uint32_t time);
 sim_state_t sim_http_post(void);
-uint32_t    sim_http_read_response(uint32_t address, uint32_t buf_size,
-                                   uint8_t* buf);
+/** @brief Read part of the HTTP response into buf, num_bytes set when done */
+sim_state_t sim_http_read_response(uint32_t address, uint32_t buf_size,
+                                   uint8_t* buf, uint32_t* num_bytes);
+
+/** @brief Request part of the HTTP response without waiting for the reply
+ *
+ * Streaming read split into three steps so the caller can do other work (e.g.
+ * program flash) while the SIM800 turns the request around:
+ * sim_http_read_request() -> sim_http_read_wait() -> read the returned number
+ * of bytes with sim_read() -> sim_http_read_done()
+ */
+void        sim_http_read_request(uint32_t address, uint32_t size);
+/** @brief Wait for +HTTPREAD header, num_bytes set to number that follow */
+sim_state_t sim_http_read_wait(uint32_t timeout_ms, uint32_t* num_bytes);
+/** @brief Wait for final OK after all data bytes have been read */
+sim_state_t sim_http_read_done(void);
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // TCP
 /*////////////////////////////////////////////////////////////////////////////*/
 
-bool sim_tcp_init(const char* url_str, uint16_t port, bool ssl);
+/** @brief Open TCP connection and enter data mode (> prompt) */
+sim_state_t sim_tcp_init(const char* url_str, uint16_t port, bool ssl);
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // SMS
 /*////////////////////////////////////////////////////////////////////////////*/
 
-bool sim_send_sms(const char* phone_number, const char* str);
+sim_state_t sim_send_sms(const char* phone_number, const char* str);
 
 /** @} */
 
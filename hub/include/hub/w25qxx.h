@@ -18,6 +18,20 @@ typedef enum {
 
 } W25_ID_t;
 
+// Started without waiting, finished once status BUSY clears
+typedef enum {
+    W25_OP_NONE = 0,
+    W25_OP_ERASE,
+    W25_OP_PROGRAM,
+} W25_Op_t;
+
+// Erased map, unknown until scanned, checked or erased
+typedef enum {
+    W25_SECTOR_UNKNOWN = 0,
+    W25_SECTOR_ERASED,
+    W25_SECTOR_DIRTY,
+} W25_SectorState_t;
+
 typedef struct {
     W25_ID_t ID;
     uint8_t  UniqID[8];
@@ -32,6 +46,7 @@ typedef struct {
     uint8_t  StatusRegister2;
     uint8_t  StatusRegister3;
     uint8_t  Lock;
+    W25_Op_t Pending;
 
 } w25_t;
 
@@ -56,6 +71,27 @@ void w25_EraseChip(void);
 void w25_EraseSector(uint32_t SectorAddr);
 void w25_EraseBlock(uint32_t BlockAddr);
 
+// ############################################################################
+//  Non blocking, return false & start nothing if the last one is still
+//  running. Reads & page programs while an erase runs suspend it, the sector
+//  being erased must not be touched until w25_IsBusy() returns false
+// ############################################################################
+bool w25_EraseSectorStart(uint32_t SectorAddr);
+bool w25_EraseBlockStart(uint32_t BlockAddr);
+bool w25_WritePageStart(uint8_t* pBuffer, uint32_t Page_Address,
+                        uint32_t OffsetInByte,
+                        uint32_t NumByteToWrite_up_to_PageSize);
+bool w25_IsBusy(void);
+
+// ############################################################################
+//  Erased map, kept in RAM for sectors below W25_MAP_NUM_SECTORS. Erases
+//  mark sectors erased, programs mark them dirty & w25_IsEmpty* answer from
+//  it without reading. Erasing a sector already erased is skipped. Scan once
+//  after w25_Init() so every sector in the range is known
+// ############################################################################
+void              w25_ScanErased(uint32_t SectorAddr, uint32_t NumSectors);
+W25_SectorState_t w25_SectorState(uint32_t SectorAddr);
+
 uint32_t w25_PageToSector(uint32_t PageAddress);
 uint32_t w25_PageToBlock(uint32_t PageAddress);
 uint32_t w25_SectorToBlock(uint32_t SectorAddress);
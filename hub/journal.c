@@ -0,0 +1,323 @@
+/**
+ ******************************************************************************
+ * @file    journal.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Reading Journal Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/journal.h"
+
+#include <string.h>
+
+#include "common/log.h"
+#include "common/timers.h"
+#include "config/board_defs.h"
+
+#include "hub/w25qxx.h"
+
+/** @addtogroup JOURNAL_FILE
+ * @{
+ */
+
+/** @addtogroup JOURNAL_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef JOURNAL_LOG_LEVEL
+#define JOURNAL_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define JOURNAL_LOG(level, ...)                                                \
+    LOG_AT(level, JOURNAL_LOG_LEVEL, "JNL: " __VA_ARGS__)
+
+#define REC_SIZE        sizeof(journal_rec_t)
+#define PAGE_SIZE       256U
+#define SECTOR_SIZE     4096U
+#define RECS_PER_SECTOR (SECTOR_SIZE / REC_SIZE)
+#define NUM_RECS        (W25_JOURNAL_NUM_SECTORS * RECS_PER_SECTOR)
+
+// Erased flash, dev_id never all ones
+#define REC_EMPTY_ID  0xFFFFFFFF
+#define FLAG_PENDING  0xFF
+#define FLAG_UPLOADED 0x00
+
+static bool journal_ok = false;
+
+// Record indexes in ring, 0 is first record of W25_JOURNAL_START_SECTOR
+static uint32_t head = 0;
+static uint32_t cursor = 0;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint32_t rec_address(uint32_t idx);
+static void     read_rec(uint32_t idx, journal_rec_t* rec);
+static bool     rec_written(uint32_t idx);
+static bool     rec_pending(uint32_t idx);
+static bool     sector_written(uint32_t sector);
+static void     erase_sector(uint32_t sector);
+static bool     find_head_and_cursor(void);
+
+/** @} */
+
+/** @addtogroup JOURNAL_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+bool journal_init(void) {
+    journal_ok = false;
+
+    if (false == w25_Init()) {
+        JOURNAL_LOG(LOG_ERR, "ERR no flash\n");
+        return false;
+    }
+
+    if ((W25_JOURNAL_START_SECTOR + W25_JOURNAL_NUM_SECTORS) >
+        w25.SectorCount) {
+        JOURNAL_LOG(LOG_ERR, "ERR flash too small %u\n", w25.SectorCount);
+        return false;
+    }
+
+    // Otherwise every sector looks written & the ring is wiped each boot
+    if ((W25_JOURNAL_START_SECTOR + W25_JOURNAL_NUM_SECTORS) >
+        W25_MAP_NUM_SECTORS) {
+        JOURNAL_LOG(LOG_ERR, "ERR outside erased map\n");
+        return false;
+    }
+
+    // Mount, after this erased sectors are known without reading them & the
+    // ring skips erasing sectors still blank
+    w25_ScanErased(W25_JOURNAL_START_SECTOR, W25_JOURNAL_NUM_SECTORS);
+
+    // Corrupt, no erased sector to mark start of ring
+    if (false == find_head_and_cursor()) {
+        JOURNAL_LOG(LOG_ERR, "ERR no gap, erasing\n");
+
+        // Up to 400 ms each, well past the watchdog all together
+        for (uint32_t i = 0; i < W25_JOURNAL_NUM_SECTORS; i++) {
+            timers_pet_dogs();
+            erase_sector(i);
+        }
+
+        head = 0;
+        cursor = 0;
+    }
+
+    JOURNAL_LOG(LOG_INFO, "head %u pend %u\n", head, journal_pending());
+
+    journal_ok = true;
+
+    return true;
+}
+
+bool journal_append(const journal_rec_t* rec) {
+    if (false == journal_ok) {
+        return false;
+    }
+
+    // Entering new sector, keep the next one erased
+    if ((head % RECS_PER_SECTOR) == 0) {
+        uint32_t next = ((head / RECS_PER_SECTOR) + 1) %
+                        W25_JOURNAL_NUM_SECTORS;
+
+        // Oldest sector about to go, move cursor past it if not uploaded
+        if ((cursor != head) && ((cursor / RECS_PER_SECTOR) == next)) {
+            uint32_t lost = RECS_PER_SECTOR - (cursor % RECS_PER_SECTOR);
+            JOURNAL_LOG(LOG_ERR, "ERR full, lost %u\n", lost);
+
+            cursor = ((next + 1) % W25_JOURNAL_NUM_SECTORS) * RECS_PER_SECTOR;
+        }
+
+        // Runs in the background, suspended for reads & programs
+        if (false == w25_EraseSectorStart(W25_JOURNAL_START_SECTOR + next)) {
+            erase_sector(next);
+        }
+    }
+
+    journal_rec_t tmp = *rec;
+    tmp.flags = FLAG_PENDING;
+
+    uint32_t address = rec_address(head);
+    w25_WritePage((uint8_t*)&tmp, address / PAGE_SIZE, address % PAGE_SIZE,
+                  REC_SIZE);
+
+    head = (head + 1) % NUM_RECS;
+
+    return true;
+}
+
+uint32_t journal_pending(void) {
+    if (false == journal_ok) {
+        return 0;
+    }
+
+    return (head + NUM_RECS - cursor) % NUM_RECS;
+}
+
+bool journal_peek(uint32_t n, journal_rec_t* rec) {
+    if (n >= journal_pending()) {
+        return false;
+    }
+
+    read_rec((cursor + n) % NUM_RECS, rec);
+
+    return true;
+}
+
+void journal_mark_uploaded(uint32_t num) {
+    // Records are page aligned so flags can be cleared one page at a time,
+    // writing 0xFF leaves the rest of the record untouched
+    static uint8_t page_buf[PAGE_SIZE];
+
+    if (num > journal_pending()) {
+        num = journal_pending();
+    }
+
+    while (num) {
+        uint32_t address = rec_address(cursor);
+        uint32_t offset = address % PAGE_SIZE;
+        uint32_t len = 0;
+
+        memset(page_buf, 0xFF, sizeof(page_buf));
+
+        // Stop at end of page or end of ring
+        do {
+            page_buf[len + REC_SIZE - 1] = FLAG_UPLOADED;
+            len += REC_SIZE;
+            cursor = (cursor + 1) % NUM_RECS;
+            num--;
+        } while (num && ((offset + len) < PAGE_SIZE) && (cursor != 0));
+
+        w25_WritePage(page_buf, address / PAGE_SIZE, offset, len);
+    }
+}
+
+void journal_poll(void) {
+    if (journal_ok) {
+        w25_IsBusy();
+    }
+}
+
+/** @} */
+
+/** @addtogroup JOURNAL_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint32_t rec_address(uint32_t idx) {
+    return (W25_JOURNAL_START_SECTOR * SECTOR_SIZE) + (idx * REC_SIZE);
+}
+
+static void read_rec(uint32_t idx, journal_rec_t* rec) {
+    w25_ReadBytes((uint8_t*)rec, rec_address(idx), REC_SIZE);
+}
+
+static bool rec_written(uint32_t idx) {
+    journal_rec_t rec;
+    read_rec(idx, &rec);
+    return (rec.dev_id != REC_EMPTY_ID);
+}
+
+static bool rec_pending(uint32_t idx) {
+    journal_rec_t rec;
+    read_rec(idx, &rec);
+    return (rec.flags == FLAG_PENDING);
+}
+
+// Records are written in order from the start, so any data means written
+static bool sector_written(uint32_t sector) {
+    return (w25_SectorState(W25_JOURNAL_START_SECTOR + sector) !=
+            W25_SECTOR_ERASED);
+}
+
+static void erase_sector(uint32_t sector) {
+    w25_EraseSector(W25_JOURNAL_START_SECTOR + sector);
+}
+
+static bool find_head_and_cursor(void) {
+    uint32_t sector = 0;
+    bool     any_written = false;
+    bool     found = false;
+
+    // Head sector is the written one followed by the erased gap
+    for (uint32_t i = 0; i < W25_JOURNAL_NUM_SECTORS; i++) {
+        uint32_t next = (i + 1) % W25_JOURNAL_NUM_SECTORS;
+
+        if (sector_written(i)) {
+            any_written = true;
+
+            if (false == sector_written(next)) {
+                sector = i;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    // Blank
+    if (false == any_written) {
+        head = 0;
+        cursor = 0;
+        return true;
+    } else if (false == found) {
+        return false;
+    }
+
+    // Binary search for first empty record in head sector
+    uint32_t lo = sector * RECS_PER_SECTOR;
+    uint32_t hi = lo + RECS_PER_SECTOR;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if (rec_written(mid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    head = lo % NUM_RECS;
+
+    // Oldest record is after the gap if the ring has wrapped
+    uint32_t oldest = ((sector + 2) % W25_JOURNAL_NUM_SECTORS) * RECS_PER_SECTOR;
+    if (false == rec_written(oldest)) {
+        oldest = 0;
+    }
+
+    // Uploaded in order, binary search for first pending after oldest
+    uint32_t count = (head + NUM_RECS - oldest) % NUM_RECS;
+    lo = 0;
+    hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if (rec_pending((oldest + mid) % NUM_RECS)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    cursor = (oldest + lo) % NUM_RECS;
+
+    return true;
+}
+
+/** @} */
+/** @} */
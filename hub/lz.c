@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ * @file    lz.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   LZ Compression Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/lz.h"
+
+/** @addtogroup LZ_FILE
+ * @{
+ */
+
+/** @addtogroup LZ_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#define MIN_MATCH 3
+#define MAX_MATCH (MIN_MATCH + 255)
+#define WINDOW    256
+
+#define ITEMS_PER_GROUP 8
+
+// Flag byte & every item a match
+#define GROUP_MAX (1 + (ITEMS_PER_GROUP * 2))
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static uint32_t find_match(lz_get_t get, uint32_t pos, uint32_t len,
+                           uint32_t* dist);
+
+/** @} */
+
+/** @addtogroup LZ_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+uint32_t lz_compress(lz_get_t get, uint32_t len, lz_put_t put,
+                     uint32_t max_out) {
+    uint8_t  group[GROUP_MAX];
+    uint32_t pos = 0;
+    uint32_t out = 0;
+
+    // Room for a full group checked before starting each one
+    while ((pos < len) && ((out + GROUP_MAX) <= max_out)) {
+        uint8_t group_len = 1;
+
+        group[0] = 0;
+
+        for (uint8_t item = 0; (item < ITEMS_PER_GROUP) && (pos < len);
+             item++) {
+            uint32_t dist = 0;
+            uint32_t match = find_match(get, pos, len, &dist);
+
+            if (match >= MIN_MATCH) {
+                group[0] |= (uint8_t)(1 << item);
+                group[group_len++] = (uint8_t)(dist - 1);
+                group[group_len++] = (uint8_t)(match - MIN_MATCH);
+                pos += match;
+            } else {
+                group[group_len++] = get(pos++);
+            }
+        }
+
+        for (uint8_t i = 0; i < group_len; i++) {
+            put(group[i]);
+        }
+        out += group_len;
+    }
+
+    return pos;
+}
+
+/** @} */
+
+/** @addtogroup LZ_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// Longest match starting in the window, nearest wins ties
+static uint32_t find_match(lz_get_t get, uint32_t pos, uint32_t len,
+                           uint32_t* dist) {
+    uint32_t best = 0;
+    uint32_t max = len - pos;
+
+    if (max > MAX_MATCH) {
+        max = MAX_MATCH;
+    }
+
+    if (max < MIN_MATCH) {
+        return 0;
+    }
+
+    uint8_t first = get(pos);
+
+    for (uint32_t d = 1; (d <= WINDOW) && (d <= pos); d++) {
+        if (get(pos - d) != first) {
+            continue;
+        }
+
+        // May run on into bytes being matched, decoder copies byte by byte
+        uint32_t n = 1;
+        while ((n < max) && (get(pos - d + n) == get(pos + n))) {
+            n++;
+        }
+
+        if (n > best) {
+            best = n;
+            *dist = d;
+
+            if (n == max) {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,244 @@
+/**
+ ******************************************************************************
+ * @file    modem_pwr.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Modem Power Policy Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/modem_pwr.h"
+
+#include <stddef.h>
+
+#include "common/log.h"
+#include "common/timers.h"
+
+/** @addtogroup MODEM_PWR_FILE
+ * @{
+ */
+
+/** @addtogroup MODEM_PWR_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef MODEM_PWR_LOG_LEVEL
+#define MODEM_PWR_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define MODEM_PWR_LOG_S(level, ...)                                            \
+    LOG_AT_S(level, MODEM_PWR_LOG_LEVEL, "PWR: " __VA_ARGS__)
+
+// Upload interval on battery, stretched as it runs down
+#define SLEEP_DEFAULT_MS  120000
+#define SLEEP_LOW_MS      900000
+#define SLEEP_CRITICAL_MS 3600000
+#define BATT_LOW          360
+#define BATT_CRITICAL     340
+
+// Urgent uploads only idle in states that wake this fast
+#define URGENT_MAX_WAKE_MS 2000
+
+// Average current while registering & opening the bearer
+#define ATTACH_MA 80
+
+// Measured wake times above this are counted as this
+#define WAKE_MAX_MS 300000
+
+typedef struct model_s {
+    uint32_t idle_ua;
+    uint32_t wake_ms;
+} model_t;
+
+// Starting estimates from SIM800 datasheet, wake times are then measured
+static model_t model[MODEM_PWR_NUM_STATES] = {
+    [MODEM_PWR_ON] = {15000, 0},
+    [MODEM_PWR_CSCLK] = {1200, 200},
+    [MODEM_PWR_MIN] = {800, 15000},
+    [MODEM_PWR_OFF] = {100, 25000},
+    [MODEM_PWR_ATTACH] = {ATTACH_MA * 1000, 0},
+};
+
+static modem_pwr_policy_t policy = NULL;
+
+static modem_pwr_state_t curr_state = MODEM_PWR_OFF;
+static modem_pwr_state_t wake_from = MODEM_PWR_OFF;
+static uint32_t          state_start = 0;
+
+static uint32_t time_s[MODEM_PWR_NUM_STATES];
+static uint32_t time_ms[MODEM_PWR_NUM_STATES];
+
+static const char* state_names[MODEM_PWR_NUM_STATES] = {"on", "csclk", "min",
+                                                        "off", "attach"};
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static modem_pwr_state_t default_policy(const modem_pwr_input_t* in,
+                                        uint32_t*                sleep_ms);
+static void              add_time(modem_pwr_state_t state, uint32_t ms);
+
+/** @} */
+
+/** @addtogroup MODEM_PWR_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void modem_pwr_init(void) {
+    for (uint8_t i = 0; i < MODEM_PWR_NUM_STATES; i++) {
+        time_s[i] = 0;
+        time_ms[i] = 0;
+    }
+
+    curr_state = MODEM_PWR_OFF;
+    wake_from = MODEM_PWR_OFF;
+    state_start = timers_millis();
+}
+
+void modem_pwr_set_policy(modem_pwr_policy_t new_policy) {
+    policy = new_policy;
+}
+
+modem_pwr_state_t modem_pwr_select(const modem_pwr_input_t* in,
+                                   uint32_t*                sleep_ms) {
+    return policy ? policy(in, sleep_ms) : default_policy(in, sleep_ms);
+}
+
+uint32_t modem_pwr_estimate_uas(modem_pwr_state_t state, uint32_t sleep_ms) {
+    // mA * ms = uA * s
+    return (model[state].idle_ua * (sleep_ms / 1000)) +
+           (ATTACH_MA * model[state].wake_ms);
+}
+
+void modem_pwr_set_state(modem_pwr_state_t state) {
+    if (state == curr_state) {
+        return;
+    }
+
+    uint32_t now = timers_millis();
+    uint32_t elapsed = now - state_start;
+
+    add_time(curr_state, elapsed);
+
+    if (state == MODEM_PWR_ATTACH) {
+        wake_from = curr_state;
+    }
+    // Back on network, average in how long it took
+    else if ((curr_state == MODEM_PWR_ATTACH) && (state == MODEM_PWR_ON) &&
+             (wake_from != MODEM_PWR_ON)) {
+        if (elapsed > WAKE_MAX_MS) {
+            elapsed = WAKE_MAX_MS;
+        }
+
+        model[wake_from].wake_ms =
+            ((3 * model[wake_from].wake_ms) + elapsed) / 4;
+
+        MODEM_PWR_LOG_S(LOG_DBG, "wake %s %u ms, avg %u\n",
+                        state_names[wake_from], elapsed,
+                        model[wake_from].wake_ms);
+    }
+
+    curr_state = state;
+    state_start = now;
+}
+
+modem_pwr_state_t modem_pwr_get_state(void) { return curr_state; }
+
+uint32_t modem_pwr_get_time_s(modem_pwr_state_t state) {
+    uint32_t secs = time_s[state];
+
+    if (state == curr_state) {
+        secs += (timers_millis() - state_start) / 1000;
+    }
+
+    return secs;
+}
+
+void modem_pwr_print(void) {
+    if (!LOG_ON(LOG_INFO, MODEM_PWR_LOG_LEVEL)) {
+        return;
+    }
+
+    log_printf("PWR: ");
+    for (uint8_t i = 0; i < MODEM_PWR_NUM_STATES; i++) {
+        log_printf("%s %u s ", state_names[i],
+                   modem_pwr_get_time_s((modem_pwr_state_t)i));
+    }
+    log_printf("\n");
+}
+
+/** @} */
+
+/** @addtogroup MODEM_PWR_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static modem_pwr_state_t default_policy(const modem_pwr_input_t* in,
+                                        uint32_t*                sleep_ms) {
+    // Mains power, stay connected
+    if (in->plugged_in) {
+        *sleep_ms = 0;
+        return MODEM_PWR_ON;
+    }
+
+    uint32_t max_wake_ms = UINT32_MAX;
+
+    // Voltage 0 until first measurement, low battery only ever stretches
+    *sleep_ms = in->upload_ms ? in->upload_ms : SLEEP_DEFAULT_MS;
+    if (in->prio == MODEM_PWR_PRIO_URGENT) {
+        max_wake_ms = URGENT_MAX_WAKE_MS;
+    } else if (in->batt_voltage && (in->batt_voltage < BATT_CRITICAL)) {
+        if (*sleep_ms < SLEEP_CRITICAL_MS) {
+            *sleep_ms = SLEEP_CRITICAL_MS;
+        }
+    } else if (in->batt_voltage && (in->batt_voltage < BATT_LOW)) {
+        if (*sleep_ms < SLEEP_LOW_MS) {
+            *sleep_ms = SLEEP_LOW_MS;
+        }
+    }
+
+    modem_pwr_state_t best = MODEM_PWR_ON;
+    uint32_t          best_uas = modem_pwr_estimate_uas(best, *sleep_ms);
+
+    for (uint8_t i = MODEM_PWR_CSCLK; i <= MODEM_PWR_OFF; i++) {
+        uint32_t uas = modem_pwr_estimate_uas((modem_pwr_state_t)i, *sleep_ms);
+
+        if ((model[i].wake_ms <= max_wake_ms) && (uas < best_uas)) {
+            best = (modem_pwr_state_t)i;
+            best_uas = uas;
+        }
+    }
+
+    MODEM_PWR_LOG_S(LOG_INFO, "%s for %u s, %u uAs, batt %u\n",
+                    state_names[best], *sleep_ms / 1000, best_uas,
+                    in->batt_voltage);
+
+    return best;
+}
+
+static void add_time(modem_pwr_state_t state, uint32_t ms) {
+    time_ms[state] += ms;
+    time_s[state] += time_ms[state] / 1000;
+    time_ms[state] %= 1000;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,258 @@
+/**
+ ******************************************************************************
+ * @file    remote_cfg.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Remote Config Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include "hub/remote_cfg.h"
+
+#include <string.h>
+
+#include "common/log.h"
+#include "common/memory.h"
+#include "common/printf.h"
+#include "config/board_defs.h"
+
+/** @addtogroup REMOTE_CFG_FILE
+ * @{
+ */
+
+/** @addtogroup REMOTE_CFG_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#ifndef CFG_LOG_LEVEL
+#define CFG_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define CFG_LOG_S(level, ...)                                                  \
+    LOG_AT_S(level, CFG_LOG_LEVEL, "CFG: " __VA_ARGS__)
+
+#define DEFAULT_URL "http://rickceas.azurewebsites.net/CE/hub.php"
+
+typedef struct item_s {
+    const char* name;
+    int32_t     def;
+    int32_t     min;
+    int32_t     max;
+} item_t;
+
+// Numeric keys must fill remote_cfg_info_t.vals exactly
+static const item_t items[REMOTE_CFG_NUM_VALS] = {
+    [REMOTE_CFG_CHECK_S] = {"check_s", 60, 10, 3600},
+    [REMOTE_CFG_LOG_S] = {"log_s", 3600, 60, 86400},
+    [REMOTE_CFG_TIME_SYNC_S] = {"sync_s", 21600, 600, 604800},
+    [REMOTE_CFG_UPLOAD_S] = {"upload_s", 120, 30, 86400},
+    [REMOTE_CFG_LOG_LEVEL] = {"log_lvl", LOG_INFO, LOG_NONE, LOG_DBG},
+};
+
+static remote_cfg_info_t cfg;
+
+static bool changed = false;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool url_valid(const char* url);
+static void save(void);
+
+/** @} */
+
+/** @addtogroup REMOTE_CFG_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void remote_cfg_init(void) {
+    bool stored = (app_info->remote_cfg.key == REMOTE_CFG_KEY);
+
+    cfg.key = REMOTE_CFG_KEY;
+
+    for (uint8_t i = 0; i < REMOTE_CFG_NUM_VALS; i++) {
+        int32_t val = app_info->remote_cfg.vals[i];
+
+        if (!stored || (val < items[i].min) || (val > items[i].max)) {
+            val = items[i].def;
+        }
+
+        cfg.vals[i] = val;
+    }
+
+    if (stored) {
+        memcpy(cfg.url, app_info->remote_cfg.url, sizeof(cfg.url));
+        cfg.url[sizeof(cfg.url) - 1] = '\0';
+    }
+
+    if (!stored || !url_valid(cfg.url)) {
+        strncpy(cfg.url, DEFAULT_URL, sizeof(cfg.url) - 1);
+        cfg.url[sizeof(cfg.url) - 1] = '\0';
+    }
+
+    changed = false;
+
+    remote_cfg_print();
+}
+
+int8_t remote_cfg_find(const char* name) {
+    for (uint8_t i = 0; i < REMOTE_CFG_NUM_VALS; i++) {
+        if (!strcmp(name, items[i].name)) {
+            return (int8_t)i;
+        }
+    }
+
+    if (!strcmp(name, "url")) {
+        return REMOTE_CFG_URL;
+    }
+
+    return -1;
+}
+
+bool remote_cfg_set(int8_t key, const char* str) {
+    if ((key < 0) || (key >= REMOTE_CFG_NUM_KEYS)) {
+        return false;
+    }
+
+    if (key == REMOTE_CFG_URL) {
+        if ((strlen(str) >= sizeof(cfg.url)) || !url_valid(str)) {
+            CFG_LOG_S(LOG_WARN, "bad url %s\n", str);
+            return false;
+        }
+
+        if (strcmp(str, cfg.url)) {
+            memset(cfg.url, 0, sizeof(cfg.url));
+            strcpy(cfg.url, str);
+            CFG_LOG_S(LOG_INFO, "url %s\n", cfg.url);
+            changed = true;
+            save();
+        }
+
+        return true;
+    }
+
+    bool neg = (*str == '-');
+    if (neg) {
+        str++;
+    }
+
+    if (!_is_digit(*str)) {
+        return false;
+    }
+
+    int32_t val = (int32_t)_atoi(&str);
+    if (neg) {
+        val = -val;
+    }
+
+    if ((val < items[key].min) || (val > items[key].max)) {
+        CFG_LOG_S(LOG_WARN, "%s %i out of range\n", items[key].name,
+                  val);
+        return false;
+    }
+
+    if (val != cfg.vals[key]) {
+        CFG_LOG_S(LOG_INFO, "%s %i -> %i\n", items[key].name, cfg.vals[key],
+                  val);
+        cfg.vals[key] = val;
+        changed = true;
+        save();
+    }
+
+    return true;
+}
+
+void remote_cfg_default_url(void) {
+    if (strcmp(cfg.url, DEFAULT_URL)) {
+        memset(cfg.url, 0, sizeof(cfg.url));
+        strcpy(cfg.url, DEFAULT_URL);
+        CFG_LOG_S(LOG_WARN, "url back to %s\n", cfg.url);
+        changed = true;
+        save();
+    }
+}
+
+int32_t remote_cfg_get(remote_cfg_key_t key) {
+    return (key < REMOTE_CFG_NUM_VALS) ? cfg.vals[key] : 0;
+}
+
+const char* remote_cfg_url(void) { return cfg.url; }
+
+bool remote_cfg_changed(void) {
+    bool res = changed;
+    changed = false;
+    return res;
+}
+
+uint32_t remote_cfg_hash(void) {
+    const uint8_t* p = (const uint8_t*)cfg.vals;
+    uint32_t       hash = 5381;
+
+    for (uint8_t i = 0; i < sizeof(cfg.vals); i++) {
+        hash = (hash * 33) ^ p[i];
+    }
+
+    for (const char* c = cfg.url; *c; c++) {
+        hash = (hash * 33) ^ (uint8_t)*c;
+    }
+
+    return hash;
+}
+
+void remote_cfg_print(void) {
+    if (!LOG_ON(LOG_INFO, CFG_LOG_LEVEL)) {
+        return;
+    }
+
+    log_printf("CFG: ");
+    for (uint8_t i = 0; i < REMOTE_CFG_NUM_VALS; i++) {
+        log_printf("%s %i ", items[i].name, cfg.vals[i]);
+    }
+    log_printf("\n");
+    log_printf("CFG: url %s\n", cfg.url);
+}
+
+/** @} */
+
+/** @addtogroup REMOTE_CFG_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool url_valid(const char* url) {
+    return !strncmp(url, "http://", 7) || !strncmp(url, "https://", 8);
+}
+
+static void save(void) {
+    const uint32_t* src = (const uint32_t*)&cfg;
+    uint32_t*       dst = (uint32_t*)&app_info->remote_cfg;
+
+    // Invalid while writing so a reset part way through loads defaults
+    mem_eeprom_write_word_ptr(&dst[0], 0);
+
+    for (uint8_t i = 1; i < (sizeof(cfg) / sizeof(uint32_t)); i++) {
+        mem_eeprom_write_word_ptr(&dst[i], src[i]);
+    }
+
+    mem_eeprom_write_word_ptr(&dst[0], src[0]);
+}
+
+/** @} */
+/** @} */
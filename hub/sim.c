@@ -19,21 +19,31 @@
 
 #include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/flash.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/usart.h>
 
+#include "common/date.h"
 #include "common/log.h"
 #include "common/memory.h"
 #include "common/printf.h"
 #include "common/timers.h"
 #include "config/board_defs.h"
+#include "hub/cmux.h"
 
 /** @addtogroup SIM_FILE
  * @{
  */
 
+#ifndef SIM_LOG_LEVEL
+#define SIM_LOG_LEVEL LOG_LEVEL
+#endif
+
+#define SIM_LOG(level, ...)   LOG_AT(level, SIM_LOG_LEVEL, __VA_ARGS__)
+#define SIM_LOG_S(level, ...) LOG_AT_S(level, SIM_LOG_LEVEL, __VA_ARGS__)
+
 #define PRINT_CMD(type, cmd, val)                                              \
     serial_printf("%s: %s %s\n",                                               \
                   ((type == CMD_TEST)    ? "TEST"                              \
@@ -95,21 +105,46 @@
 #define RX_TIMEOUT_MS     100
 #define QUICK_RESPONSE_MS 100
 
+// Network time not received if CCLK year before this
+#define SIM_MIN_VALID_YEAR 21
+
+// Autobaud attempts at one baud rate before trying the other
+#define AUTOBAUD_TRIES_PER_BAUD 10
+
 sim800_t sim800;
 
-enum cmd_type { CMD_TEST = 0, CMD_READ, CMD_WRITE, CMD_EXEC, CMD_WAIT };
+enum cmd_type {
+    CMD_TEST = 0,
+    CMD_READ,
+    CMD_WRITE,
+    CMD_EXEC,
+    CMD_WAIT,
+    CMD_RAW
+};
 
 #define SIM_BUFFER_SIZE 64U
 
-static char    sim_rx_buf[SIM_BUFFER_SIZE];
-static char    sim_tx_buf[SIM_BUFFER_SIZE];
-static uint8_t sim_tx_head = 0;
-static uint8_t sim_tx_tail = 0;
-static uint8_t sim_rx_head = 0;
-static uint8_t sim_rx_tail = 0;
-static bool    sim_rx_overflow = false;
-
-static char    _sprintf_buf[SIM_BUFFER_SIZE];
+// RX is filled by circular DMA so it keeps receiving while the CPU is stalled
+// e.g. by flash programming. Head & tail count bytes since DMA setup, head is
+// derived from the DMA counter & the wraps counted by SIM_DMA_ISR(), so the
+// main loop can stall for longer than a lap (22 ms at 115200), see rx_head()
+#define SIM_RX_BUFFER_SIZE 256U
+#define sim_rx_pos                                                             \
+    ((uint16_t)((SIM_RX_BUFFER_SIZE -                                          \
+                 dma_get_number_of_data(DMA1, SIM_USART_DMA_RX_CHANNEL)) %     \
+                SIM_RX_BUFFER_SIZE))
+
+static char     sim_rx_buf[SIM_RX_BUFFER_SIZE];
+static char     sim_tx_buf[SIM_BUFFER_SIZE];
+static uint8_t  sim_tx_head = 0;
+static uint8_t  sim_tx_tail = 0;
+static volatile uint32_t sim_rx_laps = 0;
+static uint32_t sim_rx_tail = 0;
+
+// Holds formatted commands & values, long enough for HTTPPARA URL
+#define SIM_SPRINTF_BUFFER_SIZE 128U
+
+static char    _sprintf_buf[SIM_SPRINTF_BUFFER_SIZE];
 static uint8_t _sprintf_buf_idx = 0;
 
 static char param_buf[SIM_BUFFER_SIZE];
@@ -121,6 +156,69 @@ static uint8_t timestamp[6] = {0, 0, 0, 0, 0, 0};
 static uint32_t _timer = 0;
 static uint32_t _timeout_ms = 0;
 
+// MCU side baud rate. SIM800 keeps the negotiated rate over resets so start
+// there and fall back to SIM_USART_BAUD if it does not respond
+static uint32_t sim_baud = SIM_USART_BAUD_FAST;
+
+// HTTP session already set up on the SIM800, only valid while http.state is
+// not HTTP_TERM or HTTP_ERROR. Lets uploads skip HTTPINIT & HTTPPARA
+#define HTTP_SSL_UNKNOWN 0xFF
+
+static uint32_t http_url_hash = 0;
+static uint8_t  http_ssl = HTTP_SSL_UNKNOWN;
+static bool     http_content_set = false;
+
+// Estimated bytes on air per HTTP action on top of the bodies: DNS, TCP open
+// & close, request & response headers. Plus IP/TCP headers per segment
+#define HTTP_OVERHEAD_BYTES     700U
+#define TCP_SEGMENT_SIZE        1360U
+#define TCP_SEGMENT_OVERHEAD    40U
+
+static uint32_t http_url_len = 0;
+static uint32_t http_tx_size = 0;
+
+// Bearer seen open, cleared by reset or HTTP error
+static bool bearer_open = false;
+
+// AT commands sent, for counting round trips
+static uint32_t num_cmds = 0;
+
+// GSM 07.10 mux. Status commands & URCs use the control channel, HTTP the
+// data channel so neither can stall or corrupt the other. Frames are decoded
+// out of the DMA ring into a ring per channel, reads & writes go to the
+// channel selected by the public function being called. Only started when
+// built with SIM_CMUX, otherwise everything shares the one AT channel
+typedef enum sim_channel {
+    SIM_CH_CTRL = 0, // DLCI 1
+    SIM_CH_DATA,     // DLCI 2
+    SIM_NUM_CH
+} sim_channel_t;
+
+#define CMUX_DLCI(ch) ((uint8_t)((ch) + 1))
+
+// Room for a full frame plus part of the next
+#define SIM_CH_BUFFER_SIZE 192U
+
+// Bytes staged by _putchar before being sent as one frame
+#define CMUX_TX_SIZE 32U
+
+#define CMUX_UA_TIMEOUT_MS 1000
+#define CMUX_CLOSE_MS      200
+
+typedef struct chan_s {
+    char     rx_buf[SIM_CH_BUFFER_SIZE];
+    uint16_t rx_head;
+    uint16_t rx_tail;
+} chan_t;
+
+static chan_t         chans[SIM_NUM_CH];
+static sim_channel_t  chan = SIM_CH_CTRL;
+static cmux_decoder_t cmux_dec;
+static uint8_t        cmux_ua = 0; // Bit per DLCI acknowledged
+static uint8_t        cmux_tx_buf[CMUX_TX_SIZE];
+static uint8_t        cmux_tx_len = 0;
+static uint8_t        cmux_frame_buf[CMUX_TX_SIZE + CMUX_FRAME_OVERHEAD];
+
 /*////////////////////////////////////////////////////////////////////////////*/
 // Comms
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -139,13 +237,8 @@ static sim_state_t exec_command(const char* cmd_str, uint32_t timeout_ms);
 static sim_state_t set_param(const char* cmd_str, const char* val_str,
                              uint32_t timeout_ms);
 static sim_state_t wait_command(const char* wait_str, uint32_t timeout_ms);
-
-/** @brief Wait until correct response received or timeout
- *
- * Check response + timeout
- */
-static bool wait_and_check_response(uint32_t    timeout_ms,
-                                    const char* expected_response);
+/** @brief Queue as much of data as fits in TX buffer, true once all sent */
+static bool send_data(const char* data, uint32_t len, uint32_t* idx);
 /** @brief Read all unread characters until terminated or no rx in 100ms */
 static bool response_done(const char terminating_char);
 /** @brief Search for string in reply_buf */
@@ -169,6 +262,12 @@ static sim_state_t reset_and_wait_ready(void);
  */
 static sim_state_t try_autobaud(void);
 static sim_state_t disable_echo(void);
+/** @brief Switch SIM800 and MCU to fixed baud rate and save it in SIM800
+ *
+ * SIM800 replies OK at the old rate then switches. Verified with AT at the new
+ * rate, MCU goes back to the old rate if that fails
+ */
+static sim_state_t set_baud_rate(uint32_t baud);
 static sim_state_t toggle_local_timestamp(bool on);
 static sim_state_t set_function(sim_function_t func);
 static sim_state_t config_saved_params(void);
@@ -181,11 +280,37 @@ static sim_state_t toggle_bearer(bool open);
 
 static sim_state_t http_toggle_ssl(bool on);
 static sim_state_t http_action(uint8_t action);
+static bool        http_session_up(void);
+static uint32_t    http_hash(const char* str);
 
+/*////////////////////////////////////////////////////////////////////////////*/
+// CMUX
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static sim_state_t cmux_start(void);
+static sim_state_t cmux_stop(void);
+static void        cmux_poll(void);
+static void        cmux_send(uint8_t dlci, uint8_t control, const uint8_t* info,
+                             uint8_t len);
+static void        use_channel(sim_channel_t ch);
+static uint16_t    chan_free(sim_channel_t ch);
+static void        rx_count_lap(void);
+static uint32_t    rx_head(void);
+static uint32_t    rx_unread(void);
+static bool        rx_pending(void);
+static char        rx_get(void);
+static uint8_t     tx_free(void);
+static void        tx_flush(void);
+
+/** @brief Setup MCU & hold SIM800 in reset, released by
+ * reset_and_wait_ready() */
 static void reset(void);
 static void mcu_setup(void);
 static void usart_setup(void);
+static void usart_set_baud(uint32_t baud);
+static void dma_setup(void);
 static void clear_rx_buf(void);
+static void usart_putchar(char character);
 static void _putchar(char character);
 static void print_timestamp(void);
 
@@ -226,31 +351,30 @@ void sim_printf(const char* format, ...) {
     va_start(va, format);
     fnprintf(_putchar, format, va);
     va_end(va);
+
+    tx_flush();
 }
 
-bool sim_printf_and_check_response(uint32_t    timeout_ms,
-                                   const char* expected_response,
-                                   const char* format, ...) {
-    // Write to SIM800
+sim_state_t sim_printf_and_check_response(uint32_t    timeout_ms,
+                                          const char* expected_response,
+                                          const char* format, ...) {
+    // Formatted every call but only sent when command starts
+    _sprintf_clear_buf();
+
     va_list va;
     va_start(va, format);
-    fnprintf(_putchar, format, va);
+    fnprintf(_putchar_buffer, format, va);
     va_end(va);
 
-    clear_rx_buf();
-
-    return wait_and_check_response(timeout_ms, expected_response);
+    return command(CMD_RAW, _sprintf_buf, expected_response, timeout_ms);
 }
 
-bool sim_available(void) {
-    return ((sim_rx_head + SIM_BUFFER_SIZE - sim_rx_tail) % SIM_BUFFER_SIZE);
-}
+bool sim_available(void) { return rx_pending(); }
 
 char sim_read(void) {
     char c = 0;
-    if (sim_available()) {
-        c = sim_rx_buf[sim_rx_tail];
-        sim_rx_tail = (sim_rx_tail + 1) % SIM_BUFFER_SIZE;
+    if (rx_pending()) {
+        c = rx_get();
     }
 
     return c;
@@ -281,8 +405,6 @@ static sim_state_t command(enum cmd_type type, const char* cmd_str,
 
     sim_state_t res = SIM_ERROR;
 
-    bool quick_response = (timeout_ms <= QUICK_RESPONSE_MS) ? true : false;
-
     switch (state) {
     // Send command
     case 0:
@@ -293,12 +415,11 @@ static sim_state_t command(enum cmd_type type, const char* cmd_str,
         res = SIM_BUSY;
         state++;
 
-        timers_delay_milliseconds(1);
-
         timeout_init(timeout_ms);
 
         if (type != CMD_WAIT) {
             clear_rx_buf();
+            num_cmds++;
         }
 
         switch (type) {
@@ -316,51 +437,46 @@ static sim_state_t command(enum cmd_type type, const char* cmd_str,
             break;
         case CMD_WAIT:
             break;
-        default:
+        case CMD_RAW:
+            sim_printf("%s", cmd_str);
             break;
-        }
-
-        if (!quick_response) {
+        default:
             break;
         }
-        /* fall through */
+        break;
 
-    // Parse response, waits until finished if timeout is small
+    // Parse response, one line per call
     case 1:
         res = SIM_BUSY;
-        do {
-            if (timeout()) {
-                res = SIM_TIMEOUT;
-                state = 0;
 
-                log_printf("SIM ERR: CMD TO %u %s %s\n", type, cmd_str,
-                           val_str);
-                break;
-            } else if (response_done('\n')) {
-                if (check_response("OK")) {
-                    res = SIM_SUCCESS;
-                    state = 0;
+        if (timeout()) {
+            res = SIM_TIMEOUT;
+            state = 0;
 
-                    break;
-                } else if (check_response("ERROR")) {
-                    res = SIM_ERROR;
-                    state = 0;
+            SIM_LOG_S(LOG_ERR, "SIM ERR: CMD TO %u %s %s\n", type, cmd_str,
+                      val_str);
+        } else if (response_done('\n')) {
+            // Raw commands wait for their own expected response
+            if (check_response((type == CMD_RAW) ? val_str : "OK")) {
+                res = SIM_SUCCESS;
+                state = 0;
+            } else if (check_response("ERROR")) {
+                res = SIM_ERROR;
+                state = 0;
 
-                    log_printf("SIM ERR: CMD FA %u %s %s\n", type, cmd_str,
-                               val_str);
-                    break;
-                }
-                // Save parameter value e.g. +CLTS: 1
-                else if (check_response(cmd_str)) {
-                    strcpy(param_buf, reply_buf);
+                SIM_LOG_S(LOG_ERR, "SIM ERR: CMD FA %u %s %s\n", type, cmd_str,
+                          val_str);
+            }
+            // Save parameter value e.g. +CLTS: 1
+            else if ((type != CMD_RAW) && check_response(cmd_str)) {
+                strcpy(param_buf, reply_buf);
 
-                    if (type == CMD_WAIT) {
-                        res = SIM_SUCCESS;
-                        state = 0;
-                    }
+                if (type == CMD_WAIT) {
+                    res = SIM_SUCCESS;
+                    state = 0;
                 }
             }
-        } while (quick_response);
+        }
         break;
 
     default:
@@ -453,19 +569,34 @@ static sim_state_t set_param(const char* cmd_str, const char* val_str,
     return res;
 }
 
-static bool wait_and_check_response(uint32_t    timeout_ms,
-                                    const char* expected_response) {
-    bool     result = false;
-    uint32_t timer = timers_millis();
+static bool send_data(const char* data, uint32_t len, uint32_t* idx) {
+    if (!sim800.cmux) {
+        while ((*idx < len) && tx_free()) {
+            _putchar(data[(*idx)++]);
+        }
 
-    while ((timers_millis() - timer) < timeout_ms) {
-        if (response_done('\n') && check_response(expected_response)) {
-            result = true;
-            break;
+        return (*idx >= len);
+    }
+
+    // Whole frames only so the TX buffer never blocks
+    uint8_t space = tx_free();
+    while ((*idx < len) && (space > CMUX_FRAME_OVERHEAD)) {
+        uint32_t n = len - *idx;
+
+        if (n > (uint32_t)(space - CMUX_FRAME_OVERHEAD)) {
+            n = space - CMUX_FRAME_OVERHEAD;
         }
+        if (n > CMUX_TX_SIZE) {
+            n = CMUX_TX_SIZE;
+        }
+
+        cmux_send(CMUX_DLCI(chan), CMUX_UIH, (const uint8_t*)&data[*idx],
+                  (uint8_t)n);
+        *idx += n;
+        space = tx_free();
     }
 
-    return result;
+    return (*idx >= len);
 }
 
 static bool check_response(const char* expected_response) {
@@ -496,13 +627,12 @@ static bool response_done(const char terminating_char) {
 
     // Go through unread RX Buf until terminating char found
     bool terminated = false;
-    while (sim_rx_tail != sim_rx_head) {
+    while (rx_pending()) {
         // Reset rx timeout for every new char received
         rx_timeout = timers_millis();
 
         // Get next char from RX Buf
-        char character = sim_rx_buf[sim_rx_tail];
-        sim_rx_tail = (sim_rx_tail + 1) % SIM_BUFFER_SIZE;
+        char character = rx_get();
 
         check_buf[check_idx] = character;
         check_idx = (check_idx + 1) % SIM_BUFFER_SIZE;
@@ -576,16 +706,20 @@ void sim_print_state(sim_state_t res) {
 
 sim_state_t sim_init(void) {
     static uint8_t state = 0;
+    static bool    plain_at = false;
     sim_state_t    res = SIM_ERROR;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     case 0:
         res = SIM_BUSY;
         state++;
 
         sim800.func = FUNC_OFF;
+        plain_at = false;
 
-        log_printf("SIM: Init\n");
+        SIM_LOG(LOG_INFO, "SIM: Init\n");
 
         // // If sim already on, skip reset
         // mcu_setup();
@@ -610,7 +744,28 @@ sim_state_t sim_init(void) {
     case 4:
         res = set_function(FUNC_FULL);
         break;
+    // Mux is opt in, app only. If the modem won't open it, it may already be
+    // framing so reset & carry on with plain AT commands
     case 5:
+#ifdef SIM_CMUX
+        if (plain_at) {
+            res = SIM_SUCCESS;
+        } else {
+            res = cmux_start();
+
+            if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+                SIM_LOG(LOG_WARN, "SIM: CMUX failed, plain AT\n");
+                plain_at = true;
+                res = SIM_BUSY;
+                state = 3;
+            }
+        }
+#else
+        (void)plain_at;
+        res = SIM_SUCCESS;
+#endif
+        break;
+    case 6:
         state = 'S';
         break;
     default:
@@ -636,11 +791,13 @@ sim_state_t sim_end(void) {
     static uint8_t state = 0;
     sim_state_t    res = SIM_ERROR;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: End\n");
+        SIM_LOG(LOG_INFO, "SIM: End\n");
 
         break;
     case 1:
@@ -657,6 +814,7 @@ sim_state_t sim_end(void) {
         res = SIM_SUCCESS;
 
         usart_disable(SIM_USART);
+        dma_disable_channel(DMA1, SIM_USART_DMA_RX_CHANNEL);
         rcc_periph_clock_disable(SIM_USART_RCC);
 
         sim800.func = FUNC_SLEEP;
@@ -690,11 +848,13 @@ sim_state_t sim_sleep(void) {
     sim_state_t     res = SIM_ERROR;
     static uint32_t timer = 0;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: Sleep\n");
+        SIM_LOG(LOG_INFO, "SIM: Sleep\n");
 
         break;
     case 1:
@@ -748,18 +908,117 @@ sim_state_t sim_sleep(void) {
     return res;
 }
 
+sim_state_t sim_slow_clock(bool on) {
+    static uint8_t  state = 0;
+    sim_state_t     res = SIM_ERROR;
+    static uint32_t timer = 0;
+    static bool     remux = false; // Mux closed for sleep, reopen on wake
+
+    use_channel(SIM_CH_CTRL);
+
+    switch (state) {
+    case 0:
+        res = SIM_SUCCESS;
+
+        SIM_LOG_S(LOG_DBG, "SIM: Slow clk %s\n", on ? "on" : "off");
+
+        if (on) {
+            remux = sim800.cmux;
+        } else {
+            // First character wakes SIM800 & is lost
+            sim_printf("AT\r");
+            timer = timers_millis();
+            state = 1;
+        }
+        break;
+    // Mux frames would wake it, close before sleeping
+    case 1:
+        res = cmux_stop();
+        if (res == SIM_SUCCESS) {
+            state = 2;
+        }
+        break;
+    // Serial port usable 100 ms after waking
+    case 2:
+        res = SIM_BUSY;
+
+        if ((timers_millis() - timer) > 100) {
+            res = SIM_SUCCESS;
+        }
+        break;
+    // Sleeps whenever serial is idle, wakes on next command
+    case 3:
+        res = write_command("+CSCLK", on ? "2" : "0", 1000);
+        break;
+    // Only if one was open before, plain AT otherwise
+    case 4:
+        if (on || !remux) {
+            res = SIM_SUCCESS;
+        } else {
+            res = cmux_start();
+
+            if (res != SIM_BUSY) {
+                remux = false;
+            }
+        }
+        break;
+    case 5:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+sim_state_t sim_min_function(bool on) {
+    use_channel(SIM_CH_CTRL);
+
+    // Detaching & registering can take several seconds
+    sim_state_t res = write_command("+CFUN", on ? "0" : "1", 10000);
+
+    if (res == SIM_SUCCESS) {
+        SIM_LOG_S(LOG_DBG, "SIM: Min func %s\n", on ? "on" : "off");
+        sim800.func = on ? FUNC_MIN : FUNC_FULL;
+
+        // RF off, network & bearer lost
+        if (on) {
+            sim800.reg_status = REG_NONE;
+            sim800.http.state = HTTP_TERM;
+            bearer_open = false;
+        }
+    }
+
+    return res;
+}
+
 sim_state_t sim_register_to_network(void) {
     static uint8_t  state = 0;
     static uint8_t  num_tries = 0;
     static uint32_t timer = 0;
     sim_state_t     res = SIM_ERROR;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     // Init state machine
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: Register\n");
+        SIM_LOG(LOG_INFO, "SIM: Register\n");
 
         sim800.reg_status = REG_NONE;
         num_tries = 0;
@@ -843,10 +1102,11 @@ sim_state_t sim_register_to_network(void) {
     return res;
 }
 
-uint8_t* sim_get_timestamp(void) {
-    // E.g. +CCLK: "21/02/03,13:37:12+00"
+sim_state_t sim_get_timestamp(uint32_t* stamp) {
+    use_channel(SIM_CH_CTRL);
 
-    sim_state_t res = read_command("+CCLK", QUICK_RESPONSE_MS);
+    // E.g. +CCLK: "21/02/03,13:37:12+04", zone in quarter hours
+    sim_state_t res = read_command("+CCLK", 1000);
 
     if (res == SIM_SUCCESS) {
         // Basic error check of reponse format
@@ -857,6 +1117,23 @@ uint8_t* sim_get_timestamp(void) {
                 ptr = &param_buf[8 + (3 * i)];
                 timestamp[i] = (uint8_t)_atoi((const char**)&ptr);
             }
+
+            ptr = &param_buf[26];
+            int32_t zone_s = (int32_t)_atoi((const char**)&ptr) * 15 * 60;
+            if (param_buf[25] == '-') {
+                zone_s = -zone_s;
+            }
+
+            // Default time before network sends it is 2004
+            if (timestamp[0] < SIM_MIN_VALID_YEAR) {
+                res = SIM_ERROR;
+            } else {
+                *stamp = (uint32_t)((int32_t)date_to_timestamp(
+                                        timestamp[0], timestamp[1],
+                                        timestamp[2], timestamp[3],
+                                        timestamp[4], timestamp[5]) -
+                                    zone_s);
+            }
         } else {
             res = SIM_ERROR;
         }
@@ -869,13 +1146,36 @@ uint8_t* sim_get_timestamp(void) {
         memset(timestamp, 0, sizeof(timestamp));
     }
 
-    return timestamp;
+    return res;
+}
+
+sim_state_t sim_get_signal(uint8_t* csq) {
+    use_channel(SIM_CH_CTRL);
+
+    // E.g. +CSQ: 18,0, rssi 0-31 or 99 if not known
+    sim_state_t res = exec_command("+CSQ", 1000);
+
+    if (res == SIM_SUCCESS) {
+        char* ptr = &param_buf[6];
+
+        if ((strstr(param_buf, "+CSQ") != NULL) && _is_digit(*ptr)) {
+            *csq = (uint8_t)_atoi((const char**)&ptr);
+        } else {
+            *csq = SIM_CSQ_UNKNOWN;
+        }
+    } else if (res != SIM_BUSY) {
+        *csq = SIM_CSQ_UNKNOWN;
+    }
+
+    return res;
 }
 
 sim_state_t sim_open_bearer(char* apn_str, char* user_str, char* pwd_str) {
     static uint8_t state = 0;
     sim_state_t    res = SIM_ERROR;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     case 0:
         res = write_command("+SAPBR", "2,1", 1000);
@@ -885,6 +1185,7 @@ sim_state_t sim_open_bearer(char* apn_str, char* user_str, char* pwd_str) {
         res = SIM_BUSY;
 
         if (check_param_response("+SAPBR", "1,1")) {
+            bearer_open = true;
             state = 'S';
         } else {
             state++;
@@ -900,6 +1201,7 @@ sim_state_t sim_open_bearer(char* apn_str, char* user_str, char* pwd_str) {
         res = toggle_bearer(true);
 
         if (res == SIM_SUCCESS) {
+            bearer_open = true;
             state = 'S';
         }
         break;
@@ -927,8 +1229,11 @@ sim_state_t sim_close_bearer(void) {
     static uint8_t state = 0;
     sim_state_t    res = SIM_ERROR;
 
+    use_channel(SIM_CH_CTRL);
+
     switch (state) {
     case 0:
+        bearer_open = false;
         res = write_command("+SAPBR", "2,1", QUICK_RESPONSE_MS);
         break;
     case 1:
@@ -963,29 +1268,76 @@ sim_state_t sim_close_bearer(void) {
 }
 
 sim_state_t sim_is_connected(void) {
-    bool res =
-        sim_printf_and_check_response(1000, "+SAPBR: 1,1", "AT+SAPBR=2,1\r");
-    res = sim_printf_and_check_response(1000, "OK", "");
-    return res ? SIM_SUCCESS : SIM_ERROR;
+    static uint8_t state = 0;
+    sim_state_t    res = SIM_ERROR;
+
+    use_channel(SIM_CH_CTRL);
+
+    switch (state) {
+    // Already known to be open, a dropped bearer shows up as an HTTP error
+    case 0:
+        if (bearer_open) {
+            res = SIM_BUSY;
+            state = 'S';
+        } else {
+            res = write_command("+SAPBR", "2,1", 1000);
+        }
+        break;
+    // Bearer status stored in param_buf e.g. +SAPBR: 1,1,"10.1.2.3"
+    case 1:
+        res = check_param_response("+SAPBR", "1,1") ? SIM_SUCCESS : SIM_ERROR;
+        bearer_open = (res == SIM_SUCCESS);
+        break;
+    case 2:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
 }
 
 static sim_state_t reset_and_wait_ready(void) {
-    static uint8_t state = 0;
-    sim_state_t    res = SIM_ERROR;
+    static uint8_t  state = 0;
+    static uint32_t timer = 0;
+    sim_state_t     res = SIM_ERROR;
 
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
         reset();
+        timer = timers_millis();
         break;
+    // Hold in reset for 1 second
     case 1:
-        res = try_autobaud();
+        res = SIM_BUSY;
+
+        if ((timers_millis() - timer) > 1000) {
+            gpio_set(SIM_RESET_PORT, SIM_RESET);
+            res = SIM_SUCCESS;
+        }
         break;
     case 2:
-        res = disable_echo();
+        res = try_autobaud();
         break;
     case 3:
+        res = disable_echo();
+        break;
+    case 4:
         state = 'S';
         break;
     default:
@@ -1011,28 +1363,33 @@ static sim_state_t try_autobaud(void) {
     static uint8_t num_tries = 0;
 
     if (num_tries == 0) {
-        log_printf("SIM: AB\n");
+        SIM_LOG(LOG_DBG, "SIM: AB\n");
     }
 
-// Done with printf directly to avoid logging errors when no response
 #ifdef DEBUG
-    sim_state_t res = sim_printf_and_check_response(1000, "OK", "AT\r")
-                          ? SIM_SUCCESS
-                          : SIM_ERROR;
+    sim_state_t res = sim_printf_and_check_response(1000, "OK", "AT\r");
 #else
-    sim_state_t res = sim_printf_and_check_response(100, "OK", "AT\r")
-                          ? SIM_SUCCESS
-                          : SIM_ERROR;
+    sim_state_t res = sim_printf_and_check_response(100, "OK", "AT\r");
 #endif
 
-    if (res == SIM_ERROR) {
+    if (res == SIM_ERROR || res == SIM_TIMEOUT) {
         if (num_tries++ < 100) {
             res = SIM_BUSY;
+
+            // SIM800 may be at default or negotiated rate, keep switching
+            // until it answers e.g. after factory reset
+            if ((num_tries % AUTOBAUD_TRIES_PER_BAUD) == 0) {
+                usart_set_baud((sim_baud == SIM_USART_BAUD_FAST)
+                                   ? SIM_USART_BAUD
+                                   : SIM_USART_BAUD_FAST);
+            }
         } else {
-            log_printf("SIM: ERR AB\n");
+            SIM_LOG(LOG_ERR, "SIM: ERR AB\n");
+            res = SIM_ERROR;
             num_tries = 0;
         }
     } else if (res == SIM_SUCCESS) {
+        SIM_LOG(LOG_DBG, "SIM: AB %u\n", sim_baud);
         num_tries = 0;
     }
 
@@ -1053,6 +1410,9 @@ static sim_state_t config_saved_params(void) {
         res = set_function(FUNC_FULL);
         break;
     case 2:
+        res = set_baud_rate(SIM_USART_BAUD_FAST);
+        break;
+    case 3:
         state = 'S';
         break;
     default:
@@ -1074,81 +1434,200 @@ static sim_state_t config_saved_params(void) {
     return res;
 }
 
-static sim_state_t toggle_local_timestamp(bool on) {
-    return set_param("+CLTS", on ? "1" : "0", 1000);
-}
-
-static sim_state_t set_function(sim_function_t func) {
-    char buf[2] = {'1', '\0'};
-    buf[0] = func + '0';
-    return set_param("+CFUN", buf, 1000);
-}
-
-static sim_state_t config_bearer(char* apn_str, char* user_str, char* pwd_str) {
-    bool res = true;
-
-    if (strlen(apn_str)) {
-        res &= sim_printf_and_check_response(
-            100, "OK", "AT+SAPBR=3,1,\"APN\",\"%s\"\r", apn_str);
-    }
-
-    if (strlen(user_str)) {
-        res &= sim_printf_and_check_response(
-            100, "OK", "AT+SAPBR=3,1,\"USER\",\"%s\"\r", user_str);
-    }
-
-    if (strlen(pwd_str)) {
-        res &= sim_printf_and_check_response(
-            100, "OK", "AT+SAPBR=3,1,\"PWD\",\"%s\"\r", pwd_str);
-    }
-
-    if (res) {
-        return SIM_SUCCESS;
-    }
-
-    return SIM_ERROR;
-}
-
-static sim_state_t toggle_bearer(bool open) {
-    return write_command("+SAPBR", open ? "1,1" : "0,1", 120000);
-}
-
-/*////////////////////////////////////////////////////////////////////////////*/
-// Device information
-/*////////////////////////////////////////////////////////////////////////////*/
-
-void sim_print_capabilities(void) { sim_printf("at+gcap"); }
-
-/*////////////////////////////////////////////////////////////////////////////*/
-// HTTP
-/*////////////////////////////////////////////////////////////////////////////*/
-
-sim_state_t sim_http_init(const char* url_str, bool ssl) {
-    static uint8_t state = 0;
-    sim_state_t    res = SIM_ERROR;
+static sim_state_t set_baud_rate(uint32_t baud) {
+    static uint8_t  state = 0;
+    static uint32_t old_baud = 0;
+    static uint32_t timer = 0;
+    sim_state_t     res = SIM_ERROR;
 
     switch (state) {
+    // Autobauding (IPR 0) also answers at the fast rate, only skip once the
+    // fixed rate is set
     case 0:
+        res = read_command("+IPR", 1000);
+        break;
+    case 1:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: HTTP Init\n");
-
-        sim800.http.response_size = 0;
-        sim800.http.status_code = 0;
+        old_baud = sim_baud;
+        _sprintf("%u", baud);
 
-        break;
-    case 1:
-        res = sim_http_term();
+        if ((sim_baud == baud) && check_param_response("+IPR", _sprintf_buf)) {
+            state = 'S';
+        } else {
+            SIM_LOG(LOG_INFO, "SIM: Baud %u -> %u\n", sim_baud, baud);
+        }
         break;
     case 2:
-        if (sim800.http.state == HTTP_INIT) {
+        res = write_command("+IPR", _sprintf_buf, 1000);
+        break;
+    case 3:
+        res = SIM_SUCCESS;
+
+        timer = timers_millis();
+        break;
+    // Let OK finish sending before switching
+    case 4:
+        res = SIM_BUSY;
+
+        if ((timers_millis() - timer) > 10) {
+            usart_set_baud(baud);
             res = SIM_SUCCESS;
+        }
+        break;
+    case 5:
+        res = exec_command("", 1000);
+
+        // Not responding at new rate, go back to old one
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            SIM_LOG(LOG_ERR, "SIM: ERR Baud %u\n", baud);
+            usart_set_baud(old_baud);
+            res = SIM_BUSY;
+            state = 7;
+        }
+        break;
+    case 6:
+        // Save to SIM800 user profile
+        res = exec_command("&W", 1000);
+        if (res == SIM_SUCCESS) {
+            state = 'S';
+        }
+        break;
+    case 7:
+        // Make sure SIM800 still there at old rate, otherwise error & reset
+        res = exec_command("", 1000);
+        if (res == SIM_SUCCESS) {
+            state = 'S';
+        }
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+static sim_state_t toggle_local_timestamp(bool on) {
+    return set_param("+CLTS", on ? "1" : "0", 1000);
+}
+
+static sim_state_t set_function(sim_function_t func) {
+    char buf[2] = {'1', '\0'};
+    buf[0] = func + '0';
+    return set_param("+CFUN", buf, 1000);
+}
+
+static sim_state_t config_bearer(char* apn_str, char* user_str, char* pwd_str) {
+    static uint8_t state = 0;
+    static uint8_t idx = 0;
+    sim_state_t    res = SIM_ERROR;
+
+    const char* names[3] = {"APN", "USER", "PWD"};
+    const char* vals[3] = {apn_str, user_str, pwd_str};
+
+    switch (state) {
+    case 0:
+        res = SIM_SUCCESS;
+
+        idx = 0;
+        break;
+    // Format next non empty parameter
+    case 1:
+        res = SIM_BUSY;
+
+        if (idx >= 3) {
+            state = 'S';
+        } else if (strlen(vals[idx]) == 0) {
+            idx++;
         } else {
-            res = exec_command("+HTTPINIT", 1000);
+            _sprintf("3,1,\"%s\",\"%s\"", names[idx], vals[idx]);
+            res = SIM_SUCCESS;
+        }
+        break;
+    case 2:
+        res = write_command("+SAPBR", _sprintf_buf, 1000);
 
-            if (res == SIM_SUCCESS) {
-                sim800.http.state = HTTP_INIT;
-            }
+        if (res == SIM_SUCCESS) {
+            res = SIM_BUSY;
+            idx++;
+            state = 1;
+        }
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+static sim_state_t toggle_bearer(bool open) {
+    return write_command("+SAPBR", open ? "1,1" : "0,1", 120000);
+}
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Device information
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void sim_print_capabilities(void) { sim_printf("at+gcap"); }
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// HTTP
+/*////////////////////////////////////////////////////////////////////////////*/
+
+sim_state_t sim_http_init(const char* url_str, bool ssl) {
+    static uint8_t state = 0;
+    sim_state_t    res = SIM_ERROR;
+
+    use_channel(SIM_CH_DATA);
+
+    switch (state) {
+    case 0:
+        res = SIM_SUCCESS;
+
+        sim800.http.response_size = 0;
+        sim800.http.status_code = 0;
+
+        // Session still up, only update what has changed
+        if (http_session_up()) {
+            state = 6;
+        } else {
+            SIM_LOG(LOG_DBG, "SIM: HTTP Init\n");
+        }
+        break;
+    case 1:
+        res = sim_http_term();
+        break;
+    case 2:
+        res = exec_command("+HTTPINIT", 1000);
+
+        if (res == SIM_SUCCESS) {
+            http_url_hash = 0;
+            http_ssl = HTTP_SSL_UNKNOWN;
+            http_content_set = false;
         }
         break;
     case 3:
@@ -1158,21 +1637,34 @@ sim_state_t sim_http_init(const char* url_str, bool ssl) {
         res = write_command("+HTTPPARA", "\"REDIR\",\"1\"", 100);
         break;
     case 5:
-        if (sim_printf_and_check_response(
-                100, "OK", "AT+HTTPPARA=\"URL\",\"%s\"\r", url_str)) {
-            res = SIM_SUCCESS;
-        } else {
-            res = SIM_ERROR;
-        }
+        res = write_command("+SSLOPT", "0,1", 100);
         break;
     case 6:
-        res = http_toggle_ssl(ssl ? true : false);
+        res = write_command("+SSLOPT", "1,0", 100);
         break;
     case 7:
-        res = write_command("+SSLOPT", "0,1", 100);
+        if (http_url_hash == http_hash(url_str)) {
+            res = SIM_SUCCESS;
+        } else {
+            res = sim_printf_and_check_response(
+                1000, "OK", "AT+HTTPPARA=\"URL\",\"%s\"\r", url_str);
+
+            if (res == SIM_SUCCESS) {
+                http_url_hash = http_hash(url_str);
+                http_url_len = strlen(url_str);
+            }
+        }
         break;
     case 8:
-        res = write_command("+SSLOPT", "1,0", 100);
+        if (http_ssl == (ssl ? 1 : 0)) {
+            res = SIM_SUCCESS;
+        } else {
+            res = http_toggle_ssl(ssl ? true : false);
+
+            if (res == SIM_SUCCESS) {
+                http_ssl = ssl ? 1 : 0;
+            }
+        }
         break;
     case 9:
         state = 'S';
@@ -1189,6 +1681,7 @@ sim_state_t sim_http_init(const char* url_str, bool ssl) {
         state = 0;
     } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
         sim800.http.state = HTTP_ERROR;
+        bearer_open = false;
         state = 0;
     } else if (res == SIM_SUCCESS) {
         res = SIM_BUSY;
@@ -1199,11 +1692,15 @@ sim_state_t sim_http_init(const char* url_str, bool ssl) {
 }
 
 sim_state_t sim_http_term(void) {
-    sim_state_t res = SIM_ERROR;
-    sim_printf_and_check_response(1000, "OK", "AT+HTTPTERM\r");
+    use_channel(SIM_CH_DATA);
 
-    res = SIM_SUCCESS;
-    sim800.http.state = HTTP_TERM;
+    sim_state_t res = exec_command("+HTTPTERM", 1000);
+
+    // Error just means not initialized
+    if (res != SIM_BUSY) {
+        res = SIM_SUCCESS;
+        sim800.http.state = HTTP_TERM;
+    }
 
     return res;
 }
@@ -1214,11 +1711,13 @@ sim_state_t sim_http_get(const char* url_str, bool ssl, uint8_t num_tries) {
 
     static uint8_t tries = 0;
 
+    use_channel(SIM_CH_DATA);
+
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: HTTP Get\n");
+        SIM_LOG(LOG_DBG, "SIM: HTTP Get\n");
 
         tries = 0;
 
@@ -1259,6 +1758,7 @@ sim_state_t sim_http_get(const char* url_str, bool ssl, uint8_t num_tries) {
         state = 0;
     } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
         sim800.http.state = HTTP_ERROR;
+        bearer_open = false;
         state = 0;
     } else if (res == SIM_SUCCESS) {
         res = SIM_BUSY;
@@ -1275,15 +1775,20 @@ sim_state_t sim_http_post_str(const char* url_str, const char* msg_str,
 
     static uint8_t  tries = 0;
     static uint32_t size = 0;
+    static uint32_t sent = 0;
+    static uint32_t timer = 0;
+
+    use_channel(SIM_CH_DATA);
 
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: HTTP Post Str\n");
+        SIM_LOG(LOG_DBG, "SIM: HTTP Post Str\n");
 
         tries = 0;
         size = strlen(msg_str);
+        num_cmds = 0;
 
         break;
     case 1:
@@ -1299,13 +1804,24 @@ sim_state_t sim_http_post_str(const char* url_str, const char* msg_str,
         break;
     case 3:
         res = sim_http_post_enter_data(size, 2000);
+
+        sent = 0;
+        timer = timers_millis();
         break;
+    // Send message as TX buffer empties
     case 4:
-        res = SIM_SUCCESS;
-        sim_printf("%s\r\n", msg_str);
+        res = send_data(msg_str, size, &sent) ? SIM_SUCCESS : SIM_BUSY;
         break;
     case 5:
         res = wait_command("OK", 2000);
+
+        if (res == SIM_SUCCESS) {
+            timer = timers_millis() - timer;
+            SIM_LOG(LOG_DBG, "SIM: TX %u B %u ms %u B/s @%u\n", size, timer,
+                    (size * 1000) / (timer ? timer : 1), sim_baud);
+
+            http_tx_size = size;
+        }
         break;
     case 6:
         res = sim_http_post();
@@ -1319,6 +1835,7 @@ sim_state_t sim_http_post_str(const char* url_str, const char* msg_str,
         }
         break;
     case 8:
+        SIM_LOG(LOG_DBG, "SIM: Post %u cmds\n", num_cmds);
         state = 'S';
         break;
     default:
@@ -1329,9 +1846,11 @@ sim_state_t sim_http_post_str(const char* url_str, const char* msg_str,
     // Stop or go to next state
     if (state == 'S') {
         res = SIM_SUCCESS;
+        sim800.http.state = HTTP_DONE;
         state = 0;
     } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
         sim800.http.state = HTTP_ERROR;
+        bearer_open = false;
         state = 0;
     } else if (res == SIM_SUCCESS) {
         res = SIM_BUSY;
@@ -1345,20 +1864,26 @@ sim_state_t sim_http_post_init(const char* url_str, bool ssl) {
     static uint8_t state = 0;
     sim_state_t    res = SIM_ERROR;
 
+    use_channel(SIM_CH_DATA);
+
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        log_printf("SIM: HTTP Post Init\n");
-
         break;
     case 1:
         res = sim_http_init(url_str, ssl);
         break;
     case 2:
-        res = write_command("+HTTPPARA",
-                            "\"CONTENT\",\"application/x-www-form-urlencoded\"",
-                            1000);
+        if (http_content_set) {
+            res = SIM_SUCCESS;
+        } else {
+            res = write_command(
+                "+HTTPPARA",
+                "\"CONTENT\",\"application/x-www-form-urlencoded\"", 1000);
+
+            http_content_set = (res == SIM_SUCCESS);
+        }
         break;
     case 3:
         state = 'S';
@@ -1374,6 +1899,7 @@ sim_state_t sim_http_post_init(const char* url_str, bool ssl) {
         state = 0;
     } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
         sim800.http.state = HTTP_ERROR;
+        bearer_open = false;
         state = 0;
     } else if (res == SIM_SUCCESS) {
         res = SIM_BUSY;
@@ -1384,87 +1910,68 @@ sim_state_t sim_http_post_init(const char* url_str, bool ssl) {
 }
 
 sim_state_t sim_http_post_enter_data(uint32_t size, uint32_t time) {
-    sim_state_t res = sim_printf_and_check_response(
-                          100, "DOWNLOAD", "AT+HTTPDATA=%u,%u\r", size, time)
-                          ? SIM_SUCCESS
-                          : SIM_ERROR;
-    return res;
-}
-
-sim_state_t sim_http_post(void) { return http_action(1); }
-
-uint32_t sim_http_read_response(uint32_t address, uint32_t buf_size,
-                                uint8_t* buf) {
-    uint32_t num_ret = 0;
-    uint8_t  i = 0;
-
-    clear_rx_buf();
-
-    // Request data
-    if (!sim_printf_and_check_response(2000, "+HTTPREAD", "AT+HTTPREAD=%u,%u\r",
-                                       address, buf_size)) {
-        log_error(ERR_SIM_HTTP_READ_TIMEOUT);
-    } else {
-        // Get actual number of bytes returned
-        char* ptr = &reply_buf[11];
-
-        if (_is_digit(*ptr)) {
-            num_ret = _atoi((const char**)&ptr);
-        }
+    use_channel(SIM_CH_DATA);
 
-        // Only read up to buf_size
-        for (i = 0; i < num_ret; i++) {
-            while (!sim_available()) {
-            }
-            buf[i] = (uint8_t)sim_read();
-        }
+    return sim_printf_and_check_response(1000, "DOWNLOAD",
+                                         "AT+HTTPDATA=%u,%u\r", size, time);
+}
 
-        // Wait for final ok reply
-        sim_printf_and_check_response(1000, "OK", "");
-    }
+sim_state_t sim_http_post(void) {
+    use_channel(SIM_CH_DATA);
 
-    return num_ret;
+    return http_action(1);
 }
 
-static sim_state_t http_toggle_ssl(bool on) {
-    return set_param("+HTTPSSL", on ? "1" : "0", 100);
-}
+sim_state_t sim_http_read_response(uint32_t address, uint32_t buf_size,
+                                   uint8_t* buf, uint32_t* num_bytes) {
+    static uint8_t  state = 0;
+    static uint32_t num_ret = 0;
+    static uint32_t idx = 0;
+    static uint32_t timer = 0;
+    sim_state_t     res = SIM_ERROR;
 
-static sim_state_t http_action(uint8_t action) {
-    static uint8_t state = 0;
-    sim_state_t    res = SIM_ERROR;
+    use_channel(SIM_CH_DATA);
 
     switch (state) {
     case 0:
         res = SIM_SUCCESS;
 
-        sim800.http.state = HTTP_ACTION;
+        num_ret = 0;
+        idx = 0;
+        sim_http_read_request(address, buf_size);
         break;
     case 1:
-        res = write_command("+HTTPACTION", (action == 1) ? "1" : "0", 1000);
+        res = sim_http_read_wait(2000, &num_ret);
+
+        // Only read up to buf_size
+        if (num_ret > buf_size) {
+            num_ret = buf_size;
+        }
+
+        timer = timers_millis();
         break;
+    // SIM800 now returns that number of bytes
     case 2:
-        res = wait_command("+HTTPACTION", 120000);
-        break;
-    case 3:
-        res = SIM_SUCCESS;
-
-        char* ptr;
+        res = SIM_BUSY;
 
-        // Status code
-        ptr = &param_buf[15];
-        if (_is_digit(*ptr)) {
-            sim800.http.status_code = _atoi((const char**)&ptr);
+        while (sim_available() && (idx < num_ret)) {
+            buf[idx++] = (uint8_t)sim_read();
+            timer = timers_millis();
         }
 
-        // Response length
-        ptr = &param_buf[19];
-        if (_is_digit(*ptr)) {
-            sim800.http.response_size = _atoi((const char**)&ptr);
+        if (idx >= num_ret) {
+            res = SIM_SUCCESS;
+        } else if ((timers_millis() - timer) > 1000) {
+            log_error(ERR_SIM_HTTP_READ_TIMEOUT);
+            res = SIM_TIMEOUT;
         }
-
+        break;
+    // Wait for final ok reply, already received if no data
+    case 3:
+        res = num_ret ? sim_http_read_done() : SIM_SUCCESS;
         break;
     case 4:
+        *num_bytes = num_ret;
         state = 'S';
         break;
     default:
@@ -1477,6 +1984,7 @@ static sim_state_t http_action(uint8_t action) {
         res = SIM_SUCCESS;
         state = 0;
     } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        *num_bytes = 0;
         state = 0;
     } else if (res == SIM_SUCCESS) {
         res = SIM_BUSY;
@@ -1486,70 +1994,270 @@ static sim_state_t http_action(uint8_t action) {
     return res;
 }
 
-/*////////////////////////////////////////////////////////////////////////////*/
-// TCP
-/*////////////////////////////////////////////////////////////////////////////*/
+void sim_http_read_request(uint32_t address, uint32_t size) {
+    use_channel(SIM_CH_DATA);
+    clear_rx_buf();
+    param_buf[0] = '\0';
+    sim_printf("AT+HTTPREAD=%u,%u\r", address, size);
+}
 
-bool sim_tcp_init(const char* url_str, uint16_t port, bool ssl) {
-    if (!sim_printf_and_check_response(
-            1000, "OK", "AT+CSTT=\"data.rewicom.net\",\"\",\"\"\r")) {
-        log_error(ERR_SIM_SAPBR_CONFIG);
-    } else if (!sim_printf_and_check_response(5000, "OK", "AT+CIICR\r")) {
-        log_error(ERR_SIM_SAPBR_CONFIG);
-    } else if (!sim_printf_and_check_response(1000, "10", "AT+CIFSR\r")) {
-        log_error(ERR_SIM_SAPBR_CONFIG);
-    } else if (!sim_printf_and_check_response(1000, "OK", "AT+CIPSSL=%u\r",
-                                              (ssl ? 1 : 0))) {
-        log_error(ERR_SIM_HTTPINIT);
-    } else if (!sim_printf_and_check_response(10000, "CONNECT OK",
-                                              "AT+CIPSTART=\"TCP\",\"%s\",%u\r",
-                                              url_str, port)) {
-        log_error(ERR_SIM_HTTPPARA_CID);
-    } else {
-        // sim_serial_pass_through();
-        sim_printf("AT+CIPSEND\r\n");
-        timers_delay_milliseconds(500);
-        return true;
-    }
+sim_state_t sim_http_read_wait(uint32_t timeout_ms, uint32_t* num_bytes) {
+    use_channel(SIM_CH_DATA);
 
-    return false;
-}
+    // E.g. +HTTPREAD: 64, only OK if no data
+    sim_state_t res = wait_command("+HTTPREAD", timeout_ms);
 
-/*////////////////////////////////////////////////////////////////////////////*/
-// SMS
-/*////////////////////////////////////////////////////////////////////////////*/
+    if (res == SIM_SUCCESS) {
+        *num_bytes = 0;
 
-bool sim_send_sms(const char* phone_number, const char* msg_str) {
-    (void)phone_number;
-    (void)msg_str;
-    bool result = false;
+        // Get actual number of bytes returned
+        char* ptr = &param_buf[11];
 
-    // Set text mode
-    if (!sim_printf_and_check_response(1000, "OK", "AT+CMGF=1\r")) {
-    } else if (!sim_printf_and_check_response(1000, "OK",
-                                              "AT+CSCS=\"GSM\"\r")) {
-    }
-    // else if (!sim_printf_and_check_response(1000, ">",
-    // "AT+CMGS=\"%s\"\r%s%c\r", phone_number, str, 0x1A))
-    // {
-    // }
-    // else if (!sim_printf_and_check_response(1000, "OK",
-    // "AT+CMGS=\"%s\"\r%s%c\r", phone_number, str, 0x1A))
-    // {
-    // }
-    else {
-        sim_serial_pass_through();
-        result = true;
+        if ((strstr(param_buf, "+HTTPREAD") != NULL) && _is_digit(*ptr)) {
+            *num_bytes = _atoi((const char**)&ptr);
+        }
+    } else if (res != SIM_BUSY) {
+        log_error(ERR_SIM_HTTP_READ_TIMEOUT);
+        *num_bytes = 0;
     }
 
-    return result;
+    return res;
 }
 
-/** @} */
+sim_state_t sim_http_read_done(void) {
+    use_channel(SIM_CH_DATA);
 
-/** @addtogroup SIM_INT
- * @{
- */
+    return wait_command("OK", 1000);
+}
+
+static sim_state_t http_toggle_ssl(bool on) {
+    return set_param("+HTTPSSL", on ? "1" : "0", 100);
+}
+
+static bool http_session_up(void) {
+    return ((sim800.http.state != HTTP_TERM) &&
+            (sim800.http.state != HTTP_ERROR));
+}
+
+// djb2, only needs to tell URLs apart
+static uint32_t http_hash(const char* str) {
+    uint32_t hash = 5381;
+
+    while (*str) {
+        hash = (hash * 33) + (uint8_t)*str++;
+    }
+
+    return hash;
+}
+
+static sim_state_t http_action(uint8_t action) {
+    static uint8_t  state = 0;
+    sim_state_t     res = SIM_ERROR;
+    static uint32_t tx_size = 0;
+
+    switch (state) {
+    case 0:
+        res = SIM_SUCCESS;
+
+        sim800.http.state = HTTP_ACTION;
+        break;
+    case 1:
+        res = write_command("+HTTPACTION", (action == 1) ? "1" : "0", 1000);
+        break;
+    case 2:
+        res = wait_command("+HTTPACTION", 120000);
+
+        // Body goes on air now, count even if no reply
+        if (res != SIM_BUSY) {
+            tx_size = (action == 1) ? http_tx_size : 0;
+            sim800.data.tx += tx_size;
+            sim800.data.overhead += HTTP_OVERHEAD_BYTES + http_url_len;
+        }
+        break;
+    case 3:
+        res = SIM_SUCCESS;
+
+        char* ptr;
+
+        // Status code
+        ptr = &param_buf[15];
+        if (_is_digit(*ptr)) {
+            sim800.http.status_code = _atoi((const char**)&ptr);
+        }
+
+        // Response length
+        ptr = &param_buf[19];
+        if (_is_digit(*ptr)) {
+            sim800.http.response_size = _atoi((const char**)&ptr);
+        }
+
+        sim800.data.rx += sim800.http.response_size;
+        sim800.data.overhead +=
+            TCP_SEGMENT_OVERHEAD *
+            ((tx_size + sim800.http.response_size) / TCP_SEGMENT_SIZE);
+
+        break;
+    case 4:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// TCP
+/*////////////////////////////////////////////////////////////////////////////*/
+
+sim_state_t sim_tcp_init(const char* url_str, uint16_t port, bool ssl) {
+    static uint8_t state = 0;
+    sim_state_t    res = SIM_ERROR;
+
+    use_channel(SIM_CH_DATA);
+
+    switch (state) {
+    case 0:
+        res = sim_printf_and_check_response(
+            1000, "OK", "AT+CSTT=\"data.rewicom.net\",\"\",\"\"\r");
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            log_error(ERR_SIM_SAPBR_CONFIG);
+        }
+        break;
+    case 1:
+        res = sim_printf_and_check_response(5000, "OK", "AT+CIICR\r");
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            log_error(ERR_SIM_SAPBR_CONFIG);
+        }
+        break;
+    // Returns local IP address only
+    case 2:
+        res = sim_printf_and_check_response(1000, "10", "AT+CIFSR\r");
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            log_error(ERR_SIM_SAPBR_CONFIG);
+        }
+        break;
+    case 3:
+        res = sim_printf_and_check_response(1000, "OK", "AT+CIPSSL=%u\r",
+                                            (ssl ? 1 : 0));
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            log_error(ERR_SIM_HTTPINIT);
+        }
+        break;
+    case 4:
+        res = sim_printf_and_check_response(10000, "CONNECT OK",
+                                            "AT+CIPSTART=\"TCP\",\"%s\",%u\r",
+                                            url_str, port);
+        if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+            log_error(ERR_SIM_HTTPPARA_CID);
+        }
+        break;
+    // Ready for data once prompt received
+    case 5:
+        res = sim_printf_and_check_response(1000, ">", "AT+CIPSEND\r");
+        break;
+    case 6:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// SMS
+/*////////////////////////////////////////////////////////////////////////////*/
+
+sim_state_t sim_send_sms(const char* phone_number, const char* msg_str) {
+    static uint8_t  state = 0;
+    static uint32_t sent = 0;
+    sim_state_t     res = SIM_ERROR;
+
+    use_channel(SIM_CH_CTRL);
+
+    switch (state) {
+    // Set text mode
+    case 0:
+        res = write_command("+CMGF", "1", 1000);
+        break;
+    case 1:
+        res = write_command("+CSCS", "\"GSM\"", 1000);
+        break;
+    // Wait for prompt before entering message
+    case 2:
+        res = sim_printf_and_check_response(5000, ">", "AT+CMGS=\"%s\"\r",
+                                            phone_number);
+        sent = 0;
+        break;
+    case 3:
+        res = send_data(msg_str, strlen(msg_str), &sent) ? SIM_SUCCESS
+                                                         : SIM_BUSY;
+        break;
+    // Ctrl-Z to send
+    case 4:
+        res = SIM_SUCCESS;
+
+        sim_printf("%c", 0x1A);
+        break;
+    // Network can take a while to accept message
+    case 5:
+        res = wait_command("+CMGS", 60000);
+        break;
+    case 6:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        SIM_LOG(LOG_ERR, "SIM: ERR SMS %u\n", state);
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+/** @} */
+
+/** @addtogroup SIM_INT
+ * @{
+ */
 
 /*////////////////////////////////////////////////////////////////////////////*/
 // Static Function Definitions
@@ -1561,12 +2269,12 @@ static void reset(void) {
 
     // Reset SIM800
     gpio_clear(SIM_RESET_PORT, SIM_RESET);
-    timers_delay_milliseconds(1000);
-    gpio_set(SIM_RESET_PORT, SIM_RESET);
 
     sim800.func = FUNC_RESET;
     sim800.reg_status = REG_NONE;
     sim800.http.state = HTTP_TERM;
+    sim800.cmux = false;
+    bearer_open = false;
 }
 
 static void mcu_setup(void) {
@@ -1582,19 +2290,19 @@ static void mcu_setup(void) {
     gpio_set(SIM_RESET_PORT, SIM_RESET);
 
     usart_setup();
+    dma_setup();
 
-    // Enable interrupts for RX/TX
-    usart_enable_rx_interrupt(SIM_USART);
+    // Enable interrupt for TX, RX is handled by DMA
     // usart_enable_tx_interrupt(SIM_USART);
     nvic_enable_irq(SIM_USART_NVIC);
     nvic_set_priority(SIM_USART_NVIC, IRQ_PRIORITY_SIM);
 
     // Init RX, TX & Reply Buffers
-    sim_rx_head = sim_rx_tail = sim_tx_head = sim_tx_tail = 0;
+    sim_rx_tail = rx_head();
+    sim_tx_head = sim_tx_tail = 0;
+    cmux_tx_len = 0;
     memset(reply_buf, 0, sizeof(reply_buf));
 
-    timers_delay_milliseconds(10);
-
     _sprintf_clear_buf();
 }
 
@@ -1614,7 +2322,8 @@ static void usart_setup(void) {
 
     rcc_periph_reset_pulse(SIM_USART_RCC_RST);
     usart_disable(SIM_USART);
-    usart_set_baudrate(SIM_USART, SIM_USART_BAUD);
+    usart_set_baudrate(SIM_USART, sim_baud);
+    sim800.baud = sim_baud;
     usart_set_databits(SIM_USART, 8);
     usart_set_stopbits(SIM_USART, USART_STOPBITS_1);
     usart_set_mode(SIM_USART, USART_MODE_TX_RX);
@@ -1628,16 +2337,69 @@ static void usart_setup(void) {
     USART_ICR(SPF_USART) |= USART_ICR_RTOCF;
     usart_enable_rx_timeout(SIM_USART);
 
-    usart_enable_rx_interrupt(SIM_USART);
-
     nvic_clear_pending_irq(SIM_USART_NVIC);
     nvic_set_priority(SIM_USART_NVIC, IRQ_PRIORITY_SIM);
     nvic_enable_irq(SIM_USART_NVIC);
 }
 
-static void clear_rx_buf(void) { sim_rx_tail = sim_rx_head; }
+static void usart_set_baud(uint32_t baud) {
+    sim_baud = baud;
+    sim800.baud = baud;
 
-static void _putchar(char character) {
+    // BRR can only be written while USART disabled
+    usart_disable(SIM_USART);
+    usart_set_baudrate(SIM_USART, baud);
+    usart_enable(SIM_USART);
+
+    clear_rx_buf();
+}
+
+static void dma_setup(void) {
+    rcc_periph_clock_enable(RCC_DMA);
+
+    dma_channel_reset(DMA1, SIM_USART_DMA_RX_CHANNEL);
+    dma_set_channel_request(DMA1, SIM_USART_DMA_RX_CHANNEL,
+                            SIM_USART_DMA_RX_REQ);
+
+    dma_enable_circular_mode(DMA1, SIM_USART_DMA_RX_CHANNEL);
+    dma_set_read_from_peripheral(DMA1, SIM_USART_DMA_RX_CHANNEL);
+    dma_set_number_of_data(DMA1, SIM_USART_DMA_RX_CHANNEL, SIM_RX_BUFFER_SIZE);
+    dma_set_priority(DMA1, SIM_USART_DMA_RX_CHANNEL, DMA_CCR_PL_HIGH);
+
+    dma_set_peripheral_address(DMA1, SIM_USART_DMA_RX_CHANNEL,
+                               (uint32_t)&USART_RDR(SIM_USART));
+    dma_set_peripheral_size(DMA1, SIM_USART_DMA_RX_CHANNEL,
+                            DMA_CCR_PSIZE_8BIT);
+    dma_disable_peripheral_increment_mode(DMA1, SIM_USART_DMA_RX_CHANNEL);
+
+    dma_set_memory_address(DMA1, SIM_USART_DMA_RX_CHANNEL,
+                           (uint32_t)sim_rx_buf);
+    dma_set_memory_size(DMA1, SIM_USART_DMA_RX_CHANNEL, DMA_CCR_MSIZE_8BIT);
+    dma_enable_memory_increment_mode(DMA1, SIM_USART_DMA_RX_CHANNEL);
+
+    // Reset clears the wrap flag & counter
+    sim_rx_laps = 0;
+    sim_rx_tail = 0;
+
+    // Vector shared with SPF TX
+    dma_enable_transfer_complete_interrupt(DMA1, SIM_USART_DMA_RX_CHANNEL);
+    nvic_set_priority(SIM_DMA_NVIC, IRQ_PRIORITY_SIM);
+    nvic_enable_irq(SIM_DMA_NVIC);
+
+    dma_enable_channel(DMA1, SIM_USART_DMA_RX_CHANNEL);
+    usart_enable_rx_dma(SIM_USART);
+}
+
+static void clear_rx_buf(void) {
+    if (sim800.cmux) {
+        cmux_poll();
+        chans[chan].rx_tail = chans[chan].rx_head;
+    } else {
+        sim_rx_tail = rx_head();
+    }
+}
+
+static void usart_putchar(char character) {
     bool done = false;
 
     if ((sim_tx_head == sim_tx_tail) &&
@@ -1675,8 +2437,23 @@ static void _putchar(char character) {
 #endif
 }
 
+static void _putchar(char character) {
+    if (!sim800.cmux) {
+        usart_putchar(character);
+        return;
+    }
+
+    cmux_tx_buf[cmux_tx_len++] = (uint8_t)character;
+    if (cmux_tx_len >= CMUX_TX_SIZE) {
+        tx_flush();
+    }
+}
+
 static void _putchar_buffer(char character) {
-    _sprintf_buf[_sprintf_buf_idx++] = character;
+    // Leave room for null terminator
+    if (_sprintf_buf_idx < (SIM_SPRINTF_BUFFER_SIZE - 1)) {
+        _sprintf_buf[_sprintf_buf_idx++] = character;
+    }
 }
 
 static void print_timestamp(void) {
@@ -1687,6 +2464,295 @@ static void print_timestamp(void) {
     serial_printf("\n");
 }
 
+/*////////////////////////////////////////////////////////////////////////////*/
+// CMUX
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static sim_state_t cmux_start(void) {
+    static uint8_t state = 0;
+    static uint8_t dlci = 0;
+    sim_state_t    res = SIM_ERROR;
+
+    switch (state) {
+    // Basic option, SIM800 defaults for the rest e.g. N1 127
+    case 0:
+        res = write_command("+CMUX", "0", 1000);
+        break;
+    case 1:
+        res = SIM_SUCCESS;
+
+        sim800.cmux = true;
+        cmux_decoder_reset(&cmux_dec);
+        cmux_ua = 0;
+        cmux_tx_len = 0;
+        for (uint8_t i = 0; i < SIM_NUM_CH; i++) {
+            chans[i].rx_head = chans[i].rx_tail = 0;
+        }
+        dlci = 0;
+        break;
+    // Open control DLCI 0 then one DLCI per channel
+    case 2:
+        res = SIM_SUCCESS;
+
+        cmux_send(dlci, CMUX_SABM, NULL, 0);
+        timeout_init(CMUX_UA_TIMEOUT_MS);
+        break;
+    case 3:
+        res = SIM_BUSY;
+
+        cmux_poll();
+
+        if (cmux_ua & (1 << dlci)) {
+            res = SIM_SUCCESS;
+
+            if (++dlci <= SIM_NUM_CH) {
+                state = 1;
+            }
+        } else if (timeout()) {
+            res = SIM_TIMEOUT;
+            SIM_LOG(LOG_ERR, "SIM ERR: CMUX DLCI %u\n", dlci);
+        }
+        break;
+    case 4:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+        SIM_LOG(LOG_INFO, "SIM: CMUX up\n");
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+        sim800.cmux = false;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+static sim_state_t cmux_stop(void) {
+    static uint8_t  state = 0;
+    static uint32_t timer = 0;
+    sim_state_t     res = SIM_ERROR;
+
+    // Close down, length 0
+    static const uint8_t cld[] = {CMUX_MSG_CLD, 0x01};
+
+    switch (state) {
+    case 0:
+        res = SIM_SUCCESS;
+
+        if (!sim800.cmux) {
+            state = 'S';
+        } else {
+            cmux_send(0, CMUX_UIH, cld, sizeof(cld));
+            timer = timers_millis();
+        }
+        break;
+    // Reply not needed, give it time to go back to AT commands
+    case 1:
+        res = SIM_BUSY;
+
+        if ((timers_millis() - timer) > CMUX_CLOSE_MS) {
+            res = SIM_SUCCESS;
+        }
+        break;
+    case 2:
+        res = SIM_SUCCESS;
+
+        sim800.cmux = false;
+        chan = SIM_CH_CTRL;
+        clear_rx_buf();
+        break;
+    case 3:
+        state = 'S';
+        break;
+    default:
+        res = SIM_ERROR;
+        break;
+    }
+
+    // Stop or go to next state
+    if (state == 'S') {
+        res = SIM_SUCCESS;
+        state = 0;
+    } else if (res == SIM_ERROR || res == SIM_TIMEOUT) {
+        state = 0;
+    } else if (res == SIM_SUCCESS) {
+        res = SIM_BUSY;
+        state++;
+    }
+
+    return res;
+}
+
+static void cmux_poll(void) {
+    // Stop while the channel being read is full, DMA keeps receiving
+    while (rx_unread() && (chan_free(chan) >= CMUX_N1)) {
+        uint8_t byte = (uint8_t)sim_rx_buf[sim_rx_tail % SIM_RX_BUFFER_SIZE];
+        sim_rx_tail++;
+
+        if (!cmux_decode(&cmux_dec, byte)) {
+            continue;
+        }
+
+        cmux_frame_t* frame = &cmux_dec.frame;
+
+        switch (CMUX_CONTROL(frame->control)) {
+        case CMUX_CONTROL(CMUX_UA):
+            if (frame->dlci <= SIM_NUM_CH) {
+                cmux_ua |= (uint8_t)(1 << frame->dlci);
+            }
+            break;
+        case CMUX_CONTROL(CMUX_DM):
+            if (frame->dlci <= SIM_NUM_CH) {
+                cmux_ua &= (uint8_t)~(1 << frame->dlci);
+            }
+            break;
+        case CMUX_CONTROL(CMUX_UIH):
+            if ((frame->dlci > 0) && (frame->dlci <= SIM_NUM_CH)) {
+                chan_t* ch = &chans[frame->dlci - 1];
+
+                // Only a channel not being read can fill, drop the rest
+                for (uint8_t i = 0; i < frame->len; i++) {
+                    uint16_t next = (ch->rx_head + 1) % SIM_CH_BUFFER_SIZE;
+
+                    if (next == ch->rx_tail) {
+                        SIM_LOG(LOG_WARN, "SIM: CMUX DLCI %u full %u B\n",
+                                frame->dlci, frame->len - i);
+                        sim800.rx_dropped += frame->len - i;
+                        break;
+                    }
+
+                    ch->rx_buf[ch->rx_head] = (char)frame->info[i];
+                    ch->rx_head = next;
+                }
+            }
+            // Control channel command e.g. modem status, acknowledge by
+            // sending it back as a response
+            else if ((frame->dlci == 0) && frame->len &&
+                     (frame->info[0] & CMUX_CR)) {
+                frame->info[0] &= (uint8_t)~CMUX_CR;
+                cmux_send(0, CMUX_UIH, frame->info, frame->len);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void cmux_send(uint8_t dlci, uint8_t control, const uint8_t* info,
+                      uint8_t len) {
+    if (len > CMUX_TX_SIZE) {
+        len = CMUX_TX_SIZE;
+    }
+
+    uint16_t size = cmux_encode(dlci, control, info, len, cmux_frame_buf);
+
+    for (uint16_t i = 0; i < size; i++) {
+        usart_putchar((char)cmux_frame_buf[i]);
+    }
+}
+
+static void use_channel(sim_channel_t ch) {
+    chan = sim800.cmux ? ch : SIM_CH_CTRL;
+}
+
+static uint16_t chan_free(sim_channel_t ch) {
+    return (chans[ch].rx_tail + SIM_CH_BUFFER_SIZE - chans[ch].rx_head - 1) %
+           SIM_CH_BUFFER_SIZE;
+}
+
+// Run by SIM_DMA_ISR() on each wrap & by rx_head() in case it is held off
+static void rx_count_lap(void) {
+    if (dma_get_interrupt_flag(DMA1, SIM_USART_DMA_RX_CHANNEL, DMA_TCIF)) {
+        dma_clear_interrupt_flags(DMA1, SIM_USART_DMA_RX_CHANNEL, DMA_TCIF);
+        sim_rx_laps++;
+    }
+}
+
+static uint32_t rx_head(void) {
+    cm_disable_interrupts();
+
+    // Wrap not seen by the interrupt yet, e.g. it is pending or the vector is
+    // disabled. Flag read after the counter so a wrap in between is counted
+    uint16_t pos = sim_rx_pos;
+    uint32_t laps = sim_rx_laps;
+
+    rx_count_lap();
+
+    if (laps != sim_rx_laps) {
+        pos = sim_rx_pos;
+    }
+
+    uint32_t head = (sim_rx_laps * SIM_RX_BUFFER_SIZE) + pos;
+
+    cm_enable_interrupts();
+
+    return head;
+}
+
+static uint32_t rx_unread(void) {
+    uint32_t head = rx_head();
+    uint32_t unread = head - sim_rx_tail;
+
+    // DMA has lapped the tail, unread bytes overwritten. Drop all of them,
+    // the caller sees a short or bad response rather than mixed data
+    if (unread > SIM_RX_BUFFER_SIZE) {
+        SIM_LOG(LOG_WARN, "SIM: RX overrun %u B\n", unread);
+        sim800.rx_dropped += unread;
+        sim_rx_tail = head;
+        unread = 0;
+    }
+
+    return unread;
+}
+
+static bool rx_pending(void) {
+    if (!sim800.cmux) {
+        return (rx_unread() != 0);
+    }
+
+    cmux_poll();
+
+    return (chans[chan].rx_head != chans[chan].rx_tail);
+}
+
+// Check rx_pending() first
+static char rx_get(void) {
+    char c;
+
+    if (sim800.cmux) {
+        c = chans[chan].rx_buf[chans[chan].rx_tail];
+        chans[chan].rx_tail = (chans[chan].rx_tail + 1) % SIM_CH_BUFFER_SIZE;
+    } else {
+        c = sim_rx_buf[sim_rx_tail % SIM_RX_BUFFER_SIZE];
+        sim_rx_tail++;
+    }
+
+    return c;
+}
+
+static uint8_t tx_free(void) {
+    return (uint8_t)((sim_tx_tail + SIM_BUFFER_SIZE - sim_tx_head - 1) %
+                     SIM_BUFFER_SIZE);
+}
+
+static void tx_flush(void) {
+    if (cmux_tx_len) {
+        cmux_send(CMUX_DLCI(chan), CMUX_UIH, cmux_tx_buf, cmux_tx_len);
+        cmux_tx_len = 0;
+    }
+}
+
 /** @} */
 
 /** @addtogroup SIM_API
@@ -1700,18 +2766,7 @@ static void print_timestamp(void) {
 SIM_ISR() {
     // serial_printf("Sim ISR: %8x\n", USART2_ISR);
 
-    // Received data from sim
-    // Read data (clears flag automatically)
-    if (usart_get_flag(SIM_USART, USART_ISR_RXNE)) {
-        char c = usart_recv(SIM_USART);
-        if (((sim_rx_head + 1) % SIM_BUFFER_SIZE) == sim_rx_tail) {
-            // Read overflow
-            sim_rx_overflow = true;
-        } else {
-            sim_rx_buf[sim_rx_head] = c;
-            sim_rx_head = (sim_rx_head + 1) % SIM_BUFFER_SIZE;
-        }
-    }
+    // Received data from sim is moved into sim_rx_buf by DMA
 
     // Transmit buffer empty
     // Fill it (clears flag automatically)
@@ -1729,5 +2784,19 @@ SIM_ISR() {
     }
 }
 
+#ifdef DEBUG
+// In common/log.c
+SPF_DMA_ISR();
+#endif
+
+// Shared by DMA1 channels 4 to 7
+SIM_DMA_ISR() {
+    rx_count_lap();
+
+#ifdef DEBUG
+    spf_dma_isr();
+#endif
+}
+
 /** @} */
 /** @} */
@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ * @file    host.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Host Test Harness Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// MAP_32BIT & mallopt()
+#define _GNU_SOURCE
+
+#include "host.h"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include <libopencm3/stm32/memorymap.h>
+
+#include "common/log.h"
+
+/** @addtogroup HOST_FILE
+ * @{
+ */
+
+/** @addtogroup HOST_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#define STACK_SIZE  (1024U * 1024U)
+#define PERIPH_SIZE 0x30000U
+
+static int failures;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void* run(void* arg);
+
+/** @} */
+
+/** @addtogroup HOST_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+int main(void) {
+    pthread_attr_t attr;
+    pthread_t      thread;
+
+    // Other threads get their own heap arena, mapped anywhere
+    mallopt(M_ARENA_MAX, 1);
+
+    void* regs = mmap((void*)PERIPH_BASE, PERIPH_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* stack = mmap(NULL, STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_32BIT | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if ((regs == MAP_FAILED) || (stack == MAP_FAILED) ||
+        ((uintptr_t)&failures > UINT32_MAX)) {
+        fprintf(stderr, "host: can't place memory below 4 GB\n");
+        return 1;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, STACK_SIZE);
+
+    if (pthread_create(&thread, &attr, run, NULL)) {
+        fprintf(stderr, "host: can't start test thread\n");
+        return 1;
+    }
+
+    pthread_join(thread, NULL);
+
+    return failures ? 1 : 0;
+}
+
+void log_printf(const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    vprintf(format, va);
+    va_end(va);
+}
+
+void log_lprintf(uint32_t level, const char* format, ...) {
+    va_list va;
+    (void)level;
+    va_start(va, format);
+    vprintf(format, va);
+    va_end(va);
+}
+
+void log_error(uint16_t error) { printf("ERR %u\n", error); }
+
+#ifdef DEBUG
+void serial_printf(const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    vprintf(format, va);
+    va_end(va);
+}
+
+// Nothing typed in, tests drive the modules themselves
+bool serial_available(void) { return false; }
+
+char serial_read(void) { return 0; }
+#endif
+
+/** @} */
+
+/** @addtogroup HOST_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void* run(void* arg) {
+    (void)arg;
+    failures = host_test_main();
+    return NULL;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * @file    host.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Host Test Harness Header File
+ *
+ * @defgroup   HOST_FILE  Host Test Harness
+ * @brief      Runs hub modules on Linux against emulated peripherals
+ *
+ * The drivers hand buffers to DMA as 32 bit addresses. To keep them working
+ * unmodified the tests are linked -no-pie, so statics sit below 4 GB, and
+ * main() here runs host_test_main() on a stack mapped below 4 GB as well.
+ * host_ptr() then turns a DMA address register back into a pointer.
+ * Buffers from malloc() are not covered, the drivers don't use any.
+ *
+ * main() also maps RAM over the peripheral registers so the odd direct
+ * register access, e.g. clearing a USART flag, lands somewhere harmless.
+ *
+ * Serial & log output goes to stdout.
+ *
+ * @{
+ * @defgroup   HOST_API  Host Test Harness API
+ * @brief
+ *
+ * @defgroup   HOST_INT  Host Test Harness Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup HOST_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Defined by each test, runs on the low stack, returns failures */
+int host_test_main(void);
+
+/** @brief Pointer from a DMA memory address register */
+static inline void* host_ptr(uint32_t address) {
+    assert(address != 0);
+    return (void*)(uintptr_t)address;
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_H
@@ -0,0 +1,32 @@
+/**
+ ******************************************************************************
+ * @file    cortex.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   Host Stand In For libopencm3 cortex.h
+ *
+ * The real one is inline CPSIE/CPSID. Found first on the host include path,
+ * these are out of line so the peripheral emulators can hold back interrupt
+ * handlers while masked, see uart_emu.c.
+ *
+ ******************************************************************************
+ */
+
+#ifndef LIBOPENCM3_CORTEX_H
+#define LIBOPENCM3_CORTEX_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void cm_enable_interrupts(void);
+void cm_disable_interrupts(void);
+bool cm_is_masked_interrupts(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBOPENCM3_CORTEX_H
@@ -0,0 +1,567 @@
+/**
+ ******************************************************************************
+ * @file    uart_emu.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   UART Emulator Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// kill(), usleep() & clock_gettime() under -std=c99
+#define _DEFAULT_SOURCE
+
+#include "uart_emu.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "common/timers.h"
+#include "host.h"
+
+/** @addtogroup UART_EMU_FILE
+ * @{
+ */
+
+/** @addtogroup UART_EMU_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#define NUM_DMA_CHANNELS 8
+
+#define START_TIMEOUT_MS 5000
+#define TX_TIMEOUT_MS    1000
+
+typedef struct dma_chan_s {
+    uint32_t periph;
+    uint32_t mem;
+    uint16_t num; /**< Reload value */
+    uint16_t cnt; /**< Left before the end of the buffer */
+    bool     circ;
+    bool     from_mem;
+    bool     enabled;
+    bool     tcif;
+} dma_chan_t;
+
+static struct {
+    pid_t pid;
+    int   fd;  // Peer tty
+    int   out; // Peer stdout
+
+    uint32_t usart;
+    void (*isr)(void);
+    bool enabled;
+    bool rx_dma;
+    bool tx_irq;
+    bool txe;
+    bool masked;
+    bool in_isr;
+    bool hold_rx;
+
+    struct timespec start;
+
+    uart_emu_stats_t stats;
+
+    dma_chan_t dma[NUM_DMA_CHANNELS];
+} emu = {.pid = -1, .fd = -1, .out = -1};
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static bool read_tty_name(char* name, uint32_t size);
+static void copy_peer_output(void);
+static void run_isr(void);
+static void fill_rx(dma_chan_t* ch);
+
+/** @} */
+
+/** @addtogroup UART_EMU_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+bool uart_emu_open(const char* cmd, uint32_t usart, void (*isr)(void)) {
+    char name[128];
+    char line[512];
+    int  pipe_fd[2];
+
+    uart_emu_close();
+
+    memset(&emu, 0, sizeof(emu));
+    emu.fd = emu.out = -1;
+    emu.usart = usart;
+    emu.isr = isr;
+    emu.txe = true;
+    clock_gettime(CLOCK_MONOTONIC, &emu.start);
+
+    if (pipe(pipe_fd)) {
+        return false;
+    }
+
+    // Shell replaced by the peer, so it is the one stopped by close
+    snprintf(line, sizeof(line), "exec %s", cmd);
+    fflush(stdout);
+
+    emu.pid = fork();
+    if (emu.pid == 0) {
+        dup2(pipe_fd[1], STDOUT_FILENO);
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        execl("/bin/sh", "sh", "-c", line, (char*)NULL);
+        _exit(127);
+    }
+
+    close(pipe_fd[1]);
+    emu.out = pipe_fd[0];
+
+    if ((emu.pid < 0) || !read_tty_name(name, sizeof(name))) {
+        fprintf(stderr, "uart_emu: no tty from %s\n", cmd);
+        uart_emu_close();
+        return false;
+    }
+
+    // Peer already made it raw
+    emu.fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    fcntl(emu.out, F_SETFL, O_NONBLOCK);
+
+    if (emu.fd < 0) {
+        fprintf(stderr, "uart_emu: can't open %s\n", name);
+        uart_emu_close();
+        return false;
+    }
+
+    return true;
+}
+
+void uart_emu_close(void) {
+    if (emu.pid > 0) {
+        kill(emu.pid, SIGTERM);
+        waitpid(emu.pid, NULL, 0);
+    }
+    emu.pid = -1;
+
+    if (emu.out >= 0) {
+        copy_peer_output();
+        close(emu.out);
+    }
+    emu.out = -1;
+
+    if (emu.fd >= 0) {
+        close(emu.fd);
+    }
+    emu.fd = -1;
+}
+
+void uart_emu_hold_rx(bool hold) { emu.hold_rx = hold; }
+
+const uart_emu_stats_t* uart_emu_stats(void) { return &emu.stats; }
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// libopencm3 & timers
+/*////////////////////////////////////////////////////////////////////////////*/
+
+void cm_enable_interrupts(void) {
+    emu.masked = false;
+    run_isr();
+}
+
+void cm_disable_interrupts(void) { emu.masked = true; }
+
+bool cm_is_masked_interrupts(void) { return emu.masked; }
+
+void nvic_enable_irq(uint8_t irqn) { (void)irqn; }
+
+void nvic_set_priority(uint8_t irqn, uint8_t priority) {
+    (void)irqn;
+    (void)priority;
+}
+
+void nvic_clear_pending_irq(uint8_t irqn) { (void)irqn; }
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken) { (void)clken; }
+
+void rcc_periph_clock_disable(enum rcc_periph_clken clken) { (void)clken; }
+
+void rcc_periph_reset_pulse(enum rcc_periph_rst rst) { (void)rst; }
+
+void gpio_set(uint32_t gpioport, uint16_t gpios) {
+    (void)gpioport;
+    (void)gpios;
+}
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios) {
+    (void)gpioport;
+    (void)gpios;
+}
+
+void gpio_mode_setup(uint32_t gpioport, uint8_t mode, uint8_t pull_up_down,
+                     uint16_t gpios) {
+    (void)gpioport;
+    (void)mode;
+    (void)pull_up_down;
+    (void)gpios;
+}
+
+void gpio_set_output_options(uint32_t gpioport, uint8_t otype, uint8_t speed,
+                             uint16_t gpios) {
+    (void)gpioport;
+    (void)otype;
+    (void)speed;
+    (void)gpios;
+}
+
+void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios) {
+    (void)gpioport;
+    (void)alt_func_num;
+    (void)gpios;
+}
+
+void usart_enable(uint32_t usart) {
+    if (usart == emu.usart) {
+        emu.enabled = true;
+    }
+}
+
+void usart_disable(uint32_t usart) {
+    if (usart == emu.usart) {
+        emu.enabled = false;
+    }
+}
+
+void usart_set_baudrate(uint32_t usart, uint32_t baud) {
+    if (usart == emu.usart) {
+        emu.stats.baud = baud;
+    }
+}
+
+void usart_set_databits(uint32_t usart, uint32_t bits) {
+    (void)usart;
+    (void)bits;
+}
+
+void usart_set_stopbits(uint32_t usart, uint32_t stopbits) {
+    (void)usart;
+    (void)stopbits;
+}
+
+void usart_set_mode(uint32_t usart, uint32_t mode) {
+    (void)usart;
+    (void)mode;
+}
+
+void usart_set_parity(uint32_t usart, uint32_t parity) {
+    (void)usart;
+    (void)parity;
+}
+
+void usart_set_flow_control(uint32_t usart, uint32_t flowcontrol) {
+    (void)usart;
+    (void)flowcontrol;
+}
+
+void usart_enable_rx_dma(uint32_t usart) {
+    if (usart == emu.usart) {
+        emu.rx_dma = true;
+    }
+}
+
+void usart_enable_rx_timeout(uint32_t usart) { (void)usart; }
+
+void usart_disable_rx_timeout(uint32_t usart) { (void)usart; }
+
+void usart_disable_rx_timeout_interrupt(uint32_t usart) { (void)usart; }
+
+void usart_set_rx_timeout_value(uint32_t usart, uint32_t value) {
+    (void)usart;
+    (void)value;
+}
+
+void usart_enable_tx_interrupt(uint32_t usart) {
+    if (usart == emu.usart) {
+        emu.tx_irq = true;
+        run_isr();
+    }
+}
+
+void usart_disable_tx_interrupt(uint32_t usart) {
+    if (usart == emu.usart) {
+        emu.tx_irq = false;
+    }
+}
+
+bool usart_get_flag(uint32_t usart, uint32_t flag) {
+    return (usart == emu.usart) && (flag & USART_ISR_TXE) && emu.txe;
+}
+
+void usart_send(uint32_t usart, uint16_t data) {
+    uint8_t byte = (uint8_t)data;
+
+    if ((usart != emu.usart) || !emu.enabled || (emu.fd < 0)) {
+        return;
+    }
+
+    // Peer reads as fast as it can, only waits if its tty is full
+    while (write(emu.fd, &byte, 1) != 1) {
+        struct pollfd pfd = {.fd = emu.fd, .events = POLLOUT};
+
+        if ((errno != EAGAIN) || (poll(&pfd, 1, TX_TIMEOUT_MS) <= 0)) {
+            return;
+        }
+    }
+
+    emu.stats.bytes_tx++;
+    emu.txe = false;
+}
+
+void dma_channel_reset(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    memset(&emu.dma[channel], 0, sizeof(emu.dma[channel]));
+}
+
+void dma_set_channel_request(uint32_t dma, uint8_t channel, uint8_t request) {
+    (void)dma;
+    (void)channel;
+    (void)request;
+}
+
+void dma_enable_circular_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].circ = true;
+}
+
+void dma_set_read_from_peripheral(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].from_mem = false;
+}
+
+void dma_set_read_from_memory(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].from_mem = true;
+}
+
+void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio) {
+    (void)dma;
+    (void)channel;
+    (void)prio;
+}
+
+void dma_set_peripheral_address(uint32_t dma, uint8_t channel,
+                                uint32_t address) {
+    (void)dma;
+    emu.dma[channel].periph = address;
+}
+
+void dma_set_peripheral_size(uint32_t dma, uint8_t channel,
+                             uint32_t peripheral_size) {
+    (void)dma;
+    (void)channel;
+    (void)peripheral_size;
+}
+
+void dma_disable_peripheral_increment_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    (void)channel;
+}
+
+void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t mem_size) {
+    (void)dma;
+    (void)channel;
+    (void)mem_size;
+}
+
+void dma_set_memory_address(uint32_t dma, uint8_t channel, uint32_t address) {
+    (void)dma;
+    emu.dma[channel].mem = address;
+}
+
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    (void)channel;
+}
+
+void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number) {
+    (void)dma;
+    emu.dma[channel].num = number;
+    emu.dma[channel].cnt = number;
+}
+
+uint16_t dma_get_number_of_data(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    fill_rx(&emu.dma[channel]);
+    return emu.dma[channel].cnt;
+}
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel,
+                               uint32_t interrupts) {
+    (void)dma;
+    if (interrupts & DMA_TCIF) {
+        emu.dma[channel].tcif = false;
+    }
+}
+
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t channel,
+                            uint32_t interrupts) {
+    (void)dma;
+    return (interrupts & DMA_TCIF) && emu.dma[channel].tcif;
+}
+
+// Never raised, the driver also picks up TCIF when it reads the counter
+void dma_enable_transfer_complete_interrupt(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    (void)channel;
+}
+
+void dma_enable_channel(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].enabled = true;
+}
+
+void dma_disable_channel(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].enabled = false;
+}
+
+uint32_t timers_micros(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)(((now.tv_sec - emu.start.tv_sec) * 1000000) +
+                      ((now.tv_nsec - emu.start.tv_nsec) / 1000));
+}
+
+uint32_t timers_millis(void) {
+    // Driver polls in tight loops, give the peer a look in
+    usleep(50);
+    copy_peer_output();
+
+    return timers_micros() / 1000;
+}
+
+void timers_delay_milliseconds(uint32_t delay_milliseconds) {
+    usleep(delay_milliseconds * 1000);
+}
+
+void timers_pet_dogs(void) {}
+
+// Shares the SIM RX DMA vector, see hub_defs.h
+void spf_dma_isr(void) {}
+
+/** @} */
+
+/** @addtogroup UART_EMU_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// First line is "... on <tty>"
+static bool read_tty_name(char* name, uint32_t size) {
+    char     line[256];
+    uint32_t len = 0;
+
+    struct pollfd pfd = {.fd = emu.out, .events = POLLIN};
+
+    while ((len < (sizeof(line) - 1)) &&
+           (poll(&pfd, 1, START_TIMEOUT_MS) > 0)) {
+        if ((read(emu.out, &line[len], 1) != 1) || (line[len] == '\n')) {
+            break;
+        }
+        len++;
+    }
+    line[len] = '\0';
+
+    char* tty = strstr(line, " on ");
+
+    if (!tty || (strlen(tty + 4) >= size)) {
+        return false;
+    }
+
+    strcpy(name, tty + 4);
+    printf("%s\n", line);
+
+    return true;
+}
+
+static void copy_peer_output(void) {
+    char    buf[256];
+    ssize_t len;
+
+    if (emu.out < 0) {
+        return;
+    }
+
+    while ((len = read(emu.out, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, (size_t)len, stdout);
+    }
+}
+
+// Each byte has gone by the time the handler runs, so it keeps sending until
+// it has nothing left & turns itself off
+static void run_isr(void) {
+    if (emu.in_isr || !emu.isr) {
+        return;
+    }
+
+    emu.in_isr = true;
+    while (emu.tx_irq && !emu.masked) {
+        emu.txe = true;
+        emu.isr();
+        emu.stats.tx_irqs++;
+    }
+    emu.in_isr = false;
+}
+
+static void fill_rx(dma_chan_t* ch) {
+    if (!ch->enabled || ch->from_mem || !emu.enabled || !emu.rx_dma ||
+        emu.hold_rx || (emu.fd < 0) ||
+        (ch->periph != (uint32_t)&USART_RDR(emu.usart)) || !ch->cnt) {
+        return;
+    }
+
+    uint8_t* mem = host_ptr(ch->mem);
+    ssize_t  len = read(emu.fd, &mem[ch->num - ch->cnt], ch->cnt);
+
+    if (len <= 0) {
+        return;
+    }
+
+    emu.stats.bytes_rx += (uint32_t)len;
+    ch->cnt -= (uint16_t)len;
+
+    if (ch->cnt == 0) {
+        ch->tcif = true;
+        ch->cnt = ch->circ ? ch->num : 0;
+    }
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file    uart_emu.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   UART Emulator Header File
+ *
+ * @defgroup   UART_EMU_FILE  UART Emulator
+ * @brief      Host stand in for a USART wired to a scripted peer
+ *
+ * Provides the libopencm3 USART, DMA, GPIO, RCC, NVIC & cortex calls and the
+ * timers calls that hub/sim.c makes, so it compiles unmodified for Linux and
+ * talks to host/sim800_emu.py, or anything else that prints
+ * "... on <tty>" as its first line, over a pseudo terminal.
+ *
+ * Each byte sent is written straight to the tty and clears TXE, so the next
+ * one is queued by the driver. The TX interrupt handler then runs, with TXE
+ * set again, as soon as it is enabled and interrupts are not masked by
+ * cm_disable_interrupts(), until it disables itself.
+ *
+ * RX goes through the DMA channel whose peripheral address is the USART RDR.
+ * Bytes are only moved from the tty into the channel memory when the driver
+ * reads the channel counter, no more than up to the end of the buffer each
+ * time, so circular mode wraps and sets TCIF as on the part but the ring can
+ * never be overrun. What has not been read yet waits in the tty.
+ *
+ * Baud rate is recorded but not applied and the reset line is not modelled,
+ * the peer keeps its state over a reset. timers_millis() is wall clock time,
+ * matching the delays in the peer. The peer's own output is copied to stdout.
+ *
+ * Built by hub/test/CMakeLists.txt, see host.h for how DMA addresses stay
+ * valid.
+ *
+ * @{
+ * @defgroup   UART_EMU_API  UART Emulator API
+ * @brief
+ *
+ * @defgroup   UART_EMU_INT  UART Emulator Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef UART_EMU_H
+#define UART_EMU_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup UART_EMU_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+typedef struct uart_emu_stats_s {
+    uint32_t bytes_tx;
+    uint32_t bytes_rx;
+    uint32_t tx_irqs; /**< TX interrupt handler runs */
+    uint32_t baud;    /**< Last set */
+} uart_emu_stats_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Start peer with /bin/sh & open its tty as usart, isr is the TX
+ * interrupt handler */
+bool uart_emu_open(const char* cmd, uint32_t usart, void (*isr)(void));
+
+/** @brief Stop peer & close tty */
+void uart_emu_close(void);
+
+/** @brief Leave received bytes in the tty, the driver sees a silent line */
+void uart_emu_hold_rx(bool hold);
+
+const uart_emu_stats_t* uart_emu_stats(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UART_EMU_H
@@ -0,0 +1,702 @@
+/**
+ ******************************************************************************
+ * @file    w25_emu.c
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   W25Qxx Flash Emulator Source File
+ *
+ ******************************************************************************
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+// ftruncate() & mmap() under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include "w25_emu.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "common/timers.h"
+#include "config/board_defs.h"
+#include "host.h"
+
+/** @addtogroup W25_EMU_FILE
+ * @{
+ */
+
+/** @addtogroup W25_EMU_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#define MANUFACTURER_ID 0xEF
+#define MEMORY_TYPE     0x40
+
+#define PAGE_SIZE   256
+#define SECTOR_SIZE 0x1000
+#define BLOCK_SIZE  0x10000
+
+#define SR1_BUSY 0x01
+#define SR1_WEL  0x02
+#define SR2_SUS  0x80
+
+#define NUM_DMA_CHANNELS 8
+
+#define POLL_NS 1000
+
+typedef struct dma_chan_s {
+    uint32_t mem;
+    uint16_t num;
+    bool     minc;
+    bool     from_mem;
+    bool     enabled;
+    bool     tcif;
+} dma_chan_t;
+
+static const w25_emu_timing_t default_timing = {
+    .page_program_us = 700,
+    .sector_erase_us = 45000,
+    .block_erase_us = 150000,
+    .chip_erase_us_per_mb = 2500000,
+    .suspend_us = 20,
+    .byte_ns = 500,
+};
+
+static struct {
+    uint8_t*  mem;
+    uint32_t  size;
+    uint32_t* wear;
+    uint32_t  wear_size;
+    W25_ID_t  id;
+    uint8_t   addr_bytes;
+
+    w25_emu_timing_t timing;
+    w25_emu_stats_t  stats;
+    uint64_t         now_ns;
+
+    // Current command, from chip select to deselect
+    bool     selected;
+    uint8_t  cmd;
+    uint32_t pos;
+    uint32_t addr;
+    bool     ignored;
+
+    uint8_t  sr[3];
+    uint64_t busy_until_ns;
+
+    // Erase running or suspended, reads & programs must keep out
+    bool     erasing;
+    bool     suspended;
+    uint32_t erase_lo;
+    uint32_t erase_hi;
+    uint64_t erase_left_ns;
+
+    uint8_t page_buf[PAGE_SIZE];
+    bool    page_set[PAGE_SIZE];
+
+    dma_chan_t dma[NUM_DMA_CHANNELS];
+} emu;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void*   map_file(const char* path, uint32_t size, uint8_t fill);
+static bool    busy(void);
+static bool    in_erase(uint32_t addr);
+static uint8_t xfer_byte(uint8_t data);
+static void    end_command(void);
+static void    start_erase(uint32_t addr, uint32_t len, uint64_t us);
+static void    program_page(void);
+
+/** @} */
+
+/** @addtogroup W25_EMU_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+bool w25_emu_open(const char* path, W25_ID_t id,
+                  const w25_emu_timing_t* timing) {
+    char wear_path[256];
+
+    if ((id < W25Q10) || (id > W25Q512)) {
+        return false;
+    }
+
+    memset(&emu, 0, sizeof(emu));
+    emu.id = id;
+    emu.size = (128U * 1024U) << (id - W25Q10);
+    emu.addr_bytes = (id >= W25Q256) ? 4 : 3;
+    emu.timing = timing ? *timing : default_timing;
+
+    emu.mem = map_file(path, emu.size, 0xFF);
+    if (emu.mem == NULL) {
+        return false;
+    }
+
+    snprintf(wear_path, sizeof(wear_path), "%s.wear", path);
+    emu.wear_size = (emu.size / SECTOR_SIZE) * sizeof(uint32_t);
+    emu.wear = map_file(wear_path, emu.wear_size, 0x00);
+    if (emu.wear == NULL) {
+        munmap(emu.mem, emu.size);
+        emu.mem = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void w25_emu_close(void) {
+    if (emu.mem) {
+        msync(emu.mem, emu.size, MS_SYNC);
+        munmap(emu.mem, emu.size);
+        emu.mem = NULL;
+    }
+
+    if (emu.wear) {
+        msync(emu.wear, emu.wear_size, MS_SYNC);
+        munmap(emu.wear, emu.wear_size);
+        emu.wear = NULL;
+    }
+}
+
+uint32_t w25_emu_erase_count(uint32_t sector) {
+    return (sector < (emu.size / SECTOR_SIZE)) ? emu.wear[sector] : 0;
+}
+
+uint32_t w25_emu_max_erase_count(void) {
+    uint32_t max = 0;
+
+    for (uint32_t i = 0; i < (emu.size / SECTOR_SIZE); i++) {
+        if (emu.wear[i] > max) {
+            max = emu.wear[i];
+        }
+    }
+
+    return max;
+}
+
+const w25_emu_stats_t* w25_emu_stats(void) { return &emu.stats; }
+
+void w25_emu_clear_stats(void) { memset(&emu.stats, 0, sizeof(emu.stats)); }
+
+uint64_t w25_emu_time_us(void) { return emu.now_ns / 1000; }
+
+uint8_t* w25_emu_image(void) { return emu.mem; }
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// libopencm3 & timers
+/*////////////////////////////////////////////////////////////////////////////*/
+
+uint16_t spi_xfer(uint32_t spi, uint16_t data) {
+    (void)spi;
+    emu.now_ns += emu.timing.byte_ns;
+    return emu.selected ? xfer_byte((uint8_t)data) : 0xFF;
+}
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios) {
+    if ((gpioport == W25_SPI_NSS_PORT) && (gpios & W25_SPI_NSS)) {
+        emu.selected = true;
+        emu.pos = 0;
+        emu.addr = 0;
+        emu.ignored = false;
+    }
+}
+
+void gpio_set(uint32_t gpioport, uint16_t gpios) {
+    if ((gpioport == W25_SPI_NSS_PORT) && (gpios & W25_SPI_NSS) &&
+        emu.selected) {
+        emu.selected = false;
+        end_command();
+    }
+}
+
+void gpio_mode_setup(uint32_t gpioport, uint8_t mode, uint8_t pull_up_down,
+                     uint16_t gpios) {
+    (void)gpioport;
+    (void)mode;
+    (void)pull_up_down;
+    (void)gpios;
+}
+
+void gpio_set_output_options(uint32_t gpioport, uint8_t otype, uint8_t speed,
+                             uint16_t gpios) {
+    (void)gpioport;
+    (void)otype;
+    (void)speed;
+    (void)gpios;
+}
+
+void gpio_set_af(uint32_t gpioport, uint8_t alt_func_num, uint16_t gpios) {
+    (void)gpioport;
+    (void)alt_func_num;
+    (void)gpios;
+}
+
+void rcc_periph_clock_enable(enum rcc_periph_clken clken) { (void)clken; }
+
+void rcc_periph_reset_pulse(enum rcc_periph_rst rst) { (void)rst; }
+
+void spi_enable(uint32_t spi) { (void)spi; }
+
+void spi_disable(uint32_t spi) { (void)spi; }
+
+int spi_init_master(uint32_t spi, uint32_t br, uint32_t cpol, uint32_t cpha,
+                    uint32_t dff, uint32_t lsbfirst) {
+    (void)spi;
+    (void)br;
+    (void)cpol;
+    (void)cpha;
+    (void)dff;
+    (void)lsbfirst;
+    return 0;
+}
+
+void spi_enable_rx_dma(uint32_t spi) { (void)spi; }
+
+void spi_disable_rx_dma(uint32_t spi) { (void)spi; }
+
+void spi_disable_tx_dma(uint32_t spi) { (void)spi; }
+
+// TX request starts the burst, the driver enables it last
+void spi_enable_tx_dma(uint32_t spi) {
+    dma_chan_t* tx = NULL;
+    dma_chan_t* rx = NULL;
+
+    for (uint8_t i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (emu.dma[i].enabled && emu.dma[i].from_mem) {
+            tx = &emu.dma[i];
+        } else if (emu.dma[i].enabled) {
+            rx = &emu.dma[i];
+        }
+    }
+
+    if (tx == NULL) {
+        return;
+    }
+
+    // Byte at a time through the same path as spi_xfer()
+    const uint8_t* src = host_ptr(tx->mem);
+    uint8_t*       dst = rx ? host_ptr(rx->mem) : NULL;
+
+    for (uint16_t i = 0; i < tx->num; i++) {
+        uint8_t in = (uint8_t)spi_xfer(spi, src[tx->minc ? i : 0]);
+
+        if (dst && (i < rx->num)) {
+            dst[rx->minc ? i : 0] = in;
+        }
+    }
+
+    tx->tcif = true;
+    if (rx) {
+        rx->tcif = true;
+    }
+}
+
+void dma_channel_reset(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    memset(&emu.dma[channel], 0, sizeof(emu.dma[channel]));
+}
+
+void dma_set_channel_request(uint32_t dma, uint8_t channel, uint8_t request) {
+    (void)dma;
+    (void)channel;
+    (void)request;
+}
+
+void dma_set_read_from_peripheral(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].from_mem = false;
+}
+
+void dma_set_read_from_memory(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].from_mem = true;
+}
+
+void dma_set_priority(uint32_t dma, uint8_t channel, uint32_t prio) {
+    (void)dma;
+    (void)channel;
+    (void)prio;
+}
+
+void dma_set_peripheral_address(uint32_t dma, uint8_t channel,
+                                uint32_t address) {
+    (void)dma;
+    (void)channel;
+    (void)address;
+}
+
+void dma_set_peripheral_size(uint32_t dma, uint8_t channel,
+                             uint32_t peripheral_size) {
+    (void)dma;
+    (void)channel;
+    (void)peripheral_size;
+}
+
+void dma_disable_peripheral_increment_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    (void)channel;
+}
+
+void dma_set_memory_size(uint32_t dma, uint8_t channel, uint32_t mem_size) {
+    (void)dma;
+    (void)channel;
+    (void)mem_size;
+}
+
+void dma_set_memory_address(uint32_t dma, uint8_t channel, uint32_t address) {
+    (void)dma;
+    emu.dma[channel].mem = address;
+}
+
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].minc = true;
+}
+
+void dma_disable_memory_increment_mode(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].minc = false;
+}
+
+void dma_set_number_of_data(uint32_t dma, uint8_t channel, uint16_t number) {
+    (void)dma;
+    emu.dma[channel].num = number;
+}
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t channel,
+                               uint32_t interrupts) {
+    (void)dma;
+    (void)interrupts;
+    emu.dma[channel].tcif = false;
+}
+
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t channel,
+                            uint32_t interrupts) {
+    (void)dma;
+    (void)interrupts;
+    return emu.dma[channel].tcif;
+}
+
+void dma_enable_channel(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].enabled = true;
+}
+
+void dma_disable_channel(uint32_t dma, uint8_t channel) {
+    (void)dma;
+    emu.dma[channel].enabled = false;
+}
+
+// Reading the time costs some, so loops polling it still see it move
+uint32_t timers_micros(void) {
+    emu.now_ns += POLL_NS;
+    return (uint32_t)(emu.now_ns / 1000);
+}
+
+uint32_t timers_millis(void) {
+    emu.now_ns += POLL_NS;
+    return (uint32_t)(emu.now_ns / 1000000);
+}
+
+void timers_delay_microseconds(uint32_t delay_microseconds) {
+    emu.now_ns += (uint64_t)delay_microseconds * 1000;
+}
+
+void timers_delay_milliseconds(uint32_t delay_milliseconds) {
+    emu.now_ns += (uint64_t)delay_milliseconds * 1000000;
+}
+
+void timers_pet_dogs(void) {}
+
+/** @} */
+
+/** @addtogroup W25_EMU_INT
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Static Function Definitions
+/*////////////////////////////////////////////////////////////////////////////*/
+
+static void* map_file(const char* path, uint32_t size, uint8_t fill) {
+    struct stat st;
+    int         fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) ||
+        (((uint32_t)st.st_size < size) && ftruncate(fd, size))) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+
+    uint8_t* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    // New or grown, fill the rest as a blank chip would be
+    if ((uint32_t)st.st_size < size) {
+        memset(&p[st.st_size], fill, size - st.st_size);
+    }
+
+    return p;
+}
+
+static bool busy(void) {
+    if (emu.now_ns < emu.busy_until_ns) {
+        return true;
+    }
+
+    if (emu.erasing && !emu.suspended) {
+        emu.erasing = false;
+    }
+
+    return false;
+}
+
+static bool in_erase(uint32_t addr) {
+    busy();
+    return emu.erasing && (addr >= emu.erase_lo) && (addr < emu.erase_hi);
+}
+
+static uint8_t xfer_byte(uint8_t data) {
+    uint32_t pos = emu.pos++;
+
+    if (pos == 0) {
+        emu.cmd = data;
+
+        // Only status reads & suspend get through while busy
+        if (busy() && (data != 0x05) && (data != 0x35) && (data != 0x15) &&
+            (data != 0x75)) {
+            emu.stats.busy_violations++;
+            emu.ignored = true;
+        }
+
+        return 0xFF;
+    }
+
+    if (emu.ignored) {
+        return 0xFF;
+    }
+
+    switch (emu.cmd) {
+    case 0x9F:
+        return (pos == 1)   ? MANUFACTURER_ID
+               : (pos == 2) ? MEMORY_TYPE
+               : (pos == 3) ? (uint8_t)(0x10 + emu.id)
+                            : 0xFF;
+
+    case 0x4B:
+        // 4 dummy then 8 byte ID
+        return ((pos > 4) && (pos <= 12)) ? (uint8_t)(pos * 0x11) : 0xFF;
+
+    case 0x05:
+        return (uint8_t)(emu.sr[0] | (busy() ? SR1_BUSY : 0));
+    case 0x35:
+        return emu.sr[1];
+    case 0x15:
+        return emu.sr[2];
+
+    case 0x01:
+    case 0x31:
+    case 0x11:
+        if (pos == 1) {
+            emu.sr[(emu.cmd == 0x01) ? 0 : (emu.cmd == 0x31) ? 1 : 2] =
+                data & ((emu.cmd == 0x01) ? ~(SR1_BUSY | SR1_WEL) : 0xFF);
+        }
+        return 0xFF;
+
+    case 0x03:
+    case 0x0B:
+    case 0x02:
+    case 0x20:
+    case 0xD8:
+        if (pos <= emu.addr_bytes) {
+            emu.addr = (emu.addr << 8) | data;
+            return 0xFF;
+        }
+        break;
+
+    default:
+        return 0xFF;
+    }
+
+    // Data phase, fast read has a dummy byte first
+    uint32_t n = pos - emu.addr_bytes - 1;
+
+    if ((emu.cmd == 0x03) || (emu.cmd == 0x0B)) {
+        if (emu.cmd == 0x0B) {
+            if (n == 0) {
+                return 0xFF;
+            }
+            n--;
+        }
+
+        uint32_t addr = (emu.addr + n) % emu.size;
+
+        if (in_erase(addr)) {
+            emu.stats.busy_violations++;
+            return 0xFF;
+        }
+
+        emu.stats.bytes_read++;
+        return emu.mem[addr];
+    }
+
+    // Wraps within the page, last byte sent to an address wins
+    if (emu.cmd == 0x02) {
+        uint32_t offset = (emu.addr + n) % PAGE_SIZE;
+        emu.page_buf[offset] = data;
+        emu.page_set[offset] = true;
+    }
+
+    return 0xFF;
+}
+
+static void end_command(void) {
+    uint32_t addr = emu.addr % emu.size;
+
+    if (emu.ignored || (emu.pos == 0)) {
+        return;
+    }
+
+    switch (emu.cmd) {
+    case 0x06:
+        emu.sr[0] |= SR1_WEL;
+        break;
+    case 0x04:
+        emu.sr[0] &= ~SR1_WEL;
+        break;
+
+    case 0x02:
+        program_page();
+        break;
+
+    case 0x20:
+        start_erase(addr & ~(SECTOR_SIZE - 1), SECTOR_SIZE,
+                    emu.timing.sector_erase_us);
+        break;
+    case 0xD8:
+        start_erase(addr & ~(BLOCK_SIZE - 1), BLOCK_SIZE,
+                    emu.timing.block_erase_us);
+        break;
+    case 0xC7:
+    case 0x60:
+        start_erase(0, emu.size,
+                    (uint64_t)emu.timing.chip_erase_us_per_mb *
+                        (emu.size / (1024 * 1024) ? emu.size / (1024 * 1024)
+                                                  : 1));
+        break;
+
+    case 0x75:
+        if (emu.erasing && !emu.suspended && busy()) {
+            emu.erase_left_ns = emu.busy_until_ns - emu.now_ns;
+            emu.busy_until_ns =
+                emu.now_ns + ((uint64_t)emu.timing.suspend_us * 1000);
+            emu.suspended = true;
+            emu.sr[1] |= SR2_SUS;
+            emu.stats.suspends++;
+        }
+        break;
+    case 0x7A:
+        if (emu.suspended) {
+            emu.busy_until_ns = emu.now_ns + emu.erase_left_ns;
+            emu.suspended = false;
+            emu.sr[1] &= ~SR2_SUS;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void start_erase(uint32_t addr, uint32_t len, uint64_t us) {
+    if (!(emu.sr[0] & SR1_WEL)) {
+        emu.stats.wel_violations++;
+        return;
+    }
+    emu.sr[0] &= ~SR1_WEL;
+
+    // Can't start another erase while one is suspended
+    if (emu.suspended) {
+        emu.stats.busy_violations++;
+        return;
+    }
+
+    memset(&emu.mem[addr], 0xFF, len);
+
+    for (uint32_t i = addr / SECTOR_SIZE; i < (addr + len) / SECTOR_SIZE;
+         i++) {
+        emu.wear[i]++;
+    }
+
+    emu.erasing = true;
+    emu.erase_lo = addr;
+    emu.erase_hi = addr + len;
+    emu.busy_until_ns = emu.now_ns + (us * 1000);
+    emu.stats.erases++;
+}
+
+static void program_page(void) {
+    uint32_t page = (emu.addr % emu.size) & ~(PAGE_SIZE - 1);
+
+    if (!(emu.sr[0] & SR1_WEL)) {
+        emu.stats.wel_violations++;
+    } else if (in_erase(page)) {
+        emu.stats.busy_violations++;
+    } else {
+        for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+            if (emu.page_set[i]) {
+                uint8_t old = emu.mem[page + i];
+
+                if (emu.page_buf[i] & ~old) {
+                    emu.stats.bits_not_cleared++;
+                }
+
+                emu.mem[page + i] = old & emu.page_buf[i];
+                emu.stats.bytes_programmed++;
+            }
+        }
+
+        emu.busy_until_ns =
+            emu.now_ns + ((uint64_t)emu.timing.page_program_us * 1000);
+        emu.stats.programs++;
+    }
+
+    emu.sr[0] &= ~SR1_WEL;
+    memset(emu.page_set, 0, sizeof(emu.page_set));
+}
+
+/** @} */
+/** @} */
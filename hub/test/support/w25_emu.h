@@ -0,0 +1,112 @@
+/**
+ ******************************************************************************
+ * @file    w25_emu.h
+ * @author  Richard Davies
+ * @date    18/Oct/2026
+ * @brief   W25Qxx Flash Emulator Header File
+ *
+ * @defgroup   W25_EMU_FILE  W25 Emulator
+ * @brief      Host stand in for the W25Qxx behind hub/w25qxx.c
+ *
+ * Provides the libopencm3 SPI, GPIO, RCC & DMA calls and the timers calls
+ * that hub/w25qxx.c makes, so the driver and anything built on it compile
+ * unmodified for Linux. The flash contents live in an mmap'd image file,
+ * erase counts per sector in <image>.wear next to it.
+ *
+ * NOR rules are kept: programs only clear bits and wrap within the page,
+ * erase sets a whole sector/block to 0xFF, both need write enable first.
+ * Program & erase hold BUSY for a configurable time on a virtual clock that
+ * only moves with SPI bytes and timers delays, so a run takes as long as the
+ * CPU needs but timers_millis() reports what the hardware would take.
+ * Commands sent while busy, or reads & programs into a suspended erase, are
+ * ignored and counted rather than asserted on so tests can check for them.
+ *
+ * DMA bursts are clocked a byte at a time from the memory addresses the
+ * driver sets, see host.h for how those stay valid. Built by
+ * hub/test/CMakeLists.txt.
+ *
+ * @{
+ * @defgroup   W25_EMU_API  W25 Emulator API
+ * @brief
+ *
+ * @defgroup   W25_EMU_INT  W25 Emulator Internal
+ * @brief
+ * @}
+ ******************************************************************************
+ */
+
+#ifndef W25_EMU_H
+#define W25_EMU_H
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Includes
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hub/w25qxx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup W25_EMU_API
+ * @{
+ */
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Variables
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Latencies, typical values from the W25Q64JV datasheet if NULL */
+typedef struct w25_emu_timing_s {
+    uint32_t page_program_us;
+    uint32_t sector_erase_us;
+    uint32_t block_erase_us;
+    uint32_t chip_erase_us_per_mb;
+    uint32_t suspend_us;
+    uint32_t byte_ns; /**< SPI clock, 500 for 16 MHz */
+} w25_emu_timing_t;
+
+typedef struct w25_emu_stats_s {
+    uint32_t bytes_read;
+    uint32_t bytes_programmed;
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t suspends;
+    uint32_t bits_not_cleared; /**< Program tried to turn a 0 back to 1 */
+    uint32_t wel_violations;   /**< Program or erase without write enable */
+    uint32_t busy_violations;  /**< Ignored, chip busy or region suspended */
+} w25_emu_stats_t;
+
+/*////////////////////////////////////////////////////////////////////////////*/
+// Exported Function Declarations
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/** @brief Map image, created or grown to the chip size & filled with 0xFF */
+bool w25_emu_open(const char* path, W25_ID_t id,
+                  const w25_emu_timing_t* timing);
+
+/** @brief Sync & unmap image and wear counts */
+void w25_emu_close(void);
+
+uint32_t w25_emu_erase_count(uint32_t sector);
+uint32_t w25_emu_max_erase_count(void);
+
+const w25_emu_stats_t* w25_emu_stats(void);
+void                   w25_emu_clear_stats(void);
+
+/** @brief Virtual time since open */
+uint64_t w25_emu_time_us(void);
+
+/** @brief Direct access to the image, e.g. to corrupt it or check it */
+uint8_t* w25_emu_image(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // W25_EMU_H
@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "hub/cmux.h"
+#include "unity.h"
+
+static uint8_t        info[CMUX_N1];
+static uint8_t        out[2 * (CMUX_N1 + CMUX_FRAME_OVERHEAD)];
+static cmux_decoder_t dec;
+
+// Frames completed by feeding data, last one left in dec.frame
+static uint32_t feed(const uint8_t* data, uint16_t len) {
+    uint32_t frames = 0;
+
+    for (uint16_t i = 0; i < len; i++) {
+        if (cmux_decode(&dec, data[i])) {
+            frames++;
+        }
+    }
+
+    return frames;
+}
+
+void setUp(void) {
+    for (uint8_t i = 0; i < CMUX_N1; i++) {
+        info[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    cmux_decoder_reset(&dec);
+}
+
+void tearDown(void) {}
+
+void test_sabm_matches_spec(void) {
+    // Open DLCI 0, as in every GSM 07.10 trace
+    const uint8_t sabm[] = {0xF9, 0x03, 0x3F, 0x01, 0x1C, 0xF9};
+
+    TEST_ASSERT_EQUAL_UINT16(sizeof(sabm),
+                             cmux_encode(0, CMUX_SABM, NULL, 0, out));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sabm, out, sizeof(sabm));
+}
+
+void test_round_trip_every_dlci_and_length(void) {
+    for (uint8_t dlci = 0; dlci < 64; dlci++) {
+        for (uint8_t len = 0; len <= CMUX_N1; len++) {
+            uint16_t size = cmux_encode(dlci, CMUX_UIH, info, len, out);
+
+            TEST_ASSERT_EQUAL_UINT16(len + CMUX_FRAME_OVERHEAD, size);
+            TEST_ASSERT_EQUAL_UINT32(1, feed(out, size));
+            TEST_ASSERT_EQUAL_UINT8(dlci, dec.frame.dlci);
+            TEST_ASSERT_EQUAL_UINT8(CMUX_UIH, dec.frame.control);
+            TEST_ASSERT_EQUAL_UINT8(len, dec.frame.len);
+            if (len) {
+                TEST_ASSERT_EQUAL_UINT8_ARRAY(info, dec.frame.info, len);
+            }
+        }
+    }
+}
+
+void test_round_trip_control_frames(void) {
+    const uint8_t controls[] = {CMUX_SABM, CMUX_UA, CMUX_DM, CMUX_DISC};
+
+    for (uint8_t i = 0; i < sizeof(controls); i++) {
+        uint16_t size = cmux_encode(2, controls[i], NULL, 0, out);
+
+        TEST_ASSERT_EQUAL_UINT32(1, feed(out, size));
+        TEST_ASSERT_EQUAL_UINT8(2, dec.frame.dlci);
+        TEST_ASSERT_EQUAL_UINT8(controls[i],
+                                CMUX_CONTROL(dec.frame.control) | CMUX_PF);
+        TEST_ASSERT_EQUAL_UINT8(0, dec.frame.len);
+    }
+}
+
+void test_encode_clamps_to_n1(void) {
+    static uint8_t big[CMUX_N1 + 10];
+
+    TEST_ASSERT_EQUAL_UINT16(CMUX_N1 + CMUX_FRAME_OVERHEAD,
+                             cmux_encode(1, CMUX_UIH, big, sizeof(big), out));
+}
+
+void test_header_bit_error_rejected(void) {
+    uint16_t size = cmux_encode(1, CMUX_UIH, info, 16, out);
+
+    // Address, control, length & FCS. UIH FCS doesn't cover the info
+    for (uint8_t byte = 1; byte < 4; byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            out[byte] ^= (uint8_t)(1 << bit);
+            cmux_decoder_reset(&dec);
+
+            // A bad length may swallow the closing flag instead
+            TEST_ASSERT_EQUAL_UINT32(0, feed(out, size));
+
+            out[byte] ^= (uint8_t)(1 << bit);
+        }
+    }
+
+    out[size - 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_UINT32(0, feed(out, size));
+}
+
+void test_shared_flag_between_frames(void) {
+    uint16_t first = cmux_encode(1, CMUX_UIH, info, 10, out);
+
+    // Second frame starts on the first frame's closing flag
+    uint16_t second = cmux_encode(2, CMUX_UIH, &info[10], 20, &out[first - 1]);
+
+    TEST_ASSERT_EQUAL_UINT32(2, feed(out, first - 1 + second));
+    TEST_ASSERT_EQUAL_UINT8(2, dec.frame.dlci);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&info[10], dec.frame.info, 20);
+}
+
+void test_resyncs_after_noise(void) {
+    // Modem text before the mux is up is skipped
+    const uint8_t noise[] = "\r\nOK\r\n";
+
+    TEST_ASSERT_EQUAL_UINT32(0, feed(noise, sizeof(noise) - 1));
+
+    uint16_t size = cmux_encode(1, CMUX_UIH, info, 40, out);
+    TEST_ASSERT_EQUAL_UINT32(1, feed(out, size));
+
+    // Basic option has no escaping so a flag can't restart a frame, one cut
+    // short swallows the next & the one after is good
+    TEST_ASSERT_EQUAL_UINT32(0, feed(out, 20));
+    TEST_ASSERT_EQUAL_UINT32(0, feed(out, size));
+    TEST_ASSERT_EQUAL_UINT32(1, feed(out, size));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(info, dec.frame.info, 40);
+}
+
+int host_test_main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_sabm_matches_spec);
+    RUN_TEST(test_round_trip_every_dlci_and_length);
+    RUN_TEST(test_round_trip_control_frames);
+    RUN_TEST(test_encode_clamps_to_n1);
+    RUN_TEST(test_header_bit_error_rejected);
+    RUN_TEST(test_shared_flag_between_frames);
+    RUN_TEST(test_resyncs_after_noise);
+
+    return UNITY_END();
+}
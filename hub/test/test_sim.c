@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <libopencm3/cm3/nvic.h>
+
+#include "common/timers.h"
+#include "config/board_defs.h"
+#include "hub/sim.h"
+#include "uart_emu.h"
+#include "unity.h"
+
+// Peer delays cut down so a test takes seconds, sim.c still holds reset 1 s
+#define EMU_ARGS                                                               \
+    " --reg-delay 0.2 --bearer-delay 0.1 --action-delay 0.2 --response OK"
+
+// Longer than any single step in sim.c, bar HTTPACTION
+#define RUN_LIMIT_MS 30000
+
+#define URL "http://emu.local/api"
+#define MSG "dev=30000001&t=215&rh=40"
+
+static sim_state_t res;
+
+// Poll a state machine to the end, as net_task does
+#define RUN(call)                                                              \
+    do {                                                                       \
+        uint32_t start = timers_millis();                                      \
+        while (((res = (call)) == SIM_BUSY) &&                                 \
+               ((timers_millis() - start) < RUN_LIMIT_MS)) {                   \
+        }                                                                      \
+    } while (0)
+
+static void start(const char* args) {
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd), "%s%s%s", SIM800_EMU, EMU_ARGS, args);
+    TEST_ASSERT_TRUE(uart_emu_open(cmd, SIM_USART, usart2_isr));
+}
+
+static void connect(void) {
+    RUN(sim_init());
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+
+    RUN(sim_register_to_network());
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+
+    RUN(sim_open_bearer("emu.apn", "", ""));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+}
+
+void setUp(void) {}
+
+void tearDown(void) { uart_emu_close(); }
+
+void test_init_and_post(void) {
+    start("");
+    connect();
+
+    TEST_ASSERT_EQUAL_UINT32(SIM_USART_BAUD_FAST, sim800.baud);
+    TEST_ASSERT_EQUAL_UINT32(SIM_USART_BAUD_FAST, uart_emu_stats()->baud);
+#ifdef SIM_CMUX
+    TEST_ASSERT_TRUE(sim800.cmux);
+#else
+    TEST_ASSERT_FALSE(sim800.cmux);
+#endif
+
+    RUN(sim_http_post_str(URL, MSG, false, 1));
+
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+    TEST_ASSERT_EQUAL(HTTP_DONE, sim800.http.state);
+    TEST_ASSERT_EQUAL_UINT32(200, sim800.http.status_code);
+    TEST_ASSERT_EQUAL_UINT32(2, sim800.http.response_size);
+    TEST_ASSERT_EQUAL_UINT32(strlen(MSG), sim800.data.tx);
+    TEST_ASSERT_EQUAL_UINT32(0, sim800.rx_dropped);
+
+    // TX queued behind a busy shift register went out through the ISR
+    TEST_ASSERT_NOT_EQUAL(0, uart_emu_stats()->tx_irqs);
+}
+
+void test_silent_modem_times_out(void) {
+    start("");
+    connect();
+
+    uart_emu_hold_rx(true);
+
+    uint32_t start_ms = timers_millis();
+    RUN(sim_printf_and_check_response(300, "OK", "AT\r"));
+    uint32_t took = timers_millis() - start_ms;
+
+    TEST_ASSERT_EQUAL(SIM_TIMEOUT, res);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(300, took);
+    TEST_ASSERT_LESS_THAN_UINT32(2000, took);
+
+    // Talking again once the line comes back
+    uart_emu_hold_rx(false);
+
+    RUN(sim_printf_and_check_response(1000, "OK", "AT\r"));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+}
+
+void test_post_error_then_retry(void) {
+    start(" --fail +HTTPACTION:1");
+    connect();
+
+    RUN(sim_http_post_str(URL, MSG, false, 1));
+
+    TEST_ASSERT_EQUAL(SIM_ERROR, res);
+    TEST_ASSERT_EQUAL(HTTP_ERROR, sim800.http.state);
+
+    // Bearer & HTTP session set up again from scratch
+    RUN(sim_open_bearer("emu.apn", "", ""));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+
+    RUN(sim_http_post_str(URL, MSG, false, 1));
+
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+    TEST_ASSERT_EQUAL_UINT32(200, sim800.http.status_code);
+}
+
+#ifndef SIM_CMUX
+void test_slow_clock_stays_plain_at(void) {
+    // Any AT+CMUX gets ERROR & fails the wake
+    start(" --fail +CMUX");
+    connect();
+
+    RUN(sim_slow_clock(true));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+
+    RUN(sim_slow_clock(false));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+    TEST_ASSERT_FALSE(sim800.cmux);
+
+    // Modem not framing, plain AT still answered
+    RUN(sim_printf_and_check_response(1000, "OK", "AT\r"));
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+}
+#endif
+
+#ifdef SIM_CMUX
+void test_cmux_refused_falls_back(void) {
+    start(" --fail +CMUX");
+    connect();
+
+    TEST_ASSERT_FALSE(sim800.cmux);
+
+    RUN(sim_http_post_str(URL, MSG, false, 1));
+
+    TEST_ASSERT_EQUAL(SIM_SUCCESS, res);
+    TEST_ASSERT_EQUAL_UINT32(200, sim800.http.status_code);
+}
+#endif
+
+int host_test_main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_init_and_post);
+    RUN_TEST(test_silent_modem_times_out);
+    RUN_TEST(test_post_error_then_retry);
+#ifndef SIM_CMUX
+    RUN_TEST(test_slow_clock_stays_plain_at);
+#endif
+#ifdef SIM_CMUX
+    RUN_TEST(test_cmux_refused_falls_back);
+#endif
+
+    return UNITY_END();
+}
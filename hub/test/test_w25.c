@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "common/timers.h"
+#include "host.h"
+#include "hub/journal.h"
+#include "hub/w25qxx.h"
+#include "unity.h"
+#include "w25_emu.h"
+
+#define IMAGE "test_w25.img"
+
+#define RECS_PER_SECTOR (4096U / sizeof(journal_rec_t))
+
+static uint8_t buf[256];
+static uint8_t rd[256];
+
+static void open_image(void) {
+    TEST_ASSERT_TRUE(w25_emu_open(IMAGE, W25Q80, NULL));
+    TEST_ASSERT_TRUE(w25_Init());
+}
+
+static void wait_idle(void) {
+    while (w25_IsBusy()) {
+        timers_delay_milliseconds(1);
+    }
+}
+
+static journal_rec_t rec_for(uint32_t i) {
+    journal_rec_t rec = {.timestamp = 1000 + i,
+                         .dev_id = 30000000 + i,
+                         .temperature = (int16_t)i};
+    return rec;
+}
+
+void setUp(void) {
+    remove(IMAGE);
+    remove(IMAGE ".wear");
+
+    open_image();
+    w25_emu_clear_stats();
+}
+
+void tearDown(void) {
+    wait_idle();
+    w25_emu_close();
+}
+
+void test_program_reads_back(void) {
+    for (uint16_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)i;
+    }
+
+    TEST_ASSERT_TRUE(w25_IsEmptySector(5, 0, 0));
+
+    w25_WritePage(buf, w25_SectorToPage(5), 0, sizeof(buf));
+    w25_ReadPage(rd, w25_SectorToPage(5), 0, sizeof(rd));
+
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(buf, rd, sizeof(buf));
+    TEST_ASSERT_FALSE(w25_IsEmptySector(5, 0, 0));
+}
+
+void test_program_only_clears_bits(void) {
+    memset(buf, 0x0F, sizeof(buf));
+    w25_WritePage(buf, 0, 0, sizeof(buf));
+
+    // 1s can't come back without an erase, 0s still go
+    memset(buf, 0xF0, sizeof(buf));
+    w25_WritePage(buf, 0, 0, sizeof(buf));
+    w25_ReadPage(rd, 0, 0, sizeof(rd));
+
+    TEST_ASSERT_EACH_EQUAL_UINT8(0x00, rd, sizeof(rd));
+    TEST_ASSERT_NOT_EQUAL(0, w25_emu_stats()->bits_not_cleared);
+}
+
+void test_erase_blanks_sector_only(void) {
+    memset(buf, 0x00, sizeof(buf));
+    w25_WritePage(buf, w25_SectorToPage(5), 0, sizeof(buf));
+    w25_WritePage(buf, w25_SectorToPage(6), 0, sizeof(buf));
+
+    w25_EraseSector(5);
+
+    TEST_ASSERT_TRUE(w25_IsEmptySector(5, 0, 0));
+    TEST_ASSERT_FALSE(w25_IsEmptySector(6, 0, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, w25_emu_erase_count(5));
+    TEST_ASSERT_EQUAL_UINT32(0, w25_emu_erase_count(6));
+}
+
+void test_page_program_stays_in_page(void) {
+    memset(buf, 0xA5, sizeof(buf));
+
+    // Chip would wrap 100 bytes from offset 200, driver stops at the end
+    w25_WritePage(buf, 7, 200, 100);
+    w25_ReadPage(rd, 7, 0, sizeof(rd));
+
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xFF, rd, 200);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xA5, &rd[200], 56);
+    TEST_ASSERT_EQUAL_UINT32(56, w25_emu_stats()->bytes_programmed);
+}
+
+void test_read_during_erase_suspends(void) {
+    w25_WritePage((uint8_t*)"hello", 0, 0, 5);
+
+    TEST_ASSERT_TRUE(w25_EraseSectorStart(6));
+    TEST_ASSERT_TRUE(w25_IsBusy());
+
+    w25_ReadBytes(rd, 0, 5);
+
+    TEST_ASSERT_EQUAL_MEMORY("hello", rd, 5);
+    TEST_ASSERT_NOT_EQUAL(0, w25_emu_stats()->suspends);
+
+    wait_idle();
+    TEST_ASSERT_TRUE(w25_IsEmptySector(6, 0, 0));
+}
+
+void test_driver_keeps_the_rules(void) {
+    memset(buf, 0x5A, sizeof(buf));
+
+    for (uint32_t i = 0; i < 16; i++) {
+        w25_WritePage(buf, i, 0, sizeof(buf));
+    }
+    TEST_ASSERT_TRUE(w25_EraseSectorStart(0));
+    w25_ReadBytes(rd, w25_SectorToPage(1) * 256, sizeof(rd));
+    wait_idle();
+    w25_EraseBlock(1);
+
+    TEST_ASSERT_EQUAL_UINT32(0, w25_emu_stats()->wel_violations);
+    TEST_ASSERT_EQUAL_UINT32(0, w25_emu_stats()->busy_violations);
+}
+
+void test_journal_survives_remount(void) {
+    journal_rec_t rec;
+
+    TEST_ASSERT_TRUE(journal_init());
+
+    for (uint32_t i = 0; i < 300; i++) {
+        rec = rec_for(i);
+        TEST_ASSERT_TRUE(journal_append(&rec));
+        journal_poll();
+    }
+    journal_mark_uploaded(100);
+
+    wait_idle();
+    w25_emu_close();
+    open_image();
+
+    TEST_ASSERT_TRUE(journal_init());
+    TEST_ASSERT_EQUAL_UINT32(200, journal_pending());
+
+    TEST_ASSERT_TRUE(journal_peek(0, &rec));
+    TEST_ASSERT_EQUAL_UINT32(rec_for(100).dev_id, rec.dev_id);
+    TEST_ASSERT_TRUE(journal_peek(199, &rec));
+    TEST_ASSERT_EQUAL_UINT32(rec_for(299).dev_id, rec.dev_id);
+}
+
+void test_journal_ring_wears_evenly(void) {
+    journal_rec_t rec;
+
+    TEST_ASSERT_TRUE(journal_init());
+
+    // Twice round the ring, uploading as it goes
+    for (uint32_t i = 0; i < (2 * W25_JOURNAL_NUM_SECTORS * RECS_PER_SECTOR);
+         i++) {
+        rec = rec_for(i);
+        TEST_ASSERT_TRUE(journal_append(&rec));
+        journal_poll();
+
+        if (journal_pending() >= 64) {
+            journal_mark_uploaded(64);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, journal_pending());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3, w25_emu_max_erase_count());
+    TEST_ASSERT_EQUAL_UINT32(0, w25_emu_stats()->wel_violations);
+    TEST_ASSERT_EQUAL_UINT32(0, w25_emu_stats()->busy_violations);
+}
+
+int host_test_main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_program_reads_back);
+    RUN_TEST(test_program_only_clears_bits);
+    RUN_TEST(test_erase_blanks_sector_only);
+    RUN_TEST(test_page_program_stays_in_page);
+    RUN_TEST(test_read_during_erase_suspends);
+    RUN_TEST(test_driver_keeps_the_rules);
+    RUN_TEST(test_journal_survives_remount);
+    RUN_TEST(test_journal_ring_wears_evenly);
+
+    return UNITY_END();
+}
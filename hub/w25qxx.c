@@ -1,896 +1,970 @@
-#include "hub/w25qxx.h"
-
-#include <stdbool.h>
-#include <stdint.h>
-
-#include <libopencm3/cm3/nvic.h>
-#include <libopencm3/stm32/exti.h>
-#include <libopencm3/stm32/flash.h>
-#include <libopencm3/stm32/gpio.h>
-#include <libopencm3/stm32/rcc.h>
-#include <libopencm3/stm32/spi.h>
-#include <libopencm3/stm32/syscfg.h>
-
-#include "common/log.h"
-#include "common/timers.h"
-#include "config/board_defs.h"
-
-#define W25_DUMMY_BYTE 0xA5
-
-// SPI Comms Functions
-#define spi_chip_select()   gpio_clear(W25_SPI_NSS_PORT, W25_SPI_NSS)
-#define spi_chip_deselect() gpio_set(W25_SPI_NSS_PORT, W25_SPI_NSS)
-
-w25_t w25;
-
-static void spi_setup(void);
-
-bool w25_Init(void) {
-    spi_setup();
-
-    w25.Lock = 1;
-    timers_delay_microseconds(100);
-    spi_chip_deselect();
-    timers_delay_microseconds(100);
-
-    timers_delay_milliseconds(20);
-
-    uint32_t id;
-    serial_printf("w25 Init Begin...\r\n");
-
-    id = w25_ReadID();
-
-    serial_printf("w25 ID:0x%X\r\n", id);
-    switch (id & 0x0000FFFF) {
-    case 0x401A: // 	w25q512
-        w25.ID = W25Q512;
-        w25.BlockCount = 1024;
-        serial_printf("w25 Chip: w25q512\r\n");
-        break;
-    case 0x4019: // 	w25q256
-        w25.ID = W25Q256;
-        w25.BlockCount = 512;
-        serial_printf("w25 Chip: w25q256\r\n");
-        break;
-    case 0x4018: // 	w25q128
-        w25.ID = W25Q128;
-        w25.BlockCount = 256;
-        serial_printf("w25 Chip: w25q128\r\n");
-        break;
-    case 0x4017: //	w25q64
-        w25.ID = W25Q64;
-        w25.BlockCount = 128;
-        serial_printf("w25 Chip: w25q64\r\n");
-        break;
-    case 0x4016: //	w25q32
-        w25.ID = W25Q32;
-        w25.BlockCount = 64;
-        serial_printf("w25 Chip: w25q32\r\n");
-        break;
-    case 0x4015: //	w25q16
-        w25.ID = W25Q16;
-        w25.BlockCount = 32;
-        serial_printf("w25 Chip: w25q16\r\n");
-        break;
-    case 0x4014: //	w25q80
-        w25.ID = W25Q80;
-        w25.BlockCount = 16;
-        serial_printf("w25 Chip: w25q80\r\n");
-        break;
-    case 0x4013: //	w25q40
-        w25.ID = W25Q40;
-        w25.BlockCount = 8;
-        serial_printf("w25 Chip: w25q40\r\n");
-        break;
-    case 0x4012: //	w25q20
-        w25.ID = W25Q20;
-        w25.BlockCount = 4;
-        serial_printf("w25 Chip: w25q20\r\n");
-        break;
-    case 0x4011: //	w25q10
-        w25.ID = W25Q10;
-        w25.BlockCount = 2;
-        serial_printf("w25 Chip: w25q10\r\n");
-        break;
-    default:
-        serial_printf("w25 Unknown ID\r\n");
-        w25.Lock = 0;
-        return false;
-    }
-
-    w25.PageSize = 256;
-    w25.SectorSize = 0x1000;
-    w25.SectorCount = w25.BlockCount * 16;
-    w25.PageCount = (w25.SectorCount * w25.SectorSize) / w25.PageSize;
-    w25.BlockSize = w25.SectorSize * 16;
-    w25.CapacityInKiloByte = (w25.SectorCount * w25.SectorSize) / 1024;
-
-    w25_ReadUniqID();
-    w25_ReadStatusRegister(1);
-    w25_ReadStatusRegister(2);
-    w25_ReadStatusRegister(3);
-    serial_printf("w25 Page Size: %d Bytes\r\n", w25.PageSize);
-    serial_printf("w25 Sector Size: %d Bytes\r\n", w25.SectorSize);
-    serial_printf("w25 Sector Count: %d\r\n", w25.SectorCount);
-    serial_printf("w25 Block Size: %d Bytes\r\n", w25.BlockSize);
-    serial_printf("w25 Block Count: %d\r\n", w25.BlockCount);
-    serial_printf("w25 Capacity: %d KiloBytes\r\n", w25.CapacityInKiloByte);
-    serial_printf("w25 Init Done\r\n");
-
-    w25.Lock = 0;
-
-    return true;
-}
-
-// ###################################################################################################################
-
-uint32_t w25_ReadID(void) {
-    uint32_t Temp = 0, Temp0 = 0, Temp1 = 0, Temp2 = 0;
-
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    spi_xfer(W25_SPI, 0x9F);
-    Temp0 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-    Temp1 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-    Temp2 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-
-    Temp = (Temp0 << 16) | (Temp1 << 8) | Temp2;
-    return Temp;
-}
-
-void w25_ReadUniqID(void) {
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    spi_xfer(W25_SPI, 0x4B);
-
-    for (uint8_t i = 0; i < 4; i++)
-        spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-
-    for (uint8_t i = 0; i < 8; i++)
-        w25.UniqID[i] = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-}
-
-// ###################################################################################################################
-
-void w25_WriteEnable(void) {
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    spi_xfer(W25_SPI, 0x06);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-}
-void w25_WriteDisable(void) {
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x04);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    timers_delay_microseconds(1);
-}
-void w25_WaitForWriteEnd(void) {
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    spi_xfer(W25_SPI, 0x05);
-
-    do {
-        w25.StatusRegister1 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-        timers_delay_microseconds(10);
-    } while ((w25.StatusRegister1 & 0x01) == 0x01);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-}
-
-// ###################################################################################################################
-
-uint8_t w25_ReadStatusRegister(uint8_t SelectStatusRegister_1_2_3) {
-    uint8_t status = 0;
-
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    if (SelectStatusRegister_1_2_3 == 1) {
-        spi_xfer(W25_SPI, 0x05);
-        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-        w25.StatusRegister1 = status;
-    } else if (SelectStatusRegister_1_2_3 == 2) {
-        spi_xfer(W25_SPI, 0x35);
-        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-        w25.StatusRegister2 = status;
-    } else {
-        spi_xfer(W25_SPI, 0x15);
-        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-        w25.StatusRegister3 = status;
-    }
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-
-    return status;
-}
-void w25_WriteStatusRegister(uint8_t SelectStatusRegister_1_2_3, uint8_t Data) {
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    if (SelectStatusRegister_1_2_3 == 1) {
-        spi_xfer(W25_SPI, 0x01);
-        w25.StatusRegister1 = Data;
-    } else if (SelectStatusRegister_1_2_3 == 2) {
-        spi_xfer(W25_SPI, 0x31);
-        w25.StatusRegister2 = Data;
-    } else {
-        spi_xfer(W25_SPI, 0x11);
-        w25.StatusRegister3 = Data;
-    }
-
-    spi_xfer(W25_SPI, Data);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-}
-
-// ###################################################################################################################
-
-void w25_EraseChip(void) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-
-    // uint32_t	StartTime=HAL_GetTick();
-    serial_printf("w25 EraseChip Begin...\r\n");
-
-    w25_WriteEnable();
-
-    spi_chip_select();
-    timers_delay_microseconds(1);
-
-    spi_xfer(W25_SPI, 0xC7);
-
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-
-    w25_WaitForWriteEnd();
-
-    // serial_printf("w25 EraseBlock done after %d
-    // ms!\r\n",HAL_GetTick()-StartTime);
-
-    timers_delay_microseconds(10);
-
-    w25.Lock = 0;
-}
-void w25_EraseSector(uint32_t SectorAddr) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    // uint32_t	StartTime=HAL_GetTick();
-    serial_printf("w25 EraseSector %d Begin...\r\n", SectorAddr);
-    w25_WaitForWriteEnd();
-    SectorAddr = SectorAddr * w25.SectorSize;
-    w25_WriteEnable();
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x20);
-    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (SectorAddr & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (SectorAddr & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (SectorAddr & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, SectorAddr & 0xFF);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    w25_WaitForWriteEnd();
-    // serial_printf("w25 EraseSector done after %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    timers_delay_microseconds(1);
-    w25.Lock = 0;
-}
-void w25_EraseBlock(uint32_t BlockAddr) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    serial_printf("w25 EraseBlock %d Begin...\r\n", BlockAddr);
-    // uint32_t	StartTime=HAL_GetTick();
-    w25_WaitForWriteEnd();
-    BlockAddr = BlockAddr * w25.SectorSize * 16;
-    w25_WriteEnable();
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0xD8);
-    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (BlockAddr & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (BlockAddr & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (BlockAddr & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, BlockAddr & 0xFF);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    w25_WaitForWriteEnd();
-    // serial_printf("w25 EraseBlock done after %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    timers_delay_microseconds(1);
-    w25.Lock = 0;
-}
-
-// ###################################################################################################################
-
-uint32_t w25_PageToSector(uint32_t PageAddress) {
-    return ((PageAddress * w25.PageSize) / w25.SectorSize);
-}
-uint32_t w25_PageToBlock(uint32_t PageAddress) {
-    return ((PageAddress * w25.PageSize) / w25.BlockSize);
-}
-uint32_t w25_SectorToBlock(uint32_t SectorAddress) {
-    return ((SectorAddress * w25.SectorSize) / w25.BlockSize);
-}
-uint32_t w25_SectorToPage(uint32_t SectorAddress) {
-    return (SectorAddress * w25.SectorSize) / w25.PageSize;
-}
-uint32_t w25_BlockToPage(uint32_t BlockAddress) {
-    return (BlockAddress * w25.BlockSize) / w25.PageSize;
-}
-
-// ###################################################################################################################
-
-bool w25_IsEmptyPage(uint32_t Page_Address, uint32_t OffsetInByte,
-                     uint32_t NumByteToCheck_up_to_PageSize) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    if (((NumByteToCheck_up_to_PageSize + OffsetInByte) > w25.PageSize) ||
-        (NumByteToCheck_up_to_PageSize == 0))
-        NumByteToCheck_up_to_PageSize = w25.PageSize - OffsetInByte;
-    serial_printf("w25 CheckPage:%d, Offset:%d, Bytes:%d begin...\r\n",
-                  Page_Address, OffsetInByte, NumByteToCheck_up_to_PageSize);
-    // uint32_t	StartTime=HAL_GetTick();
-    uint8_t  pBuffer[32];
-    uint32_t WorkAddress;
-    uint32_t i;
-    for (i = OffsetInByte; i < w25.PageSize; i += sizeof(pBuffer)) {
-        spi_chip_select();
-        timers_delay_microseconds(1);
-        WorkAddress = (i + Page_Address * w25.PageSize);
-        spi_xfer(W25_SPI, 0x0B);
-        if (w25.ID >= W25Q256) {
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-        }
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-        spi_xfer(W25_SPI, WorkAddress & 0xFF);
-        spi_xfer(W25_SPI, 0);
-        // HAL_SPI_Receive(&_W25_SPI,pBuffer,sizeof(pBuffer),100);
-        spi_chip_deselect();
-        timers_delay_microseconds(1);
-        for (uint8_t x = 0; x < sizeof(pBuffer); x++) {
-            if (pBuffer[x] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    if ((w25.PageSize + OffsetInByte) % sizeof(pBuffer) != 0) {
-        i -= sizeof(pBuffer);
-        for (; i < w25.PageSize; i++) {
-            spi_chip_select();
-            timers_delay_microseconds(1);
-            WorkAddress = (i + Page_Address * w25.PageSize);
-            spi_xfer(W25_SPI, 0x0B);
-            if (w25.ID >= W25Q256)
-                spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-            spi_xfer(W25_SPI, WorkAddress & 0xFF);
-            spi_xfer(W25_SPI, 0);
-            // HAL_SPI_Receive(&_W25_SPI,pBuffer,1,100);
-            spi_chip_deselect();
-            timers_delay_microseconds(1);
-            if (pBuffer[0] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    // serial_printf("w25 CheckPage is Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-    return true;
-    // NOT_EMPTY:
-    // serial_printf("w25 CheckPage is Not Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-    return false;
-}
-bool w25_IsEmptySector(uint32_t Sector_Address, uint32_t OffsetInByte,
-                       uint32_t NumByteToCheck_up_to_SectorSize) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    if ((NumByteToCheck_up_to_SectorSize > w25.SectorSize) ||
-        (NumByteToCheck_up_to_SectorSize == 0))
-        NumByteToCheck_up_to_SectorSize = w25.SectorSize;
-    serial_printf("w25 CheckSector:%d, Offset:%d, Bytes:%d begin...\r\n",
-                  Sector_Address, OffsetInByte,
-                  NumByteToCheck_up_to_SectorSize);
-    // uint32_t	StartTime=HAL_GetTick();
-    uint8_t  pBuffer[32];
-    uint32_t WorkAddress;
-    uint32_t i;
-    for (i = OffsetInByte; i < w25.SectorSize; i += sizeof(pBuffer)) {
-        spi_chip_select();
-        timers_delay_microseconds(1);
-        WorkAddress = (i + Sector_Address * w25.SectorSize);
-        spi_xfer(W25_SPI, 0x0B);
-        if (w25.ID >= W25Q256)
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-        spi_xfer(W25_SPI, WorkAddress & 0xFF);
-        spi_xfer(W25_SPI, 0);
-        // HAL_SPI_Receive(&_W25_SPI,pBuffer,sizeof(pBuffer),100);
-        spi_chip_deselect();
-        timers_delay_microseconds(1);
-        for (uint8_t x = 0; x < sizeof(pBuffer); x++) {
-            if (pBuffer[x] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    if ((w25.SectorSize + OffsetInByte) % sizeof(pBuffer) != 0) {
-        i -= sizeof(pBuffer);
-        for (; i < w25.SectorSize; i++) {
-            spi_chip_select();
-            timers_delay_microseconds(1);
-            WorkAddress = (i + Sector_Address * w25.SectorSize);
-            spi_xfer(W25_SPI, 0x0B);
-            if (w25.ID >= W25Q256)
-                spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-            spi_xfer(W25_SPI, WorkAddress & 0xFF);
-            spi_xfer(W25_SPI, 0);
-            // HAL_SPI_Receive(&_W25_SPI,pBuffer,1,100);
-            spi_chip_deselect();
-            timers_delay_microseconds(1);
-            if (pBuffer[0] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    // serial_printf("w25 CheckSector is Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-    return true;
-    // serial_printf("w25 CheckSector is Not Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-    return false;
-}
-bool w25_IsEmptyBlock(uint32_t Block_Address, uint32_t OffsetInByte,
-                      uint32_t NumByteToCheck_up_to_BlockSize) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    if ((NumByteToCheck_up_to_BlockSize > w25.BlockSize) ||
-        (NumByteToCheck_up_to_BlockSize == 0))
-        NumByteToCheck_up_to_BlockSize = w25.BlockSize;
-    serial_printf("w25 CheckBlock:%d, Offset:%d, Bytes:%d begin...\r\n",
-                  Block_Address, OffsetInByte, NumByteToCheck_up_to_BlockSize);
-    // uint32_t	StartTime=HAL_GetTick();
-    uint8_t  pBuffer[32];
-    uint32_t WorkAddress;
-    uint32_t i;
-    for (i = OffsetInByte; i < w25.BlockSize; i += sizeof(pBuffer)) {
-        spi_chip_select();
-        timers_delay_microseconds(1);
-        WorkAddress = (i + Block_Address * w25.BlockSize);
-        spi_xfer(W25_SPI, 0x0B);
-        if (w25.ID >= W25Q256)
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-        spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-        spi_xfer(W25_SPI, WorkAddress & 0xFF);
-        spi_xfer(W25_SPI, 0);
-        // HAL_SPI_Receive(&_W25_SPI,pBuffer,sizeof(pBuffer),100);
-        spi_chip_deselect();
-        timers_delay_microseconds(1);
-        for (uint8_t x = 0; x < sizeof(pBuffer); x++) {
-            if (pBuffer[x] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    if ((w25.BlockSize + OffsetInByte) % sizeof(pBuffer) != 0) {
-        i -= sizeof(pBuffer);
-        for (; i < w25.BlockSize; i++) {
-            spi_chip_select();
-            timers_delay_microseconds(1);
-            WorkAddress = (i + Block_Address * w25.BlockSize);
-            spi_xfer(W25_SPI, 0x0B);
-            if (w25.ID >= W25Q256)
-                spi_xfer(W25_SPI, (WorkAddress & 0xFF000000) >> 24);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF0000) >> 16);
-            spi_xfer(W25_SPI, (WorkAddress & 0xFF00) >> 8);
-            spi_xfer(W25_SPI, WorkAddress & 0xFF);
-            spi_xfer(W25_SPI, 0);
-            // HAL_SPI_Receive(&_W25_SPI,pBuffer,1,100);
-            spi_chip_deselect();
-            timers_delay_microseconds(1);
-            if (pBuffer[0] != 0xFF) {
-            }
-            // goto NOT_EMPTY;
-        }
-    }
-    // serial_printf("w25 CheckBlock is Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-
-    w25.Lock = 0;
-    return true;
-    // NOT_EMPTY:
-    // serial_printf("w25 CheckBlock is Not Empty in %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-
-    w25.Lock = 0;
-    return false;
-}
-
-// ###################################################################################################################
-
-void w25_WriteByte(uint8_t pBuffer, uint32_t WriteAddr_inBytes) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-
-    // uint32_t	StartTime=HAL_GetTick();
-    serial_printf("w25 WriteByte 0x%02X at address %d begin...", pBuffer,
-                  WriteAddr_inBytes);
-
-    w25_WaitForWriteEnd();
-    w25_WriteEnable();
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x02);
-    if (w25.ID >= W25Q256)
-        spi_xfer(W25_SPI, (WriteAddr_inBytes & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (WriteAddr_inBytes & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (WriteAddr_inBytes & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, WriteAddr_inBytes & 0xFF);
-    spi_xfer(W25_SPI, pBuffer);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    w25_WaitForWriteEnd();
-    // serial_printf("w25 WriteByte done after %d
-    // ms\r\n",HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-}
-void w25_WritePage(uint8_t* pBuffer, uint32_t Page_Address,
-                   uint32_t OffsetInByte,
-                   uint32_t NumByteToWrite_up_to_PageSize) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    if (((NumByteToWrite_up_to_PageSize + OffsetInByte) > w25.PageSize) ||
-        (NumByteToWrite_up_to_PageSize == 0))
-        NumByteToWrite_up_to_PageSize = w25.PageSize - OffsetInByte;
-    if ((OffsetInByte + NumByteToWrite_up_to_PageSize) > w25.PageSize)
-        NumByteToWrite_up_to_PageSize = w25.PageSize - OffsetInByte;
-    serial_printf("w25 WritePage:%d, Offset:%d ,Writes %d Bytes, begin...\r\n",
-                  Page_Address, OffsetInByte, NumByteToWrite_up_to_PageSize);
-// uint32_t	StartTime=HAL_GetTick();
-#
-    w25_WaitForWriteEnd();
-    w25_WriteEnable();
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x02);
-    Page_Address = (Page_Address * w25.PageSize) + OffsetInByte;
-    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (Page_Address & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (Page_Address & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (Page_Address & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, Page_Address & 0xFF);
-    // HAL_SPI_Transmit(&_W25_SPI,pBuffer,NumByteToWrite_up_to_PageSize,100);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    w25_WaitForWriteEnd();
-
-    // StartTime = HAL_GetTick()-StartTime;
-    for (uint32_t i = 0; i < NumByteToWrite_up_to_PageSize; i++) {
-        if ((i % 8 == 0) && (i > 2)) {
-            serial_printf("\r\n");
-            timers_delay_microseconds(10);
-        }
-        serial_printf("0x%02X,", pBuffer[i]);
-    }
-    serial_printf("\r\n");
-    // serial_printf("w25 WritePage done after %d ms\r\n",StartTime);
-    timers_delay_microseconds(100);
-#
-    timers_delay_microseconds(1);
-    w25.Lock = 0;
-}
-void w25_WriteSector(uint8_t* pBuffer, uint32_t Sector_Address,
-                     uint32_t OffsetInByte,
-                     uint32_t NumByteToWrite_up_to_SectorSize) {
-    if ((NumByteToWrite_up_to_SectorSize > w25.SectorSize) ||
-        (NumByteToWrite_up_to_SectorSize == 0))
-        NumByteToWrite_up_to_SectorSize = w25.SectorSize;
-    serial_printf(
-        "+++w25 WriteSector:%d, Offset:%d ,Write %d Bytes, begin...\r\n",
-        Sector_Address, OffsetInByte, NumByteToWrite_up_to_SectorSize);
-#
-    if (OffsetInByte >= w25.SectorSize) {
-        serial_printf("---w25 WriteSector Faild!\r\n");
-
-        return;
-    }
-    uint32_t StartPage;
-    int32_t  BytesToWrite;
-    uint32_t LocalOffset;
-    if ((OffsetInByte + NumByteToWrite_up_to_SectorSize) > w25.SectorSize)
-        BytesToWrite = w25.SectorSize - OffsetInByte;
-    else
-        BytesToWrite = NumByteToWrite_up_to_SectorSize;
-    StartPage =
-        w25_SectorToPage(Sector_Address) + (OffsetInByte / w25.PageSize);
-    LocalOffset = OffsetInByte % w25.PageSize;
-    do {
-        w25_WritePage(pBuffer, StartPage, LocalOffset, BytesToWrite);
-        StartPage++;
-        BytesToWrite -= w25.PageSize - LocalOffset;
-        pBuffer += w25.PageSize - LocalOffset;
-        LocalOffset = 0;
-    } while (BytesToWrite > 0);
-    serial_printf("---w25 WriteSector Done\r\n");
-}
-void w25_WriteBlock(uint8_t* pBuffer, uint32_t Block_Address,
-                    uint32_t OffsetInByte,
-                    uint32_t NumByteToWrite_up_to_BlockSize) {
-    if ((NumByteToWrite_up_to_BlockSize > w25.BlockSize) ||
-        (NumByteToWrite_up_to_BlockSize == 0))
-        NumByteToWrite_up_to_BlockSize = w25.BlockSize;
-    serial_printf(
-        "+++w25 WriteBlock:%d, Offset:%d ,Write %d Bytes, begin...\r\n",
-        Block_Address, OffsetInByte, NumByteToWrite_up_to_BlockSize);
-
-    if (OffsetInByte >= w25.BlockSize) {
-        serial_printf("---w25 WriteBlock Faild!\r\n");
-
-        return;
-    }
-    uint32_t StartPage;
-    int32_t  BytesToWrite;
-    uint32_t LocalOffset;
-    if ((OffsetInByte + NumByteToWrite_up_to_BlockSize) > w25.BlockSize)
-        BytesToWrite = w25.BlockSize - OffsetInByte;
-    else
-        BytesToWrite = NumByteToWrite_up_to_BlockSize;
-    StartPage = w25_BlockToPage(Block_Address) + (OffsetInByte / w25.PageSize);
-    LocalOffset = OffsetInByte % w25.PageSize;
-    do {
-        w25_WritePage(pBuffer, StartPage, LocalOffset, BytesToWrite);
-        StartPage++;
-        BytesToWrite -= w25.PageSize - LocalOffset;
-        pBuffer += w25.PageSize - LocalOffset;
-        LocalOffset = 0;
-    } while (BytesToWrite > 0);
-    serial_printf("---w25 WriteBlock Done\r\n");
-}
-
-// ###################################################################################################################
-
-void w25_ReadByte(uint8_t* pBuffer, uint32_t Bytes_Address) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-
-    // uint32_t	StartTime=HAL_GetTick();
-    serial_printf("w25 ReadByte at address %d begin...\r\n", Bytes_Address);
-
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x0B);
-    if (w25.ID >= W25Q256)
-        spi_xfer(W25_SPI, (Bytes_Address & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (Bytes_Address & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (Bytes_Address & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, Bytes_Address & 0xFF);
-    spi_xfer(W25_SPI, 0);
-    *pBuffer = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-    // serial_printf("w25 ReadByte 0x%02X done after %d
-    // ms\r\n",*pBuffer,HAL_GetTick()-StartTime);
-    w25.Lock = 0;
-}
-void w25_ReadBytes(uint8_t* pBuffer, uint32_t ReadAddr,
-                   uint32_t NumByteToRead) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-
-    // uint32_t	StartTime=HAL_GetTick();
-    serial_printf("w25 ReadBytes at Address:%d, %d Bytes  begin...\r\n",
-                  ReadAddr, NumByteToRead);
-
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x0B);
-    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (ReadAddr & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (ReadAddr & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (ReadAddr & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, ReadAddr & 0xFF);
-    spi_xfer(W25_SPI, 0);
-    // HAL_SPI_Receive(&_W25_SPI,pBuffer,NumByteToRead,2000);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-
-    // StartTime = HAL_GetTick()-StartTime;
-    for (uint32_t i = 0; i < NumByteToRead; i++) {
-        if ((i % 8 == 0) && (i > 2)) {
-            serial_printf("\r\n");
-            timers_delay_microseconds(10);
-        }
-        serial_printf("0x%02X,", pBuffer[i]);
-    }
-    serial_printf("\r\n");
-    // serial_printf("w25 ReadBytes done after %d ms\r\n",StartTime);
-    timers_delay_microseconds(100);
-
-    timers_delay_microseconds(1);
-    w25.Lock = 0;
-}
-void w25_ReadPage(uint8_t* pBuffer, uint32_t Page_Address,
-                  uint32_t OffsetInByte,
-                  uint32_t NumByteToRead_up_to_PageSize) {
-    while (w25.Lock == 1)
-        timers_delay_microseconds(1);
-    w25.Lock = 1;
-    if ((NumByteToRead_up_to_PageSize > w25.PageSize) ||
-        (NumByteToRead_up_to_PageSize == 0))
-        NumByteToRead_up_to_PageSize = w25.PageSize;
-    if ((OffsetInByte + NumByteToRead_up_to_PageSize) > w25.PageSize)
-        NumByteToRead_up_to_PageSize = w25.PageSize - OffsetInByte;
-    serial_printf("w25 ReadPage:%d, Offset:%d ,Read %d Bytes, begin...\r\n",
-                  Page_Address, OffsetInByte, NumByteToRead_up_to_PageSize);
-    // uint32_t	StartTime=HAL_GetTick();
-
-    Page_Address = Page_Address * w25.PageSize + OffsetInByte;
-    spi_chip_select();
-    timers_delay_microseconds(1);
-    spi_xfer(W25_SPI, 0x0B);
-    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (Page_Address & 0xFF000000) >> 24);
-    spi_xfer(W25_SPI, (Page_Address & 0xFF0000) >> 16);
-    spi_xfer(W25_SPI, (Page_Address & 0xFF00) >> 8);
-    spi_xfer(W25_SPI, Page_Address & 0xFF);
-    spi_xfer(W25_SPI, 0);
-    // HAL_SPI_Receive(&_W25_SPI,pBuffer,NumByteToRead_up_to_PageSize,100);
-    spi_chip_deselect();
-    timers_delay_microseconds(1);
-
-    // StartTime = HAL_GetTick()-StartTime;
-    for (uint32_t i = 0; i < NumByteToRead_up_to_PageSize; i++) {
-        if ((i % 8 == 0) && (i > 2)) {
-            serial_printf("\r\n");
-            timers_delay_microseconds(10);
-        }
-        serial_printf("0x%02X,", pBuffer[i]);
-    }
-    serial_printf("\r\n");
-    // serial_printf("w25 ReadPage done after %d ms\r\n",StartTime);
-    timers_delay_microseconds(100);
-
-    timers_delay_microseconds(1);
-    w25.Lock = 0;
-}
-void w25_ReadSector(uint8_t* pBuffer, uint32_t Sector_Address,
-                    uint32_t OffsetInByte,
-                    uint32_t NumByteToRead_up_to_SectorSize) {
-    if ((NumByteToRead_up_to_SectorSize > w25.SectorSize) ||
-        (NumByteToRead_up_to_SectorSize == 0))
-        NumByteToRead_up_to_SectorSize = w25.SectorSize;
-    serial_printf(
-        "+++w25 ReadSector:%d, Offset:%d ,Read %d Bytes, begin...\r\n",
-        Sector_Address, OffsetInByte, NumByteToRead_up_to_SectorSize);
-
-    if (OffsetInByte >= w25.SectorSize) {
-        serial_printf("---w25 ReadSector Faild!\r\n");
-
-        return;
-    }
-    uint32_t StartPage;
-    int32_t  BytesToRead;
-    uint32_t LocalOffset;
-    if ((OffsetInByte + NumByteToRead_up_to_SectorSize) > w25.SectorSize)
-        BytesToRead = w25.SectorSize - OffsetInByte;
-    else
-        BytesToRead = NumByteToRead_up_to_SectorSize;
-    StartPage =
-        w25_SectorToPage(Sector_Address) + (OffsetInByte / w25.PageSize);
-    LocalOffset = OffsetInByte % w25.PageSize;
-    do {
-        w25_ReadPage(pBuffer, StartPage, LocalOffset, BytesToRead);
-        StartPage++;
-        BytesToRead -= w25.PageSize - LocalOffset;
-        pBuffer += w25.PageSize - LocalOffset;
-        LocalOffset = 0;
-    } while (BytesToRead > 0);
-    serial_printf("---w25 ReadSector Done\r\n");
-}
-void w25_ReadBlock(uint8_t* pBuffer, uint32_t Block_Address,
-                   uint32_t OffsetInByte,
-                   uint32_t NumByteToRead_up_to_BlockSize) {
-    if ((NumByteToRead_up_to_BlockSize > w25.BlockSize) ||
-        (NumByteToRead_up_to_BlockSize == 0))
-        NumByteToRead_up_to_BlockSize = w25.BlockSize;
-    serial_printf("+++w25 ReadBlock:%d, Offset:%d ,Read %d Bytes, begin...\r\n",
-                  Block_Address, OffsetInByte, NumByteToRead_up_to_BlockSize);
-
-    if (OffsetInByte >= w25.BlockSize) {
-        serial_printf("w25 ReadBlock Faild!\r\n");
-
-        return;
-    }
-    uint32_t StartPage;
-    int32_t  BytesToRead;
-    uint32_t LocalOffset;
-    if ((OffsetInByte + NumByteToRead_up_to_BlockSize) > w25.BlockSize)
-        BytesToRead = w25.BlockSize - OffsetInByte;
-    else
-        BytesToRead = NumByteToRead_up_to_BlockSize;
-    StartPage = w25_BlockToPage(Block_Address) + (OffsetInByte / w25.PageSize);
-    LocalOffset = OffsetInByte % w25.PageSize;
-    do {
-        w25_ReadPage(pBuffer, StartPage, LocalOffset, BytesToRead);
-        StartPage++;
-        BytesToRead -= w25.PageSize - LocalOffset;
-        pBuffer += w25.PageSize - LocalOffset;
-        LocalOffset = 0;
-    } while (BytesToRead > 0);
-    serial_printf("---w25 ReadBlock Done\r\n");
-}
-
-// ###################################################################################################################
-
-// Static Function Definitions
-
-static void spi_setup(void) {
-    // Set GPIO Mode
-    gpio_mode_setup(W25_SPI_MISO_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
-                    W25_SPI_MISO);
-
-    gpio_mode_setup(W25_SPI_SCK_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
-                    W25_SPI_SCK);
-    gpio_mode_setup(W25_SPI_MOSI_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
-                    W25_SPI_MOSI);
-    gpio_mode_setup(W25_SPI_NSS_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
-                    W25_SPI_NSS);
-
-    // Push Pull for outputs
-    gpio_set_output_options(W25_SPI_SCK_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
-                            W25_SPI_SCK);
-    gpio_set_output_options(W25_SPI_MOSI_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
-                            W25_SPI_MOSI);
-    gpio_set_output_options(W25_SPI_NSS_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
-                            W25_SPI_NSS);
-
-    // Set NSS pin high
-    gpio_set(W25_SPI_NSS_PORT, W25_SPI_NSS);
-
-    // Set alternate function
-    gpio_set_af(W25_SPI_MISO_PORT, W25_SPI_AF, W25_SPI_MISO);
-
-    gpio_set_af(W25_SPI_SCK_PORT, W25_SPI_AF, W25_SPI_SCK);
-    gpio_set_af(W25_SPI_MOSI_PORT, W25_SPI_AF, W25_SPI_MOSI);
-
-    // Init SPI
-    rcc_periph_clock_enable(W25_SPI_RCC);
-    rcc_periph_reset_pulse(W25_SPI_RST);
-    spi_disable(W25_SPI);
-    spi_init_master(
-        W25_SPI, SPI_CR1_BAUDRATE_FPCLK_DIV_2, SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE,
-        SPI_CR1_CPHA_CLK_TRANSITION_1, SPI_CR1_DFF_8BIT, SPI_CR1_MSBFIRST);
-    spi_enable(W25_SPI);
-}
+#include "hub/w25qxx.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/syscfg.h>
+
+#include "common/log.h"
+#include "common/timers.h"
+#include "config/board_defs.h"
+
+#define W25_DUMMY_BYTE 0xA5
+
+// Every operation is logged at LOG_DBG, which slows transfers right down so
+// is off unless asked for with -DW25_LOG_LEVEL=LOG_DBG
+#ifndef W25_LOG_LEVEL
+#define W25_LOG_LEVEL LOG_INFO
+#endif
+
+#define W25_LOG(level, ...)   LOG_AT(level, W25_LOG_LEVEL, __VA_ARGS__)
+#define W25_LOG_S(level, ...) LOG_AT_S(level, W25_LOG_LEVEL, __VA_ARGS__)
+
+// Largest single DMA transfer, CNDTR is 16 bit
+#define W25_DMA_MAX 0x8000
+
+// Read back in chunks this size when checking for erased bytes
+#define W25_CHECK_CHUNK 64
+
+// Let a suspended erase run this long before suspending it again, back to
+// back reads would otherwise stop it ever finishing
+#define W25_RESUME_GAP_MS 1
+
+#define W25_SR1_BUSY 0x01
+
+#define W25_MAP_BYTES ((W25_MAP_NUM_SECTORS + 7) / 8)
+
+// SPI Comms Functions
+#define spi_chip_select()   gpio_clear(W25_SPI_NSS_PORT, W25_SPI_NSS)
+#define spi_chip_deselect() gpio_set(W25_SPI_NSS_PORT, W25_SPI_NSS)
+
+w25_t w25;
+
+static const uint8_t dma_tx_dummy = W25_DUMMY_BYTE;
+static uint8_t       dma_rx_dummy;
+
+static uint32_t resume_time;
+
+// Erased map, bit set in map_known once the sector's state is known
+static uint8_t map_known[W25_MAP_BYTES];
+static uint8_t map_erased[W25_MAP_BYTES];
+
+static void spi_setup(void);
+static void spi_dma_xfer(const uint8_t* tx, uint8_t* rx, uint32_t len);
+static void send_cmd_addr(uint8_t cmd, uint32_t addr);
+static void read_data(uint8_t* pBuffer, uint32_t addr, uint32_t len);
+static bool is_empty(uint32_t addr, uint32_t len);
+static void dump(const uint8_t* pBuffer, uint32_t len);
+static void wait_busy(void);
+static void start_erase(uint8_t cmd, uint32_t addr);
+static void program(uint8_t* pBuffer, uint32_t addr, uint32_t len);
+static bool hold_pending(void);
+static void resume(void);
+static void map_set(uint32_t first, uint32_t num, W25_SectorState_t state);
+static bool all_erased(uint32_t first, uint32_t num);
+
+bool w25_Init(void) {
+    spi_setup();
+
+    w25.Lock = 1;
+    timers_delay_microseconds(100);
+    spi_chip_deselect();
+    timers_delay_microseconds(100);
+
+    timers_delay_milliseconds(20);
+
+    uint32_t id;
+    W25_LOG(LOG_DBG, "w25 Init Begin...\r\n");
+
+    id = w25_ReadID();
+
+    W25_LOG(LOG_DBG, "w25 ID:0x%X\r\n", id);
+    switch (id & 0x0000FFFF) {
+    case 0x401A: // 	w25q512
+        w25.ID = W25Q512;
+        w25.BlockCount = 1024;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q512\r\n");
+        break;
+    case 0x4019: // 	w25q256
+        w25.ID = W25Q256;
+        w25.BlockCount = 512;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q256\r\n");
+        break;
+    case 0x4018: // 	w25q128
+        w25.ID = W25Q128;
+        w25.BlockCount = 256;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q128\r\n");
+        break;
+    case 0x4017: //	w25q64
+        w25.ID = W25Q64;
+        w25.BlockCount = 128;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q64\r\n");
+        break;
+    case 0x4016: //	w25q32
+        w25.ID = W25Q32;
+        w25.BlockCount = 64;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q32\r\n");
+        break;
+    case 0x4015: //	w25q16
+        w25.ID = W25Q16;
+        w25.BlockCount = 32;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q16\r\n");
+        break;
+    case 0x4014: //	w25q80
+        w25.ID = W25Q80;
+        w25.BlockCount = 16;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q80\r\n");
+        break;
+    case 0x4013: //	w25q40
+        w25.ID = W25Q40;
+        w25.BlockCount = 8;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q40\r\n");
+        break;
+    case 0x4012: //	w25q20
+        w25.ID = W25Q20;
+        w25.BlockCount = 4;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q20\r\n");
+        break;
+    case 0x4011: //	w25q10
+        w25.ID = W25Q10;
+        w25.BlockCount = 2;
+        W25_LOG(LOG_DBG, "w25 Chip: w25q10\r\n");
+        break;
+    default:
+        serial_printf("w25 Unknown ID 0x%X\r\n", id);
+        w25.Lock = 0;
+        return false;
+    }
+
+    w25.PageSize = 256;
+    w25.SectorSize = 0x1000;
+    w25.SectorCount = w25.BlockCount * 16;
+    w25.PageCount = (w25.SectorCount * w25.SectorSize) / w25.PageSize;
+    w25.BlockSize = w25.SectorSize * 16;
+    w25.CapacityInKiloByte = (w25.SectorCount * w25.SectorSize) / 1024;
+
+    // Could have been written by anything before now
+    map_set(0, W25_MAP_NUM_SECTORS, W25_SECTOR_UNKNOWN);
+
+    // Erase may still be running from before a reset
+    w25_WaitForWriteEnd();
+
+    w25_ReadUniqID();
+    w25_ReadStatusRegister(1);
+    w25_ReadStatusRegister(2);
+    w25_ReadStatusRegister(3);
+    W25_LOG(LOG_DBG, "w25 Page Size: %d Bytes\r\n", w25.PageSize);
+    W25_LOG(LOG_DBG, "w25 Sector Size: %d Bytes\r\n", w25.SectorSize);
+    W25_LOG(LOG_DBG, "w25 Sector Count: %d\r\n", w25.SectorCount);
+    W25_LOG(LOG_DBG, "w25 Block Size: %d Bytes\r\n", w25.BlockSize);
+    W25_LOG(LOG_DBG, "w25 Block Count: %d\r\n", w25.BlockCount);
+    serial_printf("w25 Capacity: %d KiloBytes\r\n", w25.CapacityInKiloByte);
+
+    w25.Lock = 0;
+
+    return true;
+}
+
+// ###################################################################################################################
+
+uint32_t w25_ReadID(void) {
+    uint32_t Temp = 0, Temp0 = 0, Temp1 = 0, Temp2 = 0;
+
+    spi_chip_select();
+
+    spi_xfer(W25_SPI, 0x9F);
+    Temp0 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+    Temp1 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+    Temp2 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+
+    spi_chip_deselect();
+
+    Temp = (Temp0 << 16) | (Temp1 << 8) | Temp2;
+    return Temp;
+}
+
+void w25_ReadUniqID(void) {
+    spi_chip_select();
+
+    spi_xfer(W25_SPI, 0x4B);
+
+    for (uint8_t i = 0; i < 4; i++)
+        spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+
+    for (uint8_t i = 0; i < 8; i++)
+        w25.UniqID[i] = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+
+    spi_chip_deselect();
+}
+
+// ###################################################################################################################
+
+void w25_WriteEnable(void) {
+    spi_chip_select();
+    spi_xfer(W25_SPI, 0x06);
+    spi_chip_deselect();
+}
+void w25_WriteDisable(void) {
+    spi_chip_select();
+    spi_xfer(W25_SPI, 0x04);
+    spi_chip_deselect();
+}
+void w25_WaitForWriteEnd(void) {
+    wait_busy();
+    w25.Pending = W25_OP_NONE;
+}
+
+// ###################################################################################################################
+
+uint8_t w25_ReadStatusRegister(uint8_t SelectStatusRegister_1_2_3) {
+    uint8_t status = 0;
+
+    spi_chip_select();
+
+    if (SelectStatusRegister_1_2_3 == 1) {
+        spi_xfer(W25_SPI, 0x05);
+        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+        w25.StatusRegister1 = status;
+    } else if (SelectStatusRegister_1_2_3 == 2) {
+        spi_xfer(W25_SPI, 0x35);
+        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+        w25.StatusRegister2 = status;
+    } else {
+        spi_xfer(W25_SPI, 0x15);
+        status = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+        w25.StatusRegister3 = status;
+    }
+
+    spi_chip_deselect();
+
+    return status;
+}
+void w25_WriteStatusRegister(uint8_t SelectStatusRegister_1_2_3, uint8_t Data) {
+    spi_chip_select();
+
+    if (SelectStatusRegister_1_2_3 == 1) {
+        spi_xfer(W25_SPI, 0x01);
+        w25.StatusRegister1 = Data;
+    } else if (SelectStatusRegister_1_2_3 == 2) {
+        spi_xfer(W25_SPI, 0x31);
+        w25.StatusRegister2 = Data;
+    } else {
+        spi_xfer(W25_SPI, 0x11);
+        w25.StatusRegister3 = Data;
+    }
+
+    spi_xfer(W25_SPI, Data);
+
+    spi_chip_deselect();
+}
+
+// ###################################################################################################################
+
+void w25_EraseChip(void) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+
+    W25_LOG(LOG_DBG, "w25 EraseChip Begin...\r\n");
+
+    w25_WaitForWriteEnd();
+    w25_WriteEnable();
+
+    spi_chip_select();
+    spi_xfer(W25_SPI, 0xC7);
+    spi_chip_deselect();
+
+    w25_WaitForWriteEnd();
+
+    map_set(0, W25_MAP_NUM_SECTORS, W25_SECTOR_ERASED);
+
+    w25.Lock = 0;
+}
+void w25_EraseSector(uint32_t SectorAddr) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    W25_LOG(LOG_DBG, "w25 EraseSector %d Begin...\r\n", SectorAddr);
+    if (all_erased(SectorAddr, 1)) {
+        W25_LOG(LOG_DBG, "w25 Already Erased\r\n");
+        w25.Lock = 0;
+        return;
+    }
+    w25_WaitForWriteEnd();
+    start_erase(0x20, SectorAddr * w25.SectorSize);
+    w25_WaitForWriteEnd();
+    w25.Lock = 0;
+}
+void w25_EraseBlock(uint32_t BlockAddr) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    W25_LOG(LOG_DBG, "w25 EraseBlock %d Begin...\r\n", BlockAddr);
+    if (all_erased(BlockAddr * (w25.BlockSize / w25.SectorSize),
+                   w25.BlockSize / w25.SectorSize)) {
+        W25_LOG(LOG_DBG, "w25 Already Erased\r\n");
+        w25.Lock = 0;
+        return;
+    }
+    w25_WaitForWriteEnd();
+    start_erase(0xD8, BlockAddr * w25.BlockSize);
+    w25_WaitForWriteEnd();
+    w25.Lock = 0;
+}
+
+// ###################################################################################################################
+
+bool w25_EraseSectorStart(uint32_t SectorAddr) {
+    if (all_erased(SectorAddr, 1)) {
+        return true;
+    }
+    if (w25.Lock || w25_IsBusy()) {
+        return false;
+    }
+    w25.Lock = 1;
+    W25_LOG(LOG_DBG, "w25 EraseSectorStart %d\r\n", SectorAddr);
+    start_erase(0x20, SectorAddr * w25.SectorSize);
+    w25.Pending = W25_OP_ERASE;
+    w25.Lock = 0;
+    return true;
+}
+bool w25_EraseBlockStart(uint32_t BlockAddr) {
+    if (all_erased(BlockAddr * (w25.BlockSize / w25.SectorSize),
+                   w25.BlockSize / w25.SectorSize)) {
+        return true;
+    }
+    if (w25.Lock || w25_IsBusy()) {
+        return false;
+    }
+    w25.Lock = 1;
+    W25_LOG(LOG_DBG, "w25 EraseBlockStart %d\r\n", BlockAddr);
+    start_erase(0xD8, BlockAddr * w25.BlockSize);
+    w25.Pending = W25_OP_ERASE;
+    w25.Lock = 0;
+    return true;
+}
+bool w25_WritePageStart(uint8_t* pBuffer, uint32_t Page_Address,
+                        uint32_t OffsetInByte,
+                        uint32_t NumByteToWrite_up_to_PageSize) {
+    // Can't leave a program running inside a suspended erase, a page only
+    // takes a few ms so finish it here
+    if (w25.Pending == W25_OP_ERASE) {
+        w25_WritePage(pBuffer, Page_Address, OffsetInByte,
+                      NumByteToWrite_up_to_PageSize);
+        return true;
+    }
+    if (w25.Lock || w25_IsBusy()) {
+        return false;
+    }
+    w25.Lock = 1;
+    if (((NumByteToWrite_up_to_PageSize + OffsetInByte) > w25.PageSize) ||
+        (NumByteToWrite_up_to_PageSize == 0))
+        NumByteToWrite_up_to_PageSize = w25.PageSize - OffsetInByte;
+    W25_LOG(LOG_DBG, "w25 WritePageStart:%d, Offset:%d ,Writes %d Bytes\r\n",
+            Page_Address, OffsetInByte, NumByteToWrite_up_to_PageSize);
+    program(pBuffer, (Page_Address * w25.PageSize) + OffsetInByte,
+            NumByteToWrite_up_to_PageSize);
+    w25.Pending = W25_OP_PROGRAM;
+    w25.Lock = 0;
+    return true;
+}
+bool w25_IsBusy(void) {
+    if (w25.Pending == W25_OP_NONE) {
+        return false;
+    }
+    if (w25_ReadStatusRegister(1) & W25_SR1_BUSY) {
+        return true;
+    }
+    W25_LOG(LOG_DBG, "w25 Op %d Done\r\n", w25.Pending);
+    w25.Pending = W25_OP_NONE;
+    return false;
+}
+
+// ###################################################################################################################
+
+void w25_ScanErased(uint32_t SectorAddr, uint32_t NumSectors) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    W25_LOG(LOG_DBG, "w25 ScanErased %d, %d Sectors begin...\r\n", SectorAddr,
+            NumSectors);
+    // Written sectors stop at their first programmed byte, only erased ones
+    // are read in full
+    for (uint32_t i = SectorAddr; i < (SectorAddr + NumSectors); i++) {
+        if (w25_SectorState(i) == W25_SECTOR_UNKNOWN) {
+            is_empty(i * w25.SectorSize, w25.SectorSize);
+        }
+    }
+    w25.Lock = 0;
+}
+W25_SectorState_t w25_SectorState(uint32_t SectorAddr) {
+    if ((SectorAddr >= W25_MAP_NUM_SECTORS) ||
+        !(map_known[SectorAddr / 8] & (1 << (SectorAddr % 8)))) {
+        return W25_SECTOR_UNKNOWN;
+    }
+    return (map_erased[SectorAddr / 8] & (1 << (SectorAddr % 8)))
+               ? W25_SECTOR_ERASED
+               : W25_SECTOR_DIRTY;
+}
+
+// ###################################################################################################################
+
+uint32_t w25_PageToSector(uint32_t PageAddress) {
+    return ((PageAddress * w25.PageSize) / w25.SectorSize);
+}
+uint32_t w25_PageToBlock(uint32_t PageAddress) {
+    return ((PageAddress * w25.PageSize) / w25.BlockSize);
+}
+uint32_t w25_SectorToBlock(uint32_t SectorAddress) {
+    return ((SectorAddress * w25.SectorSize) / w25.BlockSize);
+}
+uint32_t w25_SectorToPage(uint32_t SectorAddress) {
+    return (SectorAddress * w25.SectorSize) / w25.PageSize;
+}
+uint32_t w25_BlockToPage(uint32_t BlockAddress) {
+    return (BlockAddress * w25.BlockSize) / w25.PageSize;
+}
+
+// ###################################################################################################################
+
+bool w25_IsEmptyPage(uint32_t Page_Address, uint32_t OffsetInByte,
+                     uint32_t NumByteToCheck_up_to_PageSize) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    if (((NumByteToCheck_up_to_PageSize + OffsetInByte) > w25.PageSize) ||
+        (NumByteToCheck_up_to_PageSize == 0))
+        NumByteToCheck_up_to_PageSize = w25.PageSize - OffsetInByte;
+    W25_LOG(LOG_DBG, "w25 CheckPage:%d, Offset:%d, Bytes:%d begin...\r\n",
+            Page_Address, OffsetInByte, NumByteToCheck_up_to_PageSize);
+    bool res = is_empty(Page_Address * w25.PageSize + OffsetInByte,
+                        NumByteToCheck_up_to_PageSize);
+    w25.Lock = 0;
+    return res;
+}
+bool w25_IsEmptySector(uint32_t Sector_Address, uint32_t OffsetInByte,
+                       uint32_t NumByteToCheck_up_to_SectorSize) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    if (((NumByteToCheck_up_to_SectorSize + OffsetInByte) > w25.SectorSize) ||
+        (NumByteToCheck_up_to_SectorSize == 0))
+        NumByteToCheck_up_to_SectorSize = w25.SectorSize - OffsetInByte;
+    W25_LOG(LOG_DBG, "w25 CheckSector:%d, Offset:%d, Bytes:%d begin...\r\n",
+            Sector_Address, OffsetInByte, NumByteToCheck_up_to_SectorSize);
+    bool res = is_empty(Sector_Address * w25.SectorSize + OffsetInByte,
+                        NumByteToCheck_up_to_SectorSize);
+    w25.Lock = 0;
+    return res;
+}
+bool w25_IsEmptyBlock(uint32_t Block_Address, uint32_t OffsetInByte,
+                      uint32_t NumByteToCheck_up_to_BlockSize) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    if (((NumByteToCheck_up_to_BlockSize + OffsetInByte) > w25.BlockSize) ||
+        (NumByteToCheck_up_to_BlockSize == 0))
+        NumByteToCheck_up_to_BlockSize = w25.BlockSize - OffsetInByte;
+    W25_LOG(LOG_DBG, "w25 CheckBlock:%d, Offset:%d, Bytes:%d begin...\r\n",
+            Block_Address, OffsetInByte, NumByteToCheck_up_to_BlockSize);
+    bool res = is_empty(Block_Address * w25.BlockSize + OffsetInByte,
+                        NumByteToCheck_up_to_BlockSize);
+    w25.Lock = 0;
+    return res;
+}
+
+// ###################################################################################################################
+
+void w25_WriteByte(uint8_t pBuffer, uint32_t WriteAddr_inBytes) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+
+    W25_LOG(LOG_DBG, "w25 WriteByte 0x%02X at address %d begin...", pBuffer,
+            WriteAddr_inBytes);
+
+    program(&pBuffer, WriteAddr_inBytes, 1);
+    w25.Lock = 0;
+}
+void w25_WritePage(uint8_t* pBuffer, uint32_t Page_Address,
+                   uint32_t OffsetInByte,
+                   uint32_t NumByteToWrite_up_to_PageSize) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+    if (((NumByteToWrite_up_to_PageSize + OffsetInByte) > w25.PageSize) ||
+        (NumByteToWrite_up_to_PageSize == 0))
+        NumByteToWrite_up_to_PageSize = w25.PageSize - OffsetInByte;
+    W25_LOG(LOG_DBG,
+            "w25 WritePage:%d, Offset:%d ,Writes %d Bytes, begin...\r\n",
+            Page_Address, OffsetInByte, NumByteToWrite_up_to_PageSize);
+
+    program(pBuffer, (Page_Address * w25.PageSize) + OffsetInByte,
+            NumByteToWrite_up_to_PageSize);
+
+    dump(pBuffer, NumByteToWrite_up_to_PageSize);
+
+    w25.Lock = 0;
+}
+void w25_WriteSector(uint8_t* pBuffer, uint32_t Sector_Address,
+                     uint32_t OffsetInByte,
+                     uint32_t NumByteToWrite_up_to_SectorSize) {
+    if ((NumByteToWrite_up_to_SectorSize > w25.SectorSize) ||
+        (NumByteToWrite_up_to_SectorSize == 0))
+        NumByteToWrite_up_to_SectorSize = w25.SectorSize;
+    W25_LOG(LOG_DBG,
+            "+++w25 WriteSector:%d, Offset:%d ,Write %d Bytes, begin...\r\n",
+            Sector_Address, OffsetInByte, NumByteToWrite_up_to_SectorSize);
+
+    if (OffsetInByte >= w25.SectorSize) {
+        serial_printf("---w25 WriteSector Faild!\r\n");
+
+        return;
+    }
+    uint32_t StartPage;
+    int32_t  BytesToWrite;
+    uint32_t LocalOffset;
+    if ((OffsetInByte + NumByteToWrite_up_to_SectorSize) > w25.SectorSize)
+        BytesToWrite = w25.SectorSize - OffsetInByte;
+    else
+        BytesToWrite = NumByteToWrite_up_to_SectorSize;
+    StartPage =
+        w25_SectorToPage(Sector_Address) + (OffsetInByte / w25.PageSize);
+    LocalOffset = OffsetInByte % w25.PageSize;
+    do {
+        w25_WritePage(pBuffer, StartPage, LocalOffset, BytesToWrite);
+        StartPage++;
+        BytesToWrite -= w25.PageSize - LocalOffset;
+        pBuffer += w25.PageSize - LocalOffset;
+        LocalOffset = 0;
+    } while (BytesToWrite > 0);
+    W25_LOG(LOG_DBG, "---w25 WriteSector Done\r\n");
+}
+void w25_WriteBlock(uint8_t* pBuffer, uint32_t Block_Address,
+                    uint32_t OffsetInByte,
+                    uint32_t NumByteToWrite_up_to_BlockSize) {
+    if ((NumByteToWrite_up_to_BlockSize > w25.BlockSize) ||
+        (NumByteToWrite_up_to_BlockSize == 0))
+        NumByteToWrite_up_to_BlockSize = w25.BlockSize;
+    W25_LOG(LOG_DBG,
+            "+++w25 WriteBlock:%d, Offset:%d ,Write %d Bytes, begin...\r\n",
+            Block_Address, OffsetInByte, NumByteToWrite_up_to_BlockSize);
+
+    if (OffsetInByte >= w25.BlockSize) {
+        serial_printf("---w25 WriteBlock Faild!\r\n");
+
+        return;
+    }
+    uint32_t StartPage;
+    int32_t  BytesToWrite;
+    uint32_t LocalOffset;
+    if ((OffsetInByte + NumByteToWrite_up_to_BlockSize) > w25.BlockSize)
+        BytesToWrite = w25.BlockSize - OffsetInByte;
+    else
+        BytesToWrite = NumByteToWrite_up_to_BlockSize;
+    StartPage = w25_BlockToPage(Block_Address) + (OffsetInByte / w25.PageSize);
+    LocalOffset = OffsetInByte % w25.PageSize;
+    do {
+        w25_WritePage(pBuffer, StartPage, LocalOffset, BytesToWrite);
+        StartPage++;
+        BytesToWrite -= w25.PageSize - LocalOffset;
+        pBuffer += w25.PageSize - LocalOffset;
+        LocalOffset = 0;
+    } while (BytesToWrite > 0);
+    W25_LOG(LOG_DBG, "---w25 WriteBlock Done\r\n");
+}
+
+// ###################################################################################################################
+
+void w25_ReadByte(uint8_t* pBuffer, uint32_t Bytes_Address) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+
+    W25_LOG(LOG_DBG, "w25 ReadByte at address %d begin...\r\n", Bytes_Address);
+
+    read_data(pBuffer, Bytes_Address, 1);
+    w25.Lock = 0;
+}
+void w25_ReadBytes(uint8_t* pBuffer, uint32_t ReadAddr,
+                   uint32_t NumByteToRead) {
+    while (w25.Lock == 1)
+        timers_delay_microseconds(1);
+    w25.Lock = 1;
+
+    W25_LOG(LOG_DBG, "w25 ReadBytes at Address:%d, %d Bytes  begin...\r\n",
+            ReadAddr, NumByteToRead);
+
+    read_data(pBuffer, ReadAddr, NumByteToRead);
+    dump(pBuffer, NumByteToRead);
+
+    w25.Lock = 0;
+}
+void w25_ReadPage(uint8_t* pBuffer, uint32_t Page_Address,
+                  uint32_t OffsetInByte,
+                  uint32_t NumByteToRead_up_to_PageSize) {
+    if ((NumByteToRead_up_to_PageSize > w25.PageSize) ||
+        (NumByteToRead_up_to_PageSize == 0))
+        NumByteToRead_up_to_PageSize = w25.PageSize;
+    if ((OffsetInByte + NumByteToRead_up_to_PageSize) > w25.PageSize)
+        NumByteToRead_up_to_PageSize = w25.PageSize - OffsetInByte;
+
+    w25_ReadBytes(pBuffer, Page_Address * w25.PageSize + OffsetInByte,
+                  NumByteToRead_up_to_PageSize);
+}
+void w25_ReadSector(uint8_t* pBuffer, uint32_t Sector_Address,
+                    uint32_t OffsetInByte,
+                    uint32_t NumByteToRead_up_to_SectorSize) {
+    if (OffsetInByte >= w25.SectorSize) {
+        serial_printf("---w25 ReadSector Faild!\r\n");
+
+        return;
+    }
+    if (((OffsetInByte + NumByteToRead_up_to_SectorSize) > w25.SectorSize) ||
+        (NumByteToRead_up_to_SectorSize == 0))
+        NumByteToRead_up_to_SectorSize = w25.SectorSize - OffsetInByte;
+
+    // Fast read carries on across pages, one burst for the lot
+    w25_ReadBytes(pBuffer, Sector_Address * w25.SectorSize + OffsetInByte,
+                  NumByteToRead_up_to_SectorSize);
+}
+void w25_ReadBlock(uint8_t* pBuffer, uint32_t Block_Address,
+                   uint32_t OffsetInByte,
+                   uint32_t NumByteToRead_up_to_BlockSize) {
+    if (OffsetInByte >= w25.BlockSize) {
+        serial_printf("w25 ReadBlock Faild!\r\n");
+
+        return;
+    }
+    if (((OffsetInByte + NumByteToRead_up_to_BlockSize) > w25.BlockSize) ||
+        (NumByteToRead_up_to_BlockSize == 0))
+        NumByteToRead_up_to_BlockSize = w25.BlockSize - OffsetInByte;
+
+    w25_ReadBytes(pBuffer, Block_Address * w25.BlockSize + OffsetInByte,
+                  NumByteToRead_up_to_BlockSize);
+}
+
+// ###################################################################################################################
+
+// Static Function Definitions
+
+static void spi_setup(void) {
+    // Set GPIO Mode
+    gpio_mode_setup(W25_SPI_MISO_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
+                    W25_SPI_MISO);
+
+    gpio_mode_setup(W25_SPI_SCK_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
+                    W25_SPI_SCK);
+    gpio_mode_setup(W25_SPI_MOSI_PORT, GPIO_MODE_AF, GPIO_PUPD_NONE,
+                    W25_SPI_MOSI);
+    gpio_mode_setup(W25_SPI_NSS_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+                    W25_SPI_NSS);
+
+    // Push Pull for outputs
+    gpio_set_output_options(W25_SPI_SCK_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
+                            W25_SPI_SCK);
+    gpio_set_output_options(W25_SPI_MOSI_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
+                            W25_SPI_MOSI);
+    gpio_set_output_options(W25_SPI_NSS_PORT, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ,
+                            W25_SPI_NSS);
+
+    // Set NSS pin high
+    gpio_set(W25_SPI_NSS_PORT, W25_SPI_NSS);
+
+    // Set alternate function
+    gpio_set_af(W25_SPI_MISO_PORT, W25_SPI_AF, W25_SPI_MISO);
+
+    gpio_set_af(W25_SPI_SCK_PORT, W25_SPI_AF, W25_SPI_SCK);
+    gpio_set_af(W25_SPI_MOSI_PORT, W25_SPI_AF, W25_SPI_MOSI);
+
+    // Init SPI
+    rcc_periph_clock_enable(W25_SPI_RCC);
+    rcc_periph_reset_pulse(W25_SPI_RST);
+    spi_disable(W25_SPI);
+    spi_init_master(
+        W25_SPI, SPI_CR1_BAUDRATE_FPCLK_DIV_2, SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE,
+        SPI_CR1_CPHA_CLK_TRANSITION_1, SPI_CR1_DFF_8BIT, SPI_CR1_MSBFIRST);
+    spi_enable(W25_SPI);
+
+    // DMA, only addresses & counts change per transfer
+    rcc_periph_clock_enable(RCC_DMA);
+
+    dma_channel_reset(DMA1, W25_SPI_DMA_RX_CHANNEL);
+    dma_set_channel_request(DMA1, W25_SPI_DMA_RX_CHANNEL, W25_SPI_DMA_REQ);
+    dma_set_read_from_peripheral(DMA1, W25_SPI_DMA_RX_CHANNEL);
+    dma_set_priority(DMA1, W25_SPI_DMA_RX_CHANNEL, DMA_CCR_PL_MEDIUM);
+    dma_set_peripheral_address(DMA1, W25_SPI_DMA_RX_CHANNEL,
+                               (uint32_t)&SPI_DR(W25_SPI));
+    dma_set_peripheral_size(DMA1, W25_SPI_DMA_RX_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_disable_peripheral_increment_mode(DMA1, W25_SPI_DMA_RX_CHANNEL);
+    dma_set_memory_size(DMA1, W25_SPI_DMA_RX_CHANNEL, DMA_CCR_MSIZE_8BIT);
+
+    dma_channel_reset(DMA1, W25_SPI_DMA_TX_CHANNEL);
+    dma_set_channel_request(DMA1, W25_SPI_DMA_TX_CHANNEL, W25_SPI_DMA_REQ);
+    dma_set_read_from_memory(DMA1, W25_SPI_DMA_TX_CHANNEL);
+    dma_set_priority(DMA1, W25_SPI_DMA_TX_CHANNEL, DMA_CCR_PL_LOW);
+    dma_set_peripheral_address(DMA1, W25_SPI_DMA_TX_CHANNEL,
+                               (uint32_t)&SPI_DR(W25_SPI));
+    dma_set_peripheral_size(DMA1, W25_SPI_DMA_TX_CHANNEL, DMA_CCR_PSIZE_8BIT);
+    dma_disable_peripheral_increment_mode(DMA1, W25_SPI_DMA_TX_CHANNEL);
+    dma_set_memory_size(DMA1, W25_SPI_DMA_TX_CHANNEL, DMA_CCR_MSIZE_8BIT);
+}
+
+// Full duplex burst, NULL tx clocks out dummy bytes, NULL rx discards.
+// Polls for completion so no interrupt is needed, RX finishing last means
+// every byte is off the bus
+static void spi_dma_xfer(const uint8_t* tx, uint8_t* rx, uint32_t len) {
+    while (len) {
+        uint16_t num = (len > W25_DMA_MAX) ? W25_DMA_MAX : (uint16_t)len;
+
+        if (rx) {
+            dma_set_memory_address(DMA1, W25_SPI_DMA_RX_CHANNEL, (uint32_t)rx);
+            dma_enable_memory_increment_mode(DMA1, W25_SPI_DMA_RX_CHANNEL);
+            rx += num;
+        } else {
+            dma_set_memory_address(DMA1, W25_SPI_DMA_RX_CHANNEL,
+                                   (uint32_t)&dma_rx_dummy);
+            dma_disable_memory_increment_mode(DMA1, W25_SPI_DMA_RX_CHANNEL);
+        }
+
+        if (tx) {
+            dma_set_memory_address(DMA1, W25_SPI_DMA_TX_CHANNEL, (uint32_t)tx);
+            dma_enable_memory_increment_mode(DMA1, W25_SPI_DMA_TX_CHANNEL);
+            tx += num;
+        } else {
+            dma_set_memory_address(DMA1, W25_SPI_DMA_TX_CHANNEL,
+                                   (uint32_t)&dma_tx_dummy);
+            dma_disable_memory_increment_mode(DMA1, W25_SPI_DMA_TX_CHANNEL);
+        }
+
+        dma_set_number_of_data(DMA1, W25_SPI_DMA_RX_CHANNEL, num);
+        dma_set_number_of_data(DMA1, W25_SPI_DMA_TX_CHANNEL, num);
+        dma_clear_interrupt_flags(DMA1, W25_SPI_DMA_RX_CHANNEL, DMA_TCIF);
+        dma_clear_interrupt_flags(DMA1, W25_SPI_DMA_TX_CHANNEL, DMA_TCIF);
+
+        // RX first so the first byte in is not missed
+        spi_enable_rx_dma(W25_SPI);
+        dma_enable_channel(DMA1, W25_SPI_DMA_RX_CHANNEL);
+        dma_enable_channel(DMA1, W25_SPI_DMA_TX_CHANNEL);
+        spi_enable_tx_dma(W25_SPI);
+
+        while (!dma_get_interrupt_flag(DMA1, W25_SPI_DMA_RX_CHANNEL,
+                                       DMA_TCIF)) {
+        }
+
+        spi_disable_tx_dma(W25_SPI);
+        spi_disable_rx_dma(W25_SPI);
+        dma_disable_channel(DMA1, W25_SPI_DMA_TX_CHANNEL);
+        dma_disable_channel(DMA1, W25_SPI_DMA_RX_CHANNEL);
+
+        len -= num;
+    }
+}
+
+static void send_cmd_addr(uint8_t cmd, uint32_t addr) {
+    spi_xfer(W25_SPI, cmd);
+    if (w25.ID >= W25Q256) spi_xfer(W25_SPI, (addr & 0xFF000000) >> 24);
+    spi_xfer(W25_SPI, (addr & 0xFF0000) >> 16);
+    spi_xfer(W25_SPI, (addr & 0xFF00) >> 8);
+    spi_xfer(W25_SPI, addr & 0xFF);
+}
+
+static void read_data(uint8_t* pBuffer, uint32_t addr, uint32_t len) {
+    bool suspended = hold_pending();
+
+    spi_chip_select();
+    send_cmd_addr(0x0B, addr);
+    spi_xfer(W25_SPI, 0);
+    spi_dma_xfer(NULL, pBuffer, len);
+    spi_chip_deselect();
+
+    if (suspended) {
+        resume();
+    }
+}
+
+static bool is_empty(uint32_t addr, uint32_t len) {
+    uint8_t  buf[W25_CHECK_CHUNK];
+    bool     res = true;
+    uint32_t first = addr / w25.SectorSize;
+    uint32_t sectors = ((addr + len - 1) / w25.SectorSize) - first + 1;
+    bool     whole = ((addr % w25.SectorSize) == 0) &&
+                 ((len % w25.SectorSize) == 0);
+
+    if (all_erased(first, sectors)) {
+        W25_LOG(LOG_DBG, "w25 Empty, mapped\r\n");
+        return true;
+    }
+
+    // Only sure a dirty sector isn't empty when checking all of it
+    for (uint32_t i = first; whole && (i < (first + sectors)); i++) {
+        if (w25_SectorState(i) == W25_SECTOR_DIRTY) {
+            W25_LOG(LOG_DBG, "w25 Not Empty, mapped\r\n");
+            return false;
+        }
+    }
+
+    bool suspended = hold_pending();
+
+    // One fast read, stop clocking at the first programmed byte
+    spi_chip_select();
+    send_cmd_addr(0x0B, addr);
+    spi_xfer(W25_SPI, 0);
+
+    while (len && res) {
+        uint32_t num = (len > sizeof(buf)) ? sizeof(buf) : len;
+
+        spi_dma_xfer(NULL, buf, num);
+
+        for (uint32_t i = 0; i < num; i++) {
+            if (buf[i] != 0xFF) {
+                map_set((addr + i) / w25.SectorSize, 1, W25_SECTOR_DIRTY);
+                res = false;
+                break;
+            }
+        }
+
+        addr += num;
+        len -= num;
+    }
+
+    spi_chip_deselect();
+
+    if (suspended) {
+        resume();
+    }
+
+    if (res && whole) {
+        map_set(first, sectors, W25_SECTOR_ERASED);
+    }
+
+    W25_LOG_S(LOG_DBG, "w25 %s\r\n", res ? "Empty" : "Not Empty");
+
+    return res;
+}
+
+static void dump(const uint8_t* pBuffer, uint32_t len) {
+    if (!LOG_ON(LOG_DBG, W25_LOG_LEVEL)) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        if ((i % 8 == 0) && (i > 2)) {
+            serial_printf("\r\n");
+        }
+        serial_printf("0x%02X,", pBuffer[i]);
+    }
+    serial_printf("\r\n");
+}
+
+static void wait_busy(void) {
+    spi_chip_select();
+
+    spi_xfer(W25_SPI, 0x05);
+
+    do {
+        w25.StatusRegister1 = spi_xfer(W25_SPI, W25_DUMMY_BYTE);
+        timers_delay_microseconds(10);
+    } while ((w25.StatusRegister1 & W25_SR1_BUSY) == W25_SR1_BUSY);
+
+    spi_chip_deselect();
+}
+
+static void start_erase(uint8_t cmd, uint32_t addr) {
+    // Marked erased from now on. Reads wait for it or suspend it, but read
+    // while suspended the sector may still be part erased
+    map_set(addr / w25.SectorSize,
+            (cmd == 0xD8) ? (w25.BlockSize / w25.SectorSize) : 1,
+            W25_SECTOR_ERASED);
+
+    w25_WriteEnable();
+    spi_chip_select();
+    send_cmd_addr(cmd, addr);
+    spi_chip_deselect();
+}
+
+// Programs are short, so wait here. A running erase is suspended around it
+static void program(uint8_t* pBuffer, uint32_t addr, uint32_t len) {
+    bool suspended = hold_pending();
+
+    map_set(addr / w25.SectorSize, 1, W25_SECTOR_DIRTY);
+
+    w25_WriteEnable();
+    spi_chip_select();
+    send_cmd_addr(0x02, addr);
+    spi_dma_xfer(pBuffer, NULL, len);
+    spi_chip_deselect();
+    wait_busy();
+
+    if (suspended) {
+        resume();
+    }
+}
+
+// Clear the way for a read or program. A pending program is waited out, a
+// pending erase is suspended & true returned so the caller resumes it
+static bool hold_pending(void) {
+    if (w25.Pending == W25_OP_PROGRAM) {
+        w25_WaitForWriteEnd();
+        return false;
+    }
+
+    if ((w25.Pending != W25_OP_ERASE) || !w25_IsBusy()) {
+        return false;
+    }
+
+    while ((timers_millis() - resume_time) < W25_RESUME_GAP_MS) {
+    }
+
+    spi_chip_select();
+    spi_xfer(W25_SPI, 0x75);
+    spi_chip_deselect();
+
+    // BUSY clears within tSUS, 20 us
+    wait_busy();
+
+    return true;
+}
+
+static void resume(void) {
+    spi_chip_select();
+    spi_xfer(W25_SPI, 0x7A);
+    spi_chip_deselect();
+
+    resume_time = timers_millis();
+}
+
+static void map_set(uint32_t first, uint32_t num, W25_SectorState_t state) {
+    for (uint32_t i = first;
+         (i < (first + num)) && (i < W25_MAP_NUM_SECTORS); i++) {
+        uint8_t bit = 1 << (i % 8);
+
+        if (state == W25_SECTOR_UNKNOWN) {
+            map_known[i / 8] &= ~bit;
+        } else {
+            map_known[i / 8] |= bit;
+        }
+
+        if (state == W25_SECTOR_ERASED) {
+            map_erased[i / 8] |= bit;
+        } else {
+            map_erased[i / 8] &= ~bit;
+        }
+    }
+}
+
+static bool all_erased(uint32_t first, uint32_t num) {
+    for (uint32_t i = first; i < (first + num); i++) {
+        if (w25_SectorState(i) != W25_SECTOR_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -21,6 +21,7 @@
 #include "common/reset.h"
 #include "common/rf_scan.h"
 #include "common/rfm.h"
+#include "common/state.h"
 #include "common/test.h"
 #include "common/timers.h"
 #include "config/board_defs.h"
@@ -67,37 +68,38 @@ int main(void) {
     boot_init();
 
     // If first power on
-    if (boot_info->init_key != BOOT_INIT_KEY2) {
+    if (state_info->init_key != BOOT_INIT_KEY2) {
         BOOT_LOG("First App Check\n");
 
         serial_printf(".Boot: %8u\n", VERSION);
 
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_fail_runs, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset, 0);
+        state_info->app_ok_key = 0;
+        state_info->app_num_fail_runs = 0;
+        state_info->app_num_iwdg_reset = 0;
 
         // Set initialized
-        mem_eeprom_write_word_ptr(&boot_info->init_key, BOOT_INIT_KEY2);
+        state_info->init_key = BOOT_INIT_KEY2;
+        state_commit();
     }
 
     // Setup eeprom for first run of new app
-    if (boot_info->app_init_key != BOOT_APP_INIT_KEY) {
+    if (state_info->app_init_key != BOOT_APP_INIT_KEY) {
         BOOT_LOG("Setup App\n");
 
-        // Boot Info
-        mem_eeprom_write_word_ptr(&boot_info->app_ok_key, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_fail_runs, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_num_iwdg_reset, 0);
+        // Boot Info, saved with app_init_key below
+        state_info->app_ok_key = 0;
+        state_info->app_num_fail_runs = 0;
+        state_info->app_num_iwdg_reset = 0;
 
-        mem_eeprom_write_word_ptr(&boot_info->app_version, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_update_version, 0);
-        mem_eeprom_write_word_ptr(&boot_info->app_previous_version, 0);
+        state_info->app_version = 0;
+        state_info->app_update_version = 0;
+        state_info->app_previous_version = 0;
 
         // Shared Info
         mem_eeprom_write_word_ptr(&shared_info->boot_version, VERSION);
         mem_eeprom_write_word_ptr(&shared_info->upg_pending, 0);
         mem_eeprom_write_word_ptr(&shared_info->upg_flags,
-                                  boot_info->upg_flags);
+                                  state_info->upg_flags);
 
         mem_eeprom_write_word_ptr(&shared_info->app_ok_key, 0);
         mem_eeprom_write_word_ptr(&shared_info->app_curr_version, 0);
@@ -120,7 +122,8 @@ int main(void) {
             mem_eeprom_write_byte((uint32_t)u8ptr, boot_info->pwd[i]);
         }
 
-        mem_eeprom_write_word_ptr(&boot_info->app_init_key, BOOT_APP_INIT_KEY);
+        state_info->app_init_key = BOOT_APP_INIT_KEY;
+        state_commit();
     }
 
     BOOT_LOG("Jump %8x\n\n----------\n\n", boot_info->vtor);